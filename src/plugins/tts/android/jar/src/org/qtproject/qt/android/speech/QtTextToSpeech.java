@@ -15,6 +15,7 @@ import android.os.Bundle;
 import android.util.Log;
 import java.lang.Float;
 import java.io.File;
+import java.nio.ByteBuffer;
 import java.util.Locale;
 import java.util.List;
 import java.util.ArrayList;
@@ -24,6 +25,12 @@ class QtTextToSpeech
 {
     private static final String UTTERANCE_ID = "UtteranceId";
     private static final String SYNTHESIZE_ID = "SynthesizeId";
+    // Audio is collected into this many bytes before it is passed on to native code.
+    // A multiple of all possible frame sizes, so that no frame is ever split.
+    private static final int AUDIO_BUFFER_SIZE = 8192;
+    // synthesizeToFile() is the only way to get the onAudioAvailable() callbacks. The audio
+    // written to the file is discarded, so that synthesis never touches the storage.
+    private static final File AUDIO_SINK = new File("/dev/null");
 
     // Native callback functions
     native void notifyError(long id, long reason);
@@ -31,7 +38,7 @@ class QtTextToSpeech
     native void notifySpeaking(long id);
     native void notifyRangeStart(long id, int start, int end, int frame);
     native void notifyBeginSynthesis(long id, int sampleRateInHz, int audioFormat, int channelCount);
-    native void notifyAudioAvailable(long id, byte[] bytes);
+    native void notifyAudioAvailable(long id, ByteBuffer buffer, int length);
     native void notifyEndSynthesis(long id);
 
     private TextToSpeech mTts;
@@ -40,6 +47,8 @@ class QtTextToSpeech
     private float mPitch = 1.0f;
     private float mRate = 1.0f;
     private float mVolume = 1.0f;
+    // direct, so that native code can read it without a JNI array copy
+    private final ByteBuffer mAudioBuffer = ByteBuffer.allocateDirect(AUDIO_BUFFER_SIZE);
 
     private static final String TAG = "QtTextToSpeech";
     // OnInitListener
@@ -67,6 +76,7 @@ class QtTextToSpeech
             if (utteranceId.equals(UTTERANCE_ID)) {
                 notifyReady(mId);
             } else if (utteranceId.equals(SYNTHESIZE_ID)) {
+                flushAudio();
                 notifyEndSynthesis(mId);
             }
         }
@@ -98,7 +108,7 @@ class QtTextToSpeech
         @Override
         public void onRangeStart(String utteranceId, int start, int end, int frame) {
             Log.w("UtteranceProgressListener", "onRangeStart");
-            if (utteranceId.equals("UtteranceId")) {
+            if (utteranceId.equals(UTTERANCE_ID) || utteranceId.equals(SYNTHESIZE_ID)) {
                 notifyRangeStart(mId, start, end, frame);
             }
         }
@@ -121,6 +131,7 @@ class QtTextToSpeech
                     audioFormat = 0; // QAudioFormat::Unknown;
                 }
 
+                mAudioBuffer.clear();
                 notifyBeginSynthesis(mId, sampleRateInHz, audioFormat, channelCount);
             }
         }
@@ -129,11 +140,25 @@ class QtTextToSpeech
         public void onAudioAvailable(String utteranceId, byte[] bytes) {
             Log.d(utteranceTAG, "onAudioAvailable");
             if (utteranceId.equals(SYNTHESIZE_ID)) {
-                notifyAudioAvailable(mId, bytes);
+                int offset = 0;
+                while (offset < bytes.length) {
+                    final int count = Math.min(mAudioBuffer.remaining(), bytes.length - offset);
+                    mAudioBuffer.put(bytes, offset, count);
+                    offset += count;
+                    if (!mAudioBuffer.hasRemaining())
+                        flushAudio();
+                }
             }
         }
     };
 
+    private void flushAudio()
+    {
+        if (mAudioBuffer.position() > 0)
+            notifyAudioAvailable(mId, mAudioBuffer, mAudioBuffer.position());
+        mAudioBuffer.clear();
+    }
+
     QtTextToSpeech(final Context context, final long id, String engine) {
         mId = id;
         if (engine.isEmpty()) {
@@ -182,8 +207,7 @@ class QtTextToSpeech
 
         Bundle params = new Bundle();
         params.putFloat(TextToSpeech.Engine.KEY_PARAM_VOLUME, mVolume);
-        File file = new File("/dev/null");
-        result = mTts.synthesizeToFile(text, params, file, SYNTHESIZE_ID);
+        result = mTts.synthesizeToFile(text, params, AUDIO_SINK, SYNTHESIZE_ID);
 
         Log.d(TAG, "TTS synthesize() result: " + Integer.toString(result));
         if (result == TextToSpeech.ERROR)
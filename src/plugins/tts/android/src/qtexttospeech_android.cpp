@@ -1,30 +1,57 @@
 // Copyright (C) 2021 The Qt Company Ltd.
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 #include "qtexttospeech_android.h"
+#include <qtqtexttospeechengineandroidplugin_tracepoints_p.h>
 
 #include <QtCore/qcoreapplication.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qoperatingsystemversion.h>
+#include <QtCore/qreadwritelock.h>
+#include <QtCore/qthread.h>
 
 QT_BEGIN_NAMESPACE
 
 static jclass g_qtSpeechClass = 0;
 
-typedef QMap<jlong, QTextToSpeechEngineAndroid *> TextToSpeechMap;
-Q_GLOBAL_STATIC(TextToSpeechMap, textToSpeechMap)
+// Maps the ids that the Java side reports back to the engines. Ids are never reused, so
+// that late callbacks for a destroyed engine can't reach a new one at the same address.
+struct EngineRegistry
+{
+    QReadWriteLock lock;
+    QHash<jlong, QTextToSpeechEngineAndroid *> engines;
+    jlong lastId = 0;
+};
+Q_GLOBAL_STATIC(EngineRegistry, engineRegistry)
 
 Q_DECLARE_JNI_CLASS(Locale, "java/util/Locale")
+Q_DECLARE_JNI_CLASS(ByteBuffer, "java/nio/ByteBuffer")
+
+// Calls the engine with the given id. The callbacks usually arrive on a Java thread,
+// then the call is queued while the lock keeps the engine from being destroyed.
+template <typename Method, typename ...Args>
+static void dispatch(jlong id, Qt::ConnectionType type, Method method, Args &&...args)
+{
+    QReadLocker locker(&engineRegistry->lock);
+    QTextToSpeechEngineAndroid *const tts = engineRegistry->engines.value(id);
+    if (!tts)
+        return;
+
+    if (type == Qt::AutoConnection && tts->thread() == QThread::currentThread()) {
+        // only this thread can destroy the engine, and the call might do that
+        locker.unlock();
+        (tts->*method)(std::forward<Args>(args)...);
+    } else {
+        QMetaObject::invokeMethod(tts, method, Qt::QueuedConnection, std::forward<Args>(args)...);
+    }
+}
 
 static void notifyError(JNIEnv *env, jobject thiz, jlong id, jlong reason)
 {
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
-    QMetaObject::invokeMethod(tts, "processNotifyError", Qt::AutoConnection,
-                              Q_ARG(int, reason));
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyError, id, reason);
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifyError, int(reason));
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyError)
 
@@ -33,11 +60,8 @@ static void notifyReady(JNIEnv *env, jobject thiz, jlong id)
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
-    QMetaObject::invokeMethod(tts, "processNotifyReady", Qt::AutoConnection);
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyReady, id);
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifyReady);
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyReady)
 
@@ -46,11 +70,8 @@ static void notifySpeaking(JNIEnv *env, jobject thiz, jlong id)
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
-    QMetaObject::invokeMethod(tts, "processNotifySpeaking", Qt::AutoConnection);
+    Q_TRACE(QTextToSpeechEngineAndroid_notifySpeaking, id);
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifySpeaking);
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifySpeaking)
 
@@ -59,12 +80,9 @@ static void notifyRangeStart(JNIEnv *env, jobject thiz, jlong id, jint start, ji
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
-    QMetaObject::invokeMethod(tts, "processNotifyRangeStart", Qt::AutoConnection,
-        Q_ARG(int, start), Q_ARG(int, end), Q_ARG(int, frame));
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyRangeStart, id, start, end, frame);
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifyRangeStart,
+             int(start), int(end), int(frame));
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyRangeStart)
 
@@ -73,34 +91,31 @@ static void notifyBeginSynthesis(JNIEnv *env, jobject thiz, jlong id, int sample
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyBeginSynthesis, id, sampleRateInHz, channelCount);
     QAudioFormat format;
     format.setSampleRate(sampleRateInHz);
     format.setSampleFormat(QAudioFormat::SampleFormat(audioFormat));
     format.setChannelCount(channelCount);
 
-    QMetaObject::invokeMethod(tts, "processNotifyBeginSynthesis", Qt::AutoConnection,
-        Q_ARG(QAudioFormat, format));
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifyBeginSynthesis,
+             format);
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyBeginSynthesis)
 
-static void notifyAudioAvailable(JNIEnv *env, jobject thiz, jlong id, jbyteArray bytes)
+static void notifyAudioAvailable(JNIEnv *env, jobject thiz, jlong id,
+                                 QtJniTypes::ByteBuffer buffer, jint length)
 {
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyAudioAvailable, id, length);
+    // The Java side batches the audio in a direct buffer that it reuses once we return,
+    // so copy the data out of it exactly once.
+    const char *data = static_cast<const char *>(env->GetDirectBufferAddress(buffer.object()));
+    if (!data || length <= 0 || length > env->GetDirectBufferCapacity(buffer.object()))
         return;
 
-    const auto sz = env->GetArrayLength(bytes);
-    QByteArray byteArray(sz, Qt::Initialization::Uninitialized);
-    env->GetByteArrayRegion(bytes, 0, sz, reinterpret_cast<jbyte *>(byteArray.data()));
-
-    QMetaObject::invokeMethod(tts, "processNotifyAudioAvailable", Qt::AutoConnection,
-        Q_ARG(QByteArray, byteArray));
+    dispatch(id, Qt::AutoConnection, &QTextToSpeechEngineAndroid::processNotifyAudioAvailable,
+             QByteArray(data, length));
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyAudioAvailable)
 
@@ -109,13 +124,10 @@ static void notifyEndSynthesis(JNIEnv *env, jobject thiz, jlong id)
     Q_UNUSED(env);
     Q_UNUSED(thiz);
 
-    QTextToSpeechEngineAndroid *const tts = (*textToSpeechMap)[id];
-    if (!tts)
-        return;
-
+    Q_TRACE(QTextToSpeechEngineAndroid_notifyEndSynthesis, id);
     // Queued so that pending processNotifyAudioAvailable
     // invocations get processed first.
-    QMetaObject::invokeMethod(tts, "processNotifyReady", Qt::QueuedConnection);
+    dispatch(id, Qt::QueuedConnection, &QTextToSpeechEngineAndroid::processNotifyReady);
 }
 Q_DECLARE_JNI_NATIVE_METHOD(notifyEndSynthesis)
 
@@ -166,15 +178,22 @@ QTextToSpeechEngineAndroid::QTextToSpeechEngineAndroid(const QVariantMap &parame
 
     const QString engine = parameters.value("androidEngine").toString();
 
-    const jlong id = reinterpret_cast<jlong>(this);
+    {
+        // register before the Java side can report anything
+        QWriteLocker locker(&engineRegistry->lock);
+        m_id = ++engineRegistry->lastId;
+        engineRegistry->engines.insert(m_id, this);
+    }
     m_speech = QJniObject::construct<QtJniTypes::QtTextToSpeech>(QNativeInterface::QAndroidApplication::context(),
-                                                                 id, QJniObject::fromString(engine).object<jstring>());
-    (*textToSpeechMap)[id] = this;
+                                                                 m_id, QJniObject::fromString(engine).object<jstring>());
 }
 
 QTextToSpeechEngineAndroid::~QTextToSpeechEngineAndroid()
 {
-    textToSpeechMap->remove(reinterpret_cast<jlong>(this));
+    {
+        QWriteLocker locker(&engineRegistry->lock);
+        engineRegistry->engines.remove(m_id);
+    }
     m_speech.callMethod<void>("shutdown");
 }
 
@@ -308,8 +327,15 @@ void QTextToSpeechEngineAndroid::processNotifySpeaking()
 
 void QTextToSpeechEngineAndroid::processNotifyRangeStart(int start, int end, int frame)
 {
-    Q_UNUSED(frame);
     const int length = end - start;
+    if (m_state == QTextToSpeech::Synthesizing) {
+        // the frame is the position of the range in the synthesized audio
+        if (m_format.isValid()) {
+            emit synthesizedWord(m_text.sliced(start, length), start, length,
+                                 m_format.durationForFrames(frame));
+        }
+        return;
+    }
     emit sayingWord(m_text.sliced(start, length), start,length);
 }
 
@@ -488,6 +514,21 @@ QList<QVoice> QTextToSpeechEngineAndroid::availableVoices() const
     return result;
 }
 
+QList<QVoice> QTextToSpeechEngineAndroid::allVoices(const QLocale *locale) const
+{
+    auto voices = m_speech.callObjectMethod("getAvailableVoices", "()Ljava/util/List;");
+    int count = voices.callMethod<jint>("size");
+    QList<QVoice> result;
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        auto jvoice = voices.callMethod<jobject>("get", i);
+        const QVoice voice = javaVoiceObjectToQVoice(jvoice);
+        if (!locale || voice.locale() == *locale)
+            result << voice;
+    }
+    return result;
+}
+
 bool QTextToSpeechEngineAndroid::setVoice(const QVoice &voice)
 {
     const QString id = voiceData(voice).toString();
@@ -27,6 +27,7 @@ public:
     QTextToSpeech::Capabilities capabilities() const override;
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -46,7 +47,7 @@ public:
     QTextToSpeech::ErrorReason errorReason() const override;
     QString errorString() const override;
 
-public Q_SLOTS:
+    // called for the notifications from the Java side
     void processNotifyReady();
     void processNotifyError(int reason);
     void processNotifySpeaking();
@@ -60,6 +61,7 @@ private:
     QVoice javaVoiceObjectToQVoice(QJniObject &obj) const;
 
     QJniObject m_speech;
+    jlong m_id = 0;
     QTextToSpeech::State m_state = QTextToSpeech::Error;
     QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
     QString m_errorString;
@@ -24,6 +24,7 @@ public:
 
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -45,11 +46,11 @@ public:
 
     void setState(QTextToSpeech::State state);
 
-    bool ignoreNextUtterance = false;
 private:
     AVSpeechSynthesisVoice *fromQVoice(const QVoice &voice) const;
     QVoice toQVoice(AVSpeechSynthesisVoice *avVoice) const;
     void setError(QTextToSpeech::ErrorReason reason, const QString &string);
+    void resetSynthesizer();
     AVSpeechUtterance *prepareUtterance(const QString &text);
 
     AVSpeechSynthesizer *m_speechSynthesizer;
@@ -58,6 +59,8 @@ private:
     QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
     QString m_errorString;
     QAudioFormat m_format;
+    // requested with the "sampleFormat" parameter, Unknown for the format the voice produces
+    QAudioFormat::SampleFormat m_sampleFormat = QAudioFormat::Unknown;
 
     double m_pitch = 0.0;
     double m_actualPitch = 1.0;
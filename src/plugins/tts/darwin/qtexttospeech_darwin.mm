@@ -2,13 +2,29 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include <AVFoundation/AVFoundation.h>
+#include <Accelerate/Accelerate.h>
 
 #include "qtexttospeech_darwin.h"
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QPointer>
+#include <QtCore/QThread>
+#include <QtCore/QVarLengthArray>
 #include <QtMultimedia/QAudioFormat>
 
+#include <algorithm>
+
+// The synthesizer calls its delegate on the main thread, while the engine
+// might live in another thread.
+template <typename Functor>
+static void callEngine(QTextToSpeechEngineDarwin *engine, Functor &&functor)
+{
+    if (engine->thread() == QThread::currentThread())
+        functor();
+    else
+        QMetaObject::invokeMethod(engine, std::forward<Functor>(functor), Qt::QueuedConnection);
+}
+
 @interface QDarwinSpeechSynthesizerDelegate : NSObject <AVSpeechSynthesizerDelegate>
 @end
 
@@ -28,48 +44,35 @@
 {
     Q_UNUSED(synthesizer);
     Q_UNUSED(utterance);
-    if (_engine->ignoreNextUtterance)
-        return;
-
-    _engine->setState(QTextToSpeech::Ready);
+    callEngine(_engine, [engine = _engine]{ engine->setState(QTextToSpeech::Ready); });
 }
 
 - (void)speechSynthesizer:(AVSpeechSynthesizer *)synthesizer didContinueSpeechUtterance:(AVSpeechUtterance *)utterance
 {
     Q_UNUSED(synthesizer);
     Q_UNUSED(utterance);
-    if (_engine->ignoreNextUtterance)
-        return;
-
-    _engine->setState(QTextToSpeech::Speaking);
+    callEngine(_engine, [engine = _engine]{ engine->setState(QTextToSpeech::Speaking); });
 }
 
 - (void)speechSynthesizer:(AVSpeechSynthesizer *)synthesizer didFinishSpeechUtterance:(AVSpeechUtterance *)utterance
 {
     Q_UNUSED(synthesizer);
     Q_UNUSED(utterance);
-    if (_engine->ignoreNextUtterance) {
-        _engine->ignoreNextUtterance = false;
-        return;
-    }
-    _engine->setState(QTextToSpeech::Ready);
+    callEngine(_engine, [engine = _engine]{ engine->setState(QTextToSpeech::Ready); });
 }
 
 - (void)speechSynthesizer:(AVSpeechSynthesizer *)synthesizer didPauseSpeechUtterance:(AVSpeechUtterance *)utterance
 {
     Q_UNUSED(synthesizer);
     Q_UNUSED(utterance);
-    _engine->setState(QTextToSpeech::Paused);
+    callEngine(_engine, [engine = _engine]{ engine->setState(QTextToSpeech::Paused); });
 }
 
 - (void)speechSynthesizer:(AVSpeechSynthesizer *)synthesizer didStartSpeechUtterance:(AVSpeechUtterance *)utterance
 {
     Q_UNUSED(synthesizer);
     Q_UNUSED(utterance);
-    if (_engine->ignoreNextUtterance)
-        return;
-
-    _engine->setState(QTextToSpeech::Speaking);
+    callEngine(_engine, [engine = _engine]{ engine->setState(QTextToSpeech::Speaking); });
 }
 
 - (void)speechSynthesizer:(AVSpeechSynthesizer *)synthesizer willSpeakRangeOfSpeechString:(NSRange)characterRange
@@ -85,8 +88,10 @@
     if (length && text.at(characterRange.location + length - 1).isPunct())
         --length;
     if (length) {
-        _engine->sayingWord(text.sliced(characterRange.location, length),
-                            characterRange.location, length);
+        callEngine(_engine, [engine = _engine, word = text.sliced(characterRange.location, length),
+                             start = qsizetype(characterRange.location), length]{
+            emit engine->sayingWord(word, start, length);
+        });
     }
 }
 
@@ -96,10 +101,24 @@
 
 QT_BEGIN_NAMESPACE
 
-QTextToSpeechEngineDarwin::QTextToSpeechEngineDarwin(const QVariantMap &/*parameters*/, QObject *parent)
+using namespace Qt::StringLiterals;
+
+QTextToSpeechEngineDarwin::QTextToSpeechEngineDarwin(const QVariantMap &parameters, QObject *parent)
     : QTextToSpeechEngine(parent)
     , m_speechSynthesizer([AVSpeechSynthesizer new])
 {
+    const QString sampleFormat = parameters.value("sampleFormat"_L1).toString();
+    if (sampleFormat == "UInt8"_L1)
+        m_sampleFormat = QAudioFormat::UInt8;
+    else if (sampleFormat == "Int16"_L1)
+        m_sampleFormat = QAudioFormat::Int16;
+    else if (sampleFormat == "Int32"_L1)
+        m_sampleFormat = QAudioFormat::Int32;
+    else if (sampleFormat == "Float"_L1)
+        m_sampleFormat = QAudioFormat::Float;
+    else if (!sampleFormat.isEmpty())
+        qWarning() << "Unsupported sample format" << sampleFormat;
+
     m_speechSynthesizer.delegate = [[QDarwinSpeechSynthesizerDelegate alloc] initWithTextToSpeechEngineDarwin:this];
     if (setLocale(QLocale()) || setLocale(QLocale().language())) {
         m_state = QTextToSpeech::Ready;
@@ -116,6 +135,18 @@ QTextToSpeechEngineDarwin::~QTextToSpeechEngineDarwin()
     [m_speechSynthesizer release];
 }
 
+void QTextToSpeechEngineDarwin::resetSynthesizer()
+{
+    AVSpeechSynthesizer *synthesizer = [AVSpeechSynthesizer new];
+    synthesizer.delegate = m_speechSynthesizer.delegate;
+    // the old synthesizer might still be stopping, it must not report that anymore
+    m_speechSynthesizer.delegate = nil;
+    [m_speechSynthesizer stopSpeakingAtBoundary:AVSpeechBoundaryImmediate];
+    [m_speechSynthesizer release];
+    m_speechSynthesizer = synthesizer;
+    m_actualPitch = 1.0;
+}
+
 AVSpeechUtterance *QTextToSpeechEngineDarwin::prepareUtterance(const QString &text)
 {
     // Qt pitch: [-1.0, 1.0], 0 is normal
@@ -128,19 +159,10 @@ AVSpeechUtterance *QTextToSpeechEngineDarwin::prepareUtterance(const QString &te
     // pitch with that value to compensate.
     // With the compensation, we might now have a pitch multipler outside of the AVF range, e.g.
     // to get from 2.0 to 0.5 we need a pitch multiplier of 1/4th. Sadly, the API blocks values
-    // lower than 0.5, but does allow values larger than 2.0. So we need to play a silent
-    // utterance (the string can't be empty) with a pitchMultiplier of 0.5 first!
-    if (desiredPitch / m_actualPitch < 0.5) {
-        ignoreNextUtterance = true; // signal delegate to ignore the next one
-        NSString *empty = @" ";
-        AVSpeechUtterance *correctionUtterance = [AVSpeechUtterance speechUtteranceWithString:empty];
-        correctionUtterance.volume = 0;
-        correctionUtterance.rate = AVSpeechUtteranceMaximumSpeechRate;
-        correctionUtterance.voice = fromQVoice(m_voice);
-        correctionUtterance.pitchMultiplier = 0.5;
-        m_actualPitch *= 0.5;
-        [m_speechSynthesizer speakUtterance:correctionUtterance];
-    }
+    // lower than 0.5, but does allow values larger than 2.0. A new synthesizer starts out with
+    // the normal pitch, so use one instead of speaking a silent correction utterance first.
+    if (desiredPitch / m_actualPitch < 0.5)
+        resetSynthesizer();
     AVSpeechUtterance *utterance = [AVSpeechUtterance speechUtteranceWithString:text.toNSString()];
     utterance.pitchMultiplier = desiredPitch / m_actualPitch;
     m_actualPitch *= utterance.pitchMultiplier;
@@ -171,6 +193,167 @@ void QTextToSpeechEngineDarwin::say(const QString &text)
     [m_speechSynthesizer speakUtterance:utterance];
 }
 
+namespace {
+
+// The sample types that AVAudioBuffers can carry
+enum class SampleType {
+    Unknown,
+    UInt8,
+    Int16,
+    Int32,
+    Float32,
+    Float64,
+};
+
+SampleType sampleType(const AVAudioFormat *format)
+{
+    switch (format.commonFormat) {
+    case AVAudioPCMFormatFloat32:
+        return SampleType::Float32;
+    case AVAudioPCMFormatFloat64:
+        return SampleType::Float64;
+    case AVAudioPCMFormatInt16:
+        return SampleType::Int16;
+    case AVAudioPCMFormatInt32:
+        return SampleType::Int32;
+    case AVAudioOtherFormat: {
+        const id bitKey = format.settings[@"AVLinearPCMBitDepthKey"];
+        const id isFloatKey = format.settings[@"AVLinearPCMIsFloatKey"];
+        if ([isFloatKey isEqual:@(YES)]) {
+            if ([bitKey isEqual:@(32)])
+                return SampleType::Float32;
+            if ([bitKey isEqual:@(64)])
+                return SampleType::Float64;
+        } else if ([bitKey isEqual:@(8)]) {
+            return SampleType::UInt8;
+        } else if ([bitKey isEqual:@(16)]) {
+            return SampleType::Int16;
+        } else if ([bitKey isEqual:@(32)]) {
+            return SampleType::Int32;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return SampleType::Unknown;
+}
+
+int bytesPerSample(SampleType type)
+{
+    switch (type) {
+    case SampleType::UInt8:
+        return 1;
+    case SampleType::Int16:
+        return 2;
+    case SampleType::Int32:
+    case SampleType::Float32:
+        return 4;
+    case SampleType::Float64:
+        return 8;
+    case SampleType::Unknown:
+        break;
+    }
+    return 0;
+}
+
+SampleType sampleType(QAudioFormat::SampleFormat format)
+{
+    switch (format) {
+    case QAudioFormat::UInt8:
+        return SampleType::UInt8;
+    case QAudioFormat::Int16:
+        return SampleType::Int16;
+    case QAudioFormat::Int32:
+        return SampleType::Int32;
+    case QAudioFormat::Float:
+        return SampleType::Float32;
+    default:
+        break;
+    }
+    return SampleType::Unknown;
+}
+
+// Converts n strided samples to normalized floats
+void toFloat(const void *src, vDSP_Stride srcStride, SampleType type,
+             float *dst, vDSP_Stride dstStride, vDSP_Length n)
+{
+    switch (type) {
+    case SampleType::Float32: {
+        const float one = 1.0f;
+        vDSP_vsmul(static_cast<const float *>(src), srcStride, &one, dst, dstStride, n);
+        break;
+    }
+    case SampleType::Float64:
+        vDSP_vdpsp(static_cast<const double *>(src), srcStride, dst, dstStride, n);
+        break;
+    case SampleType::Int16: {
+        const float scale = 1.0f / 32768.0f;
+        vDSP_vflt16(static_cast<const short *>(src), srcStride, dst, dstStride, n);
+        vDSP_vsmul(dst, dstStride, &scale, dst, dstStride, n);
+        break;
+    }
+    case SampleType::Int32: {
+        const float scale = 1.0f / 2147483648.0f;
+        vDSP_vflt32(static_cast<const int *>(src), srcStride, dst, dstStride, n);
+        vDSP_vsmul(dst, dstStride, &scale, dst, dstStride, n);
+        break;
+    }
+    case SampleType::UInt8: {
+        const float scale = 1.0f / 128.0f;
+        const float offset = -1.0f;
+        vDSP_vfltu8(static_cast<const unsigned char *>(src), srcStride, dst, dstStride, n);
+        vDSP_vsmsa(dst, dstStride, &scale, &offset, dst, dstStride, n);
+        break;
+    }
+    case SampleType::Unknown:
+        break;
+    }
+}
+
+// Converts n normalized floats to strided samples, using scratch for intermediate results
+void fromFloat(const float *src, SampleType type, void *dst, vDSP_Stride dstStride,
+               vDSP_Length n, float *scratch)
+{
+    const float low = -1.0f;
+    const float high = 1.0f;
+    switch (type) {
+    case SampleType::Float32: {
+        const float one = 1.0f;
+        vDSP_vsmul(src, 1, &one, static_cast<float *>(dst), dstStride, n);
+        break;
+    }
+    case SampleType::Int16: {
+        const float scale = 32767.0f;
+        vDSP_vclip(src, 1, &low, &high, scratch, 1, n);
+        vDSP_vsmul(scratch, 1, &scale, scratch, 1, n);
+        vDSP_vfixr16(scratch, 1, static_cast<short *>(dst), dstStride, n);
+        break;
+    }
+    case SampleType::Int32: {
+        // the largest float that still fits into an int
+        const float scale = 2147483520.0f;
+        vDSP_vclip(src, 1, &low, &high, scratch, 1, n);
+        vDSP_vsmul(scratch, 1, &scale, scratch, 1, n);
+        vDSP_vfixr32(scratch, 1, static_cast<int *>(dst), dstStride, n);
+        break;
+    }
+    case SampleType::UInt8: {
+        const float scale = 127.5f;
+        const float offset = 127.5f;
+        vDSP_vclip(src, 1, &low, &high, scratch, 1, n);
+        vDSP_vsmsa(scratch, 1, &scale, &offset, scratch, 1, n);
+        vDSP_vfixru8(scratch, 1, static_cast<unsigned char *>(dst), dstStride, n);
+        break;
+    }
+    case SampleType::Float64:
+    case SampleType::Unknown:
+        break;
+    }
+}
+
+} // namespace
+
 void QTextToSpeechEngineDarwin::synthesize(const QString &text)
 {
     AVSpeechUtterance *utterance = prepareUtterance(text);
@@ -184,57 +367,92 @@ void QTextToSpeechEngineDarwin::synthesize(const QString &text)
     const auto bufferCallback = ^(AVAudioBuffer *buffer){
         if (!that)
             return;
+        if (![buffer isKindOfClass:[AVAudioPCMBuffer class]])
+            return;
         setState(QTextToSpeech::Synthesizing);
 
+        AVAudioPCMBuffer *pcmBuffer = (AVAudioPCMBuffer *)buffer;
+        const AVAudioFormat *format = buffer.format;
+        const SampleType sourceType = sampleType(format);
         if (!m_format.isValid()) {
-            const AVAudioFormat *format = buffer.format;
             if (format.channelCount == 1)
                 m_format.setChannelConfig(QAudioFormat::ChannelConfigMono);
             else
                 m_format.setChannelCount(format.channelCount);
             m_format.setSampleRate(format.sampleRate);
-            m_format.setSampleFormat([&format]{
-                switch (format.commonFormat) {
-                case AVAudioPCMFormatFloat32:
-                    return QAudioFormat::Float;
-                case AVAudioPCMFormatInt16:
-                    return QAudioFormat::Int16;
-                case AVAudioPCMFormatInt32:
-                    return QAudioFormat::Int32;
-                case AVAudioPCMFormatFloat64:
-                    return QAudioFormat::Unknown;
-                case AVAudioOtherFormat: {
-                    const id bitKey = format.settings[@"AVLinearPCMBitDepthKey"];
-                    const id isFloatKey = format.settings[@"AVLinearPCMIsFloatKey"];
-                    if ([isFloatKey isEqual:@(YES)]) {
-                        if ([bitKey isEqual:@(32)])
-                            return QAudioFormat::Float;
-                    } else if ([bitKey isEqual:@(8)]) {
+            if (m_sampleFormat != QAudioFormat::Unknown) {
+                m_format.setSampleFormat(m_sampleFormat);
+            } else {
+                m_format.setSampleFormat([sourceType]{
+                    switch (sourceType) {
+                    case SampleType::UInt8:
                         return QAudioFormat::UInt8;
-                    } else if ([bitKey isEqual:@(16)]) {
+                    case SampleType::Int16:
                         return QAudioFormat::Int16;
-                    } else if ([bitKey isEqual:@(32)]) {
+                    case SampleType::Int32:
                         return QAudioFormat::Int32;
+                    // QAudioFormat has no 64 bit samples
+                    case SampleType::Float32:
+                    case SampleType::Float64:
+                        return QAudioFormat::Float;
+                    case SampleType::Unknown:
+                        break;
                     }
-                    break;
-                }
-                default:
-                    break;
-                }
-                return QAudioFormat::Unknown;
-            }());
-            if (!m_format.isValid())
+                    return QAudioFormat::Unknown;
+                }());
+            }
+            if (sourceType == SampleType::Unknown || !m_format.isValid())
                 qWarning() << "Audio arrived with invalid format:" << format.settings;
         }
+        if (sourceType == SampleType::Unknown || !m_format.isValid())
+            return;
+
+        const SampleType targetType = sampleType(m_format.sampleFormat());
+        const int channels = m_format.channelCount();
+        if (int(format.channelCount) != channels)
+            return;
+        const int sourceSampleSize = bytesPerSample(sourceType);
+        const bool interleaved = format.isInterleaved || channels == 1;
+
+        // Don't trust frameLength beyond what the buffers hold
+        const AudioBufferList *bufferList = pcmBuffer.audioBufferList;
+        const UInt32 expectedBuffers = interleaved ? 1 : UInt32(channels);
+        const UInt32 channelsPerBuffer = interleaved ? UInt32(channels) : 1;
+        if (bufferList->mNumberBuffers < expectedBuffers)
+            return;
+        vDSP_Length frames = pcmBuffer.frameLength;
+        for (UInt32 i = 0; i < expectedBuffers; ++i) {
+            const AudioBuffer &audioBuffer = bufferList->mBuffers[i];
+            if (audioBuffer.mNumberChannels != channelsPerBuffer || !audioBuffer.mData)
+                return;
+            frames = std::min<vDSP_Length>(frames,
+                        audioBuffer.mDataByteSize / (sourceSampleSize * channelsPerBuffer));
+        }
+        if (!frames)
+            return;
 
-        const AudioBufferList *bufferList = buffer.audioBufferList;
-        for (UInt32 i = 0; i < bufferList->mNumberBuffers; ++i) {
-            const AudioBuffer &buffer = bufferList->mBuffers[i];
-            // we expect all buffers to have the same number of channels
-            if (int(buffer.mNumberChannels) != m_format.channelCount())
-                continue;
-            emit synthesized(m_format, QByteArray::fromRawData(static_cast<const char *>(buffer.mData), buffer.mDataByteSize));
+        // The AVAudioBuffer is only valid during the callback, and a QByteArray can't keep it
+        // alive, so convert straight into the data we hand out.
+        QByteArray data(qsizetype(m_format.bytesForFrames(qint32(frames))), Qt::Uninitialized);
+        if (interleaved && sourceType == targetType) {
+            memcpy(data.data(), bufferList->mBuffers[0].mData, data.size());
+        } else {
+            QVarLengthArray<float, 1024> scratch(qsizetype(frames * 2));
+            float *samples = scratch.data();
+            float *temporary = samples + frames;
+            char *target = data.data();
+            const int targetSampleSize = m_format.bytesPerSample();
+            for (int channel = 0; channel < channels; ++channel) {
+                const char *source = interleaved
+                    ? static_cast<const char *>(bufferList->mBuffers[0].mData) + channel * sourceSampleSize
+                    : static_cast<const char *>(bufferList->mBuffers[channel].mData);
+                const vDSP_Stride sourceStride = interleaved ? channels : 1;
+                toFloat(source, sourceStride, sourceType, samples, 1, frames);
+                fromFloat(samples, targetType, target + channel * targetSampleSize, channels,
+                          frames, temporary);
+            }
         }
+        emit synthesized(m_format, data);
     };
     [m_speechSynthesizer writeUtterance:utterance
                          toBufferCallback:bufferCallback];
@@ -347,6 +565,19 @@ QList<QVoice> QTextToSpeechEngineDarwin::availableVoices() const
     return voices;
 }
 
+QList<QVoice> QTextToSpeechEngineDarwin::allVoices(const QLocale *locale) const
+{
+    QList<QVoice> voices;
+
+    for (AVSpeechSynthesisVoice *avVoice in [AVSpeechSynthesisVoice speechVoices]) {
+        if (locale && *locale != QLocale(QString::fromNSString(avVoice.language)))
+            continue;
+        voices << toQVoice(avVoice);
+    }
+
+    return voices;
+}
+
 bool QTextToSpeechEngineDarwin::setVoice(const QVoice &voice)
 {
     AVSpeechSynthesisVoice *avVoice = fromQVoice(voice);
@@ -2,8 +2,10 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include "qtexttospeech_flite.h"
+#include "qtexttospeech_flite_plugin.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QTextBoundaryFinder>
 
 QT_BEGIN_NAMESPACE
 
@@ -12,17 +14,47 @@ using namespace Qt::StringLiterals;
 QTextToSpeechEngineFlite::QTextToSpeechEngineFlite(const QVariantMap &parameters, QObject *parent)
     : QTextToSpeechEngine(parent)
 {
-    QAudioDevice audioDevice;
-    if (const auto it = parameters.find("audioDevice"_L1); it != parameters.end())
-        audioDevice = (*it).value<QAudioDevice>();
-    else
-        audioDevice = QMediaDevices::defaultAudioOutput();
+    // Without audio output, there's no need to look for devices
+    m_headless = parameters.value("headless"_L1).toBool();
 
-    if (audioDevice.isNull()) {
-        m_errorReason = QTextToSpeech::ErrorReason::Playback;
-        m_errorString = QCoreApplication::translate("QTextToSpeech", "No audio device available");
+    QAudioDevice audioDevice;
+    if (!m_headless) {
+        if (const auto it = parameters.find("audioDevice"_L1); it != parameters.end())
+            audioDevice = (*it).value<QAudioDevice>();
+        else
+            audioDevice = QMediaDevices::defaultAudioOutput();
+
+        if (audioDevice.isNull()) {
+            m_errorReason = QTextToSpeech::ErrorReason::Playback;
+            m_errorString = QCoreApplication::translate("QTextToSpeech", "No audio device available");
+        }
     }
     m_processor.reset(new QTextToSpeechProcessorFlite(audioDevice));
+    if (const auto it = parameters.find("sinkIdleTimeout"_L1); it != parameters.end())
+        m_processor->setSinkIdleTimeout((*it).toInt());
+    m_processor->setGapless(parameters.value("gapless"_L1).toBool(),
+                            parameters.value("utteranceGap"_L1).toInt());
+    if (const QString lexicon = parameters.value("lexicon"_L1).toString(); !lexicon.isEmpty())
+        m_lexicon = QTextToSpeechFliteLexicon::open(lexicon);
+    m_processor->setLexicon(m_lexicon);
+    if (!m_headless && !audioDevice.isNull()) {
+        QList<QTextToSpeechProcessorFlite::MirrorDevice> mirrors;
+        const QVariantList devices = parameters.value("additionalAudioDevices"_L1).toList();
+        for (const QVariant &entry : devices) {
+            QTextToSpeechProcessorFlite::MirrorDevice mirror;
+            if (entry.metaType() == QMetaType::fromType<QAudioDevice>()) {
+                mirror.device = entry.value<QAudioDevice>();
+            } else {
+                const QVariantMap map = entry.toMap();
+                mirror.device = map.value("device"_L1).value<QAudioDevice>();
+                mirror.volume = qMax(map.value("volume"_L1, 1.0).toDouble(), 0.0);
+                mirror.delay = qMax(map.value("delay"_L1).toInt(), 0);
+            }
+            if (!mirror.device.isNull() && mirror.device != audioDevice)
+                mirrors.append(mirror);
+        }
+        m_processor->setMirrorDevices(mirrors);
+    }
 
     // Connect processor to engine for state changes and error
     connect(m_processor.get(), &QTextToSpeechProcessorFlite::stateChanged,
@@ -32,9 +64,18 @@ QTextToSpeechEngineFlite::QTextToSpeechEngineFlite(const QVariantMap &parameters
     connect(m_processor.get(), &QTextToSpeechProcessorFlite::sayingWord, this,
             &QTextToSpeechEngine::sayingWord);
     connect(m_processor.get(), &QTextToSpeechProcessorFlite::synthesized, this,
-            &QTextToSpeechEngine::synthesized);
-
-    // Read voices from processor before moving it to a separate thread
+            [this](const QAudioFormat &format, const QByteArray &bytes) {
+        emit synthesized(format, bytes);
+        // receivers in this thread are done with the data now
+        m_processor->releaseSynthesized(bytes.size());
+    });
+    connect(m_processor.get(), &QTextToSpeechProcessorFlite::synthesizedWord, this,
+            &QTextToSpeechEngine::synthesizedWord);
+    connect(m_processor.get(), &QTextToSpeechProcessorFlite::audioUnderrun, this,
+            &QTextToSpeechEngine::audioUnderrun);
+
+    // Read voices from processor before moving it to a separate thread. The
+    // processor only knows which voices exist, it loads them on first use.
     const QList<QTextToSpeechProcessorFlite::VoiceInfo> voices = m_processor->voices();
 
     int voiceIndex = 0;
@@ -54,6 +95,11 @@ QTextToSpeechEngineFlite::QTextToSpeechEngineFlite(const QVariantMap &parameters
         m_state = QTextToSpeech::Ready;
         m_processor->moveToThread(&m_thread);
         m_thread.start();
+
+        const int workerThreads = parameters.value("workerThreads"_L1, 1).toInt();
+        if (workerThreads > 1)
+            startWorkers(qMin(workerThreads, QThread::idealThreadCount()));
+        preloadVoice();
     } else {
         m_errorReason = QTextToSpeech::ErrorReason::Configuration;
         m_errorString = QCoreApplication::translate("QTextToSpeech", "No voices available");
@@ -62,10 +108,64 @@ QTextToSpeechEngineFlite::QTextToSpeechEngineFlite(const QVariantMap &parameters
 
 QTextToSpeechEngineFlite::~QTextToSpeechEngineFlite()
 {
+    // processors might wait for us to take their data
+    m_processor->cancelSynthesis();
+    for (const Worker &worker : m_workers)
+        worker.processor->cancelSynthesis();
+    for (const Worker &worker : m_workers)
+        worker.thread->exit();
+    for (const Worker &worker : m_workers)
+        worker.thread->wait();
     m_thread.exit();
     m_thread.wait();
 }
 
+void QTextToSpeechEngineFlite::startWorkers(int count)
+{
+    m_workers.reserve(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        Worker &worker = m_workers.emplace_back();
+        // Workers only synthesize, so they don't need an audio device
+        worker.processor.reset(new QTextToSpeechProcessorFlite(QAudioDevice()));
+        // All processors share the voices that the engine found, and the
+        // voices that it loaded, so the voice IDs are identical
+        worker.processor->setLexicon(m_lexicon);
+
+        QTextToSpeechProcessorFlite *processor = worker.processor.get();
+        connect(processor, &QTextToSpeechProcessorFlite::stateChanged, this,
+                [this, i](QTextToSpeech::State state) {
+            workerStateChanged(i, state);
+        });
+        connect(processor, &QTextToSpeechProcessorFlite::errorOccurred, this,
+                [this, i](QTextToSpeech::ErrorReason error, const QString &errorString) {
+            workerErrorOccurred(i, error, errorString);
+        });
+        connect(processor, &QTextToSpeechProcessorFlite::synthesized, this,
+                [this, i](const QAudioFormat &format, const QByteArray &bytes) {
+            workerSynthesized(i, format, bytes);
+        });
+        connect(processor, &QTextToSpeechProcessorFlite::synthesizedWord, this,
+                [this, i](const QString &word, qsizetype start, qsizetype length,
+                          qint64 position) {
+            workerSynthesizedWord(i, word, start, length, position);
+        });
+
+        worker.thread.reset(new QThread);
+        processor->moveToThread(worker.thread.get());
+        worker.thread->start();
+    }
+
+    // A single worker would only add overhead compared to m_processor
+    if (m_workers.size() < 2) {
+        for (const Worker &worker : m_workers) {
+            worker.thread->exit();
+            worker.thread->wait();
+        }
+        m_workers.clear();
+    }
+    qCDebug(lcSpeechTtsFlite) << "Using" << m_workers.size() << "synthesis workers";
+}
+
 QList<QLocale> QTextToSpeechEngineFlite::availableLocales() const
 {
     return m_voices.uniqueKeys();
@@ -76,8 +176,32 @@ QList<QVoice> QTextToSpeechEngineFlite::availableVoices() const
     return m_voices.values(m_voice.locale());
 }
 
+QList<QVoice> QTextToSpeechEngineFlite::allVoices(const QLocale *locale) const
+{
+    if (locale)
+        return m_voices.values(*locale);
+    QList<QVoice> voices;
+    voices.reserve(m_voices.size());
+    for (const QLocale &voiceLocale : m_voices.uniqueKeys())
+        voices << m_voices.values(voiceLocale);
+    return voices;
+}
+
+QTextToSpeech::Capabilities QTextToSpeechEngineFlite::capabilities() const
+{
+    if (m_headless)
+        return QTextToSpeech::Capability::Synthesize;
+    // None, so that QTextToSpeech uses the values from the plugin's meta data
+    return QTextToSpeechEngine::capabilities();
+}
+
 void QTextToSpeechEngineFlite::say(const QString &text)
 {
+    if (m_headless) {
+        setError(QTextToSpeech::ErrorReason::Playback,
+                 QCoreApplication::translate("QTextToSpeech", "Speaking is not supported in headless mode."));
+        return;
+    }
     QMetaObject::invokeMethod(m_processor.get(), "say", Qt::QueuedConnection, Q_ARG(QString, text),
                               Q_ARG(int, voiceData(voice()).toInt()), Q_ARG(double, pitch()),
                               Q_ARG(double, rate()), Q_ARG(double, volume()));
@@ -85,6 +209,10 @@ void QTextToSpeechEngineFlite::say(const QString &text)
 
 void QTextToSpeechEngineFlite::synthesize(const QString &text)
 {
+    if (!m_workers.empty()) {
+        synthesizeWithWorkers(text);
+        return;
+    }
     QMetaObject::invokeMethod(m_processor.get(), "synthesize", Qt::QueuedConnection, Q_ARG(QString, text),
                               Q_ARG(int, voiceData(voice()).toInt()), Q_ARG(double, pitch()),
                               Q_ARG(double, rate()), Q_ARG(double, volume()));
@@ -93,6 +221,15 @@ void QTextToSpeechEngineFlite::synthesize(const QString &text)
 void QTextToSpeechEngineFlite::stop(QTextToSpeech::BoundaryHint boundaryHint)
 {
     Q_UNUSED(boundaryHint);
+    if (!m_segments.isEmpty()) {
+        cancelSegments();
+        changeState(QTextToSpeech::Ready);
+    }
+    // Directly, as the processors' threads might be blocked by flow control
+    if (m_state == QTextToSpeech::Synthesizing)
+        m_processor->cancelSynthesis();
+    for (const Worker &worker : m_workers)
+        worker.processor->cancelSynthesis();
     QMetaObject::invokeMethod(m_processor.get(), &QTextToSpeechProcessorFlite::stop, Qt::QueuedConnection);
 }
 
@@ -178,9 +315,25 @@ bool QTextToSpeechEngineFlite::setVoice(const QVoice &voice)
     }
 
     m_voice = voice;
+    preloadVoice();
     return true;
 }
 
+// Load the voice library in the background, so that it is ready when needed
+void QTextToSpeechEngineFlite::preloadVoice()
+{
+    if (!m_thread.isRunning())
+        return;
+
+    const int voiceId = voiceData(m_voice).toInt();
+    QMetaObject::invokeMethod(m_processor.get(), "preloadVoice", Qt::QueuedConnection,
+                              Q_ARG(int, voiceId));
+    for (const Worker &worker : m_workers) {
+        QMetaObject::invokeMethod(worker.processor.get(), "preloadVoice", Qt::QueuedConnection,
+                                  Q_ARG(int, voiceId));
+    }
+}
+
 void QTextToSpeechEngineFlite::changeState(QTextToSpeech::State newState)
 {
     if (newState != m_state) {
@@ -204,6 +357,17 @@ QString QTextToSpeechEngineFlite::errorString() const
     return m_errorString;
 }
 
+void QTextToSpeechEngineFlite::setSynthesizeBufferLimit(qsizetype bytes)
+{
+    m_processor->setSynthesizeBufferLimit(bytes);
+    if (m_workers.empty())
+        return;
+    // The workers together stay within the limit
+    const qsizetype workerLimit = bytes > 0 ? qMax(bytes / qsizetype(m_workers.size()), 1) : 0;
+    for (const Worker &worker : m_workers)
+        worker.processor->setSynthesizeBufferLimit(workerLimit);
+}
+
 void QTextToSpeechEngineFlite::setError(QTextToSpeech::ErrorReason error, const QString &errorString)
 {
     m_errorReason = error;
@@ -212,4 +376,165 @@ void QTextToSpeechEngineFlite::setError(QTextToSpeech::ErrorReason error, const
     emit errorOccurred(error, errorString);
 }
 
+/*
+    Splits the text into sentences and distributes those round-robin over the
+    workers. Each worker processes its segments in the order they are queued,
+    so the sequence numbers in Worker::segments tell us which segment the data
+    a worker produces belongs to. Data of segments that are not next in line
+    is buffered until all previous segments have been delivered.
+*/
+void QTextToSpeechEngineFlite::synthesizeWithWorkers(const QString &text)
+{
+    // sentences, and where they start in the text
+    QList<std::pair<QString, qsizetype>> sentences;
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Sentence, text);
+    qsizetype start = 0;
+    while (finder.toNextBoundary() != -1) {
+        const QStringView slice = QStringView(text).sliced(start, finder.position() - start);
+        const QStringView sentence = slice.trimmed();
+        if (!sentence.isEmpty())
+            sentences.append({sentence.toString(), start + (sentence.data() - slice.data())});
+        start = finder.position();
+    }
+    if (sentences.isEmpty())
+        return;
+
+    m_deliveredTime = 0;
+    const int voiceId = voiceData(voice()).toInt();
+    for (const auto &[sentence, offset] : std::as_const(sentences)) {
+        const qint64 segment = m_nextSegment++;
+        Worker &worker = m_workers[segment % m_workers.size()];
+        m_segments.insert(segment, Segment{{}, {}, offset});
+        worker.segments.enqueue(segment);
+        QMetaObject::invokeMethod(worker.processor.get(), "synthesize", Qt::QueuedConnection,
+                                  Q_ARG(QString, sentence), Q_ARG(int, voiceId),
+                                  Q_ARG(double, pitch()), Q_ARG(double, rate()),
+                                  Q_ARG(double, volume()));
+    }
+}
+
+void QTextToSpeechEngineFlite::workerStateChanged(qsizetype worker, QTextToSpeech::State state)
+{
+    QQueue<qint64> &segments = m_workers[worker].segments;
+    // processors also report states outside of a segment, e.g. when they
+    // finish initializing, or when their synthesis got canceled
+    if (segments.isEmpty())
+        return;
+    switch (state) {
+    case QTextToSpeech::Synthesizing:
+        if (m_segments.contains(segments.head()))
+            changeState(QTextToSpeech::Synthesizing);
+        break;
+    case QTextToSpeech::Ready:
+        // the processor reports Ready once the last chunk of a text is out
+        if (const auto it = m_segments.find(segments.dequeue()); it != m_segments.end()) {
+            it->finished = true;
+            deliverSegments();
+        }
+        break;
+    default:
+        // Errors are handled in workerErrorOccurred
+        break;
+    }
+}
+
+void QTextToSpeechEngineFlite::workerSynthesized(qsizetype worker, const QAudioFormat &format,
+                                                 const QByteArray &bytes)
+{
+    if (m_workers[worker].segments.isEmpty()) {
+        m_workers[worker].processor->releaseSynthesized(bytes.size());
+        return;
+    }
+    const qint64 segment = m_workers[worker].segments.head();
+    if (const auto it = m_segments.find(segment); it != m_segments.end()) {
+        it->chunks.append({format, bytes});
+        if (segment == m_deliveredSegment)
+            deliverSegments();
+    } else {
+        // canceled
+        m_workers[worker].processor->releaseSynthesized(bytes.size());
+    }
+}
+
+void QTextToSpeechEngineFlite::workerSynthesizedWord(qsizetype worker, const QString &word,
+                                                     qsizetype start, qsizetype length,
+                                                     qint64 position)
+{
+    if (m_workers[worker].segments.isEmpty())
+        return;
+    const qint64 segment = m_workers[worker].segments.head();
+    if (const auto it = m_segments.find(segment); it != m_segments.end()) {
+        it->words.append({word, it->textOffset + start, length, position});
+        if (segment == m_deliveredSegment)
+            deliverSegments();
+    }
+}
+
+void QTextToSpeechEngineFlite::workerErrorOccurred(qsizetype worker,
+                                                   QTextToSpeech::ErrorReason error,
+                                                   const QString &errorString)
+{
+    if (m_workers[worker].segments.isEmpty())
+        return;
+    // A failed segment doesn't report Ready
+    const qint64 segment = m_workers[worker].segments.dequeue();
+    if (!m_segments.contains(segment))
+        return;
+    cancelSegments();
+    setError(error, errorString);
+}
+
+void QTextToSpeechEngineFlite::deliverSegments()
+{
+    while (!m_segments.isEmpty()) {
+        const qint64 segment = m_deliveredSegment;
+        const auto it = m_segments.find(segment);
+        if (it == m_segments.end())
+            break;
+        // the segment's audio follows the audio of the previous segments
+        if (it->startTime < 0)
+            it->startTime = m_deliveredTime;
+        const qint64 startTime = it->startTime;
+        const auto words = std::exchange(it->words, {});
+        const auto chunks = std::exchange(it->chunks, {});
+        const bool finished = it->finished;
+        if (finished) {
+            m_segments.erase(it);
+            ++m_deliveredSegment;
+        }
+        for (const Word &word : words)
+            emit synthesizedWord(word.text, word.start, word.length, startTime + word.position);
+        QTextToSpeechProcessorFlite *processor = segmentProcessor(segment);
+        for (const auto &[format, bytes] : chunks) {
+            m_deliveredTime += format.durationForBytes(bytes.size());
+            emit synthesized(format, bytes);
+            processor->releaseSynthesized(bytes.size());
+        }
+        if (!finished)
+            return;
+    }
+
+    if (m_segments.isEmpty() && m_state == QTextToSpeech::Synthesizing)
+        changeState(QTextToSpeech::Ready);
+}
+
+// Drops all pending data; workers will still finish the text they have been
+// given, but whatever they produce for canceled segments gets ignored.
+void QTextToSpeechEngineFlite::cancelSegments()
+{
+    for (const auto &[segment, data] : m_segments.asKeyValueRange()) {
+        for (const auto &chunk : std::as_const(data.chunks))
+            segmentProcessor(segment)->releaseSynthesized(chunk.second.size());
+    }
+    for (const Worker &worker : m_workers)
+        worker.processor->cancelSynthesis();
+    m_segments.clear();
+    m_deliveredSegment = m_nextSegment;
+}
+
+QTextToSpeechProcessorFlite *QTextToSpeechEngineFlite::segmentProcessor(qint64 segment) const
+{
+    return m_workers[segment % m_workers.size()].processor.get();
+}
+
 QT_END_NAMESPACE
@@ -12,6 +12,10 @@
 #include <QtCore/QList>
 #include <QtCore/QLocale>
 #include <QtCore/QMultiHash>
+#include <QtCore/QHash>
+#include <QtCore/QQueue>
+
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 
@@ -24,8 +28,10 @@ public:
     ~QTextToSpeechEngineFlite() override;
 
     // Plug-in API:
+    QTextToSpeech::Capabilities capabilities() const override;
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -44,6 +50,7 @@ public:
     QTextToSpeech::State state() const override;
     QTextToSpeech::ErrorReason errorReason() const override;
     QString errorString() const override;
+    void setSynthesizeBufferLimit(qsizetype bytes) override;
 
 Q_SIGNALS:
     void speaking();
@@ -53,10 +60,29 @@ private slots:
     void changeState(QTextToSpeech::State newState);
     void setError(QTextToSpeech::ErrorReason error, const QString &errorString);
 
+private:
+    void preloadVoice();
+
+    // Synthesis worker pool, used by synthesize() if the "workerThreads"
+    // parameter asks for more than one worker.
+    void startWorkers(int count);
+    void synthesizeWithWorkers(const QString &text);
+    void workerStateChanged(qsizetype worker, QTextToSpeech::State state);
+    void workerSynthesized(qsizetype worker, const QAudioFormat &format, const QByteArray &bytes);
+    void workerSynthesizedWord(qsizetype worker, const QString &word, qsizetype start,
+                               qsizetype length, qint64 position);
+    void workerErrorOccurred(qsizetype worker, QTextToSpeech::ErrorReason error,
+                             const QString &errorString);
+    void deliverSegments();
+    void cancelSegments();
+    QTextToSpeechProcessorFlite *segmentProcessor(qint64 segment) const;
+
 private:
     QTextToSpeech::State m_state = QTextToSpeech::Error;
     QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
     QString m_errorString;
+    // synthesize only, without audio device
+    bool m_headless = false;
 
     QVoice m_voice;
     double m_rate = 0;
@@ -69,6 +95,42 @@ private:
     // Thread for blocking operations
     QThread m_thread;
     std::unique_ptr<QTextToSpeechProcessorFlite> m_processor;
+    // shared by the processors, which only read it
+    std::shared_ptr<const QTextToSpeechFliteLexicon> m_lexicon;
+
+    struct Worker
+    {
+        std::unique_ptr<QThread> thread;
+        std::unique_ptr<QTextToSpeechProcessorFlite> processor;
+        // sequence numbers of the segments queued on this worker, in order
+        QQueue<qint64> segments;
+    };
+    std::vector<Worker> m_workers;
+
+    struct Word
+    {
+        QString text;
+        qsizetype start; // in the text given to synthesize()
+        qsizetype length;
+        qint64 position; // in the audio of the segment
+    };
+    struct Segment
+    {
+        // the data counts against the buffer limit of the segment's worker
+        QList<std::pair<QAudioFormat, QByteArray>> chunks;
+        QList<Word> words;
+        qsizetype textOffset = 0;
+        // microseconds of audio delivered before this segment, once known
+        qint64 startTime = -1;
+        bool finished = false;
+    };
+    // Segments that are still being synthesized, or that are waiting for
+    // earlier segments to be delivered.
+    QHash<qint64, Segment> m_segments;
+    qint64 m_nextSegment = 0;
+    qint64 m_deliveredSegment = 0;
+    // microseconds of audio delivered for the current text
+    qint64 m_deliveredTime = 0;
 };
 
 QT_END_NAMESPACE
@@ -3,18 +3,96 @@
 
 #include "qtexttospeech_flite_processor.h"
 #include "qtexttospeech_flite_plugin.h"
+#include <qtqtexttospeechfliteplugin_tracepoints_p.h>
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QString>
 #include <QtCore/QLocale>
 #include <QtCore/QMap>
+#include <QtCore/QHash>
 
 #include <flite/flite.h>
 
+#include <algorithm>
+
 QT_BEGIN_NAMESPACE
 
 using namespace Qt::StringLiterals;
 
+std::shared_ptr<const QTextToSpeechFliteLexicon> QTextToSpeechFliteLexicon::open(const QString &fileName)
+{
+    std::shared_ptr<QTextToSpeechFliteLexicon> lexicon(new QTextToSpeechFliteLexicon);
+    QFile &file = lexicon->m_file;
+    file.setFileName(fileName);
+    const uchar *data = file.open(QIODevice::ReadOnly) && file.size() > 0
+                      ? file.map(0, file.size()) : nullptr;
+    if (!data) {
+        qCWarning(lcSpeechTtsFlite) << "Cannot map the lexicon" << fileName << file.errorString();
+        return nullptr;
+    }
+
+    // Bisecting the lines only needs their positions
+    const QByteArrayView bytes(data, file.size());
+    qsizetype start = 0;
+    while (start < bytes.size()) {
+        qsizetype end = bytes.indexOf('\n', start);
+        if (end < 0)
+            end = bytes.size();
+        const QByteArrayView line = bytes.sliced(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty())
+            continue;
+        if (!lexicon->m_lines.isEmpty() && word(line) <= word(lexicon->m_lines.last())) {
+            qCWarning(lcSpeechTtsFlite) << "The lexicon" << fileName
+                                        << "is not sorted by word at" << line.toByteArray();
+            return nullptr;
+        }
+        lexicon->m_lines.append(line);
+    }
+    return lexicon;
+}
+
+QByteArrayView QTextToSpeechFliteLexicon::pronunciation(QByteArrayView word) const
+{
+    const auto it = std::lower_bound(m_lines.cbegin(), m_lines.cend(), word,
+                                     [](QByteArrayView line, QByteArrayView word) {
+        return QTextToSpeechFliteLexicon::word(line) < word;
+    });
+    if (it == m_lines.cend() || QTextToSpeechFliteLexicon::word(*it) != word)
+        return {};
+    return it->sliced(word.size()).trimmed();
+}
+
+QByteArrayView QTextToSpeechFliteLexicon::word(QByteArrayView line)
+{
+    const qsizetype space = line.indexOf(' ');
+    return space < 0 ? line : line.first(space);
+}
+
+namespace {
+// Pronunciations that the lexicons returned, by lexicon, and by the first
+// letter of the part of speech and the word. All clones of a voice, in all
+// processors, use the voice's lexicon.
+struct PronunciationCache
+{
+    QMutex mutex;
+    QHash<const cst_lexicon *, QHash<QByteArray, QByteArray>> entries;
+};
+Q_GLOBAL_STATIC(PronunciationCache, pronunciationCache)
+// per lexicon; the cache starts over once that is reached
+constexpr qsizetype MaxCachedPronunciations = 16384;
+
+cst_val *phoneList(const QByteArray &phones)
+{
+    cst_val *list = nullptr;
+    for (const QByteArray &phone : phones.split(' ')) {
+        if (!phone.isEmpty())
+            list = cons_val(string_val(phone.constData()), list);
+    }
+    return val_reverse(list);
+}
+}
+
 QTextToSpeechProcessorFlite::QTextToSpeechProcessorFlite(const QAudioDevice &audioDevice)
     : m_audioDevice(audioDevice)
 {
@@ -23,8 +101,13 @@ QTextToSpeechProcessorFlite::QTextToSpeechProcessorFlite(const QAudioDevice &aud
 
 QTextToSpeechProcessorFlite::~QTextToSpeechProcessorFlite()
 {
-    for (const VoiceInfo &voice : std::as_const(m_voices))
-        voice.unregister_func(voice.vox);
+    resetUtteranceConfig();
+    for (const VoiceInfo &voice : std::as_const(m_voices)) {
+        if (voice.vox) {
+            deleteVoiceClone(voice.vox);
+            releaseVoice(voice);
+        }
+    }
 }
 
 const QList<QTextToSpeechProcessorFlite::VoiceInfo> &QTextToSpeechProcessorFlite::voices() const
@@ -32,47 +115,117 @@ const QList<QTextToSpeechProcessorFlite::VoiceInfo> &QTextToSpeechProcessorFlite
     return m_voices;
 }
 
+void QTextToSpeechProcessorFlite::setSinkIdleTimeout(int msecs)
+{
+    m_sinkIdleTimeout = msecs;
+}
+
+void QTextToSpeechProcessorFlite::setGapless(bool gapless, int utteranceGap)
+{
+    m_gapless = gapless;
+    m_utteranceGap = qMax(utteranceGap, 0);
+}
+
+void QTextToSpeechProcessorFlite::setLexicon(const std::shared_ptr<const QTextToSpeechFliteLexicon> &lexicon)
+{
+    m_lexicon = lexicon;
+}
+
+void QTextToSpeechProcessorFlite::setMirrorDevices(const QList<MirrorDevice> &devices)
+{
+    m_mirrors.clear();
+    for (const MirrorDevice &device : devices)
+        m_mirrors.append({device});
+}
+
+// The number of frames that the sink has played
+qint64 QTextToSpeechProcessorFlite::playbackPosition() const
+{
+    return m_audioSink->processedUSecs() * m_format.sampleRate() / 1000000;
+}
+
+// Schedule the next word boundary on the sink's timeline
 void QTextToSpeechProcessorFlite::startTokenTimer()
 {
     qCDebug(lcSpeechTtsFlite) << "Starting token timer with" << m_tokens.count() - m_currentToken << "left";
 
+    if (!m_audioSink || !m_format.sampleRate())
+        return;
     const TokenData &token = m_tokens.at(m_currentToken);
-    const qint64 playedTime = m_audioSink->processedUSecs() / 1000;
-    m_tokenTimer.start(qMax(token.startTime - playedTime, 0), Qt::PreciseTimer, this);
+    const qint64 frames = m_utteranceStart + token.startFrame - playbackPosition();
+    m_tokenTimer.start(qMax(frames * 1000 / m_format.sampleRate(), 0), Qt::PreciseTimer, this);
 }
 
-int QTextToSpeechProcessorFlite::audioOutputCb(const cst_wave *w, int start, int size,
-                                               int last, cst_audio_streaming_info *asi)
+// The number of UTF-16 code units of UTF-8 text
+static qsizetype utf16Length(QByteArrayView utf8)
 {
-    QTextToSpeechProcessorFlite *processor = static_cast<QTextToSpeechProcessorFlite *>(asi->userdata);
-    if (processor) {
-        if (asi->item == NULL)
-            asi->item = relation_head(utt_relation(asi->utt,"Token"));
+    qsizetype length = 0;
+    for (const char c : utf8) {
+        const uchar byte = uchar(c);
+        // every code point starts with a byte that is not a continuation byte,
+        // and those of 4 bytes need a surrogate pair
+        if ((byte & 0xc0) != 0x80)
+            ++length;
+        if (byte >= 0xf0)
+            ++length;
+    }
+    return length;
+}
 
+// Records the tokens that start in the samples that Flite streams next
+void QTextToSpeechProcessorFlite::readTokens(const cst_wave *w, int start, int size,
+                                             cst_audio_streaming_info *asi)
+{
+    if (asi->item == NULL)
+        asi->item = relation_head(utt_relation(asi->utt,"Token"));
+
+    while (asi->item) {
         const float startTime = flite_ffeature_float(asi->item, "R:Token.daughter1.R:SylStructure.daughter1.daughter1.R:Segment.p.end");
         const int startSample = int(startTime * float(w->sample_rate));
-        if ((startSample >= start) && (startSample < start + size)) {
-            const char *ws = flite_ffeature_string(asi->item, "whitespace");
-            const char *prepunc = flite_ffeature_string(asi->item, "prepunctuation");
-            if (cst_streq("0",prepunc))
-                prepunc = "";
-            const char *token = flite_ffeature_string(asi->item, "name");
-            const char *postpunc = flite_ffeature_string(asi->item, "punc");
-            if (cst_streq("0",postpunc))
-                postpunc = "";
-            if (token) {
-                qCDebug(lcSpeechTtsFlite).nospace() << "Processing token start_time: " << startTime
-                                                    << " content: \"" << ws << prepunc << "'" << token << "'" << postpunc << "\"";
-                processor->m_tokens.append(TokenData{
-                    qRound(startTime * 1000),
-                    QString::fromUtf8(token)
-                });
-                if (!processor->m_tokenTimer.isActive())
-                    processor->startTokenTimer();
+        if (startSample >= start + size)
+            break;
+
+        const char *ws = flite_ffeature_string(asi->item, "whitespace");
+        const char *prepunc = flite_ffeature_string(asi->item, "prepunctuation");
+        if (cst_streq("0",prepunc))
+            prepunc = "";
+        const char *token = flite_ffeature_string(asi->item, "name");
+        const char *postpunc = flite_ffeature_string(asi->item, "punc");
+        if (cst_streq("0",postpunc))
+            postpunc = "";
+        if (token && *token) {
+            qCDebug(lcSpeechTtsFlite).nospace() << "Processing token start_time: " << startTime
+                                                << " content: \"" << ws << prepunc << "'" << token << "'" << postpunc << "\"";
+            // Tokens come in the order of the text, so each search continues
+            // where the previous one ended. Search the UTF-8 text that Flite
+            // got, and count the positions in m_text on the way.
+            const QByteArrayView name(token);
+            const qsizetype begin = m_utf8Text.indexOf(name, m_utf8Index);
+            if (begin >= 0) {
+                const QByteArrayView utf8Text(m_utf8Text);
+                m_index += utf16Length(utf8Text.sliced(m_utf8Index, begin - m_utf8Index));
+                const qsizetype length = utf16Length(name);
+                m_tokens.append(TokenData{startSample, m_index, length});
+                m_index += length;
+                m_utf8Index = begin + name.size();
             }
-            asi->item = item_next(asi->item);
         }
-        return processor->audioOutput(w, start, size, last, asi);
+        asi->item = item_next(asi->item);
+    }
+}
+
+int QTextToSpeechProcessorFlite::audioOutputCb(const cst_wave *w, int start, int size,
+                                               int last, cst_audio_streaming_info *asi)
+{
+    QTextToSpeechProcessorFlite *processor = static_cast<QTextToSpeechProcessorFlite *>(asi->userdata);
+    if (processor) {
+        processor->readTokens(w, start, size, asi);
+        const int result = processor->audioOutput(w, start, size, last, asi);
+        if (result == CST_AUDIO_STREAM_CONT && !processor->m_tokenTimer.isActive()
+            && processor->m_currentToken < processor->m_tokens.size()) {
+            processor->startTokenTimer();
+        }
+        return result;
     }
     return CST_AUDIO_STREAM_STOP;
 }
@@ -82,28 +235,58 @@ int QTextToSpeechProcessorFlite::audioOutput(const cst_wave *w, int start, int s
 {
     Q_UNUSED(asi);
     Q_ASSERT(QThread::currentThread() == thread());
+    Q_TRACE(QTextToSpeechProcessorFlite_audioOutput, start, size, last);
     if (size == 0)
         return CST_AUDIO_STREAM_CONT;
-    if (start == 0 && !initAudio(w->sample_rate, w->num_channels))
-        return CST_AUDIO_STREAM_STOP;
+    if (start == 0) {
+        if (!initAudio(w->sample_rate, w->num_channels))
+            return CST_AUDIO_STREAM_STOP;
+        m_startLatency = m_synthesisTimer.elapsed();
+        // A warm sink might still have data of a previous utterance to play
+        const qint64 queuedBytes = m_audioSink->bufferSize() - m_audioSink->bytesFree();
+        m_utteranceStart = playbackPosition() + qMax(queuedBytes, 0) / m_format.bytesPerFrame();
+        if (m_gapless && queuedBytes > 0 && m_utteranceGap > 0) {
+            const QByteArray silence(m_format.bytesForDuration(m_utteranceGap * 1000), '\0');
+            if (writeAudio(silence.constData(), silence.size()))
+                m_utteranceStart += m_format.framesForBytes(silence.size());
+        }
+
+        // Delay the mirrors that start playing now. Those that still play the
+        // previous utterance are delayed already.
+        for (Mirror &mirror : m_mirrors) {
+            if (mirror.buffer && mirror.delay > 0
+                && mirror.sink->bytesFree() == mirror.sink->bufferSize()) {
+                const QByteArray silence(m_format.bytesForDuration(mirror.delay * 1000), '\0');
+                mirror.buffer->write(silence);
+            }
+        }
+    }
 
     const qsizetype bytesToWrite = size * sizeof(short);
 
-    if (!m_audioBuffer->write(reinterpret_cast<const char *>(&w->samples[start]), bytesToWrite)) {
+    // The sink played everything before flite had the next chunk ready
+    if (start > 0 && m_audioSink->state() == QAudio::IdleState)
+        emit audioUnderrun();
+
+    if (!writeAudio(reinterpret_cast<const char *>(&w->samples[start]), bytesToWrite)) {
         setError(QTextToSpeech::ErrorReason::Playback,
                  QCoreApplication::translate("QTextToSpeech", "Audio streaming error."));
         stop();
         return CST_AUDIO_STREAM_STOP;
     }
+    // A sink that still plays the previous utterance doesn't change its state
+    if (start == 0 && m_audioSink->state() == QAudio::ActiveState
+        && m_state != QAudio::ActiveState) {
+        changeState(QAudio::ActiveState);
+    }
 
     // Stats for debugging
     ++numberChunks;
     totalBytes += bytesToWrite;
 
-    if (last == 1) {
+    // Keep the device open, the next utterance writes into it as well
+    if (last == 1)
         qCDebug(lcSpeechTtsFlite) << "last data chunk written";
-        m_audioBuffer->close();
-    }
     return CST_AUDIO_STREAM_CONT;
 }
 
@@ -111,30 +294,49 @@ int QTextToSpeechProcessorFlite::dataOutputCb(const cst_wave *w, int start, int
                                               int last, cst_audio_streaming_info *asi)
 {
     QTextToSpeechProcessorFlite *processor = static_cast<QTextToSpeechProcessorFlite *>(asi->userdata);
-    if (processor)
+    if (processor) {
+        processor->readTokens(w, start, size, asi);
         return processor->dataOutput(w, start, size, last, asi);
+    }
     return CST_AUDIO_STREAM_STOP;
 }
 
 int QTextToSpeechProcessorFlite::dataOutput(const cst_wave *w, int start, int size,
                                             int last, cst_audio_streaming_info *)
 {
-    if (start == 0)
+    Q_TRACE(QTextToSpeechProcessorFlite_dataOutput, start, size, last);
+    if (start == 0) {
         emit stateChanged(QTextToSpeech::Synthesizing);
 
-    QAudioFormat format;
-    if (w->num_channels == 1)
-        format.setChannelConfig(QAudioFormat::ChannelConfigMono);
-    else
-        format.setChannelCount(w->num_channels);
-    format.setSampleRate(w->sample_rate);
-    format.setSampleFormat(QAudioFormat::Int16);
+        m_synthesizeFormat = QAudioFormat();
+        if (w->num_channels == 1)
+            m_synthesizeFormat.setChannelConfig(QAudioFormat::ChannelConfigMono);
+        else
+            m_synthesizeFormat.setChannelCount(w->num_channels);
+        m_synthesizeFormat.setSampleRate(w->sample_rate);
+        m_synthesizeFormat.setSampleFormat(QAudioFormat::Int16);
+    }
 
-    if (!format.isValid())
+    if (!m_synthesizeFormat.isValid())
         return CST_AUDIO_STREAM_STOP;
 
-    const qsizetype bytesToWrite = size * format.bytesPerSample();
-    emit synthesized(format, QByteArray(reinterpret_cast<const char *>(&w->samples[start]), bytesToWrite));
+    // report the words before the audio that they start in
+    for (; m_currentToken < m_tokens.size(); ++m_currentToken) {
+        const TokenData &token = m_tokens.at(m_currentToken);
+        emit synthesizedWord(m_text.sliced(token.begin, token.length), token.begin, token.length,
+                             m_synthesizeFormat.durationForFrames(token.startFrame));
+    }
+
+    // The wave gets deleted together with the utterance once processText returns,
+    // so the data has to be copied before it is handed to another thread.
+    const qsizetype bytesToWrite = size * m_synthesizeFormat.bytesPerSample();
+    if (!reserveSynthesized(bytesToWrite)) {
+        // the engine relies on every text ending with Ready
+        emit stateChanged(QTextToSpeech::Ready);
+        return CST_AUDIO_STREAM_STOP;
+    }
+    emit synthesized(m_synthesizeFormat,
+                     QByteArray(reinterpret_cast<const char *>(&w->samples[start]), bytesToWrite));
 
     if (last == 1)
         emit stateChanged(QTextToSpeech::Ready);
@@ -144,17 +346,33 @@ int QTextToSpeechProcessorFlite::dataOutput(const cst_wave *w, int start, int si
 
 void QTextToSpeechProcessorFlite::timerEvent(QTimerEvent *event)
 {
+    if (event->timerId() == m_idleTimer.timerId()) {
+        qCDebug(lcSpeechTtsFlite) << "Closing idle audio sink";
+        m_idleTimer.stop();
+        deleteSink();
+        return;
+    }
+    if (event->timerId() == m_endTimer.timerId()) {
+        finishEarly();
+        return;
+    }
     if (event->timerId() != m_tokenTimer.timerId()) {
         QObject::timerEvent(event);
         return;
     }
 
     qCDebug(lcSpeechTtsFlite) << "Moving current token" << m_currentToken << m_tokens.size();
-    auto currentToken = m_tokens.at(m_currentToken);
-    m_index = m_text.indexOf(currentToken.text, m_index);
-    emit sayingWord(currentToken.text, m_index, currentToken.text.length());
-    m_index += currentToken.text.length();
-    ++m_currentToken;
+    // The timer fired for the current token. Report the ones that the sink
+    // has played meanwhile as well, so that a late timer doesn't fall behind.
+    const qint64 position = playbackPosition() - m_utteranceStart;
+    do {
+        const TokenData &token = m_tokens.at(m_currentToken);
+        Q_TRACE(QTextToSpeechProcessorFlite_sayingWord, token.begin, token.length);
+        emit sayingWord(m_text.sliced(token.begin, token.length), token.begin, token.length);
+        ++m_currentToken;
+    } while (m_currentToken < m_tokens.size()
+             && m_tokens.at(m_currentToken).startFrame <= position);
+
     if (m_currentToken == m_tokens.size())
         m_tokenTimer.stop();
     else
@@ -164,34 +382,183 @@ void QTextToSpeechProcessorFlite::timerEvent(QTimerEvent *event)
 void QTextToSpeechProcessorFlite::processText(const QString &text, int voiceId, double pitch, double rate, OutputHandler outputHandler)
 {
     qCDebug(lcSpeechTtsFlite) << "processText() begin";
+    Q_TRACE_SCOPE(QTextToSpeechProcessorFlite_processText, text.size());
     if (!checkVoice(voiceId))
         return;
 
+    {
+        QMutexLocker locker(&m_bufferMutex);
+        m_synthesisCanceled = false;
+    }
+    m_synthesisTimer.start();
     m_text = text;
+    m_utf8Text = text.toUtf8();
     m_tokens.clear();
     m_currentToken = 0;
     m_index = 0;
+    m_utf8Index = 0;
     float secsToSpeak = -1;
     const VoiceInfo &voiceInfo = m_voices.at(voiceId);
     cst_voice *voice = voiceInfo.vox;
-    cst_audio_streaming_info *asi = new_audio_streaming_info();
-    asi->asc = outputHandler;
-    asi->userdata = (void *)this;
-    feat_set(voice->features, "streaming_info", audio_streaming_info_val(asi));
-    setRateForVoice(voice, rate);
-    setPitchForVoice(voice, pitch);
-    secsToSpeak = flite_text_to_speech(text.toUtf8().constData(), voice, "none");
-
-    if (secsToSpeak <= 0) {
+
+    // Configure the utterance instead of the voice, so that the settings don't
+    // apply to later utterances; utt_init links the voice features in after
+    // the utterance's own features.
+    cst_utterance *utt = new_utterance();
+    utt_set_input_text(utt, m_utf8Text.constData());
+    configureUtterance(utt, pitch, rate, outputHandler);
+    utt = flite_do_synth(utt, voice, utt_synth);
+    if (utt) {
+        if (const cst_wave *wave = utt_wave(utt); wave && wave->sample_rate)
+            secsToSpeak = float(wave->num_samples) / float(wave->sample_rate);
+        delete_utterance(utt);
+    }
+
+    bool canceled;
+    {
+        QMutexLocker locker(&m_bufferMutex);
+        canceled = m_synthesisCanceled;
+    }
+    if (secsToSpeak <= 0 && !canceled) {
         setError(QTextToSpeech::ErrorReason::Input,
                  QCoreApplication::translate("QTextToSpeech", "Speech synthesizing failure."));
         return;
     }
 
+    if (m_gapless && outputHandler == QTextToSpeechProcessorFlite::audioOutputCb && !canceled
+        && m_audioSink) {
+        m_utteranceEnd = m_utteranceStart + qint64(secsToSpeak * m_format.sampleRate());
+        if (m_state == QAudio::ActiveState)
+            startEndTimer();
+    }
+
     qCDebug(lcSpeechTtsFlite) << "processText() end" << secsToSpeak << "Seconds";
 }
 
-void QTextToSpeechProcessorFlite::setRateForVoice(cst_voice *voice, float rate)
+/*
+    Sets the features that processText() configures on each utterance. The
+    values are shared by all utterances with the same settings; feat_set only
+    adds a reference, so they survive the utterances that use them.
+*/
+void QTextToSpeechProcessorFlite::configureUtterance(cst_utterance *utt, double pitch, double rate,
+                                                     OutputHandler outputHandler)
+{
+    UtteranceConfig &config = m_utteranceConfig;
+    if (!config.streamingInfo || config.outputHandler != outputHandler) {
+        if (config.streamingInfo)
+            delete_val(config.streamingInfo);
+        config.asi = new_audio_streaming_info();
+        config.asi->asc = outputHandler;
+        config.asi->userdata = (void *)this;
+        // Flite calls the output handler every 256 samples by default. Nothing needs
+        // such a fine granularity when synthesizing, so deliver fewer, larger chunks.
+        if (outputHandler == QTextToSpeechProcessorFlite::dataOutputCb)
+            config.asi->min_buffsize = SynthesizeChunkSamples;
+        config.streamingInfo = audio_streaming_info_val(config.asi);
+        config.outputHandler = outputHandler;
+    }
+    // the position in the previous utterance
+    config.asi->utt = nullptr;
+    config.asi->item = nullptr;
+
+    if (!config.durationStretch || config.rate != rate) {
+        if (config.durationStretch)
+            delete_val(config.durationStretch);
+        config.durationStretch = float_val(durationStretch(rate));
+        config.rate = rate;
+    }
+    if (!config.f0TargetMean || config.pitch != pitch) {
+        if (config.f0TargetMean)
+            delete_val(config.f0TargetMean);
+        config.f0TargetMean = float_val(f0TargetMean(pitch));
+        config.pitch = pitch;
+    }
+
+    feat_set(utt->features, "streaming_info", config.streamingInfo);
+    feat_set(utt->features, "duration_stretch", config.durationStretch);
+    feat_set(utt->features, "int_f0_target_mean", config.f0TargetMean);
+}
+
+/*
+    Looks up the pronunciations of the words before Flite's own lexical
+    insertion, which takes the phones of words that have them. Words that
+    come up again don't go through the lexicon and its letter-to-sound
+    rules again.
+*/
+cst_utterance *QTextToSpeechProcessorFlite::lexicalInsertion(cst_utterance *utt)
+{
+    // the processor that configured the utterance
+    const cst_audio_streaming_info *asi =
+            val_audio_streaming_info(feat_val(utt->features, "streaming_info"));
+    const cst_lexicon *lex = val_lexicon(feat_val(utt->features, "lexicon"));
+    if (!asi || !lex)
+        return default_lexical_insertion(utt);
+
+    const auto *processor = static_cast<const QTextToSpeechProcessorFlite *>(asi->userdata);
+    for (cst_item *word = relation_head(utt_relation(utt, "Word")); word;
+         word = item_next(word)) {
+        if (item_feat_present(word, "phones"))
+            continue;
+        const char *name = item_feat_string(word, "name");
+        const char *pos = ffeature_string(word, "pos");
+        if (cst_val *phones = processor->pronunciation(lex, name, pos, utt->features))
+            item_set(word, "phones", phones);
+    }
+    return default_lexical_insertion(utt);
+}
+
+cst_val *QTextToSpeechProcessorFlite::pronunciation(const cst_lexicon *lex, const char *word,
+                                                    const char *pos,
+                                                    const cst_features *features) const
+{
+    if (m_lexicon) {
+        const QByteArrayView phones = m_lexicon->pronunciation(word);
+        if (!phones.isEmpty())
+            return phoneList(phones.toByteArray());
+    }
+    // Flite takes the words of the addenda from there itself, unless the
+    // user's lexicon overrides them
+    if (lex->lex_addenda && val_assoc_string(word, lex->lex_addenda))
+        return nullptr;
+
+    // Like Flite's lexicon, distinguish words only by the first letter of the part of speech
+    const QByteArray key = (pos && *pos ? *pos : '0') + QByteArray(word);
+    PronunciationCache *cache = pronunciationCache();
+    {
+        QMutexLocker locker(&cache->mutex);
+        const auto &entries = cache->entries[lex];
+        if (const auto it = entries.constFind(key); it != entries.cend())
+            return phoneList(*it);
+    }
+
+    cst_val *phones = lex_lookup(lex, word, pos, features);
+    if (!phones)
+        return nullptr;
+    QByteArray joined;
+    for (const cst_val *phone = phones; phone; phone = val_cdr(phone)) {
+        if (!joined.isEmpty())
+            joined += ' ';
+        joined += val_string(val_car(phone));
+    }
+    QMutexLocker locker(&cache->mutex);
+    auto &entries = cache->entries[lex];
+    if (entries.size() >= MaxCachedPronunciations)
+        entries.clear();
+    entries.insert(key, joined);
+    return phones;
+}
+
+void QTextToSpeechProcessorFlite::resetUtteranceConfig()
+{
+    UtteranceConfig &config = m_utteranceConfig;
+    for (cst_val *val : {config.streamingInfo, config.durationStretch, config.f0TargetMean}) {
+        if (val)
+            delete_val(val);
+    }
+    config = UtteranceConfig();
+}
+
+float QTextToSpeechProcessorFlite::durationStretch(float rate)
 {
     float stretch = 1.0;
     Q_ASSERT(rate >= -1.0 && rate <= 1.0);
@@ -200,16 +567,14 @@ void QTextToSpeechProcessorFlite::setRateForVoice(cst_voice *voice, float rate)
         stretch -= rate * 2;
     if (rate > 0)
         stretch -= rate * (100.0 / 175.0);
-    feat_set_float(voice->features, "duration_stretch", stretch);
+    return stretch;
 }
 
-void QTextToSpeechProcessorFlite::setPitchForVoice(cst_voice *voice, float pitch)
+float QTextToSpeechProcessorFlite::f0TargetMean(float pitch)
 {
-    float f0;
     Q_ASSERT(pitch >= -1.0 && pitch <= 1.0);
     // Conversion taken from Speech Dispatcher
-    f0 = (pitch * 80) + 100;
-    feat_set_float(voice->features, "int_f0_target_mean", f0);
+    return (pitch * 80) + 100;
 }
 
 typedef cst_voice*(*registerFnType)();
@@ -217,8 +582,29 @@ typedef void(*unregisterFnType)(cst_voice *);
 
 bool QTextToSpeechProcessorFlite::init()
 {
-    flite_init();
+    m_voices = availableVoiceInfos();
+    return !m_voices.isEmpty();
+}
+
+/*
+    Returns the voices that are linked in, or installed as voice libraries.
+    The library paths are only scanned once per process, and all processors,
+    including the synthesis workers, start with a copy of the result, so that
+    the voice IDs are the same in all of them. The voices themselves are
+    registered on first use, and shared through acquireVoice().
+*/
+QList<QTextToSpeechProcessorFlite::VoiceInfo> QTextToSpeechProcessorFlite::availableVoiceInfos()
+{
+    static const QList<VoiceInfo> voiceInfos = []{
+        flite_init();
+        return scanVoices();
+    }();
+    return voiceInfos;
+}
 
+QList<QTextToSpeechProcessorFlite::VoiceInfo> QTextToSpeechProcessorFlite::scanVoices()
+{
+    QList<VoiceInfo> voiceInfos;
     const QLocale locale(QLocale::English, QLocale::UnitedStates);
     // ### FIXME: hardcode for now, the only voice files we know about are for en_US
     // We could source the language and perhaps the list of voices we want to load
@@ -228,37 +614,158 @@ bool QTextToSpeechProcessorFlite::init()
     const QLatin1StringView registerPrefix("register_cmu_%1_%2");
     const QLatin1StringView unregisterPrefix("unregister_cmu_%1_%2");
 
+    // Loading and registering a voice reads its whole database, so only collect
+    // what we need to do that later, in loadVoice().
     for (const auto &voice : fliteAvailableVoices(libPrefix, langCode)) {
-        QLibrary library(libPrefix.arg(langCode, voice));
+        const int id = voiceInfos.count();
+        voiceInfos.append(VoiceInfo{
+            id,
+            nullptr,
+            libPrefix.arg(langCode, voice),
+            registerPrefix.arg(langCode, voice).toLatin1(),
+            unregisterPrefix.arg(langCode, voice).toLatin1(),
+            voice,
+            locale.name(),
+            QVoice::Male,
+            QVoice::Adult
+        });
+    }
+    return voiceInfos;
+}
+
+namespace {
+// Flite registers each voice only once per process and returns the same
+// cst_voice to every caller, and unregistering deletes it. So the processors
+// share the registered voices, and the last one that uses a voice unregisters it.
+struct RegisteredVoice
+{
+    cst_voice *vox = nullptr;
+    unregisterFnType unregisterFn = nullptr;
+    int users = 0;
+};
+Q_CONSTINIT QBasicMutex registeredVoicesMutex;
+QHash<QByteArray, RegisteredVoice> &registeredVoices()
+{
+    static QHash<QByteArray, RegisteredVoice> voices;
+    return voices;
+}
+}
+
+cst_voice *QTextToSpeechProcessorFlite::acquireVoice(const VoiceInfo &voiceInfo)
+{
+    QMutexLocker locker(&registeredVoicesMutex);
+    RegisteredVoice &registered = registeredVoices()[voiceInfo.registerName];
+    if (!registered.vox) {
+        qCDebug(lcSpeechTtsFlite) << "Loading voice" << voiceInfo.name;
+        QLibrary library(voiceInfo.libraryName);
         if (!library.load()) {
             qWarning("Voice library could not be loaded: %s", qPrintable(library.fileName()));
-            continue;
+            registeredVoices().remove(voiceInfo.registerName);
+            return nullptr;
         }
-        auto registerFn = reinterpret_cast<registerFnType>(library.resolve(
-            registerPrefix.arg(langCode, voice).toLatin1().constData()));
-        auto unregisterFn = reinterpret_cast<unregisterFnType>(library.resolve(
-            unregisterPrefix.arg(langCode, voice).toLatin1().constData()));
-        if (registerFn && unregisterFn) {
-            const int id = m_voices.count();
-            m_voices.append(VoiceInfo{
-                id,
-                registerFn(),
-                unregisterFn,
-                voice,
-                locale.name(),
-                QVoice::Male,
-                QVoice::Adult
-            });
-        } else {
+        auto registerFn = reinterpret_cast<registerFnType>(
+            library.resolve(voiceInfo.registerName.constData()));
+        auto unregisterFn = reinterpret_cast<unregisterFnType>(
+            library.resolve(voiceInfo.unregisterName.constData()));
+        cst_voice *vox = registerFn && unregisterFn ? registerFn() : nullptr;
+        if (!vox) {
             library.unload();
+            registeredVoices().remove(voiceInfo.registerName);
+            return nullptr;
         }
+        registered.vox = vox;
+        registered.unregisterFn = unregisterFn;
     }
+    ++registered.users;
+    return registered.vox;
+}
 
-    return !m_voices.isEmpty();
+void QTextToSpeechProcessorFlite::releaseVoice(const VoiceInfo &voiceInfo)
+{
+    QMutexLocker locker(&registeredVoicesMutex);
+    const auto it = registeredVoices().find(voiceInfo.registerName);
+    if (it == registeredVoices().end() || --it->users > 0)
+        return;
+    // the lexicon goes away with the voice library
+    if (const cst_val *lex = feat_val(it->vox->features, "lexicon")) {
+        PronunciationCache *cache = pronunciationCache();
+        QMutexLocker cacheLocker(&cache->mutex);
+        cache->entries.remove(val_lexicon(lex));
+    }
+    it->unregisterFn(it->vox);
+    registeredVoices().erase(it);
+}
+
+/*
+    Creates a voice with its own features that falls back to those of the
+    shared, registered voice. A processor can change the features of its clone
+    without affecting the other processors, and a clone only costs a couple
+    of empty feature lists.
+*/
+cst_voice *QTextToSpeechProcessorFlite::cloneVoice(const cst_voice *voice)
+{
+    cst_voice *clone = new_voice();
+    clone->name = voice->name;
+    clone->utt_init = voice->utt_init;
+    feat_link_into(voice->features, clone->features);
+    feat_link_into(voice->ffunctions, clone->ffunctions);
+    return clone;
+}
+
+void QTextToSpeechProcessorFlite::deleteVoiceClone(cst_voice *clone)
+{
+    // Not delete_voice(), which would free the voice data of the shared voice
+    delete_features(clone->features);
+    delete_features(clone->ffunctions);
+    cst_free(clone);
+}
+
+bool QTextToSpeechProcessorFlite::loadVoice(VoiceInfo &voiceInfo)
+{
+    if (voiceInfo.vox)
+        return true;
+
+    cst_voice *vox = acquireVoice(voiceInfo);
+    if (!vox)
+        return false;
+    voiceInfo.vox = cloneVoice(vox);
+    // unless the voice does its own lexical insertion
+    if (!feat_present(vox->features, "lexical_insertion_func")) {
+        feat_set(voiceInfo.vox->features, "lexical_insertion_func",
+                 uttfunc_val(&QTextToSpeechProcessorFlite::lexicalInsertion));
+    }
+    return true;
+}
+
+void QTextToSpeechProcessorFlite::preloadVoice(int voiceId)
+{
+    if (voiceId >= 0 && voiceId < m_voices.size() && loadVoice(m_voices[voiceId]))
+        openSink(m_voices.at(voiceId));
+}
+
+// Open the sink for the format of the voice, so that the first utterance
+// can be played right away.
+void QTextToSpeechProcessorFlite::openSink(const VoiceInfo &voiceInfo)
+{
+    if (m_audioDevice.isNull() || m_sinkIdleTimeout <= 0)
+        return;
+    // don't interrupt ongoing speech
+    if (audioSinkState() == QAudio::ActiveState || audioSinkState() == QAudio::SuspendedState)
+        return;
+
+    // flite voices are mono
+    const int sampleRate = flite_get_param_int(voiceInfo.vox->features, "sample_rate", 0);
+    const QAudioFormat format = audioFormat(sampleRate, 1);
+    if (sampleRate <= 0 || !m_audioDevice.isFormatSupported(format))
+        return;
+
+    m_format = format;
+    createSink();
+    startIdleTimer();
 }
 
 QStringList QTextToSpeechProcessorFlite::fliteAvailableVoices(const QString &libPrefix,
-                                                              const QString &langCode) const
+                                                              const QString &langCode)
 {
     // Read statically linked voices
     QStringList voices;
@@ -296,59 +803,130 @@ QStringList QTextToSpeechProcessorFlite::fliteAvailableVoices(const QString &lib
     return voices;
 }
 
-bool QTextToSpeechProcessorFlite::initAudio(double rate, int channelCount)
+QAudioFormat QTextToSpeechProcessorFlite::audioFormat(int sampleRate, int channelCount)
 {
-    m_format.setSampleFormat(QAudioFormat::Int16);
-    m_format.setSampleRate(rate);
-    m_format.setChannelCount(channelCount);
+    QAudioFormat format;
+    format.setSampleFormat(QAudioFormat::Int16);
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(channelCount);
     switch (channelCount) {
     case 1:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigMono);
+        format.setChannelConfig(QAudioFormat::ChannelConfigMono);
         break;
     case 2:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigStereo);
+        format.setChannelConfig(QAudioFormat::ChannelConfigStereo);
         break;
     case 3:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfig2Dot1);
+        format.setChannelConfig(QAudioFormat::ChannelConfig2Dot1);
         break;
     case 5:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigSurround5Dot0);
+        format.setChannelConfig(QAudioFormat::ChannelConfigSurround5Dot0);
         break;
     case 6:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigSurround5Dot1);
+        format.setChannelConfig(QAudioFormat::ChannelConfigSurround5Dot1);
         break;
     case 7:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigSurround7Dot0);
+        format.setChannelConfig(QAudioFormat::ChannelConfigSurround7Dot0);
         break;
     case 8:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigSurround7Dot1);
+        format.setChannelConfig(QAudioFormat::ChannelConfigSurround7Dot1);
         break;
     default:
-        m_format.setChannelConfig(QAudioFormat::ChannelConfigUnknown);
+        format.setChannelConfig(QAudioFormat::ChannelConfigUnknown);
         break;
     }
+    return format;
+}
+
+bool QTextToSpeechProcessorFlite::initAudio(double rate, int channelCount)
+{
+    m_format = audioFormat(rate, channelCount);
     if (!checkFormat(m_format))
        return false;
 
     createSink();
+    if (!m_audioSink)
+        return false;
 
-    m_audioSink->setVolume(m_volume);
+    setSinkVolume();
 
     return true;
 }
 
+// Writes to the sink and to the mirrors; false if writing to the sink failed
+bool QTextToSpeechProcessorFlite::writeAudio(const char *data, qint64 size)
+{
+    if (!m_audioBuffer->write(data, size))
+        return false;
+    // the same samples, synthesized once, go to all devices
+    for (const Mirror &mirror : std::as_const(m_mirrors)) {
+        if (mirror.buffer && !mirror.buffer->write(data, size))
+            qCWarning(lcSpeechTtsFlite) << "Audio streaming error on" << mirror.device.description();
+    }
+    return true;
+}
+
+/*
+    Starts the timer that reports the end of the utterance in gapless mode,
+    early enough for the next utterance to be synthesized before the sink has
+    played all data.
+*/
+void QTextToSpeechProcessorFlite::startEndTimer()
+{
+    if (m_utteranceEnd < 0 || !m_audioSink || !m_format.sampleRate())
+        return;
+    const qint64 remaining = (m_utteranceEnd - playbackPosition()) * 1000 / m_format.sampleRate();
+    // some margin for the signals between the threads
+    constexpr qint64 margin = 50;
+    m_endTimer.start(qMax(remaining - m_startLatency - margin, 0), Qt::PreciseTimer, this);
+}
+
+void QTextToSpeechProcessorFlite::finishEarly()
+{
+    m_endTimer.stop();
+    m_utteranceEnd = -1;
+    if (m_state != QAudio::ActiveState)
+        return;
+
+    // the next utterance replaces the tokens, so report the last words now
+    m_tokenTimer.stop();
+    while (m_currentToken < m_tokens.size()) {
+        const TokenData &token = m_tokens.at(m_currentToken++);
+        emit sayingWord(m_text.sliced(token.begin, token.length), token.begin, token.length);
+    }
+    // without changeState(), the sink keeps playing and stays open
+    m_playingTail = true;
+    m_state = QAudio::IdleState;
+    emit stateChanged(QTextToSpeech::Ready);
+}
+
+void QTextToSpeechProcessorFlite::setSinkVolume()
+{
+    m_audioSink->setVolume(m_volume);
+    for (const Mirror &mirror : std::as_const(m_mirrors)) {
+        if (mirror.sink)
+            mirror.sink->setVolume(qBound(0.0, m_volume * mirror.volume, 1.0));
+    }
+}
+
 void QTextToSpeechProcessorFlite::deleteSink()
 {
+    m_idleTimer.stop();
     if (m_audioSink) {
         m_audioSink->disconnect();
         delete m_audioSink;
         m_audioSink = nullptr;
         m_audioBuffer = nullptr;
     }
+    for (Mirror &mirror : m_mirrors) {
+        delete std::exchange(mirror.sink, nullptr);
+        mirror.buffer = nullptr;
+    }
 }
 
 void QTextToSpeechProcessorFlite::createSink()
 {
+    m_idleTimer.stop();
     // Create new sink if none exists or the format has changed
     if (!m_audioSink || (m_audioSink->format() != m_format)) {
         // No signals while we create new sink with QIODevice
@@ -360,35 +938,123 @@ void QTextToSpeechProcessorFlite::createSink()
         connect(m_audioSink, &QAudioSink::stateChanged, this, &QTextToSpeechProcessorFlite::changeState);
         connect(QThread::currentThread(), &QThread::finished, m_audioSink, &QObject::deleteLater);
     }
-    m_audioBuffer = m_audioSink->start();
+    // A warm sink is still started, keep writing into its device
+    if (!m_audioBuffer)
+        m_audioBuffer = m_audioSink->start();
     if (!m_audioBuffer) {
         deleteSink();
         setError(QTextToSpeech::ErrorReason::Playback,
                  QCoreApplication::translate("QTextToSpeech", "Audio Open error: No I/O device available."));
+    } else {
+        createMirrorSinks();
     }
 
     numberChunks = 0;
     totalBytes = 0;
 }
 
+// Like createSink(), for the mirror devices. A mirror that fails is skipped.
+void QTextToSpeechProcessorFlite::createMirrorSinks()
+{
+    for (Mirror &mirror : m_mirrors) {
+        if (mirror.sink && mirror.sink->format() != m_format) {
+            delete std::exchange(mirror.sink, nullptr);
+            mirror.buffer = nullptr;
+        }
+        if (!mirror.sink) {
+            if (!mirror.device.isFormatSupported(m_format)) {
+                qCWarning(lcSpeechTtsFlite) << "Audio device" << mirror.device.description()
+                                            << "does not support" << m_format;
+                continue;
+            }
+            mirror.sink = new QAudioSink(mirror.device, m_format, this);
+            connect(QThread::currentThread(), &QThread::finished, mirror.sink, &QObject::deleteLater);
+        }
+        if (!mirror.buffer)
+            mirror.buffer = mirror.sink->start();
+        if (!mirror.buffer)
+            qCWarning(lcSpeechTtsFlite) << "Could not open audio device" << mirror.device.description();
+    }
+}
+
+void QTextToSpeechProcessorFlite::setSynthesizeBufferLimit(qsizetype bytes)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    m_bufferLimit = qMax(bytes, 0);
+    m_bufferReleased.wakeAll();
+}
+
+// Called by the engine once it has delivered data of synthesized()
+void QTextToSpeechProcessorFlite::releaseSynthesized(qsizetype bytes)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    m_bufferedBytes = qMax(m_bufferedBytes - bytes, 0);
+    m_bufferReleased.wakeAll();
+}
+
+// Stops the text that is currently synthesized, also if it waits for the engine
+void QTextToSpeechProcessorFlite::cancelSynthesis()
+{
+    QMutexLocker locker(&m_bufferMutex);
+    m_synthesisCanceled = true;
+    m_bufferReleased.wakeAll();
+}
+
+// Waits until there is room for another chunk; false if synthesis got canceled
+bool QTextToSpeechProcessorFlite::reserveSynthesized(qsizetype bytes)
+{
+    QMutexLocker locker(&m_bufferMutex);
+    // a single chunk always fits, so that a small limit can't block forever
+    while (!m_synthesisCanceled && m_bufferLimit > 0 && m_bufferedBytes > 0
+           && m_bufferedBytes + bytes > m_bufferLimit) {
+        m_bufferReleased.wait(&m_bufferMutex);
+    }
+    if (m_synthesisCanceled)
+        return false;
+    m_bufferedBytes += bytes;
+    return true;
+}
+
+void QTextToSpeechProcessorFlite::startIdleTimer()
+{
+    if (m_audioSink)
+        m_idleTimer.start(qMax(m_sinkIdleTimeout, 0), this);
+}
+
 // Wrapper for QAudioSink::stateChanged, bypassing early idle bug
 void QTextToSpeechProcessorFlite::changeState(QAudio::State newState)
 {
-    if (m_state == newState)
+    if (m_state == newState) {
+        // the sink has played the end of an utterance that finished early
+        if (newState == QAudio::IdleState) {
+            m_playingTail = false;
+            startIdleTimer();
+        }
         return;
+    }
+    m_playingTail = false;
 
     qCDebug(lcSpeechTtsFlite) << "Audio sink state transition" << m_state << newState;
+    Q_TRACE(QTextToSpeechProcessorFlite_changeState, m_state, newState);
 
     switch (newState) {
     case QAudio::ActiveState:
+        m_idleTimer.stop();
         // Once the sink starts playing, start a timer to keep track of the tokens.
         if (!m_tokenTimer.isActive() && m_currentToken < m_tokens.count())
             startTokenTimer();
+        startEndTimer();
         break;
     case QAudio::SuspendedState:
+        m_tokenTimer.stop();
+        m_endTimer.stop();
+        break;
     case QAudio::IdleState:
     case QAudio::StoppedState:
         m_tokenTimer.stop();
+        m_endTimer.stop();
+        m_utteranceEnd = -1;
+        startIdleTimer();
         break;
     }
 
@@ -424,14 +1090,6 @@ constexpr QTextToSpeech::State QTextToSpeechProcessorFlite::audioStateToTts(QAud
     Q_UNREACHABLE();
 }
 
-void QTextToSpeechProcessorFlite::deinitAudio()
-{
-    m_tokenTimer.stop();
-    m_index = -1;
-    m_currentToken = -1;
-    deleteSink();
-}
-
 // Check format/device and set corresponding error messages
 bool QTextToSpeechProcessorFlite::checkFormat(const QAudioFormat &format)
 {
@@ -468,12 +1126,19 @@ bool QTextToSpeechProcessorFlite::checkFormat(const QAudioFormat &format)
 // Check voice validity
 bool QTextToSpeechProcessorFlite::checkVoice(int voiceId)
 {
-    if (voiceId >= 0 && voiceId < m_voices.size())
-        return true;
+    if (voiceId < 0 || voiceId >= m_voices.size()) {
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                 QCoreApplication::translate("QTextToSpeech", "Invalid voiceId %1.").arg(voiceId));
+        return false;
+    }
 
-    setError(QTextToSpeech::ErrorReason::Configuration,
-             QCoreApplication::translate("QTextToSpeech", "Invalid voiceId %1.").arg(voiceId));
-    return false;
+    if (!loadVoice(m_voices[voiceId])) {
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                 QCoreApplication::translate("QTextToSpeech", "Voice %1 could not be loaded.")
+                    .arg(m_voices.at(voiceId).name));
+        return false;
+    }
+    return true;
 }
 
 // Wrap QAudioSink::state and compensate early idle bug
@@ -486,22 +1151,56 @@ QAudio::State QTextToSpeechProcessorFlite::audioSinkState() const
 void QTextToSpeechProcessorFlite::stop()
 {
     if (audioSinkState() == QAudio::ActiveState || audioSinkState() == QAudio::SuspendedState) {
-        deinitAudio();
-        // Call manual state change as audio sink has been deleted
+        m_tokenTimer.stop();
+        m_tokens.clear();
+        m_currentToken = 0;
+        // Drop the data that hasn't been played, but keep the sink for the
+        // next utterance. Without signals, so that the state changes only once.
+        {
+            const QSignalBlocker blocker(m_audioSink);
+            m_audioSink->reset();
+            // if the sink isn't idle now, then the next utterance starts it again
+            if (m_audioSink->state() != QAudio::IdleState) {
+                m_audioSink->stop();
+                m_audioBuffer = nullptr;
+            }
+        }
+        for (Mirror &mirror : m_mirrors) {
+            if (!mirror.sink)
+                continue;
+            mirror.sink->reset();
+            if (mirror.sink->state() != QAudio::IdleState) {
+                mirror.sink->stop();
+                mirror.buffer = nullptr;
+            }
+        }
         changeState(QAudio::StoppedState);
     }
 }
 
 void QTextToSpeechProcessorFlite::pause()
 {
-    if (audioSinkState() == QAudio::ActiveState)
+    // the end of an utterance that finished early is paused as well, as the
+    // next utterance continues the stream; the sink reports the new state
+    const bool playingTail = m_playingTail && m_audioSink
+                          && m_audioSink->state() == QAudio::ActiveState;
+    if (audioSinkState() == QAudio::ActiveState || playingTail) {
         m_audioSink->suspend();
+        for (const Mirror &mirror : std::as_const(m_mirrors)) {
+            if (mirror.sink)
+                mirror.sink->suspend();
+        }
+    }
 }
 
 void QTextToSpeechProcessorFlite::resume()
 {
     if (audioSinkState() == QAudio::SuspendedState) {
         m_audioSink->resume();
+        for (const Mirror &mirror : std::as_const(m_mirrors)) {
+            if (mirror.sink)
+                mirror.sink->resume();
+        }
         // QAudioSink in push mode transitions to Idle when resumed, even if
         // there is still data to play. Workaround this weird behavior if we
         // know we are not done yet.
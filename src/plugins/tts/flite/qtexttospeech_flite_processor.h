@@ -9,6 +9,7 @@
 
 #include <QtCore/QList>
 #include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
 #include <QtCore/QThread>
 #include <QtCore/QLibrary>
 #include <QtCore/QString>
@@ -17,13 +18,34 @@
 #include <QtCore/QAbstractEventDispatcher>
 #include <QtCore/QProcessEnvironment>
 #include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
 #include <QtMultimedia/QAudioSink>
 #include <QtMultimedia/QMediaDevices>
 
 #include <flite/flite.h>
 
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
+// Pronunciations from a file with one word per line, followed by its phones,
+// sorted by word. The file is mapped into memory and only indexed, not parsed.
+class QTextToSpeechFliteLexicon
+{
+public:
+    static std::shared_ptr<const QTextToSpeechFliteLexicon> open(const QString &fileName);
+
+    // the phones of word, separated by spaces, or empty
+    QByteArrayView pronunciation(QByteArrayView word) const;
+
+private:
+    static QByteArrayView word(QByteArrayView line);
+
+    QFile m_file;
+    QList<QByteArrayView> m_lines;
+};
+
 class QTextToSpeechProcessorFlite : public QObject
 {
     Q_OBJECT
@@ -35,8 +57,12 @@ public:
     struct VoiceInfo
     {
         int id;
+        // this processor's clone of the registered voice, created when the
+        // voice is first used
         cst_voice *vox;
-        void (*unregister_func)(cst_voice *vox);
+        QString libraryName;
+        QByteArray registerName;
+        QByteArray unregisterName;
         QString name;
         QString locale;
         QVoice::Gender gender;
@@ -45,11 +71,30 @@ public:
 
     Q_INVOKABLE void say(const QString &text, int voiceId, double pitch, double rate, double volume);
     Q_INVOKABLE void synthesize(const QString &text, int voiceId, double pitch, double rate, double volume);
+    Q_INVOKABLE void preloadVoice(int voiceId);
     Q_INVOKABLE void pause();
     Q_INVOKABLE void resume();
     Q_INVOKABLE void stop();
 
     const QList<QTextToSpeechProcessorFlite::VoiceInfo> &voices() const;
+    void setSinkIdleTimeout(int msecs);
+
+    // Another device that plays the audio of say(), with its volume relative
+    // to the utterance's volume, and a delay in milliseconds
+    struct MirrorDevice
+    {
+        QAudioDevice device;
+        double volume = 1;
+        int delay = 0;
+    };
+    void setMirrorDevices(const QList<MirrorDevice> &devices);
+    void setGapless(bool gapless, int utteranceGap);
+    void setLexicon(const std::shared_ptr<const QTextToSpeechFliteLexicon> &lexicon);
+
+    // Thread-safe flow control for synthesize()
+    void setSynthesizeBufferLimit(qsizetype bytes);
+    void releaseSynthesized(qsizetype bytes);
+    void cancelSynthesis();
     static constexpr QTextToSpeech::State audioStateToTts(QAudio::State audioState);
 
 private:
@@ -62,24 +107,46 @@ private:
     using OutputHandler = decltype(QTextToSpeechProcessorFlite::audioOutputCb);
     // Process a single text
     void processText(const QString &text, int voiceId, double pitch, double rate, OutputHandler outputHandler);
+    void readTokens(const cst_wave *w, int start, int size, cst_audio_streaming_info *asi);
     int audioOutput(const cst_wave *w, int start, int size, int last, cst_audio_streaming_info *asi);
     int dataOutput(const cst_wave *w, int start, int size, int last, cst_audio_streaming_info *asi);
 
-    void setRateForVoice(cst_voice *voice, float rate);
-    void setPitchForVoice(cst_voice *voice, float pitch);
+    void configureUtterance(cst_utterance *utt, double pitch, double rate,
+                            OutputHandler outputHandler);
+    static cst_utterance *lexicalInsertion(cst_utterance *utt);
+    cst_val *pronunciation(const cst_lexicon *lex, const char *word, const char *pos,
+                           const cst_features *features) const;
+    void resetUtteranceConfig();
+    static float durationStretch(float rate);
+    static float f0TargetMean(float pitch);
 
     bool init();
+    static QList<VoiceInfo> availableVoiceInfos();
+    static QList<VoiceInfo> scanVoices();
+    static QAudioFormat audioFormat(int sampleRate, int channelCount);
     bool initAudio(double rate, int channelCount);
-    void deinitAudio();
+    void openSink(const VoiceInfo &voiceInfo);
     bool checkFormat(const QAudioFormat &format);
     bool checkVoice(int voiceId);
+    bool loadVoice(VoiceInfo &voiceInfo);
+    static cst_voice *acquireVoice(const VoiceInfo &voiceInfo);
+    static void releaseVoice(const VoiceInfo &voiceInfo);
+    static cst_voice *cloneVoice(const cst_voice *voice);
+    static void deleteVoiceClone(cst_voice *clone);
     void deleteSink();
     void createSink();
+    void createMirrorSinks();
+    void setSinkVolume();
+    bool writeAudio(const char *data, qint64 size);
+    void startEndTimer();
+    void finishEarly();
+    void startIdleTimer();
+    bool reserveSynthesized(qsizetype bytes);
     QAudio::State audioSinkState() const;
     void setError(QTextToSpeech::ErrorReason err, const QString &errorString = QString());
 
     // Read available flite voices
-    QStringList fliteAvailableVoices(const QString &libPrefix, const QString &langCode) const;
+    static QStringList fliteAvailableVoices(const QString &libPrefix, const QString &langCode);
 
 private slots:
     void changeState(QAudio::State newState);
@@ -89,31 +156,91 @@ Q_SIGNALS:
     void stateChanged(QTextToSpeech::State);
     void sayingWord(const QString &word, qsizetype begin, qsizetype length);
     void synthesized(const QAudioFormat &format, const QByteArray &array);
+    void synthesizedWord(const QString &word, qsizetype begin, qsizetype length, qint64 position);
+    void audioUnderrun();
 
 protected:
     void timerEvent(QTimerEvent *event) override;
 
 private:
+    // Word boundaries, found once while the text is synthesized
     struct TokenData {
-        qint64 startTime;
-        QString text;
+        qint64 startFrame; // relative to the start of the utterance's audio
+        qsizetype begin;   // position of the word in m_text
+        qsizetype length;
     };
     QString m_text;
-    qsizetype m_index = -1;
+    // m_text as given to Flite, in which the tokens are searched
+    QByteArray m_utf8Text;
+    // where the search for the next token starts, in m_utf8Text and in m_text
+    qsizetype m_utf8Index = 0;
+    qsizetype m_index = 0;
     QList<TokenData> m_tokens;
-    qsizetype m_currentToken = -1;
+    qsizetype m_currentToken = 0;
+    // the sink's position, in frames, at which the current utterance starts
+    qint64 m_utteranceStart = 0;
     QBasicTimer m_tokenTimer;
     void startTokenTimer();
 
+    // In gapless mode, the utterance is reported as finished while the sink
+    // still plays its end, so that the next utterance continues the stream.
+    bool m_gapless = false;
+    int m_utteranceGap = 0; // silence between utterances, in milliseconds
+    qint64 m_utteranceEnd = -1; // the sink's position, in frames
+    bool m_playingTail = false; // the sink plays an utterance that finished early
+    qint64 m_startLatency = 0; // until Flite delivers the first audio, in milliseconds
+    QElapsedTimer m_synthesisTimer;
+    QBasicTimer m_endTimer;
+    qint64 playbackPosition() const;
+
     QAudioSink *m_audioSink = nullptr;
     QAudio::State m_state = QAudio::IdleState;
     QIODevice *m_audioBuffer = nullptr;
+    // The sink stays open for this long after playback, so that the next
+    // utterance doesn't have to open the audio device again.
+    int m_sinkIdleTimeout = 5000;
+    QBasicTimer m_idleTimer;
 
     QAudioDevice m_audioDevice;
+    // The sinks of the mirror devices get the same data as m_audioSink, which
+    // alone determines the state and the word timing.
+    struct Mirror : MirrorDevice
+    {
+        QAudioSink *sink = nullptr;
+        QIODevice *buffer = nullptr;
+    };
+    QList<Mirror> m_mirrors;
     QAudioFormat m_format;
+    // Format of the utterance that is currently synthesized
+    QAudioFormat m_synthesizeFormat;
+    // about 1/4 of a second with the 16kHz of the CMU voices
+    static constexpr int SynthesizeChunkSamples = 4096;
     double m_volume = 1;
 
     QList<VoiceInfo> m_voices;
+    // pronunciations that take precedence over those of the voices' lexicons
+    std::shared_ptr<const QTextToSpeechFliteLexicon> m_lexicon;
+
+    // Utterance features for the last used settings, reused while they don't change
+    struct UtteranceConfig
+    {
+        OutputHandler *outputHandler = nullptr;
+        double rate = 0;
+        double pitch = 0;
+        cst_audio_streaming_info *asi = nullptr; // owned by streamingInfo
+        cst_val *streamingInfo = nullptr;
+        cst_val *durationStretch = nullptr;
+        cst_val *f0TargetMean = nullptr;
+    };
+    UtteranceConfig m_utteranceConfig;
+
+    // Synthesized data that the engine hasn't delivered yet. Once that is more
+    // than the limit, synthesis waits until the engine catches up.
+    QMutex m_bufferMutex;
+    QWaitCondition m_bufferReleased;
+    qsizetype m_bufferLimit = 0;
+    qsizetype m_bufferedBytes = 0;
+    bool m_synthesisCanceled = false;
 
     // Statistics for debugging
     qint64 numberChunks = 0;
@@ -4,7 +4,8 @@
 
 #include "qtexttospeech_mock.h"
 #include <QtCore/QTimerEvent>
-#include <QtCore/QTimer>
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QRandomGenerator>
 #include <QtCore/qregularexpression.h>
 
 QT_BEGIN_NAMESPACE
@@ -16,11 +17,16 @@ QTextToSpeechEngineMock::QTextToSpeechEngineMock(const QVariantMap &parameters,
 {
     m_locale = availableLocales().first();
     m_voice = availableVoices().first();
+    m_realTimeFactor = m_parameters.value(u"realTimeFactor"_s, 1.0).toDouble();
+    m_chunkSize = m_parameters.value(u"chunkSize"_s).toLongLong();
+    m_latency = m_parameters.value(u"latency"_s).toInt();
+    m_latencyJitter = m_parameters.value(u"latencyJitter"_s).toInt();
+    m_maxSpeed = m_parameters.value(u"maxSpeed"_s).toBool();
+    m_failAfterWords = m_parameters.value(u"failAfterWords"_s).toInt();
     if (m_parameters[u"delayedInitialization"_s].toBool()) {
-        QTimer::singleShot(50, this, [this]{
-            m_state = QTextToSpeech::Ready;
-            emit stateChanged(m_state);
-        });
+        // a timer of this object, so that it moves with the engine if the
+        // engine is created in a worker thread
+        m_initTimer.start(50, this);
     } else {
         m_state = QTextToSpeech::Ready;
     }
@@ -29,6 +35,7 @@ QTextToSpeechEngineMock::QTextToSpeechEngineMock(const QVariantMap &parameters,
 
 QTextToSpeechEngineMock::~QTextToSpeechEngineMock()
 {
+    stopWorker();
 }
 
 QList<QLocale> QTextToSpeechEngineMock::availableLocales() const
@@ -54,6 +61,22 @@ QList<QLocale> QTextToSpeechEngineMock::availableLocales() const
 }
 
 QList<QVoice> QTextToSpeechEngineMock::availableVoices() const
+{
+    return voicesForLocale(m_locale);
+}
+
+QList<QVoice> QTextToSpeechEngineMock::allVoices(const QLocale *locale) const
+{
+    const QList<QLocale> locales = availableLocales();
+    if (locale)
+        return locales.contains(*locale) ? voicesForLocale(*locale) : QList<QVoice>();
+    QList<QVoice> voices;
+    for (const QLocale &voiceLocale : locales)
+        voices << voicesForLocale(voiceLocale);
+    return voices;
+}
+
+QList<QVoice> QTextToSpeechEngineMock::voicesForLocale(const QLocale &locale) const
 {
     QList<QVoice> voices;
 
@@ -61,24 +84,24 @@ QList<QVoice> QTextToSpeechEngineMock::availableVoices() const
         const auto voicesData = it->value<QList<std::tuple<QString, QLocale, QVoice::Gender, QVoice::Age>>>();
         for (const auto &voiceData : voicesData) {
             const QLocale &voiceLocale = std::get<1>(voiceData);
-            if (voiceLocale == m_locale) {
+            if (voiceLocale == locale) {
                 voices << createVoice(std::get<0>(voiceData),
                                       voiceLocale,
                                       std::get<2>(voiceData),
                                       std::get<3>(voiceData),
-                                      u"%1-%2"_s.arg(m_locale.bcp47Name()).arg(voices.count() + 1));
+                                      u"%1-%2"_s.arg(locale.bcp47Name()).arg(voices.count() + 1));
             }
         }
     } else {
-        const QString voiceData = m_locale.bcp47Name();
-        const auto newVoice = [this, &voiceData](const QString &name, QVoice::Gender gender,
+        const QString voiceData = locale.bcp47Name();
+        const auto newVoice = [&locale, &voiceData](const QString &name, QVoice::Gender gender,
                                   QVoice::Age age, const char *suffix) {
-            return createVoice(name, m_locale, gender, age,
+            return createVoice(name, locale, gender, age,
                                QVariant::fromValue<QString>(voiceData + suffix));
         };
-        switch (m_locale.language()) {
+        switch (locale.language()) {
         case QLocale::English: {
-            if (m_locale.territory() == QLocale::UnitedKingdom) {
+            if (locale.territory() == QLocale::UnitedKingdom) {
                 voices << newVoice("Bob", QVoice::Male, QVoice::Adult, "-1")
                        << newVoice("Anne", QVoice::Female, QVoice::Adult, "-2");
             } else {
@@ -100,7 +123,7 @@ QList<QVoice> QTextToSpeechEngineMock::availableVoices() const
                    << newVoice("Anneli", QVoice::Female, QVoice::Adult, "-2");
             break;
         default:
-            Q_ASSERT_X(false, "availableVoices", "Unsupported locale!");
+            Q_ASSERT_X(false, "voicesForLocale", "Unsupported locale!");
             break;
         }
     }
@@ -109,24 +132,143 @@ QList<QVoice> QTextToSpeechEngineMock::availableVoices() const
 
 void QTextToSpeechEngineMock::say(const QString &text)
 {
+    stopWorker();
     m_text = text;
-    m_currentIndex = 0;
-    m_timer.start(wordTime(), Qt::PreciseTimer, this);
+    tokenize();
     m_state = QTextToSpeech::Speaking;
+    const int latency = startLatency();
+    m_latencyPending = latency > 0;
+    m_timer.start(interval() + latency, Qt::PreciseTimer, this);
     emit stateChanged(m_state);
 }
 
 void QTextToSpeechEngineMock::synthesize(const QString &text)
 {
+    stopWorker();
     m_text = text;
-    m_currentIndex = 0;
-    m_timer.start(wordTime(), Qt::PreciseTimer, this);
+    tokenize();
     m_state = QTextToSpeech::Synthesizing;
-    emit stateChanged(m_state);
-
+    m_synthesizedTime = 0;
     m_format.setSampleRate(22050);
     m_format.setChannelConfig(QAudioFormat::ChannelConfigMono);
     m_format.setSampleFormat(QAudioFormat::Int16);
+
+    if (m_maxSpeed) {
+        synthesizeInWorker();
+    } else {
+        const int latency = startLatency();
+        m_latencyPending = latency > 0;
+        m_timer.start(interval() + latency, Qt::PreciseTimer, this);
+    }
+    emit stateChanged(m_state);
+}
+
+int QTextToSpeechEngineMock::interval() const
+{
+    // synthesizing doesn't have to keep up with playback
+    if (m_state == QTextToSpeech::Synthesizing)
+        return qMax(int(wordTime() * m_realTimeFactor), 0);
+    return wordTime();
+}
+
+int QTextToSpeechEngineMock::startLatency() const
+{
+    int latency = m_latency;
+    if (m_latencyJitter > 0)
+        latency += QRandomGenerator::global()->bounded(-m_latencyJitter, m_latencyJitter + 1);
+    return qMax(latency, 0);
+}
+
+/*
+    Splits m_text into words, skipping punctuation. This is good enough for testing.
+*/
+void QTextToSpeechEngineMock::tokenize()
+{
+    static const QRegularExpression separator(u"\\W+"_s);
+    m_words.clear();
+    m_currentWord = 0;
+    qsizetype index = 0;
+    for (const QRegularExpressionMatch &match : separator.globalMatch(m_text)) {
+        m_words.append({m_text.sliced(index, match.capturedStart() - index), index});
+        index = match.capturedEnd();
+    }
+    if (index < m_text.size())
+        m_words.append({m_text.sliced(index), index});
+}
+
+/*
+    Emits the audio for one word. All words are silent, so the data is only
+    allocated when the duration of a word changes, and then shared.
+*/
+void QTextToSpeechEngineMock::emitSilence()
+{
+    const qsizetype size = m_format.bytesForDuration(wordTime() * 1000);
+    if (size != m_silenceSize) {
+        m_silenceSize = size;
+        m_silence.clear();
+        const QByteArray data(size, 0);
+        if (m_chunkSize <= 0 || size <= m_chunkSize) {
+            m_silence.append(data);
+        } else {
+            // only whole frames in each chunk
+            const qsizetype frameSize = qMax(m_format.bytesPerFrame(), 1);
+            const qsizetype chunkSize = qMax(m_chunkSize / frameSize, 1) * frameSize;
+            const QByteArray chunk = data.first(qMin(chunkSize, size));
+            for (qsizetype offset = 0; offset < size; offset += chunkSize) {
+                const qsizetype length = qMin(chunkSize, size - offset);
+                m_silence.append(length == chunk.size() ? chunk : data.first(length));
+            }
+        }
+    }
+    m_synthesizedTime += m_format.durationForBytes(size);
+    for (const QByteArray &chunk : std::as_const(m_silence))
+        emit synthesized(m_format, chunk);
+}
+
+/*
+    Produces the audio for m_text as fast as possible. The worker only paces
+    the words; the signals are emitted in the engine's thread, in order.
+*/
+void QTextToSpeechEngineMock::synthesizeInWorker()
+{
+    stopWorker();
+    m_workerCanceled = false;
+    const quint64 run = ++m_workerRun;
+    const qsizetype wordCount = m_words.size();
+    const int latency = startLatency();
+    m_worker.reset(QThread::create([this, run, wordCount, latency] {
+        const QDeadlineTimer until(latency);
+        while (!until.hasExpired() && !m_workerCanceled)
+            QThread::msleep(qMin<qint64>(until.remainingTime(), 10));
+
+        for (qsizetype i = 0; i < wordCount && !m_workerCanceled; ++i) {
+            QMetaObject::invokeMethod(this, [this, run, i] {
+                if (run != m_workerRun)
+                    return;
+                const Word word = m_words.at(i);
+                emit synthesizedWord(word.text, word.start, word.text.size(), m_synthesizedTime);
+                emitSilence();
+            }, Qt::QueuedConnection);
+        }
+        QMetaObject::invokeMethod(this, [this, run] {
+            if (run != m_workerRun)
+                return;
+            m_state = QTextToSpeech::Ready;
+            m_currentWord = -1;
+            emit stateChanged(m_state);
+        }, Qt::QueuedConnection);
+    }));
+    m_worker->start();
+}
+
+void QTextToSpeechEngineMock::stopWorker()
+{
+    if (!m_worker)
+        return;
+    m_workerCanceled = true;
+    ++m_workerRun;
+    m_worker->wait();
+    m_worker.reset();
 }
 
 void QTextToSpeechEngineMock::stop(QTextToSpeech::BoundaryHint boundaryHint)
@@ -135,11 +277,13 @@ void QTextToSpeechEngineMock::stop(QTextToSpeech::BoundaryHint boundaryHint)
     if (m_state == QTextToSpeech::Ready || m_state == QTextToSpeech::Error)
         return;
 
-    Q_ASSERT(m_state == QTextToSpeech::Paused || m_timer.isActive());
+    Q_ASSERT(m_state == QTextToSpeech::Paused || m_timer.isActive() || m_worker);
     // finish immediately
     m_text.clear();
-    m_currentIndex = -1;
+    m_words.clear();
+    m_currentWord = -1;
     m_timer.stop();
+    stopWorker();
 
     m_state = QTextToSpeech::Ready;
     emit stateChanged(m_state);
@@ -160,13 +304,33 @@ void QTextToSpeechEngineMock::resume()
     if (m_state != QTextToSpeech::Paused)
         return;
 
-    m_timer.start(wordTime(), Qt::PreciseTimer, this);
     m_state = QTextToSpeech::Speaking;
+    m_timer.start(interval(), Qt::PreciseTimer, this);
     emit stateChanged(m_state);
 }
 
 void QTextToSpeechEngineMock::timerEvent(QTimerEvent *e)
 {
+    if (e->timerId() == m_initTimer.timerId()) {
+        m_initTimer.stop();
+        m_state = QTextToSpeech::Ready;
+        emit stateChanged(m_state);
+        // like engines that only know their voices once they are initialized
+        if (const auto it = m_parameters.constFind(u"initializedVoice"_s);
+            it != m_parameters.cend()) {
+            const QList<QVoice> voices = allVoices(nullptr);
+            const auto voice = std::find_if(voices.cbegin(), voices.cend(),
+                                            [name = it->toString()](const QVoice &voice) {
+                return voice.name() == name;
+            });
+            if (voice != voices.cend()) {
+                m_voice = *voice;
+                m_locale = voice->locale();
+            }
+            emit voicesChanged();
+        }
+        return;
+    }
     if (e->timerId() != m_timer.timerId()) {
         QTextToSpeechEngine::timerEvent(e);
         return;
@@ -175,27 +339,32 @@ void QTextToSpeechEngineMock::timerEvent(QTimerEvent *e)
     Q_ASSERT(m_state == QTextToSpeech::Speaking || m_state == QTextToSpeech::Synthesizing);
     Q_ASSERT(m_text.length());
 
-    // Find start of next word, skipping punctuations. This is good enough for testing.
-    QRegularExpressionMatch match;
-    qsizetype nextSpace = m_text.indexOf(QRegularExpression(u"\\W+"_s), m_currentIndex, &match);
-    if (nextSpace == -1)
-        nextSpace = m_text.length();
-    const QString word = m_text.sliced(m_currentIndex, nextSpace - m_currentIndex);
-    sayingWord(word, m_currentIndex, nextSpace - m_currentIndex);
-    m_currentIndex = nextSpace + match.captured().length();
+    // a copy, in case a slot of sayingWord changes the text
+    const Word word = m_words.at(m_currentWord++);
+    sayingWord(word.text, word.start, word.text.size());
+    if (m_state == QTextToSpeech::Synthesizing)
+        emit synthesizedWord(word.text, word.start, word.text.size(), m_synthesizedTime);
+    emitSilence();
 
-    emit synthesized(m_format, QByteArray(m_format.bytesForDuration(wordTime() * 1000), 0));
-
-    if (m_currentIndex >= m_text.length()) {
+    if (m_failAfterWords > 0 && --m_failAfterWords == 0) {
+        m_timer.stop();
+        m_state = QTextToSpeech::Error;
+        m_errorReason = QTextToSpeech::ErrorReason::Playback;
+        m_errorString = u"Failing as requested"_s;
+        emit stateChanged(m_state);
+        emit errorOccurred(m_errorReason, m_errorString);
+    } else if (m_currentWord >= m_words.size()) {
         // done speaking all words
         m_timer.stop();
         m_state = QTextToSpeech::Ready;
-        m_currentIndex = -1;
+        m_currentWord = -1;
         emit stateChanged(m_state);
     } else if (m_pauseRequested) {
         m_timer.stop();
         m_state = QTextToSpeech::Paused;
         emit stateChanged(m_state);
+    } else if (std::exchange(m_latencyPending, false)) {
+        m_timer.start(interval(), Qt::PreciseTimer, this);
     }
     m_pauseRequested = false;
 }
@@ -210,7 +379,8 @@ bool QTextToSpeechEngineMock::setRate(double rate)
     m_rate = rate;
     if (m_timer.isActive()) {
         m_timer.stop();
-        m_timer.start(wordTime(), Qt::PreciseTimer, this);
+        m_latencyPending = false;
+        m_timer.start(interval(), Qt::PreciseTimer, this);
     }
     return true;
 }
@@ -6,6 +6,10 @@
 
 #include "qtexttospeechengine.h"
 #include <QtCore/QBasicTimer>
+#include <QtCore/QThread>
+
+#include <atomic>
+#include <memory>
 
 QT_BEGIN_NAMESPACE
 
@@ -19,6 +23,7 @@ public:
 
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
 
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
@@ -44,14 +49,24 @@ protected:
     void timerEvent(QTimerEvent *e) override;
 
 private:
+    QList<QVoice> voicesForLocale(const QLocale &locale) const;
+
     // mock engine uses 100ms per word, +/- 50ms depending on rate
     int wordTime() const { return 100 - int(50.0 * m_rate); }
+    // time between words in the current state
+    int interval() const;
+    int startLatency() const;
+    void tokenize();
+    void emitSilence();
+    void synthesizeInWorker();
+    void stopWorker();
 
     const QVariantMap m_parameters;
     QString m_text;
     QLocale m_locale;
     QVoice m_voice;
     QBasicTimer m_timer;
+    QBasicTimer m_initTimer;
     double m_rate = 0.0;
     double m_pitch = 0.0;
     double m_volume = 0.5;
@@ -59,8 +74,39 @@ private:
     QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
     QString m_errorString;
     bool m_pauseRequested = false;
-    qsizetype m_currentIndex = -1;
+    // the words of m_text, found once per utterance
+    struct Word
+    {
+        QString text;
+        qsizetype start = 0;
+    };
+    QList<Word> m_words;
+    qsizetype m_currentWord = -1;
+    // audio of one word, in synthesized() chunks; rebuilt when the size changes
+    QList<QByteArray> m_silence;
+    qsizetype m_silenceSize = -1;
     QAudioFormat m_format;
+    // microseconds of audio synthesized for the current text
+    qint64 m_synthesizedTime = 0;
+
+    // Load generation, configured through the engine parameters:
+    // synthesis time relative to the duration of the audio
+    double m_realTimeFactor = 1.0;
+    // bytes per synthesized() chunk, 0 for one chunk per word
+    qsizetype m_chunkSize = 0;
+    // milliseconds until the first word, +/- a random jitter
+    int m_latency = 0;
+    int m_latencyJitter = 0;
+    // the timer interval includes the latency, until the first word
+    bool m_latencyPending = false;
+    // synthesize as fast as possible in a worker thread
+    bool m_maxSpeed = false;
+    // simulates a failure of the engine after that many words
+    int m_failAfterWords = 0;
+    std::unique_ptr<QThread> m_worker;
+    std::atomic<bool> m_workerCanceled = false;
+    // incremented to ignore data from a canceled worker
+    quint64 m_workerRun = 0;
 };
 
 QT_END_NAMESPACE
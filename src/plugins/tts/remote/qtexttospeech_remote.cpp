@@ -0,0 +1,327 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeech_remote.h"
+#include "qtexttospeech_remote_plugin.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDeadlineTimer>
+#include <QtMultimedia/QAudioFormat>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Qt::StringLiterals;
+using Message = QTextToSpeechRemote::Message;
+
+// The server might have to load its engine and voices first
+static constexpr int ConnectTimeout = 1000;
+static constexpr int InitTimeout = 10000;
+
+QTextToSpeechEngineRemote::QTextToSpeechEngineRemote(const QVariantMap &parameters,
+                                                     QObject *parent)
+    : QTextToSpeechEngine(parent)
+    , m_socket(new QLocalSocket(this))
+{
+    const QString serverName = parameters.value("serverName"_L1,
+                                                QTextToSpeechRemote::defaultServerName()).toString();
+    connect(m_socket, &QLocalSocket::readyRead, this, &QTextToSpeechEngineRemote::readMessages);
+    connect(m_socket, &QLocalSocket::disconnected, this, [this]{
+        if (m_initialized) {
+            setError(QTextToSpeech::ErrorReason::Playback,
+                     QCoreApplication::translate("QTextToSpeech",
+                                                 "Lost the connection to the speech server"));
+        }
+    });
+
+    m_socket->connectToServer(serverName);
+    if (!m_socket->waitForConnected(ConnectTimeout)) {
+        m_errorString = QCoreApplication::translate("QTextToSpeech",
+                                                    "Cannot connect to the speech server %1: %2")
+                                                    .arg(serverName, m_socket->errorString());
+        qCDebug(lcSpeechTtsRemote) << m_errorString;
+        return;
+    }
+
+    // The server creates the engine, and tells us about it
+    send(Message::Hello, QTextToSpeechRemote::ProtocolVersion,
+         parameters.value("engine"_L1).toString(),
+         parameters.value("engineParameters"_L1).toMap());
+    const QDeadlineTimer deadline(InitTimeout);
+    while (!m_initialized && m_socket->waitForReadyRead(deadline.remainingTime()))
+        ;
+    if (!m_initialized && m_errorString.isEmpty()) {
+        m_errorString = QCoreApplication::translate("QTextToSpeech",
+                                                    "The speech server %1 did not respond")
+                                                    .arg(serverName);
+    }
+}
+
+QTextToSpeechEngineRemote::~QTextToSpeechEngineRemote()
+{
+    // the server stops speaking for us once we are gone
+    m_socket->disconnect(this);
+}
+
+QTextToSpeech::Capabilities QTextToSpeechEngineRemote::capabilities() const
+{
+    return m_capabilities;
+}
+
+QList<QLocale> QTextToSpeechEngineRemote::availableLocales() const
+{
+    QList<QLocale> locales;
+    for (const QVoice &voice : m_voices) {
+        if (!locales.contains(voice.locale()))
+            locales.append(voice.locale());
+    }
+    return locales;
+}
+
+QList<QVoice> QTextToSpeechEngineRemote::availableVoices() const
+{
+    return allVoices(&m_locale);
+}
+
+QList<QVoice> QTextToSpeechEngineRemote::allVoices(const QLocale *locale) const
+{
+    if (!locale)
+        return m_voices;
+    QList<QVoice> voices;
+    for (const QVoice &voice : m_voices) {
+        if (voice.locale() == *locale)
+            voices.append(voice);
+    }
+    return voices;
+}
+
+void QTextToSpeechEngineRemote::say(const QString &text)
+{
+    ++m_request;
+    setState(QTextToSpeech::Speaking);
+    send(Message::Say, m_request, text);
+}
+
+void QTextToSpeechEngineRemote::synthesize(const QString &text)
+{
+    ++m_request;
+    setState(QTextToSpeech::Synthesizing);
+    send(Message::Synthesize, m_request, text);
+}
+
+void QTextToSpeechEngineRemote::stop(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    send(Message::Stop, qint32(boundaryHint));
+}
+
+void QTextToSpeechEngineRemote::pause(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    send(Message::Pause, qint32(boundaryHint));
+}
+
+void QTextToSpeechEngineRemote::resume()
+{
+    send(Message::Resume);
+}
+
+double QTextToSpeechEngineRemote::rate() const
+{
+    return m_rate;
+}
+
+bool QTextToSpeechEngineRemote::setRate(double rate)
+{
+    m_rate = rate;
+    send(Message::SetRate, rate);
+    return true;
+}
+
+double QTextToSpeechEngineRemote::pitch() const
+{
+    return m_pitch;
+}
+
+bool QTextToSpeechEngineRemote::setPitch(double pitch)
+{
+    m_pitch = pitch;
+    send(Message::SetPitch, pitch);
+    return true;
+}
+
+QLocale QTextToSpeechEngineRemote::locale() const
+{
+    return m_locale;
+}
+
+bool QTextToSpeechEngineRemote::setLocale(const QLocale &locale)
+{
+    const QList<QVoice> voices = allVoices(&locale);
+    if (voices.isEmpty())
+        return false;
+    return setVoice(voices.contains(m_voice) ? m_voice : voices.first());
+}
+
+double QTextToSpeechEngineRemote::volume() const
+{
+    return m_volume;
+}
+
+bool QTextToSpeechEngineRemote::setVolume(double volume)
+{
+    m_volume = volume;
+    send(Message::SetVolume, volume);
+    return true;
+}
+
+QVoice QTextToSpeechEngineRemote::voice() const
+{
+    return m_voice;
+}
+
+bool QTextToSpeechEngineRemote::setVoice(const QVoice &voice)
+{
+    const qint32 index = qint32(m_voices.indexOf(voice));
+    if (index < 0)
+        return false;
+    m_voice = voice;
+    m_locale = voice.locale();
+    send(Message::SetVoice, index);
+    return true;
+}
+
+QTextToSpeech::State QTextToSpeechEngineRemote::state() const
+{
+    return m_state;
+}
+
+QTextToSpeech::ErrorReason QTextToSpeechEngineRemote::errorReason() const
+{
+    return m_errorReason;
+}
+
+QString QTextToSpeechEngineRemote::errorString() const
+{
+    return m_errorString;
+}
+
+void QTextToSpeechEngineRemote::readMessages()
+{
+    m_reader.read(m_socket);
+    Message message;
+    QByteArray payload;
+    while (m_reader.next(&message, &payload))
+        handleMessage(message, payload);
+}
+
+void QTextToSpeechEngineRemote::handleMessage(Message message, const QByteArray &payload)
+{
+    QDataStream in(payload);
+    in.setVersion(QTextToSpeechRemote::StreamVersion);
+    quint32 request = 0;
+
+    switch (message) {
+    case Message::Init: {
+        qint32 capabilities, state, errorReason, voiceIndex;
+        QList<QTextToSpeechRemote::Voice> voices;
+        in >> capabilities >> state >> errorReason >> m_errorString >> voices >> voiceIndex
+           >> m_rate >> m_pitch >> m_volume;
+        m_initialized = true;
+        m_capabilities = QTextToSpeech::Capabilities::fromInt(capabilities);
+        m_errorReason = QTextToSpeech::ErrorReason(errorReason);
+        m_state = QTextToSpeech::State(state);
+        setVoices(voices, voiceIndex);
+        break;
+    }
+    case Message::Voices: {
+        qint32 voiceIndex;
+        QList<QTextToSpeechRemote::Voice> voices;
+        in >> voices >> voiceIndex;
+        setVoices(voices, voiceIndex);
+        emit voicesChanged();
+        break;
+    }
+    case Message::State: {
+        qint32 state;
+        in >> request >> state;
+        if (request == m_request)
+            setState(QTextToSpeech::State(state));
+        break;
+    }
+    case Message::Error: {
+        qint32 reason;
+        QString errorString;
+        in >> request >> reason >> errorString;
+        // the state follows with its own message
+        if (request == m_request) {
+            m_errorReason = QTextToSpeech::ErrorReason(reason);
+            m_errorString = errorString;
+            emit errorOccurred(m_errorReason, m_errorString);
+        }
+        break;
+    }
+    case Message::SayingWord: {
+        QString word;
+        qint64 start, length;
+        in >> request >> word >> start >> length;
+        if (request == m_request)
+            emit sayingWord(word, start, length);
+        break;
+    }
+    case Message::Synthesized: {
+        qint32 sampleRate, channelCount, sampleFormat;
+        QByteArray data;
+        in >> request >> sampleRate >> channelCount >> sampleFormat >> data;
+        if (request != m_request)
+            break;
+        QAudioFormat format;
+        format.setSampleRate(sampleRate);
+        format.setChannelCount(channelCount);
+        format.setSampleFormat(QAudioFormat::SampleFormat(sampleFormat));
+        emit synthesized(format, data);
+        break;
+    }
+    case Message::SynthesizedWord: {
+        QString word;
+        qint64 start, length, position;
+        in >> request >> word >> start >> length >> position;
+        if (request == m_request)
+            emit synthesizedWord(word, start, length, position);
+        break;
+    }
+    default:
+        qCWarning(lcSpeechTtsRemote) << "Unexpected message from the speech server"
+                                     << int(message);
+        break;
+    }
+}
+
+void QTextToSpeechEngineRemote::setVoices(const QList<QTextToSpeechRemote::Voice> &voices,
+                                          qint32 voiceIndex)
+{
+    m_voices.clear();
+    m_voices.reserve(voices.size());
+    for (const QTextToSpeechRemote::Voice &voice : voices) {
+        m_voices.append(createVoice(voice.name, voice.locale, QVoice::Gender(voice.gender),
+                                    QVoice::Age(voice.age), QVariant(qsizetype(m_voices.size()))));
+    }
+    m_voice = m_voices.value(voiceIndex);
+    m_locale = m_voice.locale();
+}
+
+void QTextToSpeechEngineRemote::setState(QTextToSpeech::State state)
+{
+    if (m_state == state)
+        return;
+    m_state = state;
+    emit stateChanged(state);
+}
+
+void QTextToSpeechEngineRemote::setError(QTextToSpeech::ErrorReason reason,
+                                         const QString &errorString)
+{
+    m_errorReason = reason;
+    m_errorString = errorString;
+    emit errorOccurred(reason, errorString);
+    setState(QTextToSpeech::Error);
+}
+
+QT_END_NAMESPACE
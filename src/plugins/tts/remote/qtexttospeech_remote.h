@@ -0,0 +1,85 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECH_REMOTE_H
+#define QTEXTTOSPEECH_REMOTE_H
+
+#include "qtexttospeechengine.h"
+#include <QtTextToSpeech/private/qtexttospeechremote_p.h>
+
+#include <QtNetwork/QLocalSocket>
+
+QT_BEGIN_NAMESPACE
+
+// Engine that lets a speech server speak, so that all applications on the
+// system share the server's engines, voices, and audio devices.
+class QTextToSpeechEngineRemote : public QTextToSpeechEngine
+{
+    Q_OBJECT
+
+public:
+    explicit QTextToSpeechEngineRemote(const QVariantMap &parameters, QObject *parent = nullptr);
+    ~QTextToSpeechEngineRemote() override;
+
+    QTextToSpeech::Capabilities capabilities() const override;
+    QList<QLocale> availableLocales() const override;
+    QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
+
+    void say(const QString &text) override;
+    void synthesize(const QString &text) override;
+    void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void pause(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void resume() override;
+
+    double rate() const override;
+    bool setRate(double rate) override;
+    double pitch() const override;
+    bool setPitch(double pitch) override;
+    QLocale locale() const override;
+    bool setLocale(const QLocale &locale) override;
+    double volume() const override;
+    bool setVolume(double volume) override;
+    QVoice voice() const override;
+    bool setVoice(const QVoice &voice) override;
+    QTextToSpeech::State state() const override;
+    QTextToSpeech::ErrorReason errorReason() const override;
+    QString errorString() const override;
+
+private:
+    template <typename ...Args>
+    void send(QTextToSpeechRemote::Message message, const Args &...args)
+    {
+        if (m_socket->state() == QLocalSocket::ConnectedState)
+            QTextToSpeechRemote::send(m_socket, message, args...);
+    }
+    void readMessages();
+    void handleMessage(QTextToSpeechRemote::Message message, const QByteArray &payload);
+    void setVoices(const QList<QTextToSpeechRemote::Voice> &voices, qint32 voiceIndex);
+    void setState(QTextToSpeech::State state);
+    void setError(QTextToSpeech::ErrorReason reason, const QString &errorString);
+
+    QLocalSocket *m_socket;
+    QTextToSpeechRemote::Reader m_reader;
+    bool m_initialized = false;
+
+    QTextToSpeech::Capabilities m_capabilities = QTextToSpeech::Capability::None;
+    // in the order of the server, which refers to them by index
+    QList<QVoice> m_voices;
+    QVoice m_voice;
+    QLocale m_locale;
+    double m_rate = 0;
+    double m_pitch = 0;
+    double m_volume = 1;
+
+    // the current say() or synthesize() request; messages about earlier
+    // requests are still on their way
+    quint32 m_request = 0;
+    QTextToSpeech::State m_state = QTextToSpeech::Error;
+    QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
+    QString m_errorString;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,17 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeech_remote_plugin.h"
+#include "qtexttospeech_remote.h"
+
+QT_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcSpeechTtsRemote, "qt.speech.tts.remote")
+
+QTextToSpeechEngine *QTextToSpeechRemotePlugin::createTextToSpeechEngine(const QVariantMap &parameters, QObject *parent, QString *errorString) const
+{
+    Q_UNUSED(errorString);
+    return new QTextToSpeechEngineRemote(parameters, parent);
+}
+
+QT_END_NAMESPACE
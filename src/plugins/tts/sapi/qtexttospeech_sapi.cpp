@@ -12,6 +12,11 @@
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
+#include <QtCore/QMutex>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+
+#include <atomic>
 
 QT_BEGIN_NAMESPACE
 
@@ -59,24 +64,342 @@ inline void SpClearEvent(SPEVENT *pe)
 }
 #endif // Q_CC_MINGW
 
-QTextToSpeechEngineSapi::QTextToSpeechEngineSapi(const QVariantMap &, QObject *)
+// Output stream for synthesize(), reused for all calls. SAPI writes many small
+// blocks, which the stream collects into larger chunks before emitting them.
+class QTextToSpeechSapiStream : public ISpStreamFormat
 {
-    if (FAILED(::CoInitialize(NULL))) {
+public:
+    QTextToSpeechSapiStream(QTextToSpeechEngineSapi *engine, const QAudioFormat &format)
+        : m_engine(engine), m_format(format)
+        // 100ms of audio
+        , m_chunkSize(format.bytesForDuration(100000))
+    {
+        m_buffer.reserve(m_chunkSize);
+        // The voice writes from its own apartment; the stream is thread-safe, so
+        // let it do so directly instead of through a proxy into the engine's thread
+        if (FAILED(CoCreateFreeThreadedMarshaler(static_cast<IUnknown *>(this), &m_marshaler)))
+            m_marshaler = nullptr;
+    }
+    virtual ~QTextToSpeechSapiStream()
+    {
+        if (m_marshaler)
+            m_marshaler->Release();
+    }
+
+    // Emits what has been collected so far
+    void flush()
+    {
+        QByteArray data;
+        {
+            QMutexLocker locker(&m_mutex);
+            data = takeBuffer();
+        }
+        if (!data.isEmpty())
+            emit m_engine->synthesized(m_format, data);
+    }
+
+    // Drops what has been collected so far
+    void reset()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_buffer.resize(0);
+        m_pos = 0;
+        m_length = 0;
+    }
+
+    // IUnknown
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_ref; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        const ULONG ref = --m_ref;
+        if (!ref)
+            delete this;
+        return ref;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, VOID **ppvInterface) override
+    {
+        if (!ppvInterface)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown)) {
+            *ppvInterface = static_cast<IUnknown*>(this);
+        } else if (riid == __uuidof(IStream)) {
+            *ppvInterface = static_cast<IStream *>(this);
+        } else if (riid == __uuidof(ISpStreamFormat)) {
+            *ppvInterface = static_cast<ISpStreamFormat *>(this);
+        } else if (riid == __uuidof(IMarshal) && m_marshaler) {
+            return m_marshaler->QueryInterface(riid, ppvInterface);
+        } else {
+            *ppvInterface = nullptr;
+            return E_NOINTERFACE;
+        }
+        AddRef();
+        return S_OK;
+    }
+
+    // IStream, called by SAPI's thread
+    HRESULT STDMETHODCALLTYPE Read(void *,ULONG,ULONG *) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE Write(const void *pv,ULONG cb,ULONG *pcbWritten) override
+    {
+        QByteArray data;
+        {
+            QMutexLocker locker(&m_mutex);
+            m_buffer.append(static_cast<const char *>(pv), cb);
+            m_pos += cb;
+            m_length = std::max(m_length, m_pos);
+            if (m_buffer.size() >= m_chunkSize)
+                data = takeBuffer();
+        }
+        if (!data.isEmpty())
+            emit m_engine->synthesized(m_format, data);
+        if (pcbWritten)
+            *pcbWritten = cb;
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition) override
+    {
+        QMutexLocker locker(&m_mutex);
+        qint64 move = dlibMove.QuadPart;
+        switch (dwOrigin) {
+        case STREAM_SEEK_SET:
+            m_pos = move;
+            break;
+        case STREAM_SEEK_CUR:
+            m_pos += move;
+            break;
+        case STREAM_SEEK_END:
+            m_pos = m_length + move;
+            break;
+        }
+        if (plibNewPosition)
+            (*plibNewPosition).QuadPart = m_pos;
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE CopyTo(IStream *,ULARGE_INTEGER,ULARGE_INTEGER *,ULARGE_INTEGER *) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE Revert(void) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER,ULARGE_INTEGER,DWORD) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER,ULARGE_INTEGER,DWORD) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE Stat(STATSTG *,DWORD) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE Clone(IStream **) override { return E_NOTIMPL; }
+
+    // ISpStreamFormat
+    HRESULT STDMETHODCALLTYPE GetFormat(GUID *pguidFormatId,WAVEFORMATEX **ppCoMemWaveFormatEx) override
+    {
+        *pguidFormatId = SPDFID_WaveFormatEx;
+        WAVEFORMATEX *format = static_cast<WAVEFORMATEX *>(CoTaskMemAlloc(sizeof(WAVEFORMATEX)));
+        format->wFormatTag = WAVE_FORMAT_PCM;
+        format->nChannels = m_format.channelCount();
+        format->nSamplesPerSec = m_format.sampleRate();
+        format->wBitsPerSample = m_format.bytesPerSample() * 8;
+        format->nBlockAlign = format->nChannels * format->wBitsPerSample / 8;
+        format->nAvgBytesPerSec = format->nSamplesPerSec * format->nBlockAlign;
+        format->cbSize = 0; // amount of extra format information
+
+        *ppCoMemWaveFormatEx = format;
+        return S_OK;
+    }
+
+private:
+    QByteArray takeBuffer()
+    {
+        QByteArray data = std::exchange(m_buffer, QByteArray());
+        m_buffer.reserve(m_chunkSize);
+        return data;
+    }
+
+    std::atomic<ULONG> m_ref = 1;
+    IUnknown *m_marshaler = nullptr;
+    QTextToSpeechEngineSapi *m_engine = nullptr;
+    const QAudioFormat m_format;
+    const qsizetype m_chunkSize;
+
+    QMutex m_mutex;
+    qint64 m_pos = 0;
+    qint64 m_length = 0;
+    QByteArray m_buffer;
+};
+
+// Owns the voice in a multithreaded apartment of its own, where it waits for the
+// voice's events and hands them to the engine in batches. Reading the events
+// doesn't involve the engine's thread, which is only woken once for all events
+// that arrived since it last looked, rather than once for each event.
+class QTextToSpeechSapiEventThread : public QThread
+{
+public:
+    struct Event
+    {
+        SPEVENTENUM id;
+        ULONG streamNumber;
+        WPARAM wParam;
+        LPARAM lParam;
+        ULONGLONG audioStreamOffset;
+    };
+
+    explicit QTextToSpeechSapiEventThread(QTextToSpeechEngineSapi *engine)
+        : m_engine(engine)
+        , m_stopEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+    {}
+
+    ~QTextToSpeechSapiEventThread() override
+    {
+        // the thread never calls into other apartments, so it can't block us
+        SetEvent(m_stopEvent);
+        wait();
+        if (m_marshaledVoice) {
+            CoReleaseMarshalData(m_marshaledVoice);
+            m_marshaledVoice->Release();
+        }
+        CloseHandle(m_stopEvent);
+    }
+
+    // Starts the thread, and returns the voice that it created for use in the
+    // calling thread, or nullptr if it couldn't be created.
+    ISpVoice *createVoice()
+    {
+        start();
+        m_created.acquire();
+        if (!m_marshaledVoice)
+            return nullptr;
+        ISpVoice *voice = nullptr;
+        // releases the stream, also when it fails
+        if (FAILED(CoGetInterfaceAndReleaseStream(std::exchange(m_marshaledVoice, nullptr),
+                                                  __uuidof(ISpVoice),
+                                                  reinterpret_cast<void **>(&voice)))) {
+            return nullptr;
+        }
+        return voice;
+    }
+
+    QList<Event> takeEvents()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_posted = false;
+        return std::exchange(m_events, {});
+    }
+
+protected:
+    void run() override
+    {
+        const bool comInitialized = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+        ISpVoice *voice = nullptr;
+        ISpEventSource2 *eventSource = nullptr;
+        HANDLE notifyEvent = nullptr;
+        if (comInitialized
+            && SUCCEEDED(CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice,
+                                          reinterpret_cast<void **>(&voice)))) {
+            // phonemes, visemes, and audio levels would only wake us up
+            const ULONGLONG interest = SPFEI(SPEI_START_INPUT_STREAM)
+                                     | SPFEI(SPEI_END_INPUT_STREAM)
+                                     | SPFEI(SPEI_WORD_BOUNDARY);
+            voice->SetInterest(interest, interest);
+            if (SUCCEEDED(voice->SetNotifyWin32Event()))
+                notifyEvent = voice->GetNotifyEventHandle();
+            if (FAILED(voice->QueryInterface(&eventSource)))
+                eventSource = nullptr;
+            if (FAILED(CoMarshalInterThreadInterfaceInStream(__uuidof(ISpVoice), voice,
+                                                             &m_marshaledVoice))) {
+                m_marshaledVoice = nullptr;
+            }
+        }
+        // from here on, m_marshaledVoice belongs to createVoice()
+        m_created.release();
+
+        // the apartment, and with it the voice, has to exist as long as the engine
+        if (eventSource && notifyEvent) {
+            const HANDLE handles[] = { m_stopEvent, notifyEvent };
+            while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+                readEvents(eventSource);
+        } else {
+            WaitForSingleObject(m_stopEvent, INFINITE);
+        }
+
+        if (eventSource)
+            eventSource->Release();
+        if (voice)
+            voice->Release();
+        if (comInitialized)
+            CoUninitialize();
+    }
+
+private:
+    void readEvents(ISpEventSource2 *eventSource)
+    {
+        static constexpr ULONG BatchSize = 16;
+        // we can't use CSpEvent here as it doesn't provide the time offset
+        SPEVENTEX events[BatchSize];
+        ULONG got = 0;
+        QList<Event> batch;
+        HRESULT hr;
+        do {
+            got = 0;
+            hr = eventSource->GetEventsEx(BatchSize, events, &got);
+            for (ULONG i = 0; i < got; ++i) {
+                SPEVENTEX &event = events[i];
+                batch.append({ SPEVENTENUM(event.eEventId), event.ulStreamNum, event.wParam,
+                               event.lParam, event.ullAudioStreamOffset });
+                // There is no SpClearEventEx, and while a SPEVENTEX is not a subclass of
+                // SPEVENT, the two structs have identical memory layout, plus the extra
+                // ullAudioTimeOffset member.
+                SpClearEvent(reinterpret_cast<SPEVENT *>(&event));
+            }
+        } while (hr == S_OK && got == BatchSize);
+        if (batch.isEmpty())
+            return;
+
+        QMutexLocker locker(&m_mutex);
+        m_events += batch;
+        // the engine takes everything that is pending when it gets to it
+        if (std::exchange(m_posted, true))
+            return;
+        locker.unlock();
+        QMetaObject::invokeMethod(m_engine, [engine = m_engine]{
+            engine->processEvents();
+        }, Qt::QueuedConnection);
+    }
+
+    QTextToSpeechEngineSapi *m_engine;
+    const HANDLE m_stopEvent;
+    QSemaphore m_created;
+    IStream *m_marshaledVoice = nullptr;
+
+    QMutex m_mutex;
+    QList<Event> m_events;
+    bool m_posted = false;
+};
+
+QTextToSpeechEngineSapi::QTextToSpeechEngineSapi(const QVariantMap &parameters, QObject *)
+{
+    // Voices usually synthesize 16 or 22.05 kHz; requesting the voice's own
+    // rate saves SAPI from resampling
+    const int sampleRate = parameters.value("sampleRate"_L1, 16000).toInt();
+    m_synthesizeFormat.setChannelConfig(QAudioFormat::ChannelConfigMono);
+    m_synthesizeFormat.setSampleRate(sampleRate > 0 ? sampleRate : 16000);
+    m_synthesizeFormat.setSampleFormat(QAudioFormat::Int16);
+
+    // worker threads might already use the multithreaded apartment, which works as well
+    const HRESULT comResult = ::CoInitialize(NULL);
+    m_comInitialized = SUCCEEDED(comResult);
+    if (!m_comInitialized && comResult != RPC_E_CHANGED_MODE) {
         qWarning() << "Init of COM failed";
         return;
     }
 
-    HRESULT hr = CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, IID_ISpVoice, (void **)&m_voice);
-    if (!SUCCEEDED(hr)) {
+    // The voice lives in the event thread's apartment, so that the thread reads
+    // its events without going through this thread. Calls from here go to the
+    // multithreaded apartment, which doesn't depend on the event thread.
+    m_eventThread = new QTextToSpeechSapiEventThread(this);
+    m_voice = m_eventThread->createVoice();
+    if (!m_voice) {
         setError(QTextToSpeech::ErrorReason::Initialization,
                  QCoreApplication::translate("QTextToSpeech",
                                              "Could not initialize text-to-speech engine."));
         return;
     }
 
-    m_voice->SetInterest(SPFEI_ALL_TTS_EVENTS, SPFEI_ALL_TTS_EVENTS);
-    m_voice->SetNotifyCallbackInterface(this, 0, 0);
     updateVoices();
+    m_currentVoice = queryVoice();
     if (m_voices.isEmpty()) {
         setError(QTextToSpeech::ErrorReason::Configuration,
                  QCoreApplication::translate("QTextToSpeech", "No voices available."));
@@ -90,7 +413,12 @@ QTextToSpeechEngineSapi::~QTextToSpeechEngineSapi()
 {
     if (m_voice)
         m_voice->Release();
-    CoUninitialize();
+    // releases the voice's last reference in its apartment
+    delete m_eventThread;
+    if (m_outputStream)
+        m_outputStream->Release();
+    if (m_comInitialized)
+        CoUninitialize();
 }
 
 bool QTextToSpeechEngineSapi::isSpeaking() const
@@ -108,129 +436,51 @@ void QTextToSpeechEngineSapi::say(const QString &text)
     if (m_state != QTextToSpeech::Ready)
         stop(QTextToSpeech::BoundaryHint::Default);
 
-    currentText = text;
-    const QString prefix = u"<pitch absmiddle=\"%1\"/>"_s.arg(m_pitch * 10);
-    textOffset = prefix.length();
-    currentText.prepend(prefix);
+    if (m_synthesizing) {
+        // back to the default audio output
+        m_voice->SetOutput(nullptr, TRUE);
+        m_synthesizing = false;
+    }
+
+    prepareText(text);
 
-    HRESULT hr = m_voice->Speak(currentText.toStdWString().data(), SPF_ASYNC, NULL);
+    HRESULT hr = m_voice->Speak(reinterpret_cast<const wchar_t *>(currentText.utf16()),
+                                SPF_ASYNC, &m_streamNumber);
     if (!SUCCEEDED(hr))
         setError(QTextToSpeech::ErrorReason::Input,
                  QCoreApplication::translate("QTextToSpeech", "Speech synthesizing failure."));
 }
 
-void QTextToSpeechEngineSapi::synthesize(const QString &text)
+// Sets currentText to the markup for the pitch, followed by text. The markup
+// only changes with the pitch, so keep it, and the string's capacity, for the
+// next call. On Windows, the UTF-16 data can then be passed to SAPI as it is.
+void QTextToSpeechEngineSapi::prepareText(const QString &text)
 {
-    class OutputStream : public ISpStreamFormat
-    {
-        ULONG m_ref = 1;
-        qint64 m_pos = 0;
-        qint64 m_length = 0;
-        QTextToSpeechEngineSapi *m_engine = nullptr;
-        QAudioFormat m_format;
-
-    public:
-        OutputStream(QTextToSpeechEngineSapi *engine)
-            : m_engine(engine)
-        {
-            m_format.setChannelConfig(QAudioFormat::ChannelConfigMono);
-            m_format.setSampleRate(16000);
-            m_format.setSampleFormat(QAudioFormat::Int16);
-        }
-        virtual ~OutputStream() = default;
-
-        // IUnknown
-        ULONG STDMETHODCALLTYPE AddRef() override { return ++m_ref; }
-        ULONG STDMETHODCALLTYPE Release() override {
-            if (!--m_ref) {
-                delete this;
-                return 0;
-            }
-            return m_ref;
-        }
-
-        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, VOID **ppvInterface) override
-        {
-            if (!ppvInterface)
-                return E_POINTER;
-
-            if (riid == __uuidof(IUnknown)) {
-                *ppvInterface = static_cast<IUnknown*>(this);
-            } else if (riid == __uuidof(IStream)) {
-                *ppvInterface = static_cast<IStream *>(this);
-            } else if (riid == __uuidof(ISpStreamFormat)) {
-                *ppvInterface = static_cast<ISpStreamFormat *>(this);
-            } else {
-                *ppvInterface = nullptr;
-                return E_NOINTERFACE;
-            }
-            AddRef();
-            return S_OK;
-        }
-
-        // IStream
-        HRESULT STDMETHODCALLTYPE Read(void *,ULONG,ULONG *) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE Write(const void *pv,ULONG cb,ULONG *pcbWritten) override
-        {
-            emit m_engine->synthesized(m_format, QByteArray(static_cast<const char *>(pv), cb));
-            *pcbWritten = cb;
-            return S_OK;
-        }
-        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition) override
-        {
-            qint64 move = dlibMove.QuadPart;
-            switch (dwOrigin) {
-            case STREAM_SEEK_SET:
-                m_pos = move;
-                break;
-            case STREAM_SEEK_CUR:
-                m_pos += move;
-                break;
-            case STREAM_SEEK_END:
-                m_pos = m_length + move;
-                break;
-            }
-            (*plibNewPosition).QuadPart = m_pos;
-            return S_OK;
-        }
-        HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE CopyTo(IStream *,ULARGE_INTEGER,ULARGE_INTEGER *,ULARGE_INTEGER *) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE Revert(void) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER,ULARGE_INTEGER,DWORD) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER,ULARGE_INTEGER,DWORD) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE Stat(STATSTG *,DWORD) override { return E_NOTIMPL; }
-        HRESULT STDMETHODCALLTYPE Clone(IStream **) override { return E_NOTIMPL; }
-
-        // ISpStreamFormat
-        HRESULT STDMETHODCALLTYPE GetFormat(GUID *pguidFormatId,WAVEFORMATEX **ppCoMemWaveFormatEx) override
-        {
-            *pguidFormatId = SPDFID_WaveFormatEx;
-            WAVEFORMATEX *format = static_cast<WAVEFORMATEX *>(CoTaskMemAlloc(sizeof(WAVEFORMATEX)));
-            format->wFormatTag = WAVE_FORMAT_PCM;
-            format->nChannels = m_format.channelCount();
-            format->nSamplesPerSec = m_format.sampleRate();
-            format->wBitsPerSample = m_format.bytesPerSample() * 8;
-            format->nBlockAlign = format->nChannels * format->wBitsPerSample / 8;
-            format->nAvgBytesPerSec = format->nSamplesPerSec * format->nBlockAlign;
-            format->cbSize = 0; // amount of extra format information
-
-            *ppCoMemWaveFormatEx = format;
-            return S_OK;
-        }
-    };
+    if (m_pitchChanged) {
+        currentText = u"<pitch absmiddle=\"%1\"/>"_s.arg(m_pitch * 10);
+        textOffset = currentText.size();
+        m_pitchChanged = false;
+    } else {
+        currentText.truncate(textOffset);
+    }
+    currentText += text;
+}
 
+void QTextToSpeechEngineSapi::synthesize(const QString &text)
+{
     if (text.isEmpty())
         return;
 
-    currentText = text;
-    const QString prefix = u"<pitch absmiddle=\"%1\"/>"_s.arg(m_pitch * 10);
-    textOffset = prefix.length();
-    currentText.prepend(prefix);
+    prepareText(text);
 
-    OutputStream *outputStream = new OutputStream(this);
-    m_voice->SetOutput(outputStream, false);
-    HRESULT hr = m_voice->Speak(currentText.toStdWString().data(), SPF_ASYNC, NULL);
+    if (!m_outputStream)
+        m_outputStream = new QTextToSpeechSapiStream(this, m_synthesizeFormat);
+    if (!m_synthesizing) {
+        m_voice->SetOutput(m_outputStream, FALSE);
+        m_synthesizing = true;
+    }
+    HRESULT hr = m_voice->Speak(reinterpret_cast<const wchar_t *>(currentText.utf16()),
+                                SPF_ASYNC, &m_streamNumber);
     if (!SUCCEEDED(hr))
         setError(QTextToSpeech::ErrorReason::Input,
                  QCoreApplication::translate("QTextToSpeech", "Speech synthesizing failure."));
@@ -242,7 +492,9 @@ void QTextToSpeechEngineSapi::stop(QTextToSpeech::BoundaryHint boundaryHint)
     if (m_state == QTextToSpeech::Paused || m_pauseRequested)
         resume();
     m_voice->Speak(NULL, SPF_PURGEBEFORESPEAK, 0);
-    currentText.clear();
+    if (m_outputStream)
+        m_outputStream->reset();
+    currentText.truncate(textOffset);
 }
 
 void QTextToSpeechEngineSapi::pause(QTextToSpeech::BoundaryHint boundaryHint)
@@ -270,7 +522,10 @@ void QTextToSpeechEngineSapi::resume()
 
 bool QTextToSpeechEngineSapi::setPitch(double pitch)
 {
-    m_pitch = pitch;
+    if (m_pitch != pitch) {
+        m_pitch = pitch;
+        m_pitchChanged = true;
+    }
     return true;
 }
 
@@ -453,17 +708,7 @@ bool QTextToSpeechEngineSapi::setLocale(const QLocale &locale)
 
 QLocale QTextToSpeechEngineSapi::locale() const
 {
-    // Get current voice id
-    ISpObjectToken *cpVoiceToken = nullptr;
-    HRESULT hr = m_voice->GetVoice(&cpVoiceToken);
-    if (FAILED(hr)) {
-        qWarning() << "ISpObjectToken::GetVoice failed";
-        return QLocale();
-    }
-    // read attributes
-    const QMap<QString, QString> vAttr = voiceAttributes(cpVoiceToken);
-    cpVoiceToken->Release();
-    return lcidToLocale(vAttr.value(u"Language"_s));
+    return m_currentVoice.locale();
 }
 
 QList<QVoice> QTextToSpeechEngineSapi::availableVoices() const
@@ -471,6 +716,17 @@ QList<QVoice> QTextToSpeechEngineSapi::availableVoices() const
     return m_voices.values(locale());
 }
 
+QList<QVoice> QTextToSpeechEngineSapi::allVoices(const QLocale *locale) const
+{
+    if (locale)
+        return m_voices.values(*locale);
+    QList<QVoice> voices;
+    voices.reserve(m_voices.size());
+    for (const QLocale &voiceLocale : m_voices.uniqueKeys())
+        voices << m_voices.values(voiceLocale);
+    return voices;
+}
+
 bool QTextToSpeechEngineSapi::setVoice(const QVoice &voice)
 {
     // Convert voice id to null-terminated wide char string
@@ -498,10 +754,17 @@ bool QTextToSpeechEngineSapi::setVoice(const QVoice &voice)
 
     m_voice->SetVoice(cpVoiceToken);
     cpVoiceToken->Release();
+    m_currentVoice = voice;
     return true;
 }
 
 QVoice QTextToSpeechEngineSapi::voice() const
+{
+    return m_currentVoice;
+}
+
+// Returns the voice that SAPI uses, for initializing m_currentVoice
+QVoice QTextToSpeechEngineSapi::queryVoice() const
 {
     ISpObjectToken *cpVoiceToken = nullptr;
     HRESULT hr = m_voice->GetVoice(&cpVoiceToken);
@@ -546,44 +809,48 @@ QString QTextToSpeechEngineSapi::errorString() const
     return m_errorString;
 }
 
-HRESULT QTextToSpeechEngineSapi::NotifyCallback(WPARAM /*wParam*/, LPARAM /*lParam*/)
+/*
+    Handles the events that the event thread collected since the last call.
+    The state is only updated and reported once for all of them. Events of
+    other texts than the one that was passed to the voice last are ignored.
+*/
+void QTextToSpeechEngineSapi::processEvents()
 {
     const QTextToSpeech::State oldState = m_state;
 
-    // we can't use CSpEvent here as it doesn't provide the time offset
-    if (ISpEventSource2 *eventSource; S_OK == m_voice->QueryInterface(&eventSource)) {
-        SPEVENTEX event;
-        ULONG got;
-        while (S_OK == eventSource->GetEventsEx(1, &event, &got)) {
-            switch (event.eEventId) {
-            case SPEI_START_INPUT_STREAM:
-                m_state = QTextToSpeech::Speaking;
-                break;
-            case SPEI_END_INPUT_STREAM:
-                m_state = QTextToSpeech::Ready;
-                break;
-            case SPEI_WORD_BOUNDARY:
-                emit sayingWord(currentText.sliced(event.lParam, event.wParam),
-                                event.lParam - textOffset, event.wParam);
-                break;
-            // these are the other TTS events which might be interesting for us at some point
-            case SPEI_SENTENCE_BOUNDARY:
-            case SPEI_PHONEME:
-            case SPEI_TTS_BOOKMARK:
-            case SPEI_VISEME:
-            case SPEI_VOICE_CHANGE:
-            case SPEI_TTS_AUDIO_LEVEL:
-                break;
-            // the rest is uninteresting (speech recognition or engine-internal events).
-            default:
+    const QList<QTextToSpeechSapiEventThread::Event> events = m_eventThread->takeEvents();
+    for (const auto &event : events) {
+        // a batch can still have events of a text that was stopped since
+        if (event.streamNumber != m_streamNumber)
+            continue;
+        switch (event.id) {
+        case SPEI_START_INPUT_STREAM:
+            m_streamStart = event.audioStreamOffset;
+            m_state = QTextToSpeech::Speaking;
+            break;
+        case SPEI_END_INPUT_STREAM:
+            if (m_synthesizing)
+                m_outputStream->flush();
+            m_state = QTextToSpeech::Ready;
+            break;
+        case SPEI_WORD_BOUNDARY: {
+            const qsizetype start = qsizetype(event.lParam);
+            const qsizetype length = qsizetype(event.wParam);
+            if (start < textOffset || length < 0 || length > currentText.size() - start)
                 break;
+            const QString word = currentText.sliced(start, length);
+            if (m_synthesizing) {
+                const qint64 offset = event.audioStreamOffset - m_streamStart;
+                emit synthesizedWord(word, start - textOffset, length,
+                                     m_synthesizeFormat.durationForBytes(offset));
             }
-            // There is no SpClearEventEx, and while a SPEVENTEX is not a subclass of SPEVENT, the
-            // two structs have identical memory layout, plus the extra ullAudioTimeOffset member.
-            SpClearEvent(reinterpret_cast<SPEVENT*>(&event));
+            emit sayingWord(word, start - textOffset, length);
+            break;
+        }
+        // we are not interested in other events
+        default:
+            break;
         }
-
-        eventSource->Release();
     }
 
     // There are no explicit events for pause/resume, so we have to brute force this ourselves.
@@ -596,8 +863,6 @@ HRESULT QTextToSpeechEngineSapi::NotifyCallback(WPARAM /*wParam*/, LPARAM /*lPar
 
     if (m_state != oldState)
         emit stateChanged(m_state);
-
-    return S_OK;
 }
 
 QT_END_NAMESPACE
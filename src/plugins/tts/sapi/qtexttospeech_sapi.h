@@ -14,10 +14,14 @@
 #include <QtCore/qhash.h>
 #include <QtTextToSpeech/qtexttospeechengine.h>
 #include <QtTextToSpeech/qvoice.h>
+#include <QtMultimedia/qaudioformat.h>
 
 QT_BEGIN_NAMESPACE
 
-class QTextToSpeechEngineSapi : public QTextToSpeechEngine, public ISpNotifyCallback
+class QTextToSpeechSapiStream;
+class QTextToSpeechSapiEventThread;
+
+class QTextToSpeechEngineSapi : public QTextToSpeechEngine
 {
     Q_OBJECT
 
@@ -28,6 +32,7 @@ public:
     // Plug-in API:
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -47,16 +52,19 @@ public:
     QTextToSpeech::ErrorReason errorReason() const override;
     QString errorString() const override;
 
-    HRESULT STDMETHODCALLTYPE NotifyCallback(WPARAM /*wParam*/, LPARAM /*lParam*/) override;
     friend class OputStream;
+    friend class QTextToSpeechSapiEventThread;
 
 private:
+    void processEvents();
     bool isSpeaking() const;
     QMap<QString, QString> voiceAttributes(ISpObjectToken *speechToken) const;
     QString voiceId(ISpObjectToken *speechToken) const;
     QLocale lcidToLocale(const QString &lcid) const;
     QVoice::Age toVoiceAge(const QString &age) const;
     void updateVoices();
+    QVoice queryVoice() const;
+    void prepareText(const QString &text);
     void setError(QTextToSpeech::ErrorReason reason, const QString &string);
 
     QTextToSpeech::State m_state = QTextToSpeech::Error;
@@ -69,8 +77,24 @@ private:
     QString currentText;
     qsizetype textOffset = 0;
     ISpVoice *m_voice = nullptr;
+    // whether we have to uninitialize COM again
+    bool m_comInitialized = false;
+    // owns the apartment of the voice, and hands its events to processEvents()
+    QTextToSpeechSapiEventThread *m_eventThread = nullptr;
     double m_pitch = 0.0;
+    // whether the pitch markup at the start of currentText is outdated
+    bool m_pitchChanged = true;
     bool m_pauseRequested = false;
+
+    QAudioFormat m_synthesizeFormat;
+    // output of synthesize(), kept for subsequent calls
+    QTextToSpeechSapiStream *m_outputStream = nullptr;
+    // whether the stream is the voice's current output
+    bool m_synthesizing = false;
+    // stream offset, in bytes, at which the audio of the current text starts
+    quint64 m_streamStart = 0;
+    // SAPI's number for the current text, that its events refer to
+    ULONG m_streamNumber = 0;
 };
 QT_END_NAMESPACE
 
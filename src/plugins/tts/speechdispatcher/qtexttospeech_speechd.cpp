@@ -7,23 +7,84 @@
 #include <QtCore/QDebug>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QLoggingCategory>
+#include <QtCore/QMutex>
+#include <QtCore/QProcess>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThreadPool>
+#include <QtCore/qendian.h>
 
 #include <libspeechd.h>
 
+#include <algorithm>
+
 #if LIBSPEECHD_MAJOR_VERSION > 0 || LIBSPEECHD_MINOR_VERSION >= 9
   #define HAVE_SPD_090
 #endif
 
 QT_BEGIN_NAMESPACE
 
+using namespace Qt::StringLiterals;
+
 Q_LOGGING_CATEGORY(lcSpeechTtsSpeechd, "qt.speech.tts.speechd")
 
-typedef QList<QTextToSpeechEngineSpeechd*> QTextToSpeechSpeechDispatcherBackendList;
-Q_GLOBAL_STATIC(QTextToSpeechSpeechDispatcherBackendList, backends)
+namespace {
+// The engines that sent each message that speech-dispatcher hasn't finished,
+// so that its notifications reach only the engine that they are meant for.
+struct MessageRegistry
+{
+    QMutex mutex;
+    // only the current message of each engine
+    QHash<size_t, QTextToSpeechEngineSpeechd *> owners;
+    // notifications that arrived before spd_say() returned the message id,
+    // or after the engine stopped waiting for them; only the latest messages
+    // are kept
+    QHash<size_t, QList<SPDNotificationType>> unclaimed;
+    static constexpr qsizetype MaxUnclaimed = 16;
+
+    void removeOwner(QTextToSpeechEngineSpeechd *engine)
+    {
+        for (auto owner = owners.begin(); owner != owners.end();)
+            owner = owner.value() == engine ? owners.erase(owner) : std::next(owner);
+    }
+
+    void addUnclaimed(size_t msgId, SPDNotificationType state)
+    {
+        if (!unclaimed.contains(msgId) && unclaimed.size() >= MaxUnclaimed) {
+            // message ids increase, so the lowest is the oldest
+            const auto oldest = std::min_element(unclaimed.keyBegin(), unclaimed.keyEnd());
+            unclaimed.remove(*oldest);
+        }
+        unclaimed[msgId].append(state);
+    }
+};
+
+// The voices of all output modules. Listing them takes a while, so it happens
+// once per process, and in the background.
+struct VoiceCache
+{
+    QMutex mutex;
+    enum { Empty, Loading, Loaded } status = Empty;
+    QByteArrayList modules;
+    QHash<QByteArray, QList<QVoice>> voices;
+    // the espeak voice, language and variant, of the voices of espeak modules
+    QHash<QString, QString> espeakVoices;
+    // the synthesizer programs of the modules that can synthesize
+    QHash<QByteArray, QString> synthesizerPrograms;
+    // engines to notify when loading is done
+    QList<QTextToSpeechEngineSpeechd *> waiting;
+};
+}
+Q_GLOBAL_STATIC(MessageRegistry, messageRegistry)
+Q_GLOBAL_STATIC(VoiceCache, voiceCache)
+
+static bool isFinal(SPDNotificationType state)
+{
+    return state == SPD_EVENT_END || state == SPD_EVENT_CANCEL;
+}
 
 void speech_finished_callback(size_t msg_id, size_t client_id, SPDNotificationType state);
 
-QLocale QTextToSpeechEngineSpeechd::localeForVoice(SPDVoice *voice) const
+QLocale QTextToSpeechEngineSpeechd::localeForVoice(SPDVoice *voice)
 {
     QString lang_var = QString::fromLatin1(voice->language);
     if (qstrcmp(voice->variant, "none") != 0) {
@@ -33,21 +94,46 @@ QLocale QTextToSpeechEngineSpeechd::localeForVoice(SPDVoice *voice) const
     return QLocale(lang_var);
 }
 
+// The espeak output modules report the language that espeak identifies the
+// voice by, and the name of the variant file, if any, which espeak's -v option
+// takes as "language+variant". The name of the voice is only for display.
+QString QTextToSpeechEngineSpeechd::espeakVoiceForVoice(SPDVoice *voice)
+{
+    QString espeakVoice = QString::fromLatin1(voice->language).toLower();
+    if (voice->variant && qstrcmp(voice->variant, "none") != 0)
+        espeakVoice += u'+' + QString::fromUtf8(voice->variant);
+    return espeakVoice;
+}
+
+QString QTextToSpeechEngineSpeechd::espeakVoiceKey(const QByteArray &moduleName,
+                                                   const QString &voiceName)
+{
+    return QString::fromLatin1(moduleName) + u'/' + voiceName;
+}
+
 QTextToSpeechEngineSpeechd::QTextToSpeechEngineSpeechd(const QVariantMap &, QObject *)
     : speechDispatcher(nullptr)
 {
-    backends->append(this);
     connectToSpeechDispatcher();
 }
 
 QTextToSpeechEngineSpeechd::~QTextToSpeechEngineSpeechd()
 {
+    stopSynthesizer();
+    {
+        VoiceCache *cache = voiceCache();
+        QMutexLocker locker(&cache->mutex);
+        cache->waiting.removeOne(this);
+    }
     if (speechDispatcher) {
         if ((m_state != QTextToSpeech::Error) && (m_state != QTextToSpeech::Ready))
-            spd_cancel_all(speechDispatcher);
+            spd_cancel(speechDispatcher);
         spd_close(speechDispatcher);
     }
-    backends->removeAll(this);
+    // no notifications arrive once the connection is closed
+    MessageRegistry *registry = messageRegistry();
+    QMutexLocker locker(&registry->mutex);
+    registry->removeOwner(this);
 }
 
 bool QTextToSpeechEngineSpeechd::connectToSpeechDispatcher()
@@ -88,17 +174,13 @@ bool QTextToSpeechEngineSpeechd::connectToSpeechDispatcher()
         return false;
     }
 
-    updateVoices();
-    if (m_currentVoice == QVoice()) {
-        // Set the default locale (which is usually the system locale), and fall back
-        // to a locale that has the same language if that fails. That might then still fail,
-        // in which case there won't be a valid voice.
-        if (!setLocale(QLocale()) && !setLocale(QLocale().language())) {
-            setError(QTextToSpeech::ErrorReason::Configuration,
-                    QCoreApplication::translate("QTextToSpeech",
-                                                "Failed to initialize default locale and voice."));
-            return false;
-        }
+    // Until the voices are loaded, speech-dispatcher uses its default voice
+    // for the default locale.
+    if (updateVoices() && m_currentVoice == QVoice() && !selectDefaultVoice()) {
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                QCoreApplication::translate("QTextToSpeech",
+                                            "Failed to initialize default locale and voice."));
+        return false;
     }
 
     m_state = QTextToSpeech::Ready;
@@ -108,9 +190,13 @@ bool QTextToSpeechEngineSpeechd::connectToSpeechDispatcher()
     return true;
 }
 
-// hack to get state notifications
-void QTextToSpeechEngineSpeechd::spdStateChanged(SPDNotificationType state)
+void QTextToSpeechEngineSpeechd::spdStateChanged(size_t msgId, SPDNotificationType state)
 {
+    // ignore late notifications for messages we replaced, and for the message
+    // we cancelled before synthesizing
+    if (msgId != m_currentMessage || m_synthesizer)
+        return;
+
     QTextToSpeech::State s = QTextToSpeech::Error;
     if (state == SPD_EVENT_PAUSE)
         s = QTextToSpeech::Paused;
@@ -119,8 +205,13 @@ void QTextToSpeechEngineSpeechd::spdStateChanged(SPDNotificationType state)
     else if ((state == SPD_EVENT_CANCEL) || (state == SPD_EVENT_END))
         s = QTextToSpeech::Ready;
 
-    if (m_state != s) {
-        m_state = s;
+    changeState(s);
+}
+
+void QTextToSpeechEngineSpeechd::changeState(QTextToSpeech::State state)
+{
+    if (m_state != state) {
+        m_state = state;
         emit stateChanged(m_state);
     }
 }
@@ -149,25 +240,234 @@ void QTextToSpeechEngineSpeechd::say(const QString &text)
     if (m_state != QTextToSpeech::Ready)
         stop(QTextToSpeech::BoundaryHint::Default);
 
-    if (spd_say(speechDispatcher, SPD_MESSAGE, text.toUtf8().constData()) < 0)
+    const int msgId = spd_say(speechDispatcher, SPD_MESSAGE, text.toUtf8().constData());
+    if (msgId < 0) {
         setError(QTextToSpeech::ErrorReason::Input,
                  QCoreApplication::translate("QTextToSpeech", "Text synthesizing failure."));
+        return;
+    }
+    claimMessage(msgId);
 }
 
-void QTextToSpeechEngineSpeechd::synthesize(const QString &)
+// Registers this engine as the receiver of notifications for msgId, and
+// handles those that speech-dispatcher sent before spd_say() returned.
+void QTextToSpeechEngineSpeechd::claimMessage(size_t msgId)
 {
-    setError(QTextToSpeech::ErrorReason::Configuration, tr("Synthesize not supported"));
+    m_currentMessage = msgId;
+
+    QList<SPDNotificationType> notifications;
+    {
+        MessageRegistry *registry = messageRegistry();
+        QMutexLocker locker(&registry->mutex);
+        // the notifications about earlier messages are ignored anyway
+        registry->removeOwner(this);
+        notifications = registry->unclaimed.take(msgId);
+        if (std::none_of(notifications.cbegin(), notifications.cend(), isFinal))
+            registry->owners.insert(msgId, this);
+    }
+    for (SPDNotificationType state : std::as_const(notifications))
+        spdStateChanged(msgId, state);
+}
+
+QTextToSpeech::Capabilities QTextToSpeechEngineSpeechd::capabilities() const
+{
+    QTextToSpeech::Capabilities caps = QTextToSpeech::Capability::Speak
+                                     | QTextToSpeech::Capability::PauseResume;
+    if (!synthesizerProgram(m_currentVoice).isEmpty())
+        caps |= QTextToSpeech::Capability::Synthesize;
+    return caps;
+}
+
+// Returns the path to the synthesizer that the output module of \a voice uses,
+// if that synthesizer can write audio to stdout. Otherwise returns an empty string.
+QString QTextToSpeechEngineSpeechd::synthesizerProgram(const QVoice &voice) const
+{
+    return m_synthesizerPrograms.value(voiceData(voice).value<QByteArray>());
+}
+
+// Looks up the synthesizer of \a moduleName, as for synthesizerProgram().
+QString QTextToSpeechEngineSpeechd::findSynthesizerProgram(const QByteArray &moduleName)
+{
+    QString program;
+    if (moduleName == "espeak-ng" || moduleName == "espeak-ng-mbrola")
+        program = u"espeak-ng"_s;
+    else if (moduleName == "espeak" || moduleName == "espeak-mbrola")
+        program = u"espeak"_s;
+    else
+        return QString();
+    return QStandardPaths::findExecutable(program);
+}
+
+void QTextToSpeechEngineSpeechd::synthesize(const QString &text)
+{
+    if (text.isEmpty() || !connectToSpeechDispatcher())
+        return;
+
+    if (m_state != QTextToSpeech::Ready)
+        stop(QTextToSpeech::BoundaryHint::Default);
+
+    const QString program = synthesizerProgram(m_currentVoice);
+    if (program.isEmpty()) {
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                 QCoreApplication::translate("QTextToSpeech",
+                    "Output module %1 does not support synthesizing")
+                        .arg(voiceData(m_currentVoice).value<QByteArray>()));
+        return;
+    }
+
+    // map rate, pitch, and volume the way the espeak output modules do
+    const double currentRate = rate();
+    const int wordsPerMinute = qRound(currentRate < 0 ? 170 + currentRate * 90
+                                                      : 170 + currentRate * 220);
+    const QByteArray moduleName = voiceData(m_currentVoice).value<QByteArray>();
+    QString espeakVoice = m_espeakVoices.value(espeakVoiceKey(moduleName, m_currentVoice.name()));
+    if (espeakVoice.isEmpty())
+        espeakVoice = m_currentVoice.locale().bcp47Name().toLower();
+    const QStringList arguments = {
+        u"--stdout"_s,
+        u"--stdin"_s,
+        u"-b"_s, u"1"_s, // UTF-8 input
+        u"-v"_s, espeakVoice,
+        u"-s"_s, QString::number(wordsPerMinute),
+        u"-p"_s, QString::number(qRound((pitch() + 1) * 49.5)),
+        u"-a"_s, QString::number(qRound(volume() * 100)),
+    };
+
+    m_synthesizer = std::make_unique<QProcess>();
+    m_synthesizer->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(m_synthesizer.get(), &QProcess::readyReadStandardOutput,
+            this, &QTextToSpeechEngineSpeechd::synthesizerOutput);
+    connect(m_synthesizer.get(), &QProcess::finished,
+            this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+        synthesizerFinished(exitStatus == QProcess::NormalExit && exitCode == 0);
+    });
+    connect(m_synthesizer.get(), &QProcess::errorOccurred,
+            this, [this, program](QProcess::ProcessError error) {
+        if (error != QProcess::FailedToStart)
+            return;
+        stopSynthesizer();
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                 QCoreApplication::translate("QTextToSpeech", "Failed to start %1")
+                    .arg(program));
+    });
+
+    changeState(QTextToSpeech::Synthesizing);
+    m_synthesizer->start(program, arguments);
+    if (m_synthesizer) {
+        m_synthesizer->write(text.toUtf8());
+        m_synthesizer->closeWriteChannel();
+    }
+}
+
+void QTextToSpeechEngineSpeechd::synthesizerOutput()
+{
+    m_synthesizerBuffer += m_synthesizer->readAllStandardOutput();
+
+    if (!m_synthesizerFormat.isValid()) {
+        // The synthesizer streams, so the sizes of the RIFF and data chunks are
+        // placeholders. Everything after the data chunk header is audio.
+        if (m_synthesizerBuffer.size() < 12)
+            return;
+        if (!m_synthesizerBuffer.startsWith("RIFF")
+            || QByteArrayView(m_synthesizerBuffer).sliced(8, 4) != "WAVE") {
+            stopSynthesizer();
+            setError(QTextToSpeech::ErrorReason::Input,
+                     QCoreApplication::translate("QTextToSpeech", "Text synthesizing failure."));
+            return;
+        }
+
+        QAudioFormat format;
+        qsizetype pos = 12;
+        while (true) {
+            if (m_synthesizerBuffer.size() < pos + 8)
+                return;
+            const QByteArrayView chunkId = QByteArrayView(m_synthesizerBuffer).sliced(pos, 4);
+            const quint32 chunkSize = qFromLittleEndian<quint32>(m_synthesizerBuffer.constData() + pos + 4);
+            pos += 8;
+            if (chunkId == "data")
+                break;
+            if (m_synthesizerBuffer.size() < pos + qsizetype(chunkSize))
+                return;
+            if (chunkId == "fmt " && chunkSize >= 16) {
+                const char *fmt = m_synthesizerBuffer.constData() + pos;
+                const quint16 encoding = qFromLittleEndian<quint16>(fmt);
+                const quint16 bitsPerSample = qFromLittleEndian<quint16>(fmt + 14);
+                if (encoding == 1 && (bitsPerSample == 16 || bitsPerSample == 8)) {
+                    format.setChannelCount(qFromLittleEndian<quint16>(fmt + 2));
+                    format.setSampleRate(qFromLittleEndian<quint32>(fmt + 4));
+                    format.setSampleFormat(bitsPerSample == 16 ? QAudioFormat::Int16
+                                                               : QAudioFormat::UInt8);
+                }
+            }
+            // chunks are padded to an even size
+            pos += chunkSize + (chunkSize & 1);
+        }
+
+        if (!format.isValid()) {
+            stopSynthesizer();
+            setError(QTextToSpeech::ErrorReason::Input,
+                     QCoreApplication::translate("QTextToSpeech", "Unsupported audio format"));
+            return;
+        }
+        m_synthesizerFormat = format;
+        m_synthesizerBuffer.remove(0, pos);
+    }
+
+    // only pass on complete frames
+    const qsizetype bytes = m_synthesizerBuffer.size()
+                          - m_synthesizerBuffer.size() % m_synthesizerFormat.bytesPerFrame();
+    if (bytes > 0) {
+        const QByteArray data = m_synthesizerBuffer.first(bytes);
+        m_synthesizerBuffer.remove(0, bytes);
+        emit synthesized(m_synthesizerFormat, data);
+    }
+}
+
+void QTextToSpeechEngineSpeechd::synthesizerFinished(bool success)
+{
+    synthesizerOutput();
+    // might have been stopped, or failed
+    if (!m_synthesizer)
+        return;
+
+    stopSynthesizer();
+    if (success) {
+        changeState(QTextToSpeech::Ready);
+    } else {
+        setError(QTextToSpeech::ErrorReason::Input,
+                 QCoreApplication::translate("QTextToSpeech", "Text synthesizing failure."));
+    }
+}
+
+void QTextToSpeechEngineSpeechd::stopSynthesizer()
+{
+    if (!m_synthesizer)
+        return;
+
+    // we might be called from one of the process' signals
+    QProcess *synthesizer = m_synthesizer.release();
+    synthesizer->disconnect(this);
+    synthesizer->kill();
+    synthesizer->deleteLater();
+    m_synthesizerBuffer.clear();
+    m_synthesizerFormat = QAudioFormat();
 }
 
 void QTextToSpeechEngineSpeechd::stop(QTextToSpeech::BoundaryHint boundaryHint)
 {
     Q_UNUSED(boundaryHint);
+    if (m_synthesizer) {
+        stopSynthesizer();
+        changeState(QTextToSpeech::Ready);
+        return;
+    }
+
     if (!connectToSpeechDispatcher())
         return;
 
     if (m_state == QTextToSpeech::Paused)
-        spd_resume_all(speechDispatcher);
-    spd_cancel_all(speechDispatcher);
+        spd_resume(speechDispatcher);
+    spd_cancel(speechDispatcher);
 }
 
 void QTextToSpeechEngineSpeechd::pause(QTextToSpeech::BoundaryHint boundaryHint)
@@ -177,7 +477,7 @@ void QTextToSpeechEngineSpeechd::pause(QTextToSpeech::BoundaryHint boundaryHint)
         return;
 
     if (m_state == QTextToSpeech::Speaking) {
-        spd_pause_all(speechDispatcher);
+        spd_pause(speechDispatcher);
     }
 }
 
@@ -187,7 +487,7 @@ void QTextToSpeechEngineSpeechd::resume()
         return;
 
     if (m_state == QTextToSpeech::Paused) {
-        spd_resume_all(speechDispatcher);
+        spd_resume(speechDispatcher);
     }
 }
 
@@ -264,6 +564,11 @@ bool QTextToSpeechEngineSpeechd::setLocale(const QLocale &locale)
         return false;
 
     const int result = spd_set_language(speechDispatcher, locale.uiLanguages().at(0).toUtf8().data());
+    if (result == 0 && !m_voicesLoaded) {
+        // we'll pick a voice for the locale once we know them
+        m_locale = locale;
+        return true;
+    }
     if (result == 0) {
         const QVoice previousVoice = m_currentVoice;
 
@@ -283,7 +588,7 @@ bool QTextToSpeechEngineSpeechd::setLocale(const QLocale &locale)
 
 QLocale QTextToSpeechEngineSpeechd::locale() const
 {
-    return m_currentVoice.locale();
+    return m_locale;
 }
 
 bool QTextToSpeechEngineSpeechd::setVoice(const QVoice &voice)
@@ -303,6 +608,7 @@ bool QTextToSpeechEngineSpeechd::setVoice(const QVoice &voice)
     const int result2 = spd_set_synthesis_voice(speechDispatcher, voice.name().toUtf8().data());
     if (result2 == 0) {
         m_currentVoice = voice;
+        m_locale = voice.locale();
         return true;
     }
     setError(QTextToSpeech::ErrorReason::Configuration,
@@ -330,46 +636,125 @@ QString QTextToSpeechEngineSpeechd::errorString() const
     return m_errorString;
 }
 
-void QTextToSpeechEngineSpeechd::updateVoices()
+// Copies the voices from the cache, and returns true if they have been loaded.
+// Otherwise starts loading them, and returns false; voicesLoaded() gets called
+// when they are available.
+bool QTextToSpeechEngineSpeechd::updateVoices()
 {
-    char **modules = spd_list_modules(speechDispatcher);
-#ifdef HAVE_SPD_090
-    char *original_module = spd_get_output_module(speechDispatcher);
-#else
-    char *original_module = modules[0];
-#endif
-    char **module = modules;
-    while (module != nullptr && module[0] != nullptr) {
-        spd_set_output_module(speechDispatcher, module[0]);
-
-        SPDVoice **voices = spd_list_synthesis_voices(speechDispatcher);
-        int i = 0;
-        while (voices != nullptr && voices[i] != nullptr) {
-            const QLocale locale = localeForVoice(voices[i]);
-            const QVariant data = QVariant::fromValue<QByteArray>(module[0]);
-            // speechd declares enums and APIs for gender and age, but the SPDVoice struct
-            // carries no relevant information.
-            const QVoice voice = createVoice(QString::fromUtf8(voices[i]->name), locale,
-                                             QVoice::Unknown, QVoice::Other, data);
-            m_voices.insert(locale, voice);
-            ++i;
+    VoiceCache *cache = voiceCache();
+    QMutexLocker locker(&cache->mutex);
+    if (cache->status != VoiceCache::Loaded) {
+        if (!cache->waiting.contains(this))
+            cache->waiting.append(this);
+        if (cache->status == VoiceCache::Empty) {
+            cache->status = VoiceCache::Loading;
+            QThreadPool::globalInstance()->start(&QTextToSpeechEngineSpeechd::loadVoices);
         }
-        // free voices.
-#ifdef HAVE_SPD_090
-        free_spd_voices(voices);
-#endif
-        ++module;
+        return false;
+    }
+
+    m_voices.clear();
+    m_espeakVoices = cache->espeakVoices;
+    m_synthesizerPrograms = cache->synthesizerPrograms;
+    for (const QByteArray &module : std::as_const(cache->modules)) {
+        for (const QVoice &voice : cache->voices.value(module))
+            m_voices.insert(voice.locale(), voice);
     }
+    m_voicesLoaded = true;
+    return true;
+}
 
+// Runs in a pool thread. Uses a connection of its own, as switching between
+// output modules would interfere with any engine that is speaking.
+void QTextToSpeechEngineSpeechd::loadVoices()
+{
+    QByteArrayList modules;
+    QHash<QByteArray, QList<QVoice>> voices;
+    QHash<QString, QString> espeakVoices;
+    QHash<QByteArray, QString> synthesizerPrograms;
+    SPDConnection *connection = spd_open("QTextToSpeech", "voices", nullptr, SPD_MODE_SINGLE);
+    const bool success = connection != nullptr;
+    if (success) {
+        char **moduleNames = spd_list_modules(connection);
+        char **module = moduleNames;
+        while (module != nullptr && module[0] != nullptr) {
+            spd_set_output_module(connection, module[0]);
+
+            const QByteArray moduleName(module[0]);
+            QList<QVoice> &moduleVoices = voices[moduleName];
+            SPDVoice **spdVoices = spd_list_synthesis_voices(connection);
+            int i = 0;
+            while (spdVoices != nullptr && spdVoices[i] != nullptr) {
+                // speechd declares enums and APIs for gender and age, but the SPDVoice struct
+                // carries no relevant information.
+                const QString name = QString::fromUtf8(spdVoices[i]->name);
+                moduleVoices << createVoice(name, localeForVoice(spdVoices[i]), QVoice::Unknown,
+                                            QVoice::Other, QVariant::fromValue(moduleName));
+                if (moduleName.startsWith("espeak")) {
+                    espeakVoices.insert(espeakVoiceKey(moduleName, name),
+                                        espeakVoiceForVoice(spdVoices[i]));
+                }
+                ++i;
+            }
 #ifdef HAVE_SPD_090
-    // Also free modules.
-    free_spd_modules(modules);
+            free_spd_voices(spdVoices);
 #endif
-    // Set the output module back to what it was.
-    spd_set_output_module(speechDispatcher, original_module);
+            const QString program = findSynthesizerProgram(moduleName);
+            if (!program.isEmpty())
+                synthesizerPrograms.insert(moduleName, program);
+            modules << moduleName;
+            ++module;
+        }
 #ifdef HAVE_SPD_090
-    free(original_module);
+        free_spd_modules(moduleNames);
 #endif
+        spd_close(connection);
+    }
+
+    VoiceCache *cache = voiceCache();
+    QMutexLocker locker(&cache->mutex);
+    // try again with the next engine if we couldn't connect
+    cache->status = success ? VoiceCache::Loaded : VoiceCache::Empty;
+    cache->modules = modules;
+    cache->voices = voices;
+    cache->espeakVoices = espeakVoices;
+    cache->synthesizerPrograms = synthesizerPrograms;
+    for (QTextToSpeechEngineSpeechd *engine : std::as_const(cache->waiting)) {
+        QMetaObject::invokeMethod(engine, [engine, success] {
+            engine->voicesLoaded(success);
+        }, Qt::QueuedConnection);
+    }
+    cache->waiting.clear();
+}
+
+void QTextToSpeechEngineSpeechd::voicesLoaded(bool success)
+{
+    if (!success) {
+        setError(QTextToSpeech::ErrorReason::Initialization,
+                 QCoreApplication::translate("QTextToSpeech",
+                                             "Failed to list the voices of speech-dispatcher."));
+        return;
+    }
+
+    updateVoices();
+    // select the voice first, so that voiceChanged() follows the new voices,
+    // as when the voices are known during initialization
+    const bool hasVoice = m_currentVoice != QVoice() || selectDefaultVoice();
+    emit voicesChanged();
+    if (!hasVoice) {
+        setError(QTextToSpeech::ErrorReason::Configuration,
+                 QCoreApplication::translate("QTextToSpeech",
+                                             "Failed to initialize default locale and voice."));
+    }
+}
+
+// Sets a voice for the current locale (which is initially the system locale), and
+// falls back to a locale that has the same language if that fails. That might then
+// still fail, in which case there won't be a valid voice.
+bool QTextToSpeechEngineSpeechd::selectDefaultVoice()
+{
+    const QLocale locale = m_voices.contains(m_locale) ? m_locale : QLocale(m_locale.language());
+    return m_voices.contains(locale) && setLocale(locale);
 }
 
 QList<QLocale> QTextToSpeechEngineSpeechd::availableLocales() const
@@ -379,18 +764,44 @@ QList<QLocale> QTextToSpeechEngineSpeechd::availableLocales() const
 
 QList<QVoice> QTextToSpeechEngineSpeechd::availableVoices() const
 {
-    QList<QVoice> resultList = m_voices.values(m_currentVoice.locale());
+    QList<QVoice> resultList = m_voices.values(m_locale);
     std::reverse(resultList.begin(), resultList.end());
     return resultList;
 }
 
-// We have no way of knowing our own client_id since speech-dispatcher seems to be incomplete
-// (history functions are just stubs)
+QList<QVoice> QTextToSpeechEngineSpeechd::allVoices(const QLocale *locale) const
+{
+    const QList<QLocale> locales = locale ? QList<QLocale>{*locale} : m_voices.uniqueKeys();
+    QList<QVoice> resultList;
+    for (const QLocale &voiceLocale : locales) {
+        QList<QVoice> voices = m_voices.values(voiceLocale);
+        std::reverse(voices.begin(), voices.end());
+        resultList << voices;
+    }
+    return resultList;
+}
+
+// Called in the thread of speech-dispatcher's connection; the engine handles
+// the notification in its own thread.
 void speech_finished_callback(size_t msg_id, size_t client_id, SPDNotificationType state)
 {
     qCDebug(lcSpeechTtsSpeechd) << "Message from speech dispatcher" << msg_id << client_id;
-    for (QTextToSpeechEngineSpeechd *backend : std::as_const(*backends))
-        backend->spdStateChanged(state);
+    MessageRegistry *registry = messageRegistry();
+    QMutexLocker locker(&registry->mutex);
+    const auto owner = registry->owners.find(msg_id);
+    if (owner == registry->owners.end()) {
+        registry->addUnclaimed(msg_id, state);
+        return;
+    }
+
+    QTextToSpeechEngineSpeechd *engine = owner.value();
+    if (isFinal(state))
+        registry->owners.erase(owner);
+    // holding the lock keeps the engine alive until the call is posted; the
+    // call is discarded if the engine is destroyed before it gets delivered
+    QMetaObject::invokeMethod(engine, [engine, msg_id, state] {
+        engine->spdStateChanged(msg_id, state);
+    }, Qt::QueuedConnection);
 }
 
 QT_END_NAMESPACE
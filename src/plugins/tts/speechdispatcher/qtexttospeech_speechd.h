@@ -12,10 +12,15 @@
 #include <QtCore/qlocale.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qstring.h>
+#include <QtMultimedia/qaudioformat.h>
 #include <libspeechd.h>
 
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
+class QProcess;
+
 class QTextToSpeechEngineSpeechd : public QTextToSpeechEngine
 {
     Q_OBJECT
@@ -25,8 +30,10 @@ public:
     ~QTextToSpeechEngineSpeechd();
 
     // Plug-in API:
+    QTextToSpeech::Capabilities capabilities() const override;
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -46,21 +53,48 @@ public:
     QTextToSpeech::ErrorReason errorReason() const override;
     QString errorString() const override;
 
-    void spdStateChanged(SPDNotificationType state);
+    void spdStateChanged(size_t msgId, SPDNotificationType state);
 
 private:
-    QLocale localeForVoice(SPDVoice *voice) const;
+    static QLocale localeForVoice(SPDVoice *voice);
+    static QString espeakVoiceForVoice(SPDVoice *voice);
+    static QString espeakVoiceKey(const QByteArray &moduleName, const QString &voiceName);
     bool connectToSpeechDispatcher();
-    void updateVoices();
+    void claimMessage(size_t msgId);
+    bool updateVoices();
+    static void loadVoices();
+    void voicesLoaded(bool success);
+    bool selectDefaultVoice();
     void setError(QTextToSpeech::ErrorReason reason, const QString &errorString);
+    void changeState(QTextToSpeech::State state);
+
+    QString synthesizerProgram(const QVoice &voice) const;
+    static QString findSynthesizerProgram(const QByteArray &moduleName);
+    void synthesizerOutput();
+    void synthesizerFinished(bool success);
+    void stopSynthesizer();
 
     QTextToSpeech::State m_state = QTextToSpeech::Error;
     QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::Initialization;
     QString m_errorString;
     SPDConnection *speechDispatcher;
+    // the message we spoke last
+    size_t m_currentMessage = 0;
     QVoice m_currentVoice;
+    QLocale m_locale;
     // Voices mapped by their locale name.
     QMultiHash<QLocale, QVoice> m_voices;
+    // the voices of the espeak modules, as the synthesizer program knows them
+    QHash<QString, QString> m_espeakVoices;
+    // the synthesizer programs by module name, looked up when loading the voices
+    QHash<QByteArray, QString> m_synthesizerPrograms;
+    bool m_voicesLoaded = false;
+
+    // speechd can't return audio, so synthesize() runs the synthesizer of the
+    // voice's output module directly and reads WAV data from its stdout
+    std::unique_ptr<QProcess> m_synthesizer;
+    QByteArray m_synthesizerBuffer;
+    QAudioFormat m_synthesizerFormat;
 };
 
 QT_END_NAMESPACE
@@ -3,6 +3,7 @@
 
 #include "qtexttospeech_winrt.h"
 #include "qtexttospeech_winrt_audiosource.h"
+#include <qtqtexttospeechwinrtplugin_tracepoints_p.h>
 
 #include <QtMultimedia/QAudioSink>
 #include <QtMultimedia/QMediaDevices>
@@ -11,8 +12,12 @@
 #include <QtCore/QBasicTimer>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QWinEventNotifier>
 #include <QtCore/private/qfunctions_winrt_p.h>
 
+#include <limits>
+
 #include <winrt/base.h>
 #include <QtCore/private/qfactorycacheregistration_p.h>
 #include <windows.foundation.h>
@@ -54,15 +59,39 @@ public:
     ComPtr<AudioSource> audioSource;
     QList<AudioSource::Boundary> boundaries;
     QList<AudioSource::Boundary>::const_iterator currentBoundary;
+    // size and number of the buffers that the source reads into
+    UINT32 bufferSize = 16384;
+    int bufferCount = 3;
+    // what counts as a pause between words when pausing without boundary data
+    qint16 silenceThreshold = 10;
+    qint64 silenceDuration = 20000;
     QBasicTimer boundaryTimer;
     QElapsedTimer elapsedTimer;
     qint64 playedTime = 0;
     // the sink is connected to the source
     std::unique_ptr<QAudioSink> audioSink;
+    // synthesize only, without audio device
+    bool headless = false;
 
     template <typename Fn> void forEachVoice(Fn &&lambda) const;
-    void updateVoices();
+    bool updateVoices();
+    void watchVoices();
+    const QVoice *findVoice(const ComPtr<IVoiceInformation> &info) const;
     QVoice createVoiceForInformation(const ComPtr<IVoiceInformation> &info) const;
+
+    // all installed voices, and the positions in that list by voice id
+    struct Voice
+    {
+        QVoice voice;
+        ComPtr<IVoiceInformation> info;
+    };
+    QList<Voice> voices;
+    QHash<QString, qsizetype> voiceIndexes;
+    QList<QLocale> locales;
+    // signals when voices get installed or removed
+    HKEY voicesKey = nullptr;
+    HANDLE voicesEvent = nullptr;
+    std::unique_ptr<QWinEventNotifier> voicesNotifier;
     void initializeAudioSink(const QAudioFormat &format);
     void sinkStateChanged(QAudio::State sinkState);
 
@@ -79,6 +108,12 @@ QTextToSpeechEngineWinRTPrivate::QTextToSpeechEngineWinRTPrivate(QTextToSpeechEn
 
 QTextToSpeechEngineWinRTPrivate::~QTextToSpeechEngineWinRTPrivate()
 {
+    voicesNotifier.reset();
+    if (voicesKey)
+        RegCloseKey(voicesKey);
+    if (voicesEvent)
+        CloseHandle(voicesEvent);
+
     // Close and free the source explicitly and in the right order so that the buffer's
     // aboutToClose signal gets emitted before this private object is destroyed.
     if (audioSource) {
@@ -107,17 +142,31 @@ QTextToSpeechEngineWinRT::QTextToSpeechEngineWinRT(const QVariantMap &params, QO
 {
     Q_D(QTextToSpeechEngineWinRT);
 
-    if (const auto it = params.find("audioDevice"_L1); it != params.end())
-        d->audioDevice = (*it).value<QAudioDevice>();
-    else
-        d->audioDevice = QMediaDevices::defaultAudioOutput();
-
-    if (d->audioDevice.isNull())
+    // Without audio output, there's no need to look for devices
+    d->headless = params.value("headless"_L1).toBool();
+    if (!d->headless) {
+        if (const auto it = params.find("audioDevice"_L1); it != params.end())
+            d->audioDevice = (*it).value<QAudioDevice>();
+        else
+            d->audioDevice = QMediaDevices::defaultAudioOutput();
+    }
+    if (const int bufferSize = params.value("bufferSize"_L1).toInt(); bufferSize > 0)
+        d->bufferSize = bufferSize;
+    if (const int bufferCount = params.value("bufferCount"_L1).toInt(); bufferCount > 0)
+        d->bufferCount = bufferCount;
+    if (const auto it = params.find("silenceThreshold"_L1); it != params.end())
+        d->silenceThreshold = qBound(1, (*it).toInt(), int(std::numeric_limits<qint16>::max()));
+    if (const auto it = params.find("silenceDuration"_L1); it != params.end())
+        d->silenceDuration = qMax(1, (*it).toInt()) * 1000;
+
+    if (!d->headless && d->audioDevice.isNull())
         d->setError(QTextToSpeech::ErrorReason::Playback,
                     QCoreApplication::translate("QTextToSpeech", "No audio device available."));
 
+    // worker threads might already use the multithreaded apartment, which works as well
     HRESULT hr = CoInitialize(nullptr);
-    Q_ASSERT_SUCCEEDED(hr);
+    m_comInitialized = SUCCEEDED(hr);
+    Q_ASSERT(m_comInitialized || hr == RPC_E_CHANGED_MODE);
 
     hr = RoActivateInstance(HString::MakeReference(RuntimeClass_Windows_Media_SpeechSynthesis_SpeechSynthesizer).Get(),
                             &d->synth);
@@ -125,7 +174,10 @@ QTextToSpeechEngineWinRT::QTextToSpeechEngineWinRT(const QVariantMap &params, QO
         d->setError(QTextToSpeech::ErrorReason::Initialization,
                     QCoreApplication::translate("QTextToSpeech", "Could not initialize text-to-speech engine."));
         return;
-    } else if (voice() == QVoice()) {
+    }
+    d->updateVoices();
+    d->watchVoices();
+    if (voice() == QVoice()) {
         d->setError(QTextToSpeech::ErrorReason::Configuration,
                     QCoreApplication::translate("QTextToSpeech", "Could not set default voice."));
     } else {
@@ -158,7 +210,8 @@ QTextToSpeechEngineWinRT::QTextToSpeechEngineWinRT(const QVariantMap &params, QO
 QTextToSpeechEngineWinRT::~QTextToSpeechEngineWinRT()
 {
     d_ptr.reset();
-    CoUninitialize();
+    if (m_comInitialized)
+        CoUninitialize();
 }
 
 /* Voice and language/locale management */
@@ -196,11 +249,7 @@ QVoice QTextToSpeechEngineWinRTPrivate::createVoiceForInformation(const ComPtr<I
     IVoiceInformation for each. If the lambda returns true, the iteration
     ends.
 
-    This helper is used in all voice and locale related engine implementations.
-    While not particular fast, none of these functions are performance critical,
-    and always operating on the official list of all voices avoids that we need
-    to maintain our own mappings, or keep all voice information instances in
-    memory.
+    Each voice takes several COM calls, so this is only used by updateVoices().
 */
 template <typename Fn>
 void QTextToSpeechEngineWinRTPrivate::forEachVoice(Fn &&lambda) const
@@ -230,36 +279,100 @@ void QTextToSpeechEngineWinRTPrivate::forEachVoice(Fn &&lambda) const
     }
 }
 
+/*
+    Reads the installed voices into the catalog that all voice and locale
+    related functions use. Returns whether the voices changed.
+*/
+bool QTextToSpeechEngineWinRTPrivate::updateVoices()
+{
+    QList<Voice> newVoices;
+    forEachVoice([this, &newVoices](const ComPtr<IVoiceInformation> &voiceInfo) {
+        newVoices.append({createVoiceForInformation(voiceInfo), voiceInfo});
+        return false;
+    });
+    if (std::equal(newVoices.cbegin(), newVoices.cend(), voices.cbegin(), voices.cend(),
+                   [](const Voice &left, const Voice &right) {
+                       return left.voice == right.voice;
+                   })) {
+        return false;
+    }
+
+    voices = std::move(newVoices);
+    voiceIndexes.clear();
+    locales.clear();
+    for (qsizetype i = 0; i < voices.size(); ++i) {
+        const QVoice &voice = voices.at(i).voice;
+        voiceIndexes.insert(QTextToSpeechEngine::voiceData(voice).toString(), i);
+        if (!locales.contains(voice.locale()))
+            locales.append(voice.locale());
+    }
+    return true;
+}
+
+/*
+    The speech synthesizer doesn't report changes to the installed voices, so
+    watch the registry key in which the voices are installed.
+*/
+void QTextToSpeechEngineWinRTPrivate::watchVoices()
+{
+    Q_Q(QTextToSpeechEngineWinRT);
+    constexpr DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET;
+    if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, L"SOFTWARE\\Microsoft\\Speech_OneCore\\Voices\\Tokens",
+                      0, KEY_NOTIFY, &voicesKey) != ERROR_SUCCESS) {
+        voicesKey = nullptr;
+        return;
+    }
+    voicesEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!voicesEvent
+        || RegNotifyChangeKeyValue(voicesKey, TRUE, filter, voicesEvent, TRUE) != ERROR_SUCCESS) {
+        return;
+    }
+
+    voicesNotifier = std::make_unique<QWinEventNotifier>(voicesEvent);
+    QObject::connect(voicesNotifier.get(), &QWinEventNotifier::activated, q, [this, q]{
+        // the notification only fires once
+        RegNotifyChangeKeyValue(voicesKey, TRUE, filter, voicesEvent, TRUE);
+        if (updateVoices())
+            emit q->voicesChanged();
+    });
+}
+
+// Returns the voice in the catalog for \a info, or nullptr if there is none
+const QVoice *QTextToSpeechEngineWinRTPrivate::findVoice(const ComPtr<IVoiceInformation> &info) const
+{
+    if (!info)
+        return nullptr;
+    HString voiceId;
+    if (!SUCCEEDED(info->get_Id(voiceId.GetAddressOf())))
+        return nullptr;
+    const auto it = voiceIndexes.constFind(QString::fromWCharArray(voiceId.GetRawBuffer(0)));
+    return it == voiceIndexes.cend() ? nullptr : &voices.at(*it).voice;
+}
+
 QList<QLocale> QTextToSpeechEngineWinRT::availableLocales() const
 {
     Q_D(const QTextToSpeechEngineWinRT);
     if (!d->synth)
         return QList<QLocale>();
-    QSet<QLocale> uniqueLocales;
-    d->forEachVoice([&uniqueLocales](const ComPtr<IVoiceInformation> &voiceInfo) {
-        HString voiceLanguage;
-        HRESULT hr = voiceInfo->get_Language(voiceLanguage.GetAddressOf());
-        Q_ASSERT_SUCCEEDED(hr);
-
-        uniqueLocales.insert(QLocale(QString::fromWCharArray(voiceLanguage.GetRawBuffer(0))));
-        return false;
-    });
-    return uniqueLocales.values();
+    return d->locales;
 }
 
 QList<QVoice> QTextToSpeechEngineWinRT::availableVoices() const
+{
+    const QLocale currentLocale = locale();
+    return allVoices(&currentLocale);
+}
+
+QList<QVoice> QTextToSpeechEngineWinRT::allVoices(const QLocale *locale) const
 {
     Q_D(const QTextToSpeechEngineWinRT);
     if (!d->synth)
         return QList<QVoice>();
     QList<QVoice> voices;
-    const QLocale currentLocale = locale();
-    d->forEachVoice([&](const ComPtr<IVoiceInformation> &voiceInfo) {
-        const QVoice voice = d->createVoiceForInformation(voiceInfo);
-        if (currentLocale == voice.locale())
-            voices.append(voice);
-        return false;
-    });
+    for (const auto &entry : d->voices) {
+        if (!locale || *locale == entry.voice.locale())
+            voices.append(entry.voice);
+    }
     return voices;
 }
 
@@ -271,6 +384,8 @@ QLocale QTextToSpeechEngineWinRT::locale() const
 
     ComPtr<IVoiceInformation> voiceInfo;
     HRESULT hr = d->synth->get_Voice(&voiceInfo);
+    if (const QVoice *voice = d->findVoice(voiceInfo))
+        return voice->locale();
 
     HString language;
     hr = voiceInfo->get_Language(language.GetAddressOf());
@@ -285,17 +400,12 @@ bool QTextToSpeechEngineWinRT::setLocale(const QLocale &locale)
         return false;
 
     ComPtr<IVoiceInformation> foundVoice;
-    d->forEachVoice([&locale, &foundVoice](const ComPtr<IVoiceInformation> &voiceInfo) {
-        HString voiceLanguage;
-        HRESULT hr = voiceInfo->get_Language(voiceLanguage.GetAddressOf());
-        Q_ASSERT_SUCCEEDED(hr);
-
-        if (locale == QLocale(QString::fromWCharArray(voiceLanguage.GetRawBuffer(0)))) {
-            foundVoice = voiceInfo;
-            return true;
+    for (const auto &entry : std::as_const(d->voices)) {
+        if (entry.voice.locale() == locale) {
+            foundVoice = entry.info;
+            break;
         }
-        return false;
-    });
+    }
 
     if (!foundVoice) {
         d->setError(QTextToSpeech::ErrorReason::Configuration,
@@ -315,8 +425,10 @@ QVoice QTextToSpeechEngineWinRT::voice() const
 
     ComPtr<IVoiceInformation> voiceInfo;
     d->synth->get_Voice(&voiceInfo);
+    if (const QVoice *voice = d->findVoice(voiceInfo))
+        return *voice;
 
-    return d->createVoiceForInformation(voiceInfo);
+    return voiceInfo ? d->createVoiceForInformation(voiceInfo) : QVoice();
 }
 
 bool QTextToSpeechEngineWinRT::setVoice(const QVoice &voice)
@@ -330,16 +442,15 @@ bool QTextToSpeechEngineWinRT::setVoice(const QVoice &voice)
         d->setError(QTextToSpeech::ErrorReason::Configuration,
                     QCoreApplication::translate("QTextToSpeech", "Invalid voice."));
 
+    auto it = d->voiceIndexes.constFind(data);
+    // the voice might have been installed since the voices were read
+    if (it == d->voiceIndexes.cend() && d->updateVoices()) {
+        emit voicesChanged();
+        it = d->voiceIndexes.constFind(data);
+    }
     ComPtr<IVoiceInformation> foundVoice;
-    d->forEachVoice([&data, &foundVoice](const ComPtr<IVoiceInformation> &voiceInfo) {
-        HString voiceId;
-        HRESULT hr = voiceInfo->get_Id(voiceId.GetAddressOf());
-        if (data == QString::fromWCharArray(voiceId.GetRawBuffer(0))) {
-            foundVoice = voiceInfo;
-            return true;
-        }
-        return false;
-    });
+    if (it != d->voiceIndexes.cend())
+        foundVoice = d->voices.at(*it).info;
 
     if (!foundVoice) {
         d->setError(QTextToSpeech::ErrorReason::Configuration,
@@ -422,6 +533,9 @@ void QTextToSpeechEngineWinRTPrivate::sinkStateChanged(QAudio::State sinkState)
                 playedTime = 0;
                 elapsedTimer.invalidate();
             } else {
+                // ran out of data while the synthesizer is still busy
+                if (audioSource->m_pause == AudioSource::NoPause)
+                    emit q->audioUnderrun();
                 boundaryTimer.stop();
                 if (elapsedTimer.isValid())
                     playedTime += elapsedTimer.nsecsElapsed() / 1000;
@@ -447,15 +561,30 @@ void QTextToSpeechEngineWinRTPrivate::sinkStateChanged(QAudio::State sinkState)
             state = QTextToSpeech::Paused;
         break;
     }
+    Q_TRACE(QTextToSpeechEngineWinRT_sinkStateChanged, sinkState, state);
     if (state != oldState)
         emit q->stateChanged(state);
 }
 
+QTextToSpeech::Capabilities QTextToSpeechEngineWinRT::capabilities() const
+{
+    Q_D(const QTextToSpeechEngineWinRT);
+    if (d->headless)
+        return QTextToSpeech::Capability::Synthesize;
+    // None, so that QTextToSpeech uses the values from the plugin's meta data
+    return QTextToSpeechEngine::capabilities();
+}
+
 void QTextToSpeechEngineWinRT::say(const QString &text)
 {
     Q_D(QTextToSpeechEngineWinRT);
     if (!d->synth)
         return;
+    if (d->headless) {
+        d->setError(QTextToSpeech::ErrorReason::Playback,
+                    QCoreApplication::translate("QTextToSpeech", "Speaking is not supported in headless mode."));
+        return;
+    }
 
     // stop ongoing speech
     stop(QTextToSpeech::BoundaryHint::Default);
@@ -474,7 +603,8 @@ void QTextToSpeechEngineWinRT::say(const QString &text)
 
     // The source will wait for the the data resulting out of the synthOperation, and emits
     // streamReady when data is available. This starts a QAudioSink, which pulls the data.
-    d->audioSource.Attach(new AudioSource(synthOperation));
+    d->audioSource.Attach(new AudioSource(synthOperation, d->bufferSize, d->bufferCount));
+    d->audioSource->setSilenceDetection(d->silenceThreshold, d->silenceDuration);
 
     connect(d->audioSource.Get(), &AudioSource::streamReady, this, [d](const QAudioFormat &format){
         d->initializeAudioSink(format);
@@ -508,18 +638,28 @@ void QTextToSpeechEngineWinRT::synthesize(const QString &text)
 
     // The source will wait for the the data resulting out of the synthOperation, and emits
     // streamReady when data is available. This starts a QAudioSink, which pulls the data.
-    d->audioSource.Attach(new AudioSource(synthOperation));
+    d->audioSource.Attach(new AudioSource(synthOperation, d->bufferSize, d->bufferCount));
 
     connect(d->audioSource.Get(), &AudioSource::streamReady, this, [d, this](const QAudioFormat &format){
         if (d->state != QTextToSpeech::Synthesizing) {
             d->state = QTextToSpeech::Synthesizing;
             emit stateChanged(d->state);
         }
+        // the boundaries are known before any audio is read
+        const QList<AudioSource::Boundary> boundaries = d->audioSource->boundaryData();
+        for (const AudioSource::Boundary &boundary : boundaries) {
+            if (boundary.type == AudioSource::Boundary::Word) {
+                emit synthesizedWord(boundary.text, boundary.beginIndex,
+                                     boundary.endIndex - boundary.beginIndex + 1,
+                                     boundary.startTime);
+            }
+        }
     });
     connect(d->audioSource.Get(), &AudioSource::readyRead, this, [d, this](){
         Q_ASSERT(d->state == QTextToSpeech::Synthesizing);
-        const QByteArray data = d->audioSource->read(d->audioSource->bytesAvailable());
-        emit synthesized(d->audioSource->format(), data);
+        // earlier signals might have taken everything already
+        if (const QByteArray data = d->audioSource->takeData(); !data.isEmpty())
+            emit synthesized(d->audioSource->format(), data);
         if (d->audioSource->atEnd())
             d->audioSource->close();
     });
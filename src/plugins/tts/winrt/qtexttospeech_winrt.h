@@ -25,8 +25,10 @@ public:
     QTextToSpeechEngineWinRT(const QVariantMap &parameters, QObject *parent);
     ~QTextToSpeechEngineWinRT();
 
+    QTextToSpeech::Capabilities capabilities() const override;
     QList<QLocale> availableLocales() const override;
     QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
     void say(const QString &text) override;
     void synthesize(const QString &text) override;
     void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
@@ -51,6 +53,8 @@ protected:
 
 private:
     QScopedPointer<QTextToSpeechEngineWinRTPrivate> d_ptr;
+    // whether we have to uninitialize COM again
+    bool m_comInitialized = false;
     Q_DECLARE_PRIVATE(QTextToSpeechEngineWinRT)
 };
 
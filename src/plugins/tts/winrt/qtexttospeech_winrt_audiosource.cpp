@@ -2,9 +2,9 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
 
 #include "qtexttospeech_winrt_audiosource.h"
+#include <qtqtexttospeechwinrtplugin_tracepoints_p.h>
 
 #include <QtCore/QDebug>
-#include <QtCore/QTimer>
 
 #include <QtCore/private/qfunctions_winrt_p.h>
 #include <QtCore/private/qsystemerror_p.h>
@@ -36,22 +36,37 @@ QT_BEGIN_NAMESPACE
     operations of the synthesized speech stream being avialable, and reading data from
     the stream via a COM buffer.
 
-    Whenever the QIODevice has read all the data from the COM buffer, more data is
-    requested. When the data is available (the BytesReadyHandler's handler's Invoke
-    implementation is called), readyRead is emitted.
+    The source reads the stream into a small number of COM buffers. Whenever a
+    buffer is free, the next read is started, so that data is available before
+    the sink runs out of it. When the data is available (the BytesReadyHandler's
+    handler's Invoke implementation is called), readyRead is emitted.
 
     The AudioSource directly controls a QAudioSink. As soon as the data stream is
     available, the source calls QAudioSink::start. Pause/resume are delegated to the
     sink; closing the source stops the sink.
 */
-AudioSource::AudioSource(ComPtr<IAsyncOperation<SpeechSynthesisStream*>> synthOperation)
+AudioSource::AudioSource(ComPtr<IAsyncOperation<SpeechSynthesisStream*>> synthOperation,
+                         UINT32 bufferSize, int bufferCount)
     : synthOperation(synthOperation)
+    , m_bufferSize(bufferSize)
+    , m_bufferCount(qMax(bufferCount, 2))
 {
     synthOperation->put_Completed(this);
 
     audioFormat.setSampleFormat(QAudioFormat::Int16);
     audioFormat.setSampleRate(16000);
     audioFormat.setChannelConfig(QAudioFormat::ChannelConfigMono);
+    setSilenceDetection(m_silenceDetector.threshold(), 20000);
+}
+
+/*
+    Pausing without a byte offset waits for \a duration microseconds of
+    samples with absolute values below \a threshold.
+*/
+void AudioSource::setSilenceDetection(qint16 threshold, qint64 duration)
+{
+    m_silenceDetector.setThreshold(threshold);
+    m_silenceDetector.setMinimumLength(audioFormat.framesForDuration(duration));
 }
 
 /*
@@ -70,6 +85,7 @@ AudioSource::~AudioSource()
 */
 void AudioSource::close()
 {
+    QMutexLocker locker(&m_mutex);
     ComPtr<IAsyncInfo> asyncInfo;
     AsyncStatus status = AsyncStatus::Completed;
     if (synthOperation) {
@@ -86,6 +102,7 @@ void AudioSource::close()
                 asyncInfo->Cancel();
         }
     }
+    locker.unlock();
     QIODevice::close();
 }
 
@@ -94,42 +111,50 @@ qint64 AudioSource::bytesAvailable() const
     return bytesInBuffer() + QIODevice::bytesAvailable();
 }
 
+const char *AudioSource::Chunk::data() const
+{
+    byte *pbyte = nullptr;
+    byteAccess->Buffer(&pbyte);
+    return reinterpret_cast<const char *>(pbyte) + offset;
+}
+
+/*
+    Check and skip the RIFF header if present at the beginning of the
+    stream, to prevent an audible click at the start of playback.
+*/
+void AudioSource::skipRiffHeader(Chunk &chunk)
+{
+    if (m_riffHeaderChecked)
+        return;
+    m_riffHeaderChecked = true;
+    static const int WaveHeaderLength = 44;
+    if (chunk.bytesLeft() >= WaveHeaderLength && !qstrncmp(chunk.data(), "RIFF", 4))
+        chunk.offset += WaveHeaderLength;
+}
+
 /*
-    Fills data with as many bytes from the COM buffer as possible. If this
-    empties the COM buffer, calls fetchMore to start a new asynchronous
-    read operation.
+    Fills data with as many bytes from the oldest COM buffer as possible. If
+    this empties the COM buffer, calls fetchMore to start reading into it again.
 */
 qint64 AudioSource::readData(char *data, qint64 maxlen)
 {
     // this may happen as per the documentation
     if (!maxlen)
         return 0;
+    const qint64 requested = maxlen;
 
-    Q_ASSERT(bufferByteAccess);
+    QMutexLocker locker(&m_mutex);
+    if (m_filled.isEmpty()) {
+        locker.unlock();
+        Q_TRACE(AudioSource_readData, requested, 0);
+        return atEnd() ? -1 : 0;
+    }
 
-    qint64 available = bytesInBuffer();
+    Chunk &chunk = m_filled.head();
+    skipRiffHeader(chunk);
+    const qint64 available = chunk.bytesLeft();
     maxlen = qMin(available, maxlen);
-
-    if (!maxlen && atEnd())
-        return -1;
-
-    byte *pbyte = nullptr;
-    bufferByteAccess->Buffer(&pbyte);
-    pbyte += m_bufferOffset;
-
-    // Check and skip the RIFF header if present to prevent an audible
-    // click at the start of playback.
-    if (!m_riffHeaderChecked) {
-        m_riffHeaderChecked = true;
-        static const int WaveHeaderLength = 44;
-        const char *descriptor = reinterpret_cast<const char*>(pbyte);
-        if (maxlen >= WaveHeaderLength && !qstrncmp(descriptor, "RIFF", 4)) {
-            pbyte += WaveHeaderLength;
-            m_bufferOffset += WaveHeaderLength;
-            maxlen -= WaveHeaderLength;
-            available -= WaveHeaderLength;
-        }
-    }
+    const char *pbyte = chunk.data();
 
     switch (m_pause) {
     case NoPause:
@@ -142,7 +167,7 @@ qint64 AudioSource::readData(char *data, qint64 maxlen)
                 // we missed the window, pause immediately
                 maxlen = 0;
             } else if (m_pauseRequestedAt <= m_bytesRead + maxlen) {
-                maxlen = qMax(quint64(0), m_pauseRequestedAt - m_bytesRead) + 44;
+                maxlen = qMin(qint64(m_pauseRequestedAt - m_bytesRead) + 44, maxlen);
             } else {
                 // wait for the next chunk
                 break;
@@ -152,38 +177,23 @@ qint64 AudioSource::readData(char *data, qint64 maxlen)
             break;
         }
         // If no byte to pause at is specified, look for silence in the current
-        // chunk. We are dealing with artificially created sound, so we don't have
-        // to find a large enough window with overall low energy; we can just
-        // look for a series (e.g. 1/50th of a second) of samples with low
-        // absolute values.
-        const int silenceDuration = audioFormat.sampleRate() / 50;
-        const short *sample = reinterpret_cast<short*>(pbyte);
-        const qsizetype sampleCount = maxlen / sizeof(short);
-        if (sampleCount < silenceDuration)
+        // chunk.
+        const qint16 *samples = reinterpret_cast<const qint16 *>(pbyte);
+        const qsizetype sampleCount = maxlen / sizeof(qint16);
+        if (sampleCount < m_silenceDetector.minimumLength())
             break;
-        qint64 silenceCount = 0;
-        for (qint64 index = 0; index < sampleCount; ++index) {
-            if (qAbs(sample[index]) < 10) {
-                ++silenceCount;
-            } else if (silenceCount > silenceDuration) {
-                // long enough silence found, only provide the data until we are in the
-                // silence. If the silence is at the beginning of our buffer, start from
-                // there, otherwise play a bit of silence now.
-                if (index != silenceCount)
-                    silenceCount /= 2;
-
-                maxlen = (index - silenceCount) * 2;
-                // The next attempt to pull data will return nothing, and the audio sink
-                // will move to idle state.
-                m_pause = Paused;
-                break;
-            } else {
-                silenceCount = 0;
-            }
+        if (const auto silence = m_silenceDetector.find(samples, sampleCount); silence.isValid()) {
+            // long enough silence found, only provide the data until we are in the
+            // silence. If the silence is at the beginning of our buffer, start from
+            // there, otherwise play a bit of silence now.
+            qsizetype end = silence.start;
+            if (silence.start != 0)
+                end += silence.length - silence.length / 2;
+            maxlen = end * sizeof(qint16);
         }
-        // no silence found - stop after this chunk
-        if (m_pause != Paused)
-            m_pause = Paused;
+        // The next attempt to pull data will return nothing, and the audio sink
+        // will move to idle state. If no silence was found, stop after this chunk.
+        m_pause = Paused;
         break;
     }
     case Paused:
@@ -192,27 +202,63 @@ qint64 AudioSource::readData(char *data, qint64 maxlen)
         break;
     }
 
+    Q_TRACE(AudioSource_readData, requested, maxlen);
     if (!maxlen)
         return 0;
 
     memcpy(data, pbyte, maxlen);
-
-    // We emptied the buffer, so schedule fetching more
-    if (available <= maxlen)
-        QTimer::singleShot(0, this, &AudioSource::fetchMore);
-    else
-        m_bufferOffset += maxlen;
-
+    chunk.offset += maxlen;
     m_bytesRead += maxlen;
+
+    // We emptied the buffer, so read into it again
+    if (!chunk.bytesLeft()) {
+        m_free.append(m_filled.dequeue().buffer);
+        locker.unlock();
+        fetchMore();
+    }
     return maxlen;
 }
 
+/*
+    Returns all data that has been read from the stream so far, copied
+    straight out of the COM buffers, and continues reading.
+*/
+QByteArray AudioSource::takeData()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_filled.isEmpty())
+        return QByteArray();
+
+    skipRiffHeader(m_filled.head());
+    qsizetype size = 0;
+    for (const Chunk &chunk : std::as_const(m_filled))
+        size += chunk.bytesLeft();
+
+    QByteArray data(size, Qt::Uninitialized);
+    char *out = data.data();
+    while (!m_filled.isEmpty()) {
+        const Chunk chunk = m_filled.dequeue();
+        memcpy(out, chunk.data(), chunk.bytesLeft());
+        out += chunk.bytesLeft();
+        m_free.append(chunk.buffer);
+    }
+    m_bytesRead += size;
+
+    locker.unlock();
+    fetchMore();
+    return data;
+}
+
 bool AudioSource::atEnd() const
 {
     // not done as long as QIODevice's buffer is not empty
     if (!QIODevice::atEnd() && QIODevice::bytesAvailable())
         return false;
 
+    QMutexLocker locker(&m_mutex);
+    if (!m_filled.isEmpty())
+        return false;
+
     // If we get here, bytesAvailable() has returned 0, so our buffers are
     // exhaused. Try to see if we are waiting for readOperation to finish.
     AsyncStatus status = AsyncStatus::Completed;
@@ -301,11 +347,15 @@ HRESULT AudioSource::Invoke(IAsyncOperation<SpeechSynthesisStream*> *operation,
     hr = RoGetActivationFactory(HString::MakeReference(RuntimeClass_Windows_Storage_Streams_Buffer).Get(),
                                 IID_PPV_ARGS(&bufferFactory));
     RETURN_HR_IF_FAILED("Could not create buffer factory.");
-    // use the same buffer size as default read chunk size
-    bufferFactory->Create(16384, m_buffer.GetAddressOf());
-
-    hr = m_buffer->QueryInterface(IID_PPV_ARGS(&bufferByteAccess));
-    RETURN_HR_IF_FAILED("Could not access buffer.");
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < m_bufferCount; ++i) {
+            ComPtr<IBuffer> buffer;
+            hr = bufferFactory->Create(m_bufferSize, buffer.GetAddressOf());
+            RETURN_HR_IF_FAILED("Could not create buffer.");
+            m_free.append(buffer);
+        }
+    }
 
     populateBoundaries();
 
@@ -398,8 +448,8 @@ void AudioSource::populateBoundaries()
 /*
     Completion handler for reading from the stream.
 
-    Resets the COM buffer so that it points at the correct position in the
-    stream, and emits readyRead so that the sink pulls more data.
+    Queues the filled COM buffer, starts reading into the next free buffer,
+    and emits readyRead so that the sink pulls more data.
 */
 HRESULT AudioSource::Invoke(IAsyncOperationWithProgress<IBuffer*, unsigned int> *read,
                             AsyncStatus status)
@@ -407,17 +457,30 @@ HRESULT AudioSource::Invoke(IAsyncOperationWithProgress<IBuffer*, unsigned int>
     if (status != AsyncStatus::Completed)
         return E_FAIL;
 
-    // there should never be multiple read operations
-    Q_ASSERT(readOperation.Get() == read);
+    {
+        QMutexLocker locker(&m_mutex);
+        // there should never be multiple read operations
+        Q_ASSERT(readOperation.Get() == read);
 
-    HRESULT hr = read->GetResults(&m_buffer);
-    RETURN_HR_IF_FAILED("Could not access buffer.");
-    m_bufferOffset = 0;
+        Chunk chunk;
+        HRESULT hr = read->GetResults(&chunk.buffer);
+        RETURN_HR_IF_FAILED("Could not access buffer.");
+        hr = chunk.buffer.As(&chunk.byteAccess);
+        RETURN_HR_IF_FAILED("Could not access buffer.");
+        chunk.buffer->get_Length(&chunk.length);
 
-    ComPtr<IAsyncInfo> asyncInfo;
-    if (HRESULT hr = readOperation.As(&asyncInfo); SUCCEEDED(hr))
-        asyncInfo->Close();
-    readOperation.Reset();
+        ComPtr<IAsyncInfo> asyncInfo;
+        if (HRESULT hr = readOperation.As(&asyncInfo); SUCCEEDED(hr))
+            asyncInfo->Close();
+        readOperation.Reset();
+
+        if (chunk.length)
+            m_filled.enqueue(chunk);
+        else
+            m_free.append(chunk.buffer);
+    }
+
+    fetchMore();
 
     // inform the sink that more data has arrived
     if (m_pause == NoPause && bytesInBuffer())
@@ -428,36 +491,49 @@ HRESULT AudioSource::Invoke(IAsyncOperationWithProgress<IBuffer*, unsigned int>
 
 qint64 AudioSource::bytesInBuffer() const
 {
-    if (!m_buffer)
-        return 0;
-
-    UINT32 bytes;
-    m_buffer->get_Length(&bytes);
-    return bytes - m_bufferOffset;
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = 0;
+    for (const Chunk &chunk : m_filled)
+        bytes += chunk.bytesLeft();
+    return bytes;
 }
 
 /*
-    Starts an asynchronous read operation. There can only be one such
-    operation pending at any given time, so fetchMore must only be called
-    if the buffer provided by a previous operation is exhaused.
+    Starts an asynchronous read operation into a free buffer, unless one is
+    already pending, all buffers are filled, or the stream has been read
+    completely. There can only be one read operation pending at any given time.
 */
 bool AudioSource::fetchMore()
 {
-    Q_ASSERT(m_buffer);
-
-    if (readOperation) {
-        qWarning () << "Fetching more while a read operation is already pending";
+    QMutexLocker locker(&m_mutex);
+    if (readOperation || m_free.isEmpty() || !inputStream) {
+        Q_TRACE(AudioSource_fetchMore, 0);
         return false;
     }
 
-    UINT32 capacity;
-    m_buffer->get_Capacity(&capacity);
+    if (randomAccessStream) {
+        UINT64 ioPos = 0;
+        UINT64 ioSize = 0;
+        randomAccessStream->get_Size(&ioSize);
+        randomAccessStream->get_Position(&ioPos);
+        if (ioPos >= ioSize)
+            return false;
+    }
+
+    const ComPtr<IBuffer> buffer = m_free.takeLast();
     InputStreamOptions streamOptions = {};
-    HRESULT hr = inputStream->ReadAsync(m_buffer.Get(), capacity, streamOptions, readOperation.GetAddressOf());
-    if (!SUCCEEDED(hr))
+    HRESULT hr = inputStream->ReadAsync(buffer.Get(), m_bufferSize, streamOptions,
+                                        readOperation.GetAddressOf());
+    if (!SUCCEEDED(hr)) {
+        m_free.append(buffer);
         return false;
+    }
 
-    readOperation->put_Completed(this);
+    Q_TRACE(AudioSource_fetchMore, 1);
+    // the handler might get called right away, in this thread
+    const ComPtr<IAsyncOperationWithProgress<IBuffer*, UINT32>> operation = readOperation;
+    locker.unlock();
+    operation->put_Completed(this);
     return true;
 }
 
@@ -5,7 +5,10 @@
 #define QTEXTTOSPEECHENGINE_WINRT_AUDIOSOURCE_H
 
 #include <QtCore/QIODevice>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
 #include <QtMultimedia/QAudioFormat>
+#include <QtTextToSpeech/private/qtexttospeechsilencedetector_p.h>
 
 #include <robuffer.h>
 #include <winrt/base.h>
@@ -32,7 +35,8 @@ class AudioSource : public QIODevice,
 {
     Q_OBJECT
 public:
-    AudioSource(ComPtr<IAsyncOperation<SpeechSynthesisStream*>> synthOperation);
+    AudioSource(ComPtr<IAsyncOperation<SpeechSynthesisStream*>> synthOperation,
+                UINT32 bufferSize, int bufferCount);
 
     bool isSequential() const override { return true; }
 
@@ -44,6 +48,8 @@ public:
     qint64 bytesAvailable() const override;
 
     QAudioFormat format() const { return audioFormat; }
+    QByteArray takeData();
+    void setSilenceDetection(qint16 threshold, qint64 duration);
 
     enum PauseState {
         NoPause,
@@ -109,7 +115,21 @@ private:
     // we don't destroy by accident, polymorphically, or via a QObject parent
     ~AudioSource() override;
 
+    struct Chunk
+    {
+        ComPtr<IBuffer> buffer;
+        // access to the raw pcm bytes in the IBuffer; this took much reading of Windows header files...
+        ComPtr<::Windows::Storage::Streams::IBufferByteAccess> byteAccess;
+        // the data in the IBuffer might be partially consumed
+        UINT32 offset = 0;
+        UINT32 length = 0;
+
+        const char *data() const;
+        UINT32 bytesLeft() const { return length - offset; }
+    };
+
     qint64 bytesInBuffer() const;
+    void skipRiffHeader(Chunk &chunk);
     bool fetchMore();
 
     QAudioFormat audioFormat;
@@ -119,17 +139,23 @@ private:
     ComPtr<IAsyncOperation<SpeechSynthesisStream*>> synthOperation;
     ComPtr<IInputStream> inputStream;
     ComPtr<IRandomAccessStream> randomAccessStream;
+    // Reads complete in a thread pool thread; the mutex protects the
+    // buffers and the read operation.
+    mutable QRecursiveMutex m_mutex;
     // the current ReadAsync operation that yields an IBuffer
     ComPtr<IAsyncOperationWithProgress<IBuffer*, UINT32>> readOperation;
-    ComPtr<IBuffer> m_buffer;
-    // access to the raw pcm bytes in the IBuffer; this took much reading of Windows header files...
-    ComPtr<::Windows::Storage::Streams::IBufferByteAccess> bufferByteAccess;
-    // The data in the IBuffer might be paritally consumed
-    UINT32 m_bufferOffset = 0;
+    // Buffers with data from the stream, in stream order, and buffers we can
+    // read into. The next read starts as soon as a buffer is free, so that
+    // data is ready when the sink asks for it.
+    QQueue<Chunk> m_filled;
+    QList<ComPtr<IBuffer>> m_free;
+    const UINT32 m_bufferSize;
+    const int m_bufferCount;
     // RIFF header has been checked at the beginning of the stream
     bool m_riffHeaderChecked = false;
     quint64 m_bytesRead = 0;
     quint64 m_pauseRequestedAt = 0;
+    QTextToSpeechSilenceDetector m_silenceDetector;
 
     void populateBoundaries();
     QList<Boundary> boundaries;
@@ -0,0 +1,36 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechserver.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+
+#include <cstdio>
+
+using namespace Qt::StringLiterals;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(u"qttexttospeechserver"_s);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(u"Speaks for applications that use the \"remote\" "
+                                     "text-to-speech engine."_s);
+    parser.addHelpOption();
+    const QCommandLineOption nameOption(u"name"_s,
+                                        u"The name of the server, as in the serverName "
+                                        "parameter of the engine."_s,
+                                        u"name"_s, QTextToSpeechRemote::defaultServerName());
+    parser.addOption(nameOption);
+    parser.process(app);
+
+    QTextToSpeechServer server;
+    if (!server.listen(parser.value(nameOption))) {
+        std::fprintf(stderr, "Cannot listen as %s: %s\n",
+                     qPrintable(parser.value(nameOption)), qPrintable(server.errorString()));
+        return 1;
+    }
+    return app.exec();
+}
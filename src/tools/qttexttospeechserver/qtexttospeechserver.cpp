@@ -0,0 +1,242 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechserver.h"
+
+#include <QtCore/QDebug>
+#include <QtMultimedia/QAudioFormat>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Qt::StringLiterals;
+using Message = QTextToSpeechRemote::Message;
+
+QTextToSpeechServer::QTextToSpeechServer(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &QTextToSpeechServer::newConnection);
+}
+
+bool QTextToSpeechServer::listen(const QString &name)
+{
+    if (m_server.listen(name))
+        return true;
+    if (m_server.serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    // Take over the name only if the server that had it is gone
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (socket.waitForConnected(1000))
+        return false;
+    QLocalServer::removeServer(name);
+    return m_server.listen(name);
+}
+
+void QTextToSpeechServer::newConnection()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection())
+        new QTextToSpeechServerClient(socket, this);
+}
+
+QTextToSpeechServerClient::QTextToSpeechServerClient(QLocalSocket *socket, QObject *parent)
+    : QObject(parent), m_socket(socket)
+{
+    m_socket->setParent(this);
+    connect(m_socket, &QLocalSocket::readyRead, this, &QTextToSpeechServerClient::readMessages);
+    // stops speaking for the client, and lets the other clients continue
+    connect(m_socket, &QLocalSocket::disconnected, this, &QObject::deleteLater);
+}
+
+void QTextToSpeechServerClient::readMessages()
+{
+    m_reader.read(m_socket);
+    Message message;
+    QByteArray payload;
+    while (m_reader.next(&message, &payload))
+        handleMessage(message, payload);
+}
+
+void QTextToSpeechServerClient::handleMessage(Message message, const QByteArray &payload)
+{
+    QDataStream in(payload);
+    in.setVersion(QTextToSpeechRemote::StreamVersion);
+
+    if (message == Message::Hello) {
+        quint32 version;
+        QString engine;
+        QVariantMap params;
+        in >> version >> engine >> params;
+        if (version != QTextToSpeechRemote::ProtocolVersion) {
+            qWarning() << "Client with unsupported protocol version" << version;
+            m_socket->disconnectFromServer();
+            return;
+        }
+        start(engine, params);
+        return;
+    }
+    if (!m_speech)
+        return;
+
+    switch (message) {
+    case Message::Say: {
+        quint32 request;
+        QString text;
+        in >> request >> text;
+        startRequest(request, [this, text] {
+            m_speech->say(text);
+        });
+        break;
+    }
+    case Message::Synthesize: {
+        quint32 request;
+        QString text;
+        in >> request >> text;
+        startRequest(request, [this, request, text] {
+            m_speech->synthesize(text, this, [this, request](const QAudioFormat &format,
+                                                             const QByteArray &data) {
+                send(Message::Synthesized, request, qint32(format.sampleRate()),
+                     qint32(format.channelCount()), qint32(format.sampleFormat()), data);
+            });
+        });
+        break;
+    }
+    case Message::Stop:
+    case Message::Pause: {
+        qint32 boundaryHint;
+        in >> boundaryHint;
+        // the client stops the request that waits, and gets the state of
+        // stopping the previous one for it
+        if (m_pending.start) {
+            m_request = m_pending.request;
+            m_pending = {};
+        }
+        if (message == Message::Stop)
+            m_speech->stop(QTextToSpeech::BoundaryHint(boundaryHint));
+        else
+            m_speech->pause(QTextToSpeech::BoundaryHint(boundaryHint));
+        break;
+    }
+    case Message::Resume:
+        m_speech->resume();
+        break;
+    case Message::SetRate:
+    case Message::SetPitch:
+    case Message::SetVolume: {
+        double value;
+        in >> value;
+        if (message == Message::SetRate)
+            m_speech->setRate(value);
+        else if (message == Message::SetPitch)
+            m_speech->setPitch(value);
+        else
+            m_speech->setVolume(value);
+        break;
+    }
+    case Message::SetVoice: {
+        qint32 index;
+        in >> index;
+        if (index >= 0 && index < m_voices.size())
+            m_speech->setVoice(m_voices.at(index));
+        break;
+    }
+    default:
+        qWarning() << "Unexpected message from a client" << int(message);
+        break;
+    }
+}
+
+void QTextToSpeechServerClient::start(const QString &engine, const QVariantMap &params)
+{
+    if (m_speech || engine == "remote"_L1) {
+        m_socket->disconnectFromServer();
+        return;
+    }
+
+    // all clients that ask for the same engine share one instance of it
+    QVariantMap engineParams = params;
+    engineParams.insert(u"sharedEngine"_s, true);
+    m_speech = std::make_unique<QTextToSpeech>(engine, engineParams);
+    m_voices = m_speech->findVoices();
+
+    connect(m_speech.get(), &QTextToSpeech::stateChanged, this, [this](QTextToSpeech::State state) {
+        send(Message::State, m_request, qint32(state));
+        if (m_pending.start
+            && (state == QTextToSpeech::Ready || state == QTextToSpeech::Error)) {
+            const PendingRequest pending = std::exchange(m_pending, {});
+            m_request = pending.request;
+            pending.start();
+        }
+    });
+    connect(m_speech.get(), &QTextToSpeech::errorOccurred, this,
+            [this](QTextToSpeech::ErrorReason reason, const QString &errorString) {
+        send(Message::Error, m_request, qint32(reason), errorString);
+    });
+    connect(m_speech.get(), &QTextToSpeech::sayingWord, this,
+            [this](const QString &word, qsizetype, qsizetype start, qsizetype length) {
+        send(Message::SayingWord, m_request, word, qint64(start), qint64(length));
+    });
+    connect(m_speech.get(), &QTextToSpeech::synthesizedWord, this,
+            [this](const QString &word, qsizetype, qsizetype start, qsizetype length,
+                   qint64 position) {
+        send(Message::SynthesizedWord, m_request, word, qint64(start), qint64(length), position);
+    });
+    connect(m_speech.get(), &QTextToSpeech::voicesChanged, this, [this] {
+        m_voices = m_speech->findVoices();
+        send(Message::Voices, voices(), voiceIndex());
+    });
+
+    send(Message::Init, qint32(m_speech->engineCapabilities().toInt()), qint32(m_speech->state()),
+         qint32(m_speech->errorReason()), m_speech->errorString(), voices(), voiceIndex(),
+         m_speech->rate(), m_speech->pitch(), m_speech->volume());
+}
+
+/*
+    Starts \a request with \a start once the engine has stopped what it does
+    for the previous request. The client only waits for the state of \a
+    request, so the state changes of stopping are sent for the previous
+    request, also if the engine reports them later.
+*/
+void QTextToSpeechServerClient::startRequest(quint32 request, std::function<void()> &&start)
+{
+    const auto busy = [this] {
+        switch (m_speech->state()) {
+        case QTextToSpeech::Speaking:
+        case QTextToSpeech::Synthesizing:
+        case QTextToSpeech::Paused:
+            return true;
+        case QTextToSpeech::Ready:
+        case QTextToSpeech::Error:
+            break;
+        }
+        return false;
+    };
+
+    // a request that still waits is replaced
+    m_pending = {};
+    if (busy()) {
+        m_speech->stop(QTextToSpeech::BoundaryHint::Immediate);
+        if (busy()) {
+            m_pending = {request, std::move(start)};
+            return;
+        }
+    }
+    m_request = request;
+    start();
+}
+
+QList<QTextToSpeechRemote::Voice> QTextToSpeechServerClient::voices() const
+{
+    QList<QTextToSpeechRemote::Voice> voices;
+    voices.reserve(m_voices.size());
+    for (const QVoice &voice : m_voices)
+        voices.append({voice.name(), voice.locale(), qint32(voice.gender()), qint32(voice.age())});
+    return voices;
+}
+
+qint32 QTextToSpeechServerClient::voiceIndex() const
+{
+    return qint32(m_voices.indexOf(m_speech->voice()));
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,71 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHSERVER_H
+#define QTEXTTOSPEECHSERVER_H
+
+#include <QtTextToSpeech/qtexttospeech.h>
+#include <QtTextToSpeech/private/qtexttospeechremote_p.h>
+
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#include <functional>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Speaks for the "remote" engines of other processes. Clients with the same
+// engine and parameters share one engine instance, and take turns with it.
+class QTextToSpeechServer : public QObject
+{
+public:
+    explicit QTextToSpeechServer(QObject *parent = nullptr);
+
+    bool listen(const QString &name);
+    QString errorString() const { return m_server.errorString(); }
+
+private:
+    void newConnection();
+
+    QLocalServer m_server;
+};
+
+// The connection to one remote engine
+class QTextToSpeechServerClient : public QObject
+{
+public:
+    explicit QTextToSpeechServerClient(QLocalSocket *socket, QObject *parent = nullptr);
+
+private:
+    template <typename ...Args>
+    void send(QTextToSpeechRemote::Message message, const Args &...args)
+    {
+        QTextToSpeechRemote::send(m_socket, message, args...);
+    }
+    void readMessages();
+    void handleMessage(QTextToSpeechRemote::Message message, const QByteArray &payload);
+    void start(const QString &engine, const QVariantMap &params);
+    void startRequest(quint32 request, std::function<void()> &&start);
+    QList<QTextToSpeechRemote::Voice> voices() const;
+    qint32 voiceIndex() const;
+
+    QLocalSocket *m_socket;
+    QTextToSpeechRemote::Reader m_reader;
+    std::unique_ptr<QTextToSpeech> m_speech;
+    // in the order in which the client knows them
+    QList<QVoice> m_voices;
+    // the request that the signals of m_speech are about
+    quint32 m_request = 0;
+    // the request that starts once the engine has stopped the previous one
+    struct PendingRequest
+    {
+        quint32 request = 0;
+        std::function<void()> start;
+    };
+    PendingRequest m_pending;
+};
+
+QT_END_NAMESPACE
+
+#endif
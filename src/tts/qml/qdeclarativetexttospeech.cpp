@@ -4,8 +4,6 @@
 #include "qdeclarativetexttospeech_p.h"
 #include "qvoiceselectorattached_p.h"
 
-#include <QtCore/qregularexpression.h>
-
 QT_BEGIN_NAMESPACE
 
 using namespace Qt::StringLiterals;
@@ -38,7 +36,7 @@ void QDeclarativeTextToSpeech::setEngine(const QString &engine)
 
     m_engine = engine;
     if (m_complete)
-        QTextToSpeech::setEngine(m_engine, m_engineParameters);
+        createEngine(m_engine);
     emit engineChanged(m_engine);
 }
 
@@ -61,10 +59,47 @@ void QDeclarativeTextToSpeech::setEngineParameters(const QVariantMap &parameters
     m_engineParameters = parameters;
     // if changed after initialization, then we need to recreate the engine
     if (m_complete)
-        QTextToSpeech::setEngine(QTextToSpeech::engine(), m_engineParameters);
+        createEngine(QTextToSpeech::engine());
     emit engineParametersChanged();
 }
 
+/*!
+    \qmlproperty bool TextToSpeech::asynchronous
+    \since 6.10
+
+    This property holds whether the engine is created asynchronously.
+
+    By default, the engine is created when the component is complete, and is
+    ready to use in \c{Component.onCompleted}. Initializing an engine can
+    take a long time, for example to enumerate the voices of the platform.
+    If this property is \c true, the engine is created without blocking the
+    user interface, in a worker thread for the engines that support it. The
+    \l state changes to \c{TextToSpeech.Ready} once the engine is ready.
+
+    \sa state
+*/
+bool QDeclarativeTextToSpeech::asynchronous() const
+{
+    return m_asynchronous;
+}
+
+void QDeclarativeTextToSpeech::setAsynchronous(bool asynchronous)
+{
+    if (m_asynchronous == asynchronous)
+        return;
+
+    m_asynchronous = asynchronous;
+    emit asynchronousChanged();
+}
+
+void QDeclarativeTextToSpeech::createEngine(const QString &engine)
+{
+    if (m_asynchronous)
+        QTextToSpeech::setEngineAsync(engine, m_engineParameters);
+    else
+        QTextToSpeech::setEngine(engine, m_engineParameters);
+}
+
 void QDeclarativeTextToSpeech::classBegin()
 {
 }
@@ -72,7 +107,7 @@ void QDeclarativeTextToSpeech::classBegin()
 void QDeclarativeTextToSpeech::componentComplete()
 {
     m_complete = true;
-    QTextToSpeech::setEngine(m_engine, m_engineParameters);
+    createEngine(m_engine);
     selectVoice();
 }
 
@@ -95,38 +130,7 @@ void QDeclarativeTextToSpeech::selectVoice()
 
 QList<QVoice> QDeclarativeTextToSpeech::findVoices(const QVariantMap &criteria) const
 {
-    const QLocale *plocale = nullptr;
-    // if we limit by locale, then limit the search to the voices for that
-    if (const auto &it = criteria.find(QLatin1String("locale")); it != criteria.end()) {
-        if (it->metaType() == QMetaType::fromType<QLocale>())
-            plocale = static_cast<const QLocale *>(it->constData());
-    }
-    QList<QVoice> voices = allVoices(plocale);
-
-    voices.removeIf([&criteria](const QVoice &voice){
-        const QMetaObject &mo = QVoice::staticMetaObject;
-        for (const auto &[key, value] : criteria.asKeyValueRange()) {
-            const int propertyIndex = mo.indexOfProperty(key.toUtf8().constData());
-            if (propertyIndex < 0) {
-                qWarning("QVoice doesn't have a property %s!", qPrintable(key));
-            } else {
-                const QMetaProperty prop = mo.property(propertyIndex);
-                const QVariant voiceValue = prop.readOnGadget(&voice);
-                if (voiceValue.metaType() == QMetaType::fromType<QLocale::Language>()) {
-                    if (voiceValue.value<QLocale::Language>() != value.toLocale().language())
-                        return true;
-                } else if (value.metaType() == QMetaType::fromType<QRegularExpression>()) {
-                    if (!value.value<QRegularExpression>().match(voiceValue.toString()).hasMatch())
-                        return true;
-                } else if (voiceValue != value) {
-                    return true;
-                }
-            }
-        }
-        return false;
-    });
-
-    return voices;
+    return voicesMatching(criteria);
 }
 
 
@@ -29,6 +29,7 @@ class QDeclarativeTextToSpeech : public QTextToSpeech, public QQmlParserStatus
     Q_OBJECT
     Q_PROPERTY(QString engine READ engine WRITE setEngine NOTIFY engineChanged FINAL)
     Q_PROPERTY(QVariantMap engineParameters READ engineParameters WRITE setEngineParameters NOTIFY engineParametersChanged REVISION(6, 6) FINAL)
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged REVISION(6, 10) FINAL)
 
     Q_INTERFACES(QQmlParserStatus)
     QML_NAMED_ELEMENT(TextToSpeech)
@@ -48,16 +49,23 @@ public:
     QVariantMap engineParameters() const;
     void setEngineParameters(const QVariantMap &parameters);
 
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
 Q_SIGNALS:
     void engineChanged(const QString &);
     Q_REVISION(6, 6) void engineParametersChanged();
+    Q_REVISION(6, 10) void asynchronousChanged();
 
 protected:
     void classBegin() override;
     void componentComplete() override;
 
 private:
+    void createEngine(const QString &engine);
+
     bool m_complete = false;
+    bool m_asynchronous = false;
     QString m_engine;
     QVariantMap m_engineParameters;
 };
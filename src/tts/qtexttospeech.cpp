@@ -4,9 +4,21 @@
 
 #include "qtexttospeech.h"
 #include "qtexttospeech_p.h"
+#include "qtexttospeechcacheplayer_p.h"
+#include "qtexttospeechmetrics_p.h"
+#include "qtexttospeechsharedengine_p.h"
+#include "qtexttospeechstreamengine_p.h"
+#include <qttexttospeech_tracepoints_p.h>
 
 #include <QtCore/qcborarray.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qpromise.h>
+#include <QtCore/qregularexpression.h>
+#include <QtCore/qvarlengtharray.h>
+#include <QtCore/qtextboundaryfinder.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qthreadpool.h>
 #include <QtCore/private/qfactoryloader_p.h>
 
 #include <QtMultimedia/qaudiobuffer.h>
@@ -19,7 +31,7 @@ Q_GLOBAL_STATIC_WITH_ARGS(QFactoryLoader, loader,
         ("org.qt-project.qt.speech.tts.plugin/6.0",
          QLatin1String("/texttospeech")))
 
-QMutex QTextToSpeechPrivate::m_mutex;
+QReadWriteLock QTextToSpeechPrivate::m_registryLock;
 
 QTextToSpeechPrivate::QTextToSpeechPrivate(QTextToSpeech *speech)
     : q_ptr(speech)
@@ -33,79 +45,299 @@ QTextToSpeechPrivate::~QTextToSpeechPrivate()
 }
 
 void QTextToSpeechPrivate::setEngineProvider(const QString &engine, const QVariantMap &params)
+{
+    if (prepareEngineProvider(engine, params))
+        attachEngine(createEngine(m_plugin, m_providerName, params));
+    else
+        attachEngine(nullptr);
+    // We have to maintain the public state separately from the engine's actual
+    // state, as we use it to manage queued texts
+    if (m_engine)
+        updateState(m_engine->state());
+}
+
+/*
+    Destroys the current engine, and finds and loads the plug-in for \a engine.
+    Returns whether the engine can be created from m_plugin.
+*/
+bool QTextToSpeechPrivate::prepareEngineProvider(const QString &engine, const QVariantMap &params)
 {
     Q_Q(QTextToSpeech);
 
+    // an engine that is still being created is not needed anymore
+    ++m_engineLoadId;
+    if (auto promise = std::exchange(m_enginePromise, {})) {
+        promise->future().cancel();
+        promise->finish();
+    }
+
     q->stop(QTextToSpeech::BoundaryHint::Immediate);
+    resetPrefetching();
     m_engine.reset();
+    m_voiceIndex.reset();
+    m_cachedVoices.clear();
+    m_engineParameters = params;
 
     m_providerName = engine;
     if (m_providerName.isEmpty()) {
-        const auto plugins = QTextToSpeechPrivate::plugins();
-        int priority = -1;
-        for (const auto &&[provider, metadata] : plugins.asKeyValueRange()) {
-            const int pluginPriority = metadata.value(QStringLiteral("Priority")).toInteger();
-            if (pluginPriority > priority) {
-                priority = pluginPriority;
-                m_providerName = provider;
-            }
-        }
+        m_providerName = registry()->defaultProvider;
         if (m_providerName.isEmpty()) {
             qCritical() << "No text-to-speech plug-ins were found.";
-            return;
+            return false;
         }
     }
     if (!loadMeta()) {
         qCritical() << "Text-to-speech plug-in" << m_providerName << "is not supported.";
-        return;
+        return false;
     }
+    loadVoiceCatalog();
     loadPlugin();
-    if (m_plugin) {
-        QString errorString;
-        m_engine.reset(m_plugin->createTextToSpeechEngine(params, nullptr, &errorString));
-        if (!m_engine) {
-            qCritical() << "Error creating text-to-speech engine" << m_providerName
-                        << (errorString.isEmpty() ? QStringLiteral("") : (QStringLiteral(": ") + errorString));
-        }
-    } else {
+    if (!m_plugin) {
         qCritical() << "Error loading text-to-speech plug-in" << m_providerName;
+        return false;
     }
+    return true;
+}
+
+/*
+    Creates the engine for \a provider from \a plugin. This doesn't access any
+    members, so plug-ins that support it can create their engines in a
+    worker thread.
+*/
+std::unique_ptr<QTextToSpeechEngine> QTextToSpeechPrivate::createEngine(QTextToSpeechPlugin *plugin,
+                                                                      const QString &provider,
+                                                                      const QVariantMap &params)
+{
+    QString errorString;
+    std::unique_ptr<QTextToSpeechEngine> engine;
+    if (params.value(u"sharedEngine"_s).toBool()) {
+        if (auto host = QTextToSpeechEngineHost::instance(plugin, provider, params, &errorString))
+            engine = std::make_unique<QTextToSpeechSharedEngine>(std::move(host));
+    } else {
+        engine.reset(plugin->createTextToSpeechEngine(params, nullptr, &errorString));
+    }
+    if (engine && params.value(u"outputStream"_s).toBool()) {
+        if (engine->capabilities() & QTextToSpeech::Capability::Synthesize) {
+            // values that are not set are defaulted, so that the format is known up front
+            QAudioFormat format = params.value(u"outputStreamFormat"_s).value<QAudioFormat>();
+            if (format.sampleRate() <= 0)
+                format.setSampleRate(22050);
+            if (format.channelCount() <= 0)
+                format.setChannelCount(1);
+            if (format.sampleFormat() == QAudioFormat::Unknown)
+                format.setSampleFormat(QAudioFormat::Int16);
+            engine = std::make_unique<QTextToSpeechStreamEngine>(std::move(engine), format);
+        } else {
+            errorString = u"The engine cannot synthesize audio for an output stream"_s;
+            engine.reset();
+        }
+    }
+    if (!engine) {
+        qCritical() << "Error creating text-to-speech engine" << provider
+                    << (errorString.isEmpty() ? QStringLiteral("") : (QStringLiteral(": ") + errorString));
+    }
+    return engine;
+}
 
+void QTextToSpeechPrivate::attachEngine(std::unique_ptr<QTextToSpeechEngine> engine)
+{
+    Q_Q(QTextToSpeech);
+
+    m_engine = std::move(engine);
+    m_voiceIndex.reset();
     if (m_engine) {
-        // We have to maintain the public state separately from the engine's actual
-        // state, as we use it to manage queued texts
-        updateState(m_engine->state());
+        refreshVoiceCatalogLater();
+        if (m_synthesizeBufferLimit > 0)
+            m_engine->setSynthesizeBufferLimit(m_synthesizeBufferLimit);
         QObjectPrivate::connect(m_engine.get(), &QTextToSpeechEngine::stateChanged,
-                                this, &QTextToSpeechPrivate::updateState);
+                                this, &QTextToSpeechPrivate::engineStateChanged);
         // The other engine signals are directly forwarded to public API signals
         QObject::connect(m_engine.get(), &QTextToSpeechEngine::errorOccurred,
                          q, &QTextToSpeech::errorOccurred);
-        QObject::connect(m_engine.get(), &QTextToSpeechEngine::sayingWord,
-                         q, [this, q](const QString &word, qsizetype start, qsizetype length){
-            emit q->sayingWord(word, m_currentUtterance, start, length);
+        QObjectPrivate::connect(m_engine.get(), &QTextToSpeechEngine::sayingWord,
+                                this, &QTextToSpeechPrivate::reportWord);
+        QObject::connect(m_engine.get(), &QTextToSpeechEngine::synthesized,
+                         q, [this](const QAudioFormat &format, const QByteArray &bytes){
+            if (!m_recordingKey.isEmpty())
+                m_recording.chunks.append({format, bytes});
+            Q_TRACE(QTextToSpeechPrivate_synthesized, m_currentUtterance, bytes.size());
+            measureFirstAudio();
+            m_metrics.d->bytesSynthesized += bytes.size();
+            m_utteranceDuration += format.durationForBytes(bytes.size());
+        });
+        QObject::connect(m_engine.get(), &QTextToSpeechEngine::synthesizedWord,
+                         q, [this, q](const QString &word, qsizetype start, qsizetype length,
+                                      qint64 position){
+            if (!m_recordingKey.isEmpty())
+                m_recording.words.append({word, start, length, position});
+            emit q->synthesizedWord(word, m_currentUtterance, m_currentOffset + start, length,
+                                    position);
+        });
+        QObject::connect(m_engine.get(), &QTextToSpeechEngine::audioUnderrun,
+                         q, [this]{
+            ++m_metrics.d->underruns;
+        });
+        QObject::connect(m_engine.get(), &QTextToSpeechEngine::voicesChanged,
+                         q, [this, q]{
+            m_voiceIndex.reset();
+            emit q->voicesChanged();
+            // the engine might only now have selected a voice
+            if (const QVoice voice = q->voice(); voice != m_reportedVoice) {
+                m_reportedVoice = voice;
+                emit q->voiceChanged(voice);
+            }
+            refreshVoiceCatalogLater();
         });
     } else {
         m_providerName.clear();
+        m_cachedVoices.clear();
     }
 }
 
-bool QTextToSpeechPrivate::loadMeta()
+namespace {
+// An engine created in a worker thread, on its way to the QTextToSpeech object
+struct QTextToSpeechPendingEngine
 {
-    m_plugin = nullptr;
-    m_metaData = QCborMap();
+    ~QTextToSpeechPendingEngine()
+    {
+        // dropped in another thread if the QTextToSpeech object is gone
+        if (engine && engine->thread() != QThread::currentThread())
+            engine.release()->deleteLater();
+    }
+    std::unique_ptr<QTextToSpeechEngine> engine;
+};
+}
+
+/*
+    Like setEngineProvider(), but creates the engine without blocking the
+    caller. Plug-ins that declare AsyncInitialization in their metadata create
+    their engines in a worker thread, all others once control returns to the
+    event loop. The engine is attached once it is created, and \a promise
+    reports whether that succeeded.
+*/
+void QTextToSpeechPrivate::setEngineProviderAsync(const QString &engine, const QVariantMap &params,
+                                                  const std::shared_ptr<QPromise<bool>> &promise)
+{
+    if (!prepareEngineProvider(engine, params)) {
+        attachEngine(nullptr);
+        finishEngineChange();
+        promise->addResult(false);
+        promise->finish();
+        return;
+    }
+    // nothing can be spoken until the new engine exists
+    updateState(QTextToSpeech::Error);
+    m_enginePromise = promise;
+
+    const quint64 loadId = m_engineLoadId;
+    createEngineAsync(m_plugin, m_providerName, m_metaData, params,
+                      [this, loadId](std::unique_ptr<QTextToSpeechEngine> engine) {
+        if (loadId == m_engineLoadId)
+            finishEngineLoad(std::move(engine));
+    });
+}
 
-    QList<QCborMap> candidates = QTextToSpeechPrivate::plugins().values(m_providerName);
+/*
+    Creates the engine for \a provider from \a plugin, and passes it to
+    \a done in the thread of the QTextToSpeech object. Plug-ins that declare
+    AsyncInitialization in their \a metaData create their engines in a worker
+    thread, all others once control returns to the event loop.
+*/
+void QTextToSpeechPrivate::createEngineAsync(QTextToSpeechPlugin *plugin, const QString &provider,
+                                             const QCborMap &metaData, const QVariantMap &params,
+                                             const EngineCreated &done)
+{
+    Q_Q(QTextToSpeech);
 
-    int versionFound = -1;
+    // shared engines live in the thread of the objects that share them
+    if (!metaData.value(u"AsyncInitialization"_s).toBool()
+        || params.value(u"sharedEngine"_s).toBool()) {
+        QMetaObject::invokeMethod(q, [plugin, provider, params, done]{
+            done(createEngine(plugin, provider, params));
+        }, Qt::QueuedConnection);
+        return;
+    }
 
-    // figure out which version of the plugin we want
-    for (int i = 0; i < candidates.size(); ++i) {
-        QCborMap meta = candidates[i];
-        if (int ver = meta.value(QLatin1String("Version")).toInteger(); ver > versionFound) {
-            versionFound = ver;
-            m_metaData = std::move(meta);
-        }
+    using PendingEngine = std::shared_ptr<QTextToSpeechPendingEngine>;
+    auto created = std::make_shared<QPromise<PendingEngine>>();
+    created->start();
+    created->future().then(q, [done](PendingEngine pending) {
+        done(std::move(pending->engine));
+    });
+    QThreadPool::globalInstance()->start([created, plugin, provider, params,
+                                          thread = q->thread()]{
+        auto pending = std::make_shared<QTextToSpeechPendingEngine>();
+        pending->engine = createEngine(plugin, provider, params);
+        if (pending->engine)
+            pending->engine->moveToThread(thread);
+        created->addResult(std::move(pending));
+        created->finish();
+    });
+}
+
+void QTextToSpeechPrivate::finishEngineLoad(std::unique_ptr<QTextToSpeechEngine> engine)
+{
+    attachEngine(std::move(engine));
+    finishEngineChange();
+    if (auto promise = std::exchange(m_enginePromise, {})) {
+        promise->addResult(m_engine != nullptr);
+        promise->finish();
+    }
+}
+
+// Reads the values of the current engine, to apply them to the next one
+void QTextToSpeechPrivate::storeEngineSettings()
+{
+    if (m_engine) {
+        m_storedPitch = m_engine->pitch();
+        m_storedRate = m_engine->rate();
+        m_storedVolume = m_engine->volume();
+    }
+}
+
+// Announces the engine that setEngineProvider() set
+void QTextToSpeechPrivate::finishEngineChange()
+{
+    Q_Q(QTextToSpeech);
+
+    emit q->engineChanged(m_providerName);
+    updateState(m_engine ? m_engine->state() : QTextToSpeech::Error);
+    restoreEngineSettings();
+    prepareFallbackLater();
+}
+
+// Restore values from the previous engine, or from
+// property setters before the engine was initialized.
+void QTextToSpeechPrivate::restoreEngineSettings()
+{
+    Q_Q(QTextToSpeech);
+
+    if (m_engine) {
+        if (!qIsNaN(m_storedPitch))
+            m_engine->setPitch(m_storedPitch);
+        if (!qIsNaN(m_storedRate))
+            m_engine->setRate(m_storedRate);
+        if (!qIsNaN(m_storedVolume))
+            m_engine->setVolume(m_storedVolume);
+
+        // setting the engine might have changed these values
+        if (double realPitch = q->pitch(); m_storedPitch != realPitch)
+            emit q->pitchChanged(realPitch);
+        if (double realRate = q->rate(); m_storedRate != realRate)
+            emit q->rateChanged(realRate);
+        if (double realVolume = q->volume(); m_storedVolume != realVolume)
+            emit q->volumeChanged(realVolume);
+
+        emit q->localeChanged(q->locale());
+        m_reportedVoice = q->voice();
+        emit q->voiceChanged(m_reportedVoice);
     }
+}
+
+bool QTextToSpeechPrivate::loadMeta()
+{
+    m_plugin = nullptr;
+    m_metaData = registry()->providers.value(m_providerName);
 
     if (m_metaData.isEmpty()) {
         m_metaData.insert(QLatin1String("index"), -1); // not found
@@ -117,28 +349,259 @@ bool QTextToSpeechPrivate::loadMeta()
 
 void QTextToSpeechPrivate::loadPlugin()
 {
-    int idx = m_metaData.value(QLatin1String("index")).toInteger();
-    if (idx < 0) {
-        m_plugin = nullptr;
+    m_plugin = loadPlugin(m_metaData);
+}
+
+QTextToSpeechPlugin *QTextToSpeechPrivate::loadPlugin(const QCborMap &metaData)
+{
+    int idx = metaData.value(QLatin1String("index")).toInteger();
+    if (idx < 0)
+        return nullptr;
+
+    // the metadata might be from an older registry, with other plugins
+    const auto plugins = registry();
+    const bool cached = idx < plugins->plugins.size();
+    if (cached) {
+        if (QTextToSpeechPlugin *plugin = plugins->instances[idx].loadAcquire())
+            return plugin;
+    }
+    auto *plugin = qobject_cast<QTextToSpeechPlugin *>(loader()->instance(idx));
+    if (cached && plugin)
+        plugins->instances[idx].storeRelease(plugin);
+    return plugin;
+}
+
+/*
+    Creates an engine that switchEngine() can change to, without affecting
+    the current engine. The engine is null if it can't be created.
+*/
+QTextToSpeechPrivate::StandbyEngine QTextToSpeechPrivate::createStandby(const QString &engine,
+                                                                        const QVariantMap &params)
+{
+    StandbyEngine standby = loadStandby(engine, params);
+    if (standby.plugin)
+        standby.engine = createEngine(standby.plugin, standby.provider, params);
+    return standby;
+}
+
+/*
+    Finds and loads the plug-in for a standby engine, without creating the
+    engine. The plug-in is null if it can't be loaded.
+*/
+QTextToSpeechPrivate::StandbyEngine QTextToSpeechPrivate::loadStandby(const QString &engine,
+                                                                      const QVariantMap &params)
+{
+    StandbyEngine standby;
+    standby.provider = engine.isEmpty() ? registry()->defaultProvider : engine;
+    standby.metaData = registry()->providers.value(standby.provider);
+    if (standby.metaData.isEmpty()) {
+        qCritical() << "Text-to-speech plug-in" << standby.provider << "is not supported.";
+        return {};
+    }
+    standby.plugin = loadPlugin(standby.metaData);
+    if (!standby.plugin) {
+        qCritical() << "Error loading text-to-speech plug-in" << standby.provider;
+        return {};
+    }
+    standby.params = params;
+    return standby;
+}
+
+/*
+    Creates the engine that the failover changes to if the current engine
+    fails: the first of the fallback engines after the current engine that
+    initializes. A new instance of the current engine is the last option.
+    The candidates are created one after the other, without blocking, like
+    setEngineProviderAsync() creates engines.
+*/
+void QTextToSpeechPrivate::prepareFallback()
+{
+    m_fallback = {};
+    ++m_fallbackId;
+    m_fallbackPending = false;
+    prepareFallbackCandidate(1);
+}
+
+/*
+    Creates the fallback engine at \a candidate positions after the current
+    engine, and continues with the next candidate if that fails.
+*/
+void QTextToSpeechPrivate::prepareFallbackCandidate(qsizetype candidate)
+{
+    const qsizetype count = m_fallbackEngines.size();
+    const qsizetype current = m_fallbackEngines.indexOf(m_providerName);
+    for (; candidate <= count; ++candidate) {
+        const QString &engine = m_fallbackEngines.at((current + candidate) % count);
+        auto fallback = std::make_shared<StandbyEngine>(loadStandby(engine, fallbackParameters()));
+        if (!fallback->plugin)
+            continue;
+
+        m_fallbackPending = true;
+        createEngineAsync(fallback->plugin, fallback->provider, fallback->metaData,
+                          fallback->params,
+                          [this, fallback, candidate, fallbackId = m_fallbackId]
+                          (std::unique_ptr<QTextToSpeechEngine> engine) {
+            if (fallbackId != m_fallbackId)
+                return;
+            m_fallbackPending = false;
+            if (!engine || engine->state() == QTextToSpeech::Error) {
+                prepareFallbackCandidate(candidate + 1);
+                return;
+            }
+            fallback->engine = std::move(engine);
+            m_fallback = std::move(*fallback);
+        });
+        return;
+    }
+}
+
+/*
+    The parameters of the current engine that QTextToSpeech handles itself,
+    so that the fallback engine is used in the same way. Parameters that are
+    specific to the current engine are not passed on.
+*/
+QVariantMap QTextToSpeechPrivate::fallbackParameters() const
+{
+    QVariantMap params;
+    for (const QString &key : {u"sharedEngine"_s, u"outputStream"_s, u"outputStreamFormat"_s}) {
+        if (const auto it = m_engineParameters.constFind(key); it != m_engineParameters.cend())
+            params.insert(key, *it);
+    }
+    return params;
+}
+
+// Prepares a new fallback engine once control returns to the event loop
+void QTextToSpeechPrivate::prepareFallbackLater()
+{
+    Q_Q(QTextToSpeech);
+    if (m_fallbackEngines.isEmpty() || m_fallbackPending || m_fallback.engine)
         return;
+    m_fallbackPending = true;
+    QMetaObject::invokeMethod(q, [this]{
+        m_fallbackPending = false;
+        if (!m_fallback.engine)
+            prepareFallback();
+    }, Qt::QueuedConnection);
+}
+
+/*
+    Continues with the fallback engine after the current engine failed.
+    Speech continues with the word that the failed engine was speaking, and
+    synthesis is repeated if the failed engine didn't produce any audio for
+    the text yet. Returns false if the error has to be reported.
+*/
+bool QTextToSpeechPrivate::failOver()
+{
+    if (!m_fallback.engine || m_fallback.engine->state() != QTextToSpeech::Ready)
+        return false;
+    // the receiver already has part of the audio
+    if (m_state == QTextToSpeech::Synthesizing && (m_firstAudio || m_replaying))
+        return false;
+
+    qWarning() << "Text-to-speech engine" << m_providerName << "failed:"
+               << m_engine->errorString() << "- continuing with" << m_fallback.provider;
+    ++m_replayId;
+    m_replaying = false;
+    cancelCaching();
+    m_sentences.clear();
+    const QTextToSpeech::State oldState = m_state;
+    switchEngine(std::exchange(m_fallback, {}));
+    prepareFallbackLater();
+
+    switch (oldState) {
+    case QTextToSpeech::Speaking:
+        // handled like an interruption by an utterance with higher priority
+        m_preemptHint = QTextToSpeech::BoundaryHint::Immediate;
+        updateState(QTextToSpeech::Ready);
+        break;
+    case QTextToSpeech::Synthesizing:
+        synthesize(m_currentText);
+        break;
+    default:
+        updateState(m_engine->state());
+        break;
+    }
+    return true;
+}
+
+/*
+    Replaces the current engine with the standby engine, keeping the pending
+    utterances. Called when the current engine is idle, or from updateState()
+    when the current engine finished an utterance.
+*/
+void QTextToSpeechPrivate::switchEngine(StandbyEngine &&standby)
+{
+    Q_Q(QTextToSpeech);
+    Q_ASSERT(standby.engine);
+
+    storeEngineSettings();
+    QObject::disconnect(m_synthesizeConnection);
+    if (m_engine) {
+        QObject::disconnect(m_engine.get(), nullptr, q, nullptr);
+        // the engine might be emitting the signal that got us here
+        m_engine.release()->deleteLater();
     }
-    m_plugin = qobject_cast<QTextToSpeechPlugin *>(loader()->instance(idx));
+    resetPrefetching();
+    m_voiceIndex.reset();
+
+    m_providerName = standby.provider;
+    m_engineParameters = standby.params;
+    m_metaData = standby.metaData;
+    m_plugin = standby.plugin;
+    loadVoiceCatalog();
+    // prepareEngine() watches the standby engine until it is used
+    QObject::disconnect(standby.engine.get(), nullptr, q, nullptr);
+    attachEngine(std::move(standby.engine));
+    standby = {};
+    // the audio of the following utterances goes to the same receiver
+    if (auto receiver = std::exchange(m_receiver, {}))
+        setReceiver(receiver);
+
+    emit q->engineChanged(m_providerName);
+    restoreEngineSettings();
 }
 
 QMultiHash<QString, QCborMap> QTextToSpeechPrivate::plugins(bool reload)
 {
-    static QMultiHash<QString, QCborMap> plugins;
-    static bool alreadyDiscovered = false;
-    QMutexLocker lock(&m_mutex);
+    return registry(reload)->plugins;
+}
 
-    if (reload == true)
-        alreadyDiscovered = false;
+std::shared_ptr<const QTextToSpeechPluginRegistry> QTextToSpeechPrivate::registry(bool reload)
+{
+    static std::shared_ptr<const QTextToSpeechPluginRegistry> registry;
+    if (!reload) {
+        QReadLocker lock(&m_registryLock);
+        if (registry)
+            return registry;
+    }
 
-    if (!alreadyDiscovered) {
-        loadPluginMetadata(plugins);
-        alreadyDiscovered = true;
+    QWriteLocker lock(&m_registryLock);
+    if (registry && !reload)
+        return registry;
+
+    auto newRegistry = std::make_shared<QTextToSpeechPluginRegistry>();
+    loadPluginMetadata(newRegistry->plugins);
+    newRegistry->instances.reset(
+            new QAtomicPointer<QTextToSpeechPlugin>[newRegistry->plugins.size()]);
+
+    int priority = -1;
+    QHash<QString, qint64> versions;
+    for (const auto &&[provider, metadata] : newRegistry->plugins.asKeyValueRange()) {
+        // figure out which version of the plugin we want
+        const qint64 version = metadata.value(QLatin1String("Version")).toInteger();
+        if (const auto it = versions.constFind(provider); it == versions.cend() || version > *it) {
+            versions.insert(provider, version);
+            newRegistry->providers.insert(provider, metadata);
+        }
+        const int pluginPriority = metadata.value(QStringLiteral("Priority")).toInteger();
+        if (pluginPriority > priority) {
+            priority = pluginPriority;
+            newRegistry->defaultProvider = provider;
+        }
     }
-    return plugins;
+
+    registry = std::move(newRegistry);
+    return registry;
 }
 
 void QTextToSpeechPrivate::loadPluginMetadata(QMultiHash<QString, QCborMap> &list)
@@ -152,19 +615,84 @@ void QTextToSpeechPrivate::loadPluginMetadata(QMultiHash<QString, QCborMap> &lis
     }
 }
 
+void QTextToSpeechPrivate::engineStateChanged(QTextToSpeech::State newState)
+{
+    // continue with a fallback engine instead of failing
+    if (newState == QTextToSpeech::Error && m_state != QTextToSpeech::Error && failOver())
+        return;
+    updateState(newState);
+}
+
 void QTextToSpeechPrivate::updateState(QTextToSpeech::State newState)
 {
     Q_Q(QTextToSpeech);
+    m_streamStarting = false;
+    // the engine might already be speaking, e.g. with sentence chunking
+    if (newState == QTextToSpeech::Speaking)
+        measureFirstAudio();
     if (m_state == newState)
         return;
+    Q_TRACE(QTextToSpeechPrivate_updateState, m_state, newState);
+
+    // asynchronously initialized engines only know their voices once they are ready
+    if (m_state == QTextToSpeech::Error)
+        m_voiceIndex.reset();
+
+    if (!m_recordingKey.isEmpty() && newState != QTextToSpeech::Synthesizing) {
+        if (newState == QTextToSpeech::Ready)
+            m_audioCache.insert(std::exchange(m_recordingKey, {}), std::exchange(m_recording, {}));
+        else
+            cancelCaching();
+    }
+
+    if (newState == QTextToSpeech::Paused || newState == QTextToSpeech::Error)
+        m_pausePending = false;
 
     if (newState == QTextToSpeech::Ready) {
+        const bool pausePending = std::exchange(m_pausePending, false);
+        // The receiver has all audio of the synthesized utterance
+        if (m_state == QTextToSpeech::Synthesizing && m_receiver && m_receiver->finished)
+            m_receiver->finished();
+        // An utterance with higher priority interrupted the current one
+        const bool interrupted = m_preemptHint && m_state == QTextToSpeech::Speaking;
+        if (interrupted)
+            requeueInterrupted();
+        m_preemptHint.reset();
+        // The engine finished the sentence instead of pausing; resume()
+        // continues with the next one
+        if (m_state == QTextToSpeech::Speaking && pausePending && !m_sentences.isEmpty()) {
+            m_state = QTextToSpeech::Paused;
+            emit q->stateChanged(m_state);
+            return;
+        }
+        // Continue with the next sentence of the current utterance
+        if (m_state == QTextToSpeech::Speaking && sayNextSentence())
+            return;
+        if (m_state == QTextToSpeech::Speaking && !interrupted)
+            finishSpoken(m_currentUtterance);
+        if (m_utteranceTimer.isValid() && !interrupted) {
+            const qint64 latency = m_utteranceTimer.nsecsElapsed() / 1000;
+            ++m_metrics.d->utterances;
+            m_metrics.d->lastLatency = latency;
+            m_metrics.d->totalLatency += latency;
+            if (m_state == QTextToSpeech::Synthesizing) {
+                m_metrics.d->synthesisTime += latency;
+                m_metrics.d->synthesizedDuration += m_utteranceDuration;
+            }
+        }
+        m_utteranceTimer.invalidate();
+        // Change to the prepared engine at this utterance boundary, once it is ready
+        if (m_switchPending && m_standby.engine
+            && m_standby.engine->state() == QTextToSpeech::Ready) {
+            m_switchPending = false;
+            switchEngine(std::exchange(m_standby, {}));
+        }
         // If we have more text to process, start the next request immediately,
         // and ignore the transition to Ready (don't emit the signals).
         if (!m_pendingUtterances.isEmpty()) {
-            const QString nextText = m_pendingUtterances.first();
+            const Utterance next = m_pendingUtterances.first();
             // QTextToSpeech::pause prepends an empty entry to request a pause
-            if (nextText.isEmpty()) {
+            if (next.text.isEmpty()) {
                 m_state = QTextToSpeech::Paused;
                 m_pendingUtterances.dequeue();
             } else {
@@ -182,18 +710,27 @@ void QTextToSpeechPrivate::updateState(QTextToSpeech::State newState)
                 }();
                 if (nextFunction) {
                     const auto oldState = m_state;
-                    emit q->aboutToSynthesize(m_currentUtterance);
+                    Q_TRACE(QTextToSpeech_aboutToSynthesize, next.id);
+                    emit q->aboutToSynthesize(next.id);
                     // connected slot could have called pause or stop, in which
                     // case the state changed or the pendingTexts got reset.
                     if (m_state == oldState && !m_pendingUtterances.isEmpty()) {
-                        m_pendingUtterances.dequeue();
-                        ++m_currentUtterance;
-                        (m_engine.get()->*nextFunction)(nextText);
+                        const Utterance utterance = m_pendingUtterances.dequeue();
+                        if (nextFunction == &QTextToSpeechEngine::synthesize) {
+                            m_currentUtterance = utterance.id;
+                            if (utterance.receiver)
+                                setReceiver(utterance.receiver);
+                            synthesize(utterance.spokenText());
+                            prefetchPending();
+                        } else {
+                            startUtterance(utterance);
+                            prefetchPending();
+                        }
                         return;
                     } else if (m_state == QTextToSpeech::Paused) {
                         // In case of pause(), empty strings got inserted.
                         // We are already idle, so remove them again.
-                        while (!m_pendingUtterances.isEmpty() && m_pendingUtterances.first().isEmpty())
+                        while (!m_pendingUtterances.isEmpty() && m_pendingUtterances.first().text.isEmpty())
                             m_pendingUtterances.dequeue();
                         return;
                     }
@@ -207,731 +744,2666 @@ void QTextToSpeechPrivate::updateState(QTextToSpeech::State newState)
             disconnectSynthesizeFunctor();
         }
     }
+    if (newState == QTextToSpeech::Error) {
+        cancelSpoken();
+        m_utteranceTimer.invalidate();
+    }
     m_state = newState;
     emit q->stateChanged(newState);
 }
 
 void QTextToSpeechPrivate::disconnectSynthesizeFunctor()
 {
-    if (m_slotObject) {
-        m_slotObject->destroyIfLastRef();
-        m_slotObject = nullptr;
-        m_engine->disconnect(m_synthesizeConnection);
-    }
+    setReceiver(nullptr);
 }
 
-/*!
-    \class QTextToSpeech
-    \brief The QTextToSpeech class provides a convenient access to text-to-speech engines.
-    \inmodule QtTextToSpeech
+/*
+    Makes \a receiver receive the audio that the engine synthesizes, converted
+    to the requested format.
+*/
+void QTextToSpeechPrivate::setReceiver(const std::shared_ptr<QTextToSpeechSynthesisReceiver> &receiver)
+{
+    Q_Q(QTextToSpeech);
+    if (receiver == m_receiver)
+        return;
+    QObject::disconnect(m_synthesizeConnection);
+    m_receiver = receiver;
+    if (!m_receiver || !m_engine || (m_receiver->hasContext && !m_receiver->context))
+        return;
 
-    Use \l say() to start reading text to the default audio device, and
-    \l stop(), \l pause(), and \l resume() to control the reading of the text.
+    const QObject *context = m_receiver->hasContext ? m_receiver->context.data() : q;
+    m_synthesizeConnection = QObject::connect(m_engine.get(), &QTextToSpeechEngine::synthesized,
+                                              context, [this, receiver](const QAudioFormat &engineFormat,
+                                                                        const QByteArray &engineBytes){
+        const QAudioFormat format = m_converter.outputFormat(engineFormat);
+        const QByteArray bytes = m_converter.convert(engineFormat, engineBytes);
+        if (!bytes.isEmpty())
+            receiver->received(format, bytes);
+    });
+}
 
-    \snippet hello_speak/mainwindow.cpp say
-    \snippet hello_speak/mainwindow.cpp stop
-    \snippet hello_speak/mainwindow.cpp pause
-    \snippet hello_speak/mainwindow.cpp resume
+/*
+    Removes the pending utterances of \a receiver, and stops the engine if it
+    is synthesizing for \a receiver. Other utterances continue.
+*/
+void QTextToSpeechPrivate::cancelReceiver(const std::shared_ptr<QTextToSpeechSynthesisReceiver> &receiver)
+{
+    m_pendingUtterances.removeIf([&receiver](const Utterance &utterance){
+        return utterance.receiver == receiver;
+    });
+    if (m_receiver != receiver)
+        return;
+    disconnectSynthesizeFunctor();
+    cancelCaching();
+    if (m_engine && m_engine->state() == QTextToSpeech::Synthesizing)
+        m_engine->stop(QTextToSpeech::BoundaryHint::Immediate);
+}
 
-    To synthesize text into PCM data for further processing, use synthesize().
+/*
+    Cancels \a receiver once the engine no longer calls it.
+*/
+void QTextToSpeechPrivate::cancelReceiverLater(const std::weak_ptr<QTextToSpeechSynthesisReceiver> &receiver)
+{
+    Q_Q(QTextToSpeech);
+    QMetaObject::invokeMethod(q, [this, receiver]{
+        if (const auto strongReceiver = receiver.lock())
+            cancelReceiver(strongReceiver);
+    }, Qt::QueuedConnection);
+}
 
-    Use \l findVoices() to get a list of matching voices, or use \l
-    availableVoices() to get the list of voices that support the current
-    locale. Change the \l locale property, using one of the \l availableLocales()
-    that is a good match for the language that the input text is in, and for
-    the accent of the desired voice output. This will change the list of
-    available voices on most platforms. Then use one of the available voices in
-    a call to \l setVoice().
+/*
+    Finishes the future returned by sayAsync() for the utterance \a id.
+*/
+void QTextToSpeechPrivate::finishSpoken(qsizetype id)
+{
+    if (const auto promise = m_spokenPromises.take(id))
+        promise->finish();
+}
 
-    Not every engine supports all features. Use the engineCapabilities() function to
-    test which features are available, and adjust the usage of the class accordingly.
+/*
+    Cancels the futures returned by sayAsync() for all utterances.
+*/
+void QTextToSpeechPrivate::cancelSpoken()
+{
+    for (const auto &promise : std::as_const(m_spokenPromises)) {
+        promise->future().cancel();
+        promise->finish();
+    }
+    m_spokenPromises.clear();
+}
 
-    \note Which locales and voices the engine supports depends usually on the Operating
-    System configuration. E.g. on macOS, end users can install voices through the
-    \e Accessibility panel in \e{System Preferences}.
+/*
+    Starts measuring the utterance that the engine is given next.
 */
+void QTextToSpeechPrivate::startMeasuring()
+{
+    m_utteranceTimer.start();
+    m_firstAudio = false;
+    m_utteranceDuration = 0;
+}
 
-/*!
-    \qmltype TextToSpeech
-    \inqmlmodule QtTextToSpeech
-    \brief The TextToSpeech type provides access to text-to-speech engines.
+/*
+    Records the time until the engine started to speak, or delivered the first
+    audio, for the current utterance.
+*/
+void QTextToSpeechPrivate::measureFirstAudio()
+{
+    if (m_firstAudio || !m_utteranceTimer.isValid())
+        return;
+    m_firstAudio = true;
+    const qint64 elapsed = m_utteranceTimer.nsecsElapsed() / 1000;
+    Q_TRACE(QTextToSpeechPrivate_firstAudio, m_currentUtterance, elapsed);
+    m_metrics.d->lastTimeToFirstAudio = elapsed;
+    m_metrics.d->totalTimeToFirstAudio += elapsed;
+    ++m_metrics.d->firstAudioCount;
+}
 
-    Use \l say() to start reading text to the default audio device, and
-    \l stop(), \l pause(), and \l resume() to control the reading of the text.
+/*
+    Synthesizes \a text for \a receiver, or queues it if the engine is busy
+    synthesizing for another receiver.
+*/
+void QTextToSpeechPrivate::startSynthesis(const QString &text,
+                                          std::shared_ptr<QTextToSpeechSynthesisReceiver> receiver)
+{
+    if (!m_engine)
+        return;
 
-    \snippet quickspeech/Main.qml initialize
-    \codeline
-    \dots
-    \codeline
-    \snippet quickspeech/Main.qml say0
-    \snippet quickspeech/Main.qml say1
-    \snippet quickspeech/Main.qml pause
-    \snippet quickspeech/Main.qml resume
-    \dots
+    if (m_engine->state() == QTextToSpeech::Synthesizing || m_replaying) {
+        // only spoken utterances get an id
+        enqueueUtterance({text, -1, QTextToSpeech::Priority::Normal, 0, std::move(receiver)});
+        prefetchPending();
+    } else {
+        setReceiver(receiver);
+        synthesize(text);
+    }
+}
 
-    To synthesize text into PCM data for further processing, use synthesize().
+/*
+    Adds \a utterance to the pending utterances, after all utterances with the
+    same or higher priority. An interrupted utterance that is \a resumed goes
+    before the texts with the same priority, but after pauses.
+*/
+void QTextToSpeechPrivate::enqueueUtterance(Utterance &&utterance, bool resumed)
+{
+    const auto it = std::find_if(m_pendingUtterances.begin(), m_pendingUtterances.end(),
+                                 [&utterance, resumed](const Utterance &pending) {
+        return resumed ? !pending.text.isEmpty() && pending.priority <= utterance.priority
+                       : pending.priority < utterance.priority;
+    });
+    m_pendingUtterances.insert(it, std::move(utterance));
+}
 
-    To set a voice, use the VoiceSelector attached property like this:
+void QTextToSpeechPrivate::startUtterance(const Utterance &utterance)
+{
+    startMeasuring();
+    m_currentUtterance = utterance.id;
+    m_currentPriority = utterance.priority;
+    m_currentOffset = utterance.offset;
+    say(utterance.spokenText());
+}
 
-    \code
-    TextToSpeech {
-        VoiceSelector.locale: Qt.locale("en_UK")
-        VoiceSelector.gender: Voice.Male
-    }
-    \endcode
+/*
+    Returns the state of whatever speaks the current utterance, the engine or
+    the player of cached audio.
+*/
+QTextToSpeech::State QTextToSpeechPrivate::speakingState() const
+{
+    return playingCached() ? m_cachePlayer->state() : m_engine->state();
+}
+
+/*
+    Reports the word at \a start in the text that the engine or the player of
+    cached audio was given.
+*/
+void QTextToSpeechPrivate::reportWord(const QString &word, qsizetype start, qsizetype length)
+{
+    Q_Q(QTextToSpeech);
+    m_lastWordStart = m_sentenceOffset + start;
+    m_lastWordEnd = m_lastWordStart + length;
+    Q_TRACE(QTextToSpeechPrivate_sayingWord, m_currentUtterance,
+            m_currentOffset + m_lastWordStart, length);
+    emit q->sayingWord(word, m_currentUtterance, m_currentOffset + m_lastWordStart, length);
+}
+
+/*
+    Stops the current utterance at \a boundaryHint so that the pending one with
+    higher priority can be spoken. The rest of the current utterance gets
+    requeued once the engine has stopped.
+*/
+void QTextToSpeechPrivate::preempt(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    if (m_preemptHint)
+        return;
+    m_preemptHint = boundaryHint;
+    // don't continue with the next sentence
+    m_sentences.clear();
+    // cached audio has no word boundaries to stop at
+    if (playingCached())
+        m_cachePlayer->stop();
+    else
+        m_engine->stop(boundaryHint);
+}
+
+void QTextToSpeechPrivate::requeueInterrupted()
+{
+    // Continue with the word that was interrupted, or after the last word
+    // or sentence that the engine finished.
+    qsizetype resumeAt = m_lastWordStart;
+    switch (*m_preemptHint) {
+    case QTextToSpeech::BoundaryHint::Word:
+        resumeAt = m_lastWordEnd;
+        break;
+    case QTextToSpeech::BoundaryHint::Sentence: {
+        QTextBoundaryFinder finder(QTextBoundaryFinder::Sentence, m_currentText);
+        finder.setPosition(m_lastWordStart);
+        resumeAt = finder.toNextBoundary();
+        if (resumeAt < 0)
+            resumeAt = m_currentText.size();
+        break;
+    }
+    default:
+        break;
+    }
+
+    // skip whitespace and punctuation between the words
+    resumeAt = qMin(resumeAt, m_currentText.size());
+    while (resumeAt < m_currentText.size() && !m_currentText.at(resumeAt).isLetterOrNumber())
+        ++resumeAt;
+    if (resumeAt == m_currentText.size())
+        return;
+    const QString rest = m_currentText.sliced(resumeAt);
+    enqueueUtterance({rest, m_currentUtterance, m_currentPriority, m_currentOffset + resumeAt},
+                     true);
+}
+
+/*
+    Speaks \a text with the engine. With sentence chunking enabled, the engine
+    gets one sentence at a time, so that it can start speaking without having
+    to process the entire text first.
+*/
+void QTextToSpeechPrivate::say(const QString &text)
+{
+    m_sentences.clear();
+    m_pausePending = false;
+    m_sentenceOffset = 0;
+    m_currentText = text;
+    m_lastWordStart = 0;
+    m_lastWordEnd = 0;
+    if (playCached(text))
+        return;
+    Q_TRACE(QTextToSpeechPrivate_startEngine, m_currentUtterance, 0, text.size());
+    if (!m_sentenceChunking) {
+        m_engine->say(text);
+        return;
+    }
+
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Sentence, text);
+    qsizetype start = 0;
+    while (finder.toNextBoundary() != -1) {
+        // so that the queue is only empty once all words are spoken
+        if (!QStringView(text).sliced(start, finder.position() - start).trimmed().isEmpty())
+            m_sentences.enqueue({start, finder.position() - start});
+        start = finder.position();
+    }
+    m_sentenceText = text;
+    if (!sayNextSentence())
+        m_engine->say(text);
+}
+
+bool QTextToSpeechPrivate::sayNextSentence()
+{
+    if (m_sentences.isEmpty()) {
+        m_sentenceText.clear();
+        return false;
+    }
+    const auto [offset, length] = m_sentences.dequeue();
+    m_sentenceOffset = offset;
+    m_engine->say(m_sentenceText.sliced(offset, length));
+    return true;
+}
+
+/*
+    Enqueues the complete sentences of the streamed text, and with \a finished
+    also the rest. The sentences are parts of the same utterance, so words are
+    reported at their position in all streamed text.
+*/
+void QTextToSpeechPrivate::enqueueStreamed(bool finished)
+{
+    Q_Q(QTextToSpeech);
+    // The boundary at the end of the text only ends a sentence if the stream
+    // is finished; otherwise the next text might continue the sentence.
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Sentence, m_streamText);
+    qsizetype start = 0;
+    qsizetype position;
+    while ((position = finder.toNextBoundary()) != -1
+           && (finished || position < m_streamText.size())) {
+        const QString sentence = m_streamText.sliced(start, position - start);
+        Utterance utterance{sentence, m_streamId, QTextToSpeech::Priority::Normal,
+                            m_streamOffset + start};
+        start = position;
+        if (sentence.trimmed().isEmpty())
+            continue;
+        if (speakingState() == QTextToSpeech::Ready && !m_streamStarting
+            && m_pendingUtterances.isEmpty()) {
+            m_streamStarting = true;
+            Q_TRACE(QTextToSpeech_aboutToSynthesize, m_streamId);
+            emit q->aboutToSynthesize(m_streamId);
+            startUtterance(utterance);
+        } else {
+            enqueueUtterance(std::move(utterance));
+        }
+    }
+    m_streamText.remove(0, start);
+    m_streamOffset += start;
+}
+
+void QTextToSpeechPrivate::resetStream()
+{
+    m_streamText.clear();
+    m_streamOffset = 0;
+    m_streamId = -1;
+    m_streamStarting = false;
+}
+
+/*
+    Synthesizes \a text with the engine, unless the audio for it is cached.
+*/
+void QTextToSpeechPrivate::synthesize(const QString &text)
+{
+    m_currentText = text;
+    m_sentenceOffset = 0;
+    m_currentOffset = 0;
+    m_converter.reset();
+    if (m_audioCache.maxCost() <= 0 && m_audioCache.directory().isEmpty()) {
+        startMeasuring();
+        Q_TRACE(QTextToSpeechPrivate_startEngine, m_currentUtterance, 1, text.size());
+        m_engine->synthesize(text);
+        return;
+    }
+
+    QByteArray key = cacheKey(text);
+    if (const auto entry = m_audioCache.find(key)) {
+        replay(*entry);
+        return;
+    }
+    // the engine synthesizes it now, so that prefetching it is not needed anymore
+    m_prefetchQueue.removeIf([&key](const PrefetchItem &item) { return item.key == key; });
+    m_recordingKey = std::move(key);
+    m_recording = {};
+    startMeasuring();
+    Q_TRACE(QTextToSpeechPrivate_startEngine, m_currentUtterance, 1, text.size());
+    m_engine->synthesize(text);
+}
+
+/*
+    Delivers cached audio to the receiver of the current utterance, and reports
+    its words with the synthesizedWord() signal, just like freshly synthesized
+    data. As with engines, the data is delivered asynchronously. Compressed
+    chunks are decoded one at a time, right before they are delivered.
+*/
+void QTextToSpeechPrivate::replay(const QTextToSpeechAudioCache::Entry &entry)
+{
+    Q_Q(QTextToSpeech);
+    m_replaying = true;
+    m_converter.reset();
+    updateState(QTextToSpeech::Synthesizing);
+    QMetaObject::invokeMethod(q, [this, q, entry, replayId = ++m_replayId]{
+        // like engines, report each word before the audio that it starts in
+        auto word = entry.words.cbegin();
+        qint64 position = 0;
+        for (const auto &chunk : entry.chunks) {
+            const QAudioFormat &format = chunk.format;
+            const QByteArray bytes = chunk.pcm();
+            position += format.durationForBytes(bytes.size());
+            for (; word != entry.words.cend() && word->position < position; ++word) {
+                emit q->synthesizedWord(word->text, m_currentUtterance,
+                                        m_currentOffset + word->start, word->length,
+                                        word->position);
+                // a connected slot might have stopped us
+                if (replayId != m_replayId)
+                    return;
+            }
+            deliverReplayed(format, bytes);
+            // the functor might have stopped us
+            if (replayId != m_replayId)
+                return;
+        }
+        m_replaying = false;
+        updateState(QTextToSpeech::Ready);
+    }, Qt::QueuedConnection);
+}
+
+/*
+    Converts replayed audio to the requested format, and passes it to the
+    receiver in the thread of its context, like the connection that
+    setReceiver() makes for the engine's audio.
+*/
+void QTextToSpeechPrivate::deliverReplayed(const QAudioFormat &engineFormat,
+                                           const QByteArray &engineBytes)
+{
+    const std::shared_ptr<QTextToSpeechSynthesisReceiver> receiver = m_receiver;
+    if (!receiver || (receiver->hasContext && !receiver->context))
+        return;
+    const QAudioFormat format = m_converter.outputFormat(engineFormat);
+    const QByteArray bytes = m_converter.convert(engineFormat, engineBytes);
+    if (bytes.isEmpty())
+        return;
+    if (receiver->hasContext && receiver->context->thread() != QThread::currentThread()) {
+        QMetaObject::invokeMethod(receiver->context.data(), [receiver, format, bytes]{
+            receiver->received(format, bytes);
+        }, Qt::QueuedConnection);
+    } else {
+        receiver->received(format, bytes);
+    }
+}
+
+/*
+    Speaks \a text with audio from the cache, if the cache has audio for it
+    with the current settings. Returns false if the engine has to speak it.
+*/
+bool QTextToSpeechPrivate::playCached(const QString &text)
+{
+    if (m_audioCache.maxCost() <= 0 && m_audioCache.directory().isEmpty())
+        return false;
+    const auto entry = m_audioCache.find(cacheKey(text));
+    if (!entry)
+        return false;
+
+    if (!m_cachePlayer) {
+        m_cachePlayer = std::make_unique<QTextToSpeechCachePlayer>();
+        QObjectPrivate::connect(m_cachePlayer.get(), &QTextToSpeechCachePlayer::stateChanged,
+                                this, &QTextToSpeechPrivate::updateState);
+        QObjectPrivate::connect(m_cachePlayer.get(), &QTextToSpeechCachePlayer::sayingWord,
+                                this, &QTextToSpeechPrivate::reportWord);
+    }
+    if (!m_cachePlayer->play(*entry, m_engine->volume()))
+        return false;
+    // the engine's latency is measured, not that of the cache
+    m_utteranceTimer.invalidate();
+    return true;
+}
+
+bool QTextToSpeechPrivate::playingCached() const
+{
+    return m_cachePlayer && m_cachePlayer->state() != QTextToSpeech::Ready;
+}
+
+QByteArray QTextToSpeechPrivate::cacheKey(const QString &text) const
+{
+    return QTextToSpeechAudioCache::key(m_providerName, m_engineParameters, m_engine->voice(),
+                                        m_engine->rate(), m_engine->pitch(), m_engine->volume(),
+                                        text);
+}
+
+/*
+    Queues \a text for the prefetch engine, creating that engine on first use.
+    Returns false if the audio cache is disabled.
+*/
+bool QTextToSpeechPrivate::prefetch(const QString &text)
+{
+    if (m_audioCache.maxCost() <= 0 && m_audioCache.directory().isEmpty())
+        return false;
+
+    QByteArray key = cacheKey(text);
+    if (key == m_prefetchKey || m_audioCache.find(key))
+        return true;
+    for (const PrefetchItem &item : std::as_const(m_prefetchQueue)) {
+        if (item.key == key)
+            return true;
+    }
+
+    if (!m_prefetchEngine && !m_prefetchEnginePending)
+        createPrefetchEngine();
+    m_prefetchQueue.enqueue({std::move(key), text, m_engine->voice(), m_engine->rate(),
+                             m_engine->pitch(), m_engine->volume()});
+    prefetchNext();
+    return true;
+}
+
+/*
+    Creates the prefetch engine in the background, like setEngineProviderAsync()
+    creates engines. With the sharedEngine parameter, the prefetch engine takes
+    turns with the other users of the shared instance, so that no second
+    instance of the engine is loaded. The prefetch engine only synthesizes, so
+    it doesn't need an output stream.
+*/
+void QTextToSpeechPrivate::createPrefetchEngine()
+{
+    Q_Q(QTextToSpeech);
+    Q_ASSERT(m_plugin);
+
+    QVariantMap params = m_engineParameters;
+    params.remove(u"outputStream"_s);
+    params.remove(u"outputStreamFormat"_s);
+    m_prefetchEnginePending = true;
+    createEngineAsync(m_plugin, m_providerName, m_metaData, params,
+                      [this, q, prefetchId = m_prefetchId](std::unique_ptr<QTextToSpeechEngine> engine) {
+        if (prefetchId != m_prefetchId)
+            return;
+        m_prefetchEnginePending = false;
+        if (!engine) {
+            qWarning() << "Error creating prefetch engine";
+            m_prefetchQueue.clear();
+            return;
+        }
+        m_prefetchEngine = std::move(engine);
+        if (m_synthesizeBufferLimit > 0)
+            m_prefetchEngine->setSynthesizeBufferLimit(m_synthesizeBufferLimit);
+        QObjectPrivate::connect(m_prefetchEngine.get(), &QTextToSpeechEngine::stateChanged,
+                                this, &QTextToSpeechPrivate::prefetchStateChanged);
+        QObject::connect(m_prefetchEngine.get(), &QTextToSpeechEngine::synthesized,
+                         q, [this](const QAudioFormat &format, const QByteArray &bytes) {
+            if (!m_prefetchKey.isEmpty())
+                m_prefetchRecording.chunks.append({format, bytes});
+        });
+        QObject::connect(m_prefetchEngine.get(), &QTextToSpeechEngine::synthesizedWord,
+                         q, [this](const QString &word, qsizetype start, qsizetype length,
+                                   qint64 position) {
+            if (!m_prefetchKey.isEmpty())
+                m_prefetchRecording.words.append({word, start, length, position});
+        });
+        prefetchNext();
+    });
+}
+
+/*
+    Drops the prefetch engine and the texts that it hasn't synthesized yet,
+    including an engine that is still being created.
+*/
+void QTextToSpeechPrivate::resetPrefetching()
+{
+    ++m_prefetchId;
+    m_prefetchEnginePending = false;
+    m_prefetchQueue.clear();
+    m_prefetchKey.clear();
+    m_prefetchEngine.reset();
+}
+
+/*
+    Prefetches the first pending utterances, up to the look-ahead depth, so
+    that their audio is cached once they are next. Spoken utterances are
+    played from the cache as well.
+*/
+void QTextToSpeechPrivate::prefetchPending()
+{
+    if (m_prefetchDepth <= 0 || !m_engine
+        || !(m_engine->capabilities() & QTextToSpeech::Capability::Synthesize)) {
+        return;
+    }
+    int depth = 0;
+    for (const Utterance &utterance : std::as_const(m_pendingUtterances)) {
+        if (depth == m_prefetchDepth)
+            break;
+        // pauses
+        if (utterance.text.isEmpty())
+            continue;
+        if (!prefetch(utterance.spokenText()))
+            return;
+        ++depth;
+    }
+}
+
+/*
+    Starts synthesizing the next prefetched text on the prefetch engine, once
+    that engine is ready. An engine that failed on the previous text gets the
+    chance to recover with the next one.
+*/
+void QTextToSpeechPrivate::prefetchNext()
+{
+    if (!m_prefetchEngine || !m_prefetchKey.isEmpty())
+        return;
+    const QTextToSpeech::State state = m_prefetchEngine->state();
+    if (state != QTextToSpeech::Ready && state != QTextToSpeech::Error)
+        return;
+
+    while (!m_prefetchQueue.isEmpty()) {
+        const PrefetchItem item = m_prefetchQueue.dequeue();
+        // Might have been synthesized since it was queued
+        if (m_audioCache.find(item.key))
+            continue;
+
+        m_prefetchEngine->setVoice(item.voice);
+        m_prefetchEngine->setRate(item.rate);
+        m_prefetchEngine->setPitch(item.pitch);
+        m_prefetchEngine->setVolume(item.volume);
+        m_prefetchKey = item.key;
+        m_prefetchRecording = {};
+        m_prefetchEngine->synthesize(item.text);
+        return;
+    }
+}
+
+void QTextToSpeechPrivate::prefetchStateChanged(QTextToSpeech::State state)
+{
+    switch (state) {
+    case QTextToSpeech::Ready:
+        if (!m_prefetchKey.isEmpty()) {
+            m_audioCache.insert(std::exchange(m_prefetchKey, {}),
+                                std::exchange(m_prefetchRecording, {}));
+        }
+        prefetchNext();
+        break;
+    case QTextToSpeech::Error:
+        qWarning() << "Prefetching failed:" << m_prefetchEngine->errorString();
+        if (m_prefetchKey.isEmpty()) {
+            // the engine could not be initialized
+            m_prefetchQueue.clear();
+        } else {
+            // skip the text that failed, and continue with the next one
+            m_prefetchKey.clear();
+            m_prefetchRecording = {};
+            prefetchNext();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void QTextToSpeechPrivate::cancelCaching()
+{
+    m_recordingKey.clear();
+    m_recording = {};
+    ++m_replayId;
+    if (std::exchange(m_replaying, false))
+        updateState(QTextToSpeech::Ready);
+}
+
+const QTextToSpeechVoiceIndex &QTextToSpeechPrivate::voiceIndex() const
+{
+    if (!m_voiceIndex) {
+        Q_Q(const QTextToSpeech);
+        // engines that don't reimplement allVoices() change their locale temporarily
+        QSignalBlocker blockSignals(const_cast<QTextToSpeech *>(q));
+        const QList<QVoice> voices = m_engine ? m_engine->allVoices(nullptr) : QList<QVoice>();
+        m_voiceIndex.emplace(voices.isEmpty() ? m_cachedVoices : voices);
+    }
+    return *m_voiceIndex;
+}
+
+QString QTextToSpeechPrivate::voiceCatalogFile() const
+{
+    return QTextToSpeechVoiceCatalog::fileName(m_voiceCacheDirectory, m_providerName,
+                                               m_metaData, m_engineParameters);
+}
+
+// Reads the voices that a previous process stored for the current engine
+void QTextToSpeechPrivate::loadVoiceCatalog()
+{
+    m_cachedVoices.clear();
+    if (!m_voiceCacheDirectory.isEmpty() && !m_providerName.isEmpty())
+        m_cachedVoices = QTextToSpeechVoiceCatalog::read(voiceCatalogFile());
+}
+
+/*
+    Stores the voices of the engine, if it knows them, for the next process.
+    If they differ from the stored voices that might have been reported until
+    now, then voicesChanged() is emitted.
+*/
+void QTextToSpeechPrivate::refreshVoiceCatalog()
+{
+    Q_Q(QTextToSpeech);
+    if (!m_engine || m_voiceCacheDirectory.isEmpty())
+        return;
+
+    QList<QVoice> voices;
+    {
+        // engines that don't reimplement allVoices() change their locale temporarily
+        QSignalBlocker blockSignals(q);
+        voices = m_engine->allVoices(nullptr);
+    }
+    // the engine is still enumerating its voices
+    if (voices.isEmpty() || voices == m_cachedVoices)
+        return;
+
+    if (!QTextToSpeechVoiceCatalog::write(voiceCatalogFile(), voices))
+        qWarning() << "Could not store the voices of" << m_providerName << "in"
+                   << m_voiceCacheDirectory;
+    const bool reported = !std::exchange(m_cachedVoices, voices).isEmpty();
+    if (reported) {
+        m_voiceIndex.reset();
+        emit q->voicesChanged();
+    }
+}
+
+// Refreshes the stored voices once control returns to the event loop
+void QTextToSpeechPrivate::refreshVoiceCatalogLater()
+{
+    Q_Q(QTextToSpeech);
+    if (m_voiceCacheDirectory.isEmpty() || std::exchange(m_voiceCatalogRefreshPending, true))
+        return;
+    QMetaObject::invokeMethod(q, [this]{
+        m_voiceCatalogRefreshPending = false;
+        refreshVoiceCatalog();
+    }, Qt::QueuedConnection);
+}
+
+QTextToSpeechVoiceIndex::QTextToSpeechVoiceIndex(const QList<QVoice> &voices)
+    : m_voices(voices)
+{
+    for (qsizetype i = 0; i < m_voices.size(); ++i) {
+        const QVoice &voice = m_voices.at(i);
+        m_byLocale[voice.locale()].append(i);
+        m_byLanguage[voice.language()].append(i);
+        m_byGender[voice.gender()].append(i);
+        m_byAge[voice.age()].append(i);
+        m_byName[voice.name()].append(i);
+    }
+}
+
+QList<QVoice> QTextToSpeechVoiceIndex::voices(const QLocale &locale) const
+{
+    QList<QVoice> result;
+    const auto it = m_byLocale.constFind(locale);
+    if (it == m_byLocale.cend())
+        return result;
+    result.reserve(it->size());
+    for (qsizetype i : *it)
+        result << m_voices.at(i);
+    return result;
+}
+
+/*
+    Returns the voices that match all \a criteria, which map the name of a
+    QVoice property to the value the voice needs to have. The name can also be
+    a QRegularExpression, and for the language, only the language of the
+    given locale is compared.
+*/
+QList<QVoice> QTextToSpeechVoiceIndex::find(const QVariantMap &criteria) const
+{
+    enum Property { Name, Gender, Age, Locale, Language };
+    struct Criterion
+    {
+        Property property;
+        QVariant value;
+    };
+    QVarLengthArray<Criterion, 5> checks;
+    // the shortest matching list from the lookup tables
+    const QList<qsizetype> *candidates = nullptr;
+    const auto narrow = [&candidates](const auto &table, const auto &key) {
+        static const QList<qsizetype> none;
+        const auto it = table.constFind(key);
+        const QList<qsizetype> *matches = it == table.cend() ? &none : &*it;
+        if (!candidates || matches->size() < candidates->size())
+            candidates = matches;
+    };
+
+    for (const auto &[key, value] : criteria.asKeyValueRange()) {
+        if (key == "name"_L1) {
+            if (value.metaType() != QMetaType::fromType<QRegularExpression>())
+                narrow(m_byName, value.toString());
+            checks.append({Name, value});
+        } else if (key == "gender"_L1) {
+            narrow(m_byGender, value.toInt());
+            checks.append({Gender, value});
+        } else if (key == "age"_L1) {
+            narrow(m_byAge, value.toInt());
+            checks.append({Age, value});
+        } else if (key == "locale"_L1) {
+            narrow(m_byLocale, value.toLocale());
+            checks.append({Locale, value});
+        } else if (key == "language"_L1) {
+            narrow(m_byLanguage, int(value.toLocale().language()));
+            checks.append({Language, value});
+        } else {
+            qWarning("QVoice doesn't have a property %s!", qPrintable(key));
+        }
+    }
+
+    const auto matches = [&checks](const QVoice &voice) {
+        for (const Criterion &check : checks) {
+            switch (check.property) {
+            case Name:
+                if (check.value.metaType() == QMetaType::fromType<QRegularExpression>()) {
+                    if (!check.value.value<QRegularExpression>().match(voice.name()).hasMatch())
+                        return false;
+                } else if (voice.name() != check.value.toString()) {
+                    return false;
+                }
+                break;
+            case Gender:
+                if (voice.gender() != check.value.toInt())
+                    return false;
+                break;
+            case Age:
+                if (voice.age() != check.value.toInt())
+                    return false;
+                break;
+            case Locale:
+                if (voice.locale() != check.value.toLocale())
+                    return false;
+                break;
+            case Language:
+                if (voice.language() != check.value.toLocale().language())
+                    return false;
+                break;
+            }
+        }
+        return true;
+    };
+
+    QList<QVoice> result;
+    if (candidates) {
+        for (qsizetype i : *candidates) {
+            if (matches(m_voices.at(i)))
+                result << m_voices.at(i);
+        }
+    } else {
+        result = m_voices;
+    }
+    return result;
+}
+
+QTextToSpeechDeviceWriter::QTextToSpeechDeviceWriter(QIODevice *device,
+                                                     QTextToSpeech::OutputFormat format)
+    : m_device(device), m_outputFormat(format)
+{
+}
+
+void QTextToSpeechDeviceWriter::write(const QAudioFormat &format, const QByteArray &bytes)
+{
+    if (!m_device)
+        return;
+
+    if (m_outputFormat == QTextToSpeech::OutputFormat::Wav) {
+        if (m_headerPos < 0) {
+            m_format = format;
+            m_headerPos = m_device->pos();
+            // sequential devices can't be patched later; use the streaming convention
+            writeWavHeader(m_device->isSequential() ? 0xffffffff : 0);
+        } else if (format != m_format) {
+            qWarning() << "Audio format changed while writing WAV data, dropping" << format;
+            return;
+        }
+    }
+
+    if (m_device->write(bytes) != bytes.size())
+        qWarning() << "Failed to write synthesized audio:" << m_device->errorString();
+    m_dataSize += bytes.size();
+}
+
+void QTextToSpeechDeviceWriter::finish()
+{
+    if (!m_device || m_headerPos < 0 || m_device->isSequential())
+        return;
+
+    const qint64 endPos = m_device->pos();
+    if (m_device->seek(m_headerPos)) {
+        writeWavHeader(quint32(qMin<qint64>(m_dataSize, 0xffffffff - 36)));
+        m_device->seek(endPos);
+    }
+}
+
+void QTextToSpeechDeviceWriter::writeWavHeader(quint32 dataSize)
+{
+    const bool isFloat = m_format.sampleFormat() == QAudioFormat::Float;
+    const quint16 channels = m_format.channelCount();
+    const quint32 sampleRate = m_format.sampleRate();
+    const quint16 blockAlign = m_format.bytesPerFrame();
+    const quint16 bitsPerSample = m_format.bytesPerSample() * 8;
+
+    char header[44];
+    memcpy(header, "RIFF", 4);
+    qToLittleEndian<quint32>(dataSize == 0xffffffff ? dataSize : dataSize + 36, header + 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, header + 16);
+    qToLittleEndian<quint16>(isFloat ? 3 : 1, header + 20); // WAVE_FORMAT_IEEE_FLOAT or PCM
+    qToLittleEndian<quint16>(channels, header + 22);
+    qToLittleEndian<quint32>(sampleRate, header + 24);
+    qToLittleEndian<quint32>(sampleRate * blockAlign, header + 28);
+    qToLittleEndian<quint16>(blockAlign, header + 32);
+    qToLittleEndian<quint16>(bitsPerSample, header + 34);
+    memcpy(header + 36, "data", 4);
+    qToLittleEndian<quint32>(dataSize, header + 40);
+    m_device->write(header, sizeof(header));
+}
+
+/*!
+    \class QTextToSpeech
+    \brief The QTextToSpeech class provides a convenient access to text-to-speech engines.
+    \inmodule QtTextToSpeech
+
+    Use \l say() to start reading text to the default audio device, and
+    \l stop(), \l pause(), and \l resume() to control the reading of the text.
+
+    \snippet hello_speak/mainwindow.cpp say
+    \snippet hello_speak/mainwindow.cpp stop
+    \snippet hello_speak/mainwindow.cpp pause
+    \snippet hello_speak/mainwindow.cpp resume
+
+    To synthesize text into PCM data for further processing, use synthesize().
+
+    Use \l findVoices() to get a list of matching voices, or use \l
+    availableVoices() to get the list of voices that support the current
+    locale. Change the \l locale property, using one of the \l availableLocales()
+    that is a good match for the language that the input text is in, and for
+    the accent of the desired voice output. This will change the list of
+    available voices on most platforms. Then use one of the available voices in
+    a call to \l setVoice().
+
+    Not every engine supports all features. Use the engineCapabilities() function to
+    test which features are available, and adjust the usage of the class accordingly.
+
+    QTextToSpeech objects can be created and used in any thread that runs an
+    event loop, and objects in different threads can speak and synthesize at
+    the same time. An object, and the engine it creates, belong to the thread
+    that the object lives in, and must only be used from that thread. The
+    signals of the engine are delivered through the event loop of that
+    thread. Engines that are shared with the \c sharedEngine parameter are only
+    shared between objects in the same thread.
+
+    \note Which locales and voices the engine supports depends usually on the Operating
+    System configuration. E.g. on macOS, end users can install voices through the
+    \e Accessibility panel in \e{System Preferences}.
+*/
+
+/*!
+    \qmltype TextToSpeech
+    \inqmlmodule QtTextToSpeech
+    \brief The TextToSpeech type provides access to text-to-speech engines.
+
+    Use \l say() to start reading text to the default audio device, and
+    \l stop(), \l pause(), and \l resume() to control the reading of the text.
+
+    \snippet quickspeech/Main.qml initialize
+    \codeline
+    \dots
+    \codeline
+    \snippet quickspeech/Main.qml say0
+    \snippet quickspeech/Main.qml say1
+    \snippet quickspeech/Main.qml pause
+    \snippet quickspeech/Main.qml resume
+    \dots
+
+    To synthesize text into PCM data for further processing, use synthesize().
+
+    To set a voice, use the VoiceSelector attached property like this:
+
+    \code
+    TextToSpeech {
+        VoiceSelector.locale: Qt.locale("en_UK")
+        VoiceSelector.gender: Voice.Male
+    }
+    \endcode
 
     The first voice that matches all specified criteria will be used. If no voice
     matches all criteria, then the voice will not change.
 
-    Alternatively, use \l findVoices() to get a list of matching voices, or use
-    \l availableVoices() to get the list of voices that support the current
-    locale. Change the \l locale property, using one of the \l availableLocales()
-    that is a good match for the language that the input text is in, and for
-    the accent of the desired voice output. This will change the list of
-    available voices on most platforms. Then use one of the available voices in
-    the \l voice property.
+    Alternatively, use \l findVoices() to get a list of matching voices, or use
+    \l availableVoices() to get the list of voices that support the current
+    locale. Change the \l locale property, using one of the \l availableLocales()
+    that is a good match for the language that the input text is in, and for
+    the accent of the desired voice output. This will change the list of
+    available voices on most platforms. Then use one of the available voices in
+    the \l voice property.
+
+    Not every engine supports all features. Use the engineCapabilities()
+    function to test which features are available, and adjust the usage of the
+    type accordingly.
+
+    \note Which locales and voices the engine supports depends usually on the Operating
+    System configuration. E.g. on macOS, end users can install voices through the
+    \e Accessibility panel in \e{System Preferences}.
+*/
+
+/*!
+    \enum QTextToSpeech::State
+
+    \brief This enum describes the current state of the text-to-speech engine.
+
+    \value Ready        The synthesizer is ready to start a new text. This is
+                        also the state after a text was finished.
+    \value Speaking     Text is being spoken.
+    \value Synthesizing Text is being synthesized into PCM data. The synthesized()
+                        signal will be emitted with chunks of data.
+    \value Paused       The synthesis was paused and can be resumed with \l resume().
+    \value Error        An error has occurred. Details are given by \l errorReason().
+
+    \sa QTextToSpeech::ErrorReason errorReason() errorString()
+*/
+
+/*!
+    \enum QTextToSpeech::ErrorReason
+
+    \brief This enum describes the current error, if any, of the QTextToSpeech engine.
+
+    \value NoError          No error has occurred.
+    \value Initialization   The backend could not be initialized, e.g. due to
+                            a missing driver or operating system requirement.
+    \value Configuration    The given backend configuration is inconsistent, e.g.
+                            due to wrong voice name or parameters.
+    \value Input            The given text could not be synthesized, e.g. due to
+                            invalid size or characters.
+    \value Playback         Audio playback failed e.g. due to missing audio device,
+                            wrong format or audio streaming interruption.
+
+    Use \l errorReason() to obtain the current error and \l errorString() to get the
+    related error message.
+
+    \sa errorOccurred()
+*/
+
+/*!
+    \enum QTextToSpeech::BoundaryHint
+
+    \brief describes when speech should be stopped and paused.
+
+    \value Default          Uses the engine specific default behavior.
+    \value Immediate        The engine should stop playback immediately.
+    \value Word             Stop speech when the current word is finished.
+    \value Sentence         Stop speech when the current sentence is finished.
+    \value [since 6.6] Utterance
+                            Stop speech when the current utterance is finished.
+                            An utterance is the block of text used in a call to
+                            say() or enqueue().
+
+    \note These are hints to the engine. The current engine might not support
+    all options.
+*/
+
+/*!
+    Loads a text-to-speech engine from a plug-in that uses the default
+    engine plug-in and constructs a QTextToSpeech object as the child
+    of \a parent.
+
+    The default engine is platform-specific.
+
+    If the engine initializes correctly, then the \l state of the engine will
+    change to QTextToSpeech::Ready; note that this might happen asynchronously.
+    If the plugin fails to load, then \l state will be set to QTextToSpeech::Error.
+
+    \sa availableEngines()
+*/
+QTextToSpeech::QTextToSpeech(QObject *parent)
+    : QTextToSpeech(QString(), QVariantMap(), parent)
+{
+}
+
+/*!
+    Loads a text-to-speech engine from a plug-in that matches parameter \a engine and
+    constructs a QTextToSpeech object as the child of \a parent.
+
+    If \a engine is empty, the default engine plug-in is used. The default
+    engine is platform-specific.
+
+    If the engine initializes correctly, the \l state of the engine will be set
+    to QTextToSpeech::Ready. If the plugin fails to load, or if the engine fails to
+    initialize, the engine's \l state will be set to QTextToSpeech::Error.
+
+    \sa availableEngines()
+*/
+QTextToSpeech::QTextToSpeech(const QString &engine, QObject *parent)
+    : QTextToSpeech(engine, QVariantMap(), parent)
+{
+}
+
+/*!
+    \since 6.4
+
+    Loads a text-to-speech engine from a plug-in that matches parameter \a engine and
+    constructs a QTextToSpeech object as the child of \a parent, passing \a params
+    through to the engine.
+
+    If \a engine is empty, the default engine plug-in is used. The default
+    engine is platform-specific. Which key/value pairs in \a params are supported
+    depends on the engine. See \l{Qt TextToSpeech Engines}{the engine documentation}
+    for details. Unsupported entries will be ignored.
+
+    If the engine initializes correctly, the \l state of the engine will be set
+    to QTextToSpeech::Ready. If the plugin fails to load, or if the engine fails to
+    initialize, the engine's \l state will be set to QTextToSpeech::Error.
+
+    \sa availableEngines()
+*/
+QTextToSpeech::QTextToSpeech(const QString &engine, const QVariantMap &params, QObject *parent)
+    : QObject(*new QTextToSpeechPrivate(this), parent)
+{
+    Q_D(QTextToSpeech);
+    // allow QDeclarativeTextToSpeech to skip initialization until the component
+    // is complete
+    if (engine != u"none"_s)
+        d->setEngineProvider(engine, params);
+    else
+        d->m_providerName = engine;
+}
+
+/*!
+    Destroys this QTextToSpeech object, stopping any speech.
+*/
+QTextToSpeech::~QTextToSpeech()
+{
+    stop(QTextToSpeech::BoundaryHint::Immediate);
+}
+
+/*!
+    \qmlproperty string TextToSpeech::engine
+
+    The engine used to synthesize text to speech.
+
+    Changing the engine stops any ongoing speech.
+
+    On most platforms, changing the engine will update the list of
+    \l{availableLocales()}{available locales} and \l{availableVoices()}{available voices}.
+*/
+
+/*!
+    \property QTextToSpeech::engine
+    \brief the engine used to synthesize text to speech.
+    \since 6.4
+
+    Changing the engine stops any ongoing speech.
+
+    On most platforms, changing the engine will update the list of
+    \l{availableLocales()}{available locales} and \l{availableVoices()}{available voices}.
+*/
+
+/*!
+    \since 6.4
+    Sets the engine used by this QTextToSpeech object to \a engine, passing
+    \a params through to the engine constructor.
+
+    \return whether \a engine could be set successfully.
+
+    Which key/value pairs in \a params are supported depends on the engine.
+    See \l{Qt TextToSpeech Engines}{the engine documentation} for details.
+    Unsupported entries will be ignored.
+
+    Since Qt 6.10, all engines support the \c sharedEngine parameter. If it is
+    \c true, then QTextToSpeech objects in the same thread that use the same
+    engine with the same parameters share a single engine instance. Each
+    QTextToSpeech object keeps its own voice, rate, pitch, and volume, and the
+    objects take turns, one utterance at a time, in the order in which they
+    requested to speak or synthesize. An object that is paused while speaking
+    lets the others speak; after resume(), it speaks next, continuing after
+    the last word it spoke. An object that is paused while synthesizing keeps
+    the engine until it is resumed or stopped.
+
+    Since Qt 6.10, all engines that can synthesize audio also support the
+    \c outputStream parameter. If it is \c true, then say() and enqueue()
+    don't play the speech on an audio device, but make it available for
+    reading from outputStream(). The \c outputStreamFormat parameter can hold
+    the QAudioFormat of that audio; by default, it is mono 16-bit audio at
+    22050 Hz.
+
+    \sa outputStream()
+*/
+bool QTextToSpeech::setEngine(const QString &engine, const QVariantMap &params)
+{
+    Q_D(QTextToSpeech);
+    if (d->m_providerName == engine && params.isEmpty())
+        return true;
+
+    d->storeEngineSettings();
+    d->setEngineProvider(engine, params);
+    d->finishEngineChange();
+    return d->m_engine.get();
+}
+
+/*!
+    \since 6.10
+
+    Sets the engine used by this QTextToSpeech object to \a engine like
+    setEngine(), passing \a params through to the engine constructor, but
+    without waiting for the engine to be created.
+
+    Returns a future that reports whether the engine could be set. The future
+    is canceled if the engine is changed again before the new engine exists.
+
+    Engines that support it are created in a worker thread; others are created
+    once control returns to the event loop. Until then, the \l state is
+    QTextToSpeech::Error and there is no engine to speak with. The
+    engineChanged() and stateChanged() signals are emitted once the engine
+    exists.
+
+    \sa setEngine()
+*/
+QFuture<bool> QTextToSpeech::setEngineAsync(const QString &engine, const QVariantMap &params)
+{
+    Q_D(QTextToSpeech);
+    auto promise = std::make_shared<QPromise<bool>>();
+    QFuture<bool> future = promise->future();
+    promise->start();
+    if (d->m_providerName == engine && params.isEmpty() && !d->m_enginePromise) {
+        promise->addResult(d->m_engine != nullptr);
+        promise->finish();
+        return future;
+    }
+
+    d->storeEngineSettings();
+    d->setEngineProviderAsync(engine, params, promise);
+    return future;
+}
+
+/*!
+    \since 6.10
+
+    Creates the engine \a engine with \a params as the prepared engine, which
+    switchToPreparedEngine() changes to. The current engine is not affected.
+    Returns whether the engine could be created.
+
+    Creating the engine, and loading its voices, can take a long time. With
+    a prepared engine, this happens before the engine is needed, and
+    switching to it doesn't interrupt the speech in progress for longer than
+    the gap between two utterances.
+
+    Preparing another engine replaces the previously prepared one.
+
+    \sa preparedEngine(), switchToPreparedEngine(), setEngine()
+*/
+bool QTextToSpeech::prepareEngine(const QString &engine, const QVariantMap &params)
+{
+    Q_D(QTextToSpeech);
+    d->m_switchPending = false;
+    d->m_standby = d->createStandby(engine, params);
+    if (!d->m_standby.engine)
+        return false;
+
+    // a switch that waits for the engine happens when it is ready, if the
+    // current engine is idle by then; otherwise at the next utterance boundary
+    connect(d->m_standby.engine.get(), &QTextToSpeechEngine::stateChanged,
+            this, [d](QTextToSpeech::State state) {
+        if (!d->m_switchPending)
+            return;
+        if (state == QTextToSpeech::Error) {
+            qWarning() << "Prepared text-to-speech engine" << d->m_standby.provider << "failed:"
+                       << d->m_standby.engine->errorString();
+            d->m_switchPending = false;
+        } else if (state == QTextToSpeech::Ready
+                   && (d->m_state == QTextToSpeech::Ready
+                       || d->m_state == QTextToSpeech::Error)) {
+            d->m_switchPending = false;
+            d->switchEngine(std::exchange(d->m_standby, {}));
+            d->prepareFallbackLater();
+            d->updateState(d->m_engine->state());
+        }
+    });
+    return true;
+}
+
+/*!
+    \since 6.10
+
+    Returns the name of the engine that prepareEngine() created, or an empty
+    string if no engine is prepared.
+
+    \sa prepareEngine()
+*/
+QString QTextToSpeech::preparedEngine() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_standby.engine ? d->m_standby.provider : QString();
+}
+
+/*!
+    \since 6.10
+
+    Changes to the engine created with prepareEngine(). Returns \c false if
+    no engine is prepared.
+
+    If the current engine is idle, or in an error state, then the prepared
+    engine is used right away. Otherwise, the current engine completes the
+    text that it is speaking or synthesizing, and the prepared engine
+    continues with the pending texts; this happens as soon as the prepared
+    engine is ready. Unlike with setEngine(), the queue of pending texts is
+    kept.
+
+    The engineChanged() signal is emitted when the engine changes, before the
+    next text is started, so that connected slots can select a voice of the
+    new engine. The rate, pitch, and volume are kept.
+
+    \sa prepareEngine(), setEngine(), enqueue()
+*/
+bool QTextToSpeech::switchToPreparedEngine()
+{
+    Q_D(QTextToSpeech);
+    if (!d->m_standby.engine)
+        return false;
+
+    if (d->m_state == QTextToSpeech::Ready || d->m_state == QTextToSpeech::Error) {
+        d->m_switchPending = false;
+        d->switchEngine(std::exchange(d->m_standby, {}));
+        d->prepareFallbackLater();
+        d->updateState(d->m_engine->state());
+    } else {
+        d->m_switchPending = true;
+    }
+    return true;
+}
+
+/*!
+    \since 6.10
+
+    Sets the engines that this QTextToSpeech object fails over to if the
+    current engine fails to \a engines.
+
+    If the current engine changes to the \l{QTextToSpeech::}{Error} state,
+    then, instead of changing to that state, this QTextToSpeech object
+    changes to a fallback engine, as with switchToPreparedEngine(), and
+    continues with the text that it was speaking, from the word that the
+    failed engine was speaking. Synthesis of a text is repeated if the failed
+    engine did not produce any audio for it yet; otherwise the error is
+    reported as usual. The pending texts are kept. Depending on the engine,
+    errorOccurred() might still be emitted for the failure.
+
+    The fallback engines are ordered by their priority, highest first, which
+    is also how the default engine is chosen. The engine that follows the
+    failed engine in that order is used; a new instance of the failed engine
+    is the last option. Engines that are not available are ignored.
+
+    The fallback engine is created in the background in advance, so that
+    failing over doesn't have to wait for the engine to initialize. It gets
+    the \c sharedEngine, \c outputStream, and \c outputStreamFormat
+    parameters of the current engine; all other parameters are specific to
+    the current engine, and the fallback engine uses its defaults.
+
+    An empty list, the default, disables failing over.
+
+    \sa fallbackEngines(), availableEngines(), errorOccurred()
+*/
+void QTextToSpeech::setFallbackEngines(const QStringList &engines)
+{
+    Q_D(QTextToSpeech);
+    const auto registry = QTextToSpeechPrivate::registry();
+    const auto priority = [&registry](const QString &engine) {
+        return registry->providers.value(engine).value(QStringLiteral("Priority")).toInteger();
+    };
+    QStringList fallbackEngines;
+    for (const QString &engine : engines) {
+        if (registry->providers.contains(engine) && !fallbackEngines.contains(engine))
+            fallbackEngines << engine;
+    }
+    std::stable_sort(fallbackEngines.begin(), fallbackEngines.end(),
+                     [&priority](const QString &left, const QString &right) {
+        return priority(left) > priority(right);
+    });
+    if (fallbackEngines == d->m_fallbackEngines)
+        return;
+
+    d->m_fallbackEngines = fallbackEngines;
+    d->prepareFallback();
+}
+
+/*!
+    \since 6.10
+
+    Returns the engines that this QTextToSpeech object fails over to, in the
+    order in which they are tried.
+
+    \sa setFallbackEngines()
+*/
+QStringList QTextToSpeech::fallbackEngines() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_fallbackEngines;
+}
+
+QString QTextToSpeech::engine() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_providerName;
+}
+
+/*!
+    \enum QTextToSpeech::Capability
+    \since 6.6
+    \brief This enum describes the capabilities of a text-to-speech engine.
+
+    \value None                 The engine implements none of the capabilities.
+    \value Speak                The engine can play audio output from text.
+    \value PauseResume          The engine can pause and then resume the audo output.
+    \value WordByWordProgress   The engine emits the sayingWord() signal for
+                                each word that gets spoken.
+    \value Synthesize           The engine can \l{synthesize()}{synthesize} PCM
+                                audio data from text.
+
+    \sa engineCapabilities()
+*/
+
+/*!
+    \qmlproperty enumeration TextToSpeech::engineCapabilities
+    \brief This property holds the capabilities implemented by the current engine.
+    \since 6.6
+
+    \sa engine, QTextToSpeech::Capability
+*/
+
+/*!
+    \property QTextToSpeech::engineCapabilities
+    \brief the capabilities implemented by the current engine
+    \since 6.6
+
+    \sa engine
+*/
+QTextToSpeech::Capabilities QTextToSpeech::engineCapabilities() const
+{
+    Q_D(const QTextToSpeech);
+
+    QTextToSpeech::Capabilities caps = d->m_engine
+                                     ? d->m_engine->capabilities()
+                                     : QTextToSpeech::Capability::None;
+    if (caps != QTextToSpeech::Capability::None)
+        return caps;
+    if (d->m_providerName.isEmpty()) {
+        qCritical() << "No engine set.";
+        return caps;
+    }
+
+    const QMetaEnum capEnum = QMetaEnum::fromType<QTextToSpeech::Capabilities>();
+    const auto plugin = QTextToSpeechPrivate::registry()->providers.value(d->m_providerName);
+    const auto capNames = plugin.value(QStringLiteral("Capabilities")).toArray();
+
+    // compatibility: plugins that don't set Features can only speak
+    if (capNames.isEmpty())
+        caps |= QTextToSpeech::Capability::Speak;
+
+    for (const auto capName : capNames) {
+        const auto capString = capName.toString().toUtf8();
+        bool ok = false;
+        const QTextToSpeech::Capability capFlag = QTextToSpeech::Capability(capEnum.keyToValue(capString, &ok));
+        if (!ok) {
+            qWarning("Unknown capability: '%s' doesn't map to any QTextToSpeech::Capability value",
+                     capString.constData());
+        } else {
+            caps |= capFlag;
+        }
+    }
+    return caps;
+}
+
+/*!
+    \qmlmethod list<string> TextToSpeech::availableEngines()
+
+    Holds the list of supported text-to-speech engine plug-ins.
+*/
+
+/*!
+    Gets the list of supported text-to-speech engine plug-ins.
+
+    \sa engine
+*/
+QStringList QTextToSpeech::availableEngines()
+{
+    return QTextToSpeechPrivate::registry()->providers.keys();
+}
+
+/*!
+    \qmlproperty enumeration TextToSpeech::state
+    \brief This property holds the current state of the speech synthesizer.
+
+    \sa QTextToSpeech::State say() stop() pause()
+
+    \snippet quickspeech/Main.qml stateChanged
+*/
+
+/*!
+    \property QTextToSpeech::state
+    \brief the current state of the speech synthesizer.
+
+    \snippet hello_speak/mainwindow.cpp stateChanged
+
+    Use \l say() to start synthesizing text with the current \l voice and \l locale.
+*/
+QTextToSpeech::State QTextToSpeech::state() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_state;
+}
+
+/*!
+    \qmlsignal TextToSpeech::aboutToSynthesize(number id)
+
+    \since 6.6
+
+    This signal gets emitted just before the engine starts to synthesize the
+    speech audio for \a id. Applications can use this signal to make last-minute
+    changes to \l voice attributes, or to track the process of text enqueued
+    via enqueue().
+
+    \sa enqueue(), voice
+*/
+
+/*!
+    \fn void QTextToSpeech::aboutToSynthesize(qsizetype id)
+    \since 6.6
+
+    This signal gets emitted just before the engine starts to synthesize the
+    speech audio for \a id. The \a id is the value returned by a call to enqueue(),
+    or -1 for text that is queued by synthesize().
+    Applications can use this signal to make last-minute changes to \l voice
+    attributes, or to track the process of text enqueued via enqueue().
+
+    \sa enqueue(), synthesize(), voice
+*/
+
+/*!
+    \qmlsignal TextToSpeech::sayingWord(string word, int id, int start, int length)
+    \since 6.6
 
-    Not every engine supports all features. Use the engineCapabilities()
-    function to test which features are available, and adjust the usage of the
-    type accordingly.
+    This signal is emitted when the \a word, which is the slice of text indicated
+    by \a start and \a length in the utterance \a id, gets played to the audio device.
 
-    \note Which locales and voices the engine supports depends usually on the Operating
-    System configuration. E.g. on macOS, end users can install voices through the
-    \e Accessibility panel in \e{System Preferences}.
+    \note This signal requires that the engine has the
+    \l {QTextToSpeech::Capability::}{WordByWordProgress} capability.
+
+    The following code highlights the word that is spoken in a TextArea \c input:
+    \snippet quickspeech/Main.qml sayingWord
+
+    \sa QTextToSpeech::Capability, say()
 */
 
 /*!
-    \enum QTextToSpeech::State
+    \fn void QTextToSpeech::sayingWord(const QString &word, qsizetype id, qsizetype start, qsizetype length)
+    \since 6.6
 
-    \brief This enum describes the current state of the text-to-speech engine.
+    This signal is emitted when the \a word, which is the slice of text indicated
+    by \a start and \a length in the utterance \a id, gets played to the audio device.
 
-    \value Ready        The synthesizer is ready to start a new text. This is
-                        also the state after a text was finished.
-    \value Speaking     Text is being spoken.
-    \value Synthesizing Text is being synthesized into PCM data. The synthesized()
-                        signal will be emitted with chunks of data.
-    \value Paused       The synthesis was paused and can be resumed with \l resume().
-    \value Error        An error has occurred. Details are given by \l errorReason().
+    \note This signal requires that the engine has the
+    \l {QTextToSpeech::Capability::}{WordByWordProgress} capability.
 
-    \sa QTextToSpeech::ErrorReason errorReason() errorString()
+    \sa Capability, say()
 */
 
 /*!
-    \enum QTextToSpeech::ErrorReason
+    \fn void QTextToSpeech::synthesizedWord(const QString &word, qsizetype id, qsizetype start, qsizetype length, qint64 position)
+    \since 6.10
 
-    \brief This enum describes the current error, if any, of the QTextToSpeech engine.
+    This signal is emitted while the utterance \a id is synthesized, for the
+    \a word that is the slice of text indicated by \a start and \a length. The
+    \a position is the time, in microseconds, at which the word starts in the
+    audio of the utterance. Use QAudioFormat::framesForDuration() to get the
+    offset in the audio data.
 
-    \value NoError          No error has occurred.
-    \value Initialization   The backend could not be initialized, e.g. due to
-                            a missing driver or operating system requirement.
-    \value Configuration    The given backend configuration is inconsistent, e.g.
-                            due to wrong voice name or parameters.
-    \value Input            The given text could not be synthesized, e.g. due to
-                            invalid size or characters.
-    \value Playback         Audio playback failed e.g. due to missing audio device,
-                            wrong format or audio streaming interruption.
+    The signal might be emitted before or after the audio that contains the
+    word gets delivered to the synthesize() functor. Engines that can't report
+    the timing of words don't emit the signal.
 
-    Use \l errorReason() to obtain the current error and \l errorString() to get the
-    related error message.
+    \sa synthesize(), sayingWord()
+*/
+
+/*!
+    \qmlsignal void TextToSpeech::errorOccurred(enumeration reason, string errorString)
+
+    This signal is emitted after an error occurred and the \l state has been set to
+    \c TextToSpeech.Error. The \a reason parameter specifies the type of error,
+    and the \a errorString provides a human-readable error description.
+
+    \sa state errorReason(), errorString()
+*/
+
+/*!
+    \fn void QTextToSpeech::errorOccurred(QTextToSpeech::ErrorReason reason, const QString &errorString)
+
+    This signal is emitted after an error occurred and the \l state has been set to
+    QTextToSpeech::Error. The \a reason parameter specifies the type of error,
+    and the \a errorString provides a human-readable error description.
+
+    QTextToSpeech::ErrorReason is not a registered metatype, so for queued
+    connections, you will have to register it with Q_DECLARE_METATYPE() and
+    qRegisterMetaType().
+
+    \sa errorReason(), errorString(), {Creating Custom Qt Types}
+*/
+
+/*!
+    \qmlmethod enumeration TextToSpeech::errorReason()
+    \return the reason why the engine has reported an error.
+
+    \sa QTextToSpeech::ErrorReason
+*/
+
+/*!
+    \return the reason why the engine has reported an error.
+
+    \sa state errorOccurred()
+*/
+QTextToSpeech::ErrorReason QTextToSpeech::errorReason() const
+{
+    Q_D(const QTextToSpeech);
+    if (d->m_engine)
+        return d->m_engine->errorReason();
+    return QTextToSpeech::ErrorReason::Initialization;
+}
+
+/*!
+    \qmlmethod string TextToSpeech::errorString()
+    \return the current engine error message.
+*/
+
+/*!
+    \return the current engine error message.
 
     \sa errorOccurred()
 */
+QString QTextToSpeech::errorString() const
+{
+    Q_D(const QTextToSpeech);
+    if (d->m_engine)
+        return d->m_engine->errorString();
+    return tr("Text to speech engine not initialized");
+}
 
 /*!
-    \enum QTextToSpeech::BoundaryHint
+    \qmlmethod TextToSpeech::say(string text)
 
-    \brief describes when speech should be stopped and paused.
+    Starts synthesizing the \a text.
 
-    \value Default          Uses the engine specific default behavior.
-    \value Immediate        The engine should stop playback immediately.
-    \value Word             Stop speech when the current word is finished.
-    \value Sentence         Stop speech when the current sentence is finished.
-    \value [since 6.6] Utterance
-                            Stop speech when the current utterance is finished.
-                            An utterance is the block of text used in a call to
-                            say() or enqueue().
+    This function starts sythesizing the speech asynchronously, and reads the text to the
+    default audio output device.
 
-    \note These are hints to the engine. The current engine might not support
-    all options.
+    \snippet quickspeech/Main.qml say0
+    \snippet quickspeech/Main.qml say1
+
+    \note All in-progress readings are stopped before beginning to read the recently
+    synthesized text.
+
+    The current state is available using the \l state property, and is
+    set to \l {QTextToSpeech::Speaking} once the reading starts. When the reading is done,
+    \l state will be set to \l {QTextToSpeech::Ready}.
+
+    \sa stop(), pause(), resume()
 */
 
 /*!
-    Loads a text-to-speech engine from a plug-in that uses the default
-    engine plug-in and constructs a QTextToSpeech object as the child
-    of \a parent.
+    Starts speaking the \a text.
 
-    The default engine is platform-specific.
+    This function starts sythesizing the speech asynchronously, and reads the text to the
+    default audio output device.
 
-    If the engine initializes correctly, then the \l state of the engine will
-    change to QTextToSpeech::Ready; note that this might happen asynchronously.
-    If the plugin fails to load, then \l state will be set to QTextToSpeech::Error.
+    \snippet hello_speak/mainwindow.cpp say
 
-    \sa availableEngines()
+    \note All in-progress readings are stopped before beginning to read the recently
+    synthesized text.
+
+    The current state is available using the \l state property, and is
+    set to \l Speaking once the reading starts. When the reading is done,
+    \l state will be set to \l Ready.
+
+    \sa enqueue(), stop(), pause(), resume(), synthesize()
 */
-QTextToSpeech::QTextToSpeech(QObject *parent)
-    : QTextToSpeech(QString(), QVariantMap(), parent)
+void QTextToSpeech::say(const QString &text)
 {
+    Q_D(QTextToSpeech);
+    d->cancelSpoken();
+    d->resetStream();
+    d->m_pendingUtterances = {};
+    d->m_utteranceCounter = 1;
+    d->m_preemptHint.reset();
+    if (d->m_engine) {
+        Q_TRACE(QTextToSpeech_aboutToSynthesize, 0);
+        emit aboutToSynthesize(0);
+        d->startUtterance({text, 0, Priority::Normal});
+    }
 }
 
 /*!
-    Loads a text-to-speech engine from a plug-in that matches parameter \a engine and
-    constructs a QTextToSpeech object as the child of \a parent.
+    \qmlmethod TextToSpeech::enqueue(string utterance)
+    \since 6.6
 
-    If \a engine is empty, the default engine plug-in is used. The default
-    engine is platform-specific.
+    Adds \a utterance to the queue of text to be spoken, and starts speaking.
 
-    If the engine initializes correctly, the \l state of the engine will be set
-    to QTextToSpeech::Ready. If the plugin fails to load, or if the engine fails to
-    initialize, the engine's \l state will be set to QTextToSpeech::Error.
+    If the engine's \l state is currently \c Ready, \a utterance will be spoken
+    immediately. Otherwise, the engine will start to speak \a utterance once it
+    has finished speaking the current text.
 
-    \sa availableEngines()
+    Each time the engine proceeds to the next text entry in the queue, the
+    aboutToSynthesize() signal gets emitted. This allows applications to keep
+    track of the progress, and to make last-minute changes to voice attributes.
+
+    Calling stop() clears the queue.
+
+    \sa say(), stop(), aboutToSynthesize()
 */
-QTextToSpeech::QTextToSpeech(const QString &engine, QObject *parent)
-    : QTextToSpeech(engine, QVariantMap(), parent)
+
+/*!
+    \since 6.6
+
+    Adds \a utterance to the queue of texts to be spoken, and starts speaking.
+    Returns the index of the text in the queue, or -1 in case of an error.
+
+    If the engine's \l state is currently \c Ready, \a utterance will be spoken
+    immediately. Otherwise, the engine will start to speak \a utterance once it
+    has finished speaking the current text.
+
+    Each time the engine proceeds to the next text entry in the queue, the
+    aboutToSynthesize() signal gets emitted. This allows applications to keep
+    track of the progress, and to make last-minute changes to voice attributes.
+
+    Calling stop() clears the queue. To pause the engine at the end of a text,
+    use the \l {QTextToSpeech::BoundaryHint::}{Utterance} boundary hint.
+
+    \sa say(), stop(), aboutToSynthesize(), synthesize()
+*/
+qsizetype QTextToSpeech::enqueue(const QString &utterance)
 {
+    return enqueue(utterance, Priority::Normal);
 }
 
 /*!
-    \since 6.4
+    \since 6.10
+    \overload
 
-    Loads a text-to-speech engine from a plug-in that matches parameter \a engine and
-    constructs a QTextToSpeech object as the child of \a parent, passing \a params
-    through to the engine.
+    Adds \a utterance with \a priority to the queue of texts to be spoken, and
+    starts speaking. Returns the index of the text in the queue, or -1 in case
+    of an error.
 
-    If \a engine is empty, the default engine plug-in is used. The default
-    engine is platform-specific. Which key/value pairs in \a params are supported
-    depends on the engine. See \l{Qt TextToSpeech Engines}{the engine documentation}
-    for details. Unsupported entries will be ignored.
+    The engine speaks queued texts with higher priority first. Texts with the
+    same priority are spoken in the order in which they were enqueued.
 
-    If the engine initializes correctly, the \l state of the engine will be set
-    to QTextToSpeech::Ready. If the plugin fails to load, or if the engine fails to
-    initialize, the engine's \l state will be set to QTextToSpeech::Error.
+    If the current text has lower priority than \a priority, then the engine
+    stops speaking it at \a boundaryHint, speaks \a utterance, and then
+    continues with the rest of the interrupted text. The sayingWord() signal
+    reports words of the continued text at their position in the original text.
+    With the default \l {QTextToSpeech::BoundaryHint::}{Utterance} boundary
+    hint, the current text is always spoken to its end.
 
-    \sa availableEngines()
+    The priority only changes the order when texts are synthesized, the
+    current text is not interrupted.
+
+    \sa say(), stop(), aboutToSynthesize()
 */
-QTextToSpeech::QTextToSpeech(const QString &engine, const QVariantMap &params, QObject *parent)
-    : QObject(*new QTextToSpeechPrivate(this), parent)
+qsizetype QTextToSpeech::enqueue(const QString &utterance, Priority priority,
+                                 BoundaryHint boundaryHint)
 {
     Q_D(QTextToSpeech);
-    // allow QDeclarativeTextToSpeech to skip initialization until the component
-    // is complete
-    if (engine != u"none"_s)
-        d->setEngineProvider(engine, params);
-    else
-        d->m_providerName = engine;
+    if (!d->m_engine || utterance.isEmpty() || d->m_engine->state() == QTextToSpeech::Error)
+        return -1;
+
+    return d->enqueueText({utterance, d->m_utteranceCounter++, priority}, boundaryHint);
 }
 
 /*!
-    Destroys this QTextToSpeech object, stopping any speech.
+    \since 6.10
+    \overload
+
+    Adds the parts of \a document in \a ranges with \a priority to the queue
+    of texts to be spoken, and starts speaking. Each range is a pair of the
+    position and the length of a part of \a document, and is spoken as one
+    text. Returns the indexes of the texts in the queue, in the order of
+    \a ranges, or an empty list in case of an error, or if one of the ranges
+    is empty or not within \a document.
+
+    Use this function to speak a long document in parts, for instance one
+    paragraph at a time. QString is implicitly shared, so the queue keeps a
+    single reference to \a document instead of a copy of each part. The
+    sayingWord() signal reports the words at their position in \a document.
+
+    Each range is enqueued like with enqueue(), using \a boundaryHint if the
+    current text has lower priority.
+
+    \sa aboutToSynthesize(), stop()
 */
-QTextToSpeech::~QTextToSpeech()
+QList<qsizetype> QTextToSpeech::enqueue(const QString &document,
+                                        const QList<std::pair<qsizetype, qsizetype>> &ranges,
+                                        Priority priority, BoundaryHint boundaryHint)
+{
+    Q_D(QTextToSpeech);
+    if (!d->m_engine || d->m_engine->state() == QTextToSpeech::Error)
+        return {};
+    for (const auto &[start, length] : ranges) {
+        if (start < 0 || length <= 0 || start > document.size() - length) {
+            qWarning() << "Cannot enqueue range" << start << length << "of a text of length"
+                       << document.size();
+            return {};
+        }
+    }
+
+    QList<qsizetype> ids;
+    ids.reserve(ranges.size());
+    for (const auto &[start, length] : ranges) {
+        QTextToSpeechPrivate::Utterance utterance{document, d->m_utteranceCounter++, priority, start};
+        utterance.length = length;
+        ids << d->enqueueText(std::move(utterance), boundaryHint);
+    }
+    return ids;
+}
+
+/*
+    Starts speaking \a utterance if the engine is ready, or adds it to the
+    pending utterances, interrupting the current utterance at \a boundaryHint
+    if that has lower priority. Returns the id of the utterance.
+*/
+qsizetype QTextToSpeechPrivate::enqueueText(Utterance &&utterance,
+                                            QTextToSpeech::BoundaryHint boundaryHint)
 {
-    stop(QTextToSpeech::BoundaryHint::Immediate);
+    Q_Q(QTextToSpeech);
+    const QTextToSpeech::State engineState = speakingState();
+    const qsizetype id = utterance.id;
+    const QTextToSpeech::Priority priority = utterance.priority;
+    Q_TRACE(QTextToSpeech_enqueue, id,
+            utterance.length < 0 ? utterance.text.size() : utterance.length, int(priority));
+    if (engineState == QTextToSpeech::Ready) {
+        Q_TRACE(QTextToSpeech_aboutToSynthesize, id);
+        emit q->aboutToSynthesize(id);
+        startUtterance(utterance);
+    } else {
+        enqueueUtterance(std::move(utterance));
+        prefetchPending();
+        if (engineState == QTextToSpeech::Speaking && m_state == QTextToSpeech::Speaking
+            && priority > m_currentPriority
+            && boundaryHint != QTextToSpeech::BoundaryHint::Utterance) {
+            preempt(boundaryHint);
+        }
+    }
+    return id;
 }
 
 /*!
-    \qmlproperty string TextToSpeech::engine
-
-    The engine used to synthesize text to speech.
+    \since 6.10
 
-    Changing the engine stops any ongoing speech.
+    Appends \a text to the text that is spoken as one utterance, and returns
+    the utterance's index in the queue, or -1 in case of an error.
 
-    On most platforms, changing the engine will update the list of
-    \l{availableLocales()}{available locales} and \l{availableVoices()}{available voices}.
-*/
+    Use this function to speak text that becomes available in pieces, for
+    instance while it is downloaded. As soon as the appended text completes a
+    sentence, that sentence gets enqueued, and the engine starts speaking it if
+    it is \l Ready. Text that might be continued by the next call is kept until
+    more text is appended, or until finishText() is called.
 
-/*!
-    \property QTextToSpeech::engine
-    \brief the engine used to synthesize text to speech.
-    \since 6.4
+    The sayingWord() signal reports all words of the utterance at their position
+    in all text appended since the utterance started. aboutToSynthesize() is
+    emitted for each sentence. If the engine has spoken all complete sentences
+    before more text is appended, the \l state becomes \l Ready in between.
 
-    Changing the engine stops any ongoing speech.
+    Calling say() or stop() discards the text that has not been enqueued yet,
+    and the next call starts a new utterance.
 
-    On most platforms, changing the engine will update the list of
-    \l{availableLocales()}{available locales} and \l{availableVoices()}{available voices}.
+    \sa finishText(), enqueue()
 */
+qsizetype QTextToSpeech::appendText(const QString &text)
+{
+    Q_D(QTextToSpeech);
+    if (!d->m_engine || d->m_engine->state() == QTextToSpeech::Error)
+        return -1;
+
+    if (d->m_streamId < 0)
+        d->m_streamId = d->m_utteranceCounter++;
+    d->m_streamText += text;
+    d->enqueueStreamed(false);
+    return d->m_streamId;
+}
 
 /*!
-    \since 6.4
-    Sets the engine used by this QTextToSpeech object to \a engine, passing
-    \a params through to the engine constructor.
+    \since 6.10
 
-    \return whether \a engine could be set successfully.
+    Enqueues the rest of the text that was appended with appendText(), and ends
+    the utterance. The next call to appendText() starts a new utterance.
 
-    Which key/value pairs in \a params are supported depends on the engine.
-    See \l{Qt TextToSpeech Engines}{the engine documentation} for details.
-    Unsupported entries will be ignored.
+    \sa appendText()
 */
-bool QTextToSpeech::setEngine(const QString &engine, const QVariantMap &params)
+void QTextToSpeech::finishText()
 {
     Q_D(QTextToSpeech);
-    if (d->m_providerName == engine && params.isEmpty())
-        return true;
+    if (d->m_streamId < 0)
+        return;
+    if (d->m_engine)
+        d->enqueueStreamed(true);
+    d->resetStream();
+}
 
-    // read values from the old engine
-    if (d->m_engine) {
-        d->m_storedPitch = d->m_engine->pitch();
-        d->m_storedRate = d->m_engine->rate();
-        d->m_storedVolume = d->m_engine->volume();
-    }
+/*!
+    \fn template<typename Functor> void QTextToSpeech::synthesize(
+            const QString &text, Functor &&functor)
+    \fn template<typename Functor> void QTextToSpeech::synthesize(
+            const QString &text, const QObject *context, Functor &&functor)
+    \since 6.6
 
-    d->setEngineProvider(engine, params);
+    Synthesizes the \a text into raw audio data.
 
-    emit engineChanged(d->m_providerName);
-    d->updateState(d->m_engine ? d->m_engine->state()
-                               : QTextToSpeech::Error);
+    This function synthesizes the speech asynchronously into raw audio data.
+    When data is available, the \a functor will be called as
+    \c {functor(QAudioFormat format, QByteArray bytes)}, with \c format
+    describing the \l {QAudioFormat}{format} of the data in \c bytes;
+    or as \c {functor(QAudioBuffer &buffer)}.
 
-    // Restore values from the previous engine, or from
-    // property setters before the engine was initialized.
-    if (d->m_engine) {
-        if (!qIsNaN(d->m_storedPitch))
-            d->m_engine->setPitch(d->m_storedPitch);
-        if (!qIsNaN(d->m_storedRate))
-            d->m_engine->setRate(d->m_storedRate);
-        if (!qIsNaN(d->m_storedVolume))
-            d->m_engine->setVolume(d->m_storedVolume);
+    The \l state property is set to \l Synthesizing when the synthesis starts,
+    and to \l Ready once the synthesis is finished. While synthesizing, the
+    \a functor might be called multiple times, possibly with changing values
+    for \c format.
 
-        // setting the engine might have changed these values
-        if (double realPitch = pitch(); d->m_storedPitch != realPitch)
-            emit pitchChanged(realPitch);
-        if (double realRate = rate(); d->m_storedRate != realRate)
-            emit rateChanged(realRate);
-        if (double realVolume = volume(); d->m_storedVolume != realVolume)
-            emit volumeChanged(realVolume);
+    The \a functor can be a callable, like a lambda or free function, with an
+    optional \a context object:
 
-        emit localeChanged(locale());
-        emit voiceChanged(voice());
-    }
-    return d->m_engine.get();
-}
+    \code
+    tts.synthesize("Hello world", [](const QAudioFormat &format, const QByteArray &bytes){
+        // process data according to format
+    });
+    \endcode
 
-QString QTextToSpeech::engine() const
-{
-    Q_D(const QTextToSpeech);
-    return d->m_providerName;
-}
+    or a member function of the \a context object:
 
-/*!
-    \enum QTextToSpeech::Capability
-    \since 6.6
-    \brief This enum describes the capabilities of a text-to-speech engine.
+    \code
+    struct PCMProcessor : QObject
+    {
+        void processData(const QAudioFormat &format, const QByteArray &bytes)
+        {
+            // process data according to format
+        }
+    } processor;
+    tts.synthesize("Hello world", &processor, &PCMProcessor::processData);
+    \endcode
 
-    \value None                 The engine implements none of the capabilities.
-    \value Speak                The engine can play audio output from text.
-    \value PauseResume          The engine can pause and then resume the audo output.
-    \value WordByWordProgress   The engine emits the sayingWord() signal for
-                                each word that gets spoken.
-    \value Synthesize           The engine can \l{synthesize()}{synthesize} PCM
-                                audio data from text.
+    If \a context is destroyed, then the \a functor will no longer get called.
 
-    \sa engineCapabilities()
+    \note This API requires that the engine has the
+    \l {QTextToSpeech::Capability::}{Synthesize} capability.
+
+    \sa say(), stop()
 */
 
 /*!
-    \qmlproperty enumeration TextToSpeech::engineCapabilities
-    \brief This property holds the capabilities implemented by the current engine.
-    \since 6.6
+    \internal
 
-    \sa engine, QTextToSpeech::Capability
+    Calls \a slotObj on the \a context object with the audio that the engine
+    synthesizes for \a text. The slot object is released once all audio for
+    \a text has been delivered. Texts that are synthesized while the engine is
+    busy are queued, and keep their own slot object.
 */
+void QTextToSpeech::synthesizeImpl(const QString &text,
+                                   QtPrivate::QSlotObjectBase *slotObj, const QObject *context,
+                                   SynthesizeOverload overload)
+{
+    Q_D(QTextToSpeech);
+    Q_ASSERT(slotObj);
+    auto receiver = std::make_shared<QTextToSpeechSynthesisReceiver>();
+    receiver->context = const_cast<QObject *>(context);
+    receiver->hasContext = context != nullptr;
+    receiver->received = [slotObj, context, overload](const QAudioFormat &format,
+                                                      const QByteArray &bytes){
+        if (overload == SynthesizeOverload::AudioBuffer) {
+            const QAudioBuffer buffer(bytes, format);
+            void *args[] = {nullptr, const_cast<QAudioBuffer *>(&buffer)};
+            slotObj->call(const_cast<QObject *>(context), args);
+        } else {
+            void *args[] = {nullptr,
+                            const_cast<QAudioFormat *>(&format),
+                            const_cast<QByteArray *>(&bytes)};
+            slotObj->call(const_cast<QObject *>(context), args);
+        }
+    };
+    receiver->released = [slotObj]{ slotObj->destroyIfLastRef(); };
+
+    d->startSynthesis(text, std::move(receiver));
+}
 
 /*!
-    \property QTextToSpeech::engineCapabilities
-    \brief the capabilities implemented by the current engine
-    \since 6.6
+    \since 6.10
 
-    \sa engine
+    Synthesizes all \a texts, one after the other, and returns a future that
+    provides the audio of each text as a QAudioBuffer.
+
+    The result at index \c i of the future is the audio for the text at index
+    \c i of \a texts. Results become available in order, once the complete
+    text has been synthesized, and the progress value of the future is the
+    number of texts that are done. Empty texts result in an empty buffer.
+
+    The texts are synthesized through the same queue as texts passed to
+    synthesize(), so several batches and calls to synthesize() can be in
+    progress at the same time without affecting each other's audio. Canceling
+    the future removes the remaining texts of the batch from the queue, and
+    stops the engine if it is synthesizing one of them.
+
+    If the engine does not have the \l {QTextToSpeech::Capability::}{Synthesize}
+    capability, then the returned future is canceled. Calling stop() finishes
+    the future with the results that are available.
+
+    \sa synthesize(), setSynthesizeFormat()
 */
-QTextToSpeech::Capabilities QTextToSpeech::engineCapabilities() const
+QFuture<QAudioBuffer> QTextToSpeech::synthesizeBatch(const QStringList &texts)
 {
-    Q_D(const QTextToSpeech);
-
-    QTextToSpeech::Capabilities caps = d->m_engine
-                                     ? d->m_engine->capabilities()
-                                     : QTextToSpeech::Capability::None;
-    if (caps != QTextToSpeech::Capability::None)
-        return caps;
-    if (d->m_providerName.isEmpty()) {
-        qCritical() << "No engine set.";
-        return caps;
+    Q_D(QTextToSpeech);
+    struct Batch
+    {
+        QPromise<QAudioBuffer> promise;
+        // indexes of the texts that still have to be synthesized
+        QList<qsizetype> pending;
+        QAudioFormat format;
+        QByteArray data;
+        int done = 0;
+        bool canceling = false;
+    };
+    auto batch = std::make_shared<Batch>();
+    QFuture<QAudioBuffer> future = batch->promise.future();
+    batch->promise.start();
+    if (!d->m_engine || !(engineCapabilities() & QTextToSpeech::Capability::Synthesize)) {
+        future.cancel();
+        batch->promise.finish();
+        return future;
     }
 
-    const QMetaEnum capEnum = QMetaEnum::fromType<QTextToSpeech::Capabilities>();
-    const auto plugin = QTextToSpeechPrivate::plugins().value(d->m_providerName);
-    const auto capNames = plugin.value(QStringLiteral("Capabilities")).toArray();
+    batch->promise.setProgressRange(0, int(texts.size()));
+    for (qsizetype i = 0; i < texts.size(); ++i) {
+        if (texts.at(i).isEmpty())
+            batch->promise.addResult(QAudioBuffer(), int(i));
+        else
+            batch->pending.append(i);
+    }
+    batch->done = int(texts.size() - batch->pending.size());
+    batch->promise.setProgressValue(batch->done);
+    if (batch->pending.isEmpty()) {
+        batch->promise.finish();
+        return future;
+    }
 
-    // compatibility: plugins that don't set Features can only speak
-    if (capNames.isEmpty())
-        caps |= QTextToSpeech::Capability::Speak;
+    auto receiver = std::make_shared<QTextToSpeechSynthesisReceiver>();
+    receiver->context = this;
+    receiver->hasContext = true;
+    const auto cancel = [d, batch, weakReceiver = std::weak_ptr(receiver)]{
+        if (!std::exchange(batch->canceling, true))
+            d->cancelReceiverLater(weakReceiver);
+    };
+    receiver->received = [batch, cancel](const QAudioFormat &format, const QByteArray &bytes){
+        if (batch->promise.isCanceled()) {
+            cancel();
+            return;
+        }
+        // a QAudioBuffer has only one format
+        if (batch->data.isEmpty())
+            batch->format = format;
+        if (format == batch->format)
+            batch->data += bytes;
+    };
+    receiver->finished = [batch, cancel]{
+        if (batch->promise.isCanceled()) {
+            cancel();
+            return;
+        }
+        if (batch->pending.isEmpty())
+            return;
+        const qsizetype index = batch->pending.takeFirst();
+        batch->promise.addResult(QAudioBuffer(std::exchange(batch->data, {}), batch->format),
+                                 int(index));
+        batch->promise.setProgressValue(++batch->done);
+    };
+    receiver->released = [batch]{ batch->promise.finish(); };
 
-    for (const auto capName : capNames) {
-        const auto capString = capName.toString().toUtf8();
-        bool ok = false;
-        const QTextToSpeech::Capability capFlag = QTextToSpeech::Capability(capEnum.keyToValue(capString, &ok));
-        if (!ok) {
-            qWarning("Unknown capability: '%s' doesn't map to any QTextToSpeech::Capability value",
-                     capString.constData());
+    // queue all, as the engine might only change its state later
+    bool first = true;
+    for (const qsizetype index : std::as_const(batch->pending)) {
+        if (std::exchange(first, false)) {
+            d->startSynthesis(texts.at(index), receiver);
         } else {
-            caps |= capFlag;
+            d->enqueueUtterance({texts.at(index), -1, QTextToSpeech::Priority::Normal, 0,
+                                 receiver});
         }
     }
-    return caps;
+    return future;
 }
 
 /*!
-    \qmlmethod list<string> TextToSpeech::availableEngines()
+    \since 6.10
 
-    Holds the list of supported text-to-speech engine plug-ins.
+    Synthesizes \a text, and returns a future that provides the audio as it
+    is produced.
+
+    Each chunk of audio that the engine produces is added as a result to the
+    future, in order, so a QFutureWatcher reports them through its
+    \l{QFutureWatcher::}{resultReadyAt()} signal. The future is finished once
+    all audio for \a text has been delivered. Continuations attached with
+    QFuture::then() run when the synthesis is done, without having to connect
+    to the stateChanged() signal.
+
+    As with synthesize(), the text is queued if the engine is synthesizing
+    other text. Canceling the future stops the synthesis of \a text.
+
+    If the engine does not have the \l {QTextToSpeech::Capability::}{Synthesize}
+    capability, then the returned future is canceled.
+
+    \sa synthesize(), synthesizeBatch(), sayAsync()
 */
+QFuture<QAudioBuffer> QTextToSpeech::synthesizeAsync(const QString &text)
+{
+    Q_D(QTextToSpeech);
+    struct Synthesis
+    {
+        QPromise<QAudioBuffer> promise;
+        bool done = false;
+        bool canceling = false;
+    };
+    auto synthesis = std::make_shared<Synthesis>();
+    QFuture<QAudioBuffer> future = synthesis->promise.future();
+    synthesis->promise.start();
+    if (!d->m_engine || !(engineCapabilities() & QTextToSpeech::Capability::Synthesize)) {
+        future.cancel();
+        synthesis->promise.finish();
+        return future;
+    }
+    if (text.isEmpty()) {
+        synthesis->promise.finish();
+        return future;
+    }
+
+    auto receiver = std::make_shared<QTextToSpeechSynthesisReceiver>();
+    receiver->context = this;
+    receiver->hasContext = true;
+    receiver->received = [d, synthesis, weakReceiver = std::weak_ptr(receiver)]
+                         (const QAudioFormat &format, const QByteArray &bytes){
+        if (synthesis->done)
+            return;
+        if (synthesis->promise.isCanceled()) {
+            if (!std::exchange(synthesis->canceling, true))
+                d->cancelReceiverLater(weakReceiver);
+            return;
+        }
+        synthesis->promise.addResult(QAudioBuffer(bytes, format));
+    };
+    // texts enqueued while synthesizing might follow with the same receiver
+    receiver->finished = [synthesis]{
+        if (!std::exchange(synthesis->done, true))
+            synthesis->promise.finish();
+    };
+    receiver->released = [synthesis]{
+        if (!std::exchange(synthesis->done, true))
+            synthesis->promise.finish();
+    };
+    d->startSynthesis(text, std::move(receiver));
+    return future;
+}
 
 /*!
-    Gets the list of supported text-to-speech engine plug-ins.
+    \since 6.10
 
-    \sa engine
+    Speaks \a text like say(), and returns a future that is finished once the
+    engine has spoken the complete text.
+
+    The future is canceled if the speech is stopped before it is complete,
+    with stop() or say(), or if the engine fails. Pausing does not affect the
+    future.
+
+    \sa say(), synthesizeAsync()
 */
-QStringList QTextToSpeech::availableEngines()
+QFuture<void> QTextToSpeech::sayAsync(const QString &text)
 {
-    return QTextToSpeechPrivate::plugins().keys();
+    Q_D(QTextToSpeech);
+    auto promise = std::make_shared<QPromise<void>>();
+    QFuture<void> future = promise->future();
+    promise->start();
+    say(text);
+    if (!d->m_engine || text.isEmpty() || d->m_engine->state() == QTextToSpeech::Error) {
+        future.cancel();
+        promise->finish();
+        return future;
+    }
+    // say() always speaks as the first utterance
+    d->m_spokenPromises.insert(0, std::move(promise));
+    return future;
 }
 
 /*!
-    \qmlproperty enumeration TextToSpeech::state
-    \brief This property holds the current state of the speech synthesizer.
+    \enum QTextToSpeech::OutputFormat
+    \since 6.10
 
-    \sa QTextToSpeech::State say() stop() pause()
+    This enum describes how synthesizeToDevice() writes the audio data.
 
-    \snippet quickspeech/Main.qml stateChanged
+    \value RawPcm  The PCM data is written as it is produced by the engine,
+                   without any header.
+    \value Wav     The PCM data is written as a WAV file.
 */
 
 /*!
-    \property QTextToSpeech::state
-    \brief the current state of the speech synthesizer.
+    \since 6.10
 
-    \snippet hello_speak/mainwindow.cpp stateChanged
+    Synthesizes the \a text, and writes the audio data to \a device, using the
+    output \a format. Returns \c false if \a device is not open for writing, or
+    if the engine does not support synthesizing.
 
-    Use \l say() to start synthesizing text with the current \l voice and \l locale.
+    The data is written to \a device as the engine produces it, so the complete
+    audio is never kept in memory. With the \l{OutputFormat::}{Wav} format, the
+    sizes in the WAV header are updated when the synthesis is finished if
+    \a device supports random access. For sequential devices, such as sockets,
+    the header uses the maximum size, as is common for streamed WAV data.
+
+    As with synthesize(), the \l state property changes to \l Synthesizing, and
+    back to \l Ready once all data has been written. If \a device is destroyed
+    before that, then the remaining data is discarded.
+
+    \note The Wav format requires that the format of the data does not change
+    during the synthesis. Data in a different format is dropped.
+
+    \sa synthesize()
 */
-QTextToSpeech::State QTextToSpeech::state() const
+bool QTextToSpeech::synthesizeToDevice(const QString &text, QIODevice *device,
+                                       QTextToSpeech::OutputFormat format)
 {
-    Q_D(const QTextToSpeech);
-    return d->m_state;
+    Q_D(QTextToSpeech);
+    if (!device || !device->isWritable()) {
+        qWarning() << "QTextToSpeech::synthesizeToDevice: device not open for writing";
+        return false;
+    }
+    if (!(engineCapabilities() & QTextToSpeech::Capability::Synthesize))
+        return false;
+
+    auto writer = std::make_shared<QTextToSpeechDeviceWriter>(device, format);
+    auto receiver = std::make_shared<QTextToSpeechSynthesisReceiver>();
+    receiver->context = device;
+    receiver->hasContext = true;
+    receiver->received = [writer](const QAudioFormat &format, const QByteArray &bytes) {
+        writer->write(format, bytes);
+    };
+    receiver->released = [writer]{ writer->finish(); };
+    d->startSynthesis(text, std::move(receiver));
+    return true;
 }
 
 /*!
-    \qmlsignal TextToSpeech::aboutToSynthesize(number id)
+    \since 6.10
+
+    Synthesizes \a text in the background, and stores the audio in the audio
+    cache. Returns \c false if the text cannot be prefetched, in particular if
+    the audio cache is disabled.
+
+    Later calls to synthesize(), synthesizeToDevice(), say(), or enqueue() with
+    the same text, and with the voice, rate, pitch, and volume that were set
+    when prefetch() was called, use the audio from the cache without delay.
+    Applications can use this to prepare texts that will be needed soon, for
+    instance the next items in a playlist, while the current item is being
+    processed.
+
+    Prefetching uses a second instance of the engine, which is created in the
+    background with the same parameters when prefetch() is called for the
+    first time. With the \c sharedEngine parameter, the shared instance is
+    used instead, taking turns with the QTextToSpeech objects that share it.
+    The state of this QTextToSpeech object is not affected. Texts are
+    prefetched in the order in which this function is called, and the amount
+    of audio that is kept is limited by the audioCacheLimit().
+
+    Prefetching requires that the engine has the
+    \l {QTextToSpeech::Capability::}{Synthesize} capability, and that the audio
+    cache is enabled with setAudioCacheLimit() or setAudioCacheDirectory().
+
+    Texts that are queued while the engine is busy are prefetched
+    automatically, up to the prefetchDepth().
+
+    \sa setAudioCacheLimit(), synthesize(), setPrefetchDepth()
+*/
+bool QTextToSpeech::prefetch(const QString &text)
+{
+    Q_D(QTextToSpeech);
+    if (!d->m_engine || text.isEmpty()
+        || !(engineCapabilities() & QTextToSpeech::Capability::Synthesize)) {
+        return false;
+    }
+    return d->prefetch(text);
+}
 
-    \since 6.6
+/*!
+    \since 6.10
 
-    This signal gets emitted just before the engine starts to synthesize the
-    speech audio for \a id. Applications can use this signal to make last-minute
-    changes to \l voice attributes, or to track the process of text enqueued
-    via enqueue().
+    Returns how many of the queued texts are prefetched automatically. The
+    default is 1.
 
-    \sa enqueue(), voice
+    \sa setPrefetchDepth(), prefetch()
 */
+int QTextToSpeech::prefetchDepth() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_prefetchDepth;
+}
 
 /*!
-    \fn void QTextToSpeech::aboutToSynthesize(qsizetype id)
-    \since 6.6
+    \since 6.10
 
-    This signal gets emitted just before the engine starts to synthesize the
-    speech audio for \a id. The \a id is the value returned by a call to enqueue(),
-    Applications can use this signal to make last-minute changes to \l voice
-    attributes, or to track the process of text enqueued via enqueue().
+    Sets how many of the queued texts are prefetched automatically to \a depth.
 
-    \sa enqueue(), synthesize(), voice
-*/
+    When synthesize(), synthesizeToDevice(), or enqueue() is called while the
+    engine is busy, the text is queued. The first \a depth queued texts are
+    then prefetched like with prefetch(), so that each text is synthesized in
+    the background while the previous one is processed, and taken from the
+    audio cache once it is next. Larger values keep the engines busy for
+    longer stretches, but use more memory of the audioCacheLimit().
 
-/*!
-    \qmlsignal TextToSpeech::sayingWord(string word, int id, int start, int length)
-    \since 6.6
+    Automatic prefetching requires the same capabilities and settings as
+    prefetch(). A \a depth of 0 disables it.
 
-    This signal is emitted when the \a word, which is the slice of text indicated
-    by \a start and \a length in the utterance \a id, gets played to the audio device.
+    \sa prefetchDepth(), prefetch(), setAudioCacheLimit()
+*/
+void QTextToSpeech::setPrefetchDepth(int depth)
+{
+    Q_D(QTextToSpeech);
+    depth = qMax(depth, 0);
+    if (d->m_prefetchDepth == depth)
+        return;
+    d->m_prefetchDepth = depth;
+    d->prefetchPending();
+}
 
-    \note This signal requires that the engine has the
-    \l {QTextToSpeech::Capability::}{WordByWordProgress} capability.
+/*!
+    \since 6.10
 
-    The following code highlights the word that is spoken in a TextArea \c input:
-    \snippet quickspeech/Main.qml sayingWord
+    Returns whether texts are passed to the engine one sentence at a time.
+    The default is \c false.
 
-    \sa QTextToSpeech::Capability, say()
+    \sa setSentenceChunking()
 */
+bool QTextToSpeech::sentenceChunking() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_sentenceChunking;
+}
 
 /*!
-    \fn void QTextToSpeech::sayingWord(const QString &word, qsizetype id, qsizetype start, qsizetype length)
-    \since 6.6
+    \since 6.10
 
-    This signal is emitted when the \a word, which is the slice of text indicated
-    by \a start and \a length in the utterance \a id, gets played to the audio device.
+    Sets whether texts passed to say() and enqueue() are split into sentences
+    that are given to the engine one after the other to \a enable.
 
-    \note This signal requires that the engine has the
-    \l {QTextToSpeech::Capability::}{WordByWordProgress} capability.
+    Most engines process the complete text before they start speaking, so for
+    long texts, like the chapter of a book, it can take a long time until
+    the first word is heard. With sentence chunking enabled, speaking starts as
+    soon as the first sentence has been processed.
 
-    \sa Capability, say()
+    The split is transparent to the application: the state stays \l Speaking
+    until the entire text has been spoken, aboutToSynthesize() is emitted once
+    per text, and the positions reported by sayingWord() refer to the
+    complete text. Pausing with the \l{BoundaryHint::}{Utterance} hint still
+    pauses at the end of the complete text.
+
+    \note Engines might use a slightly different intonation at the end of each
+    sentence, and there might be a short gap between sentences.
 */
+void QTextToSpeech::setSentenceChunking(bool enable)
+{
+    Q_D(QTextToSpeech);
+    d->m_sentenceChunking = enable;
+}
 
 /*!
-    \qmlsignal void TextToSpeech::errorOccurred(enumeration reason, string errorString)
+    \since 6.10
 
-    This signal is emitted after an error occurred and the \l state has been set to
-    \c TextToSpeech.Error. The \a reason parameter specifies the type of error,
-    and the \a errorString provides a human-readable error description.
+    Returns the maximum number of bytes of synthesized audio that are kept in
+    memory. The default is 0, which disables the memory cache.
 
-    \sa state errorReason(), errorString()
+    \sa setAudioCacheLimit(), audioCacheDirectory()
 */
+qsizetype QTextToSpeech::audioCacheLimit() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_audioCache.maxCost();
+}
 
 /*!
-    \fn void QTextToSpeech::errorOccurred(QTextToSpeech::ErrorReason reason, const QString &errorString)
-
-    This signal is emitted after an error occurred and the \l state has been set to
-    QTextToSpeech::Error. The \a reason parameter specifies the type of error,
-    and the \a errorString provides a human-readable error description.
-
-    QTextToSpeech::ErrorReason is not a registered metatype, so for queued
-    connections, you will have to register it with Q_DECLARE_METATYPE() and
-    qRegisterMetaType().
-
-    \sa errorReason(), errorString(), {Creating Custom Qt Types}
+    \since 6.10
+
+    Sets the maximum number of \a bytes of synthesized audio that are kept in
+    memory.
+
+    If the limit is larger than 0, then the audio data produced by synthesize()
+    and synthesizeToDevice() is cached, using the engine and its parameters,
+    the voice, rate, pitch, volume, and the text with normalized whitespace as
+    the key. Synthesizing the same text again with the same settings delivers
+    the cached data, including the synthesizedWord() signals, without involving
+    the engine. When the limit is exceeded, the least recently used entries are
+    discarded.
+
+    Texts that are passed to say() or enqueue() are spoken from the cache as
+    well, if it has their audio, for instance because they were synthesized
+    or prefetched before. The cached audio is played with the default audio
+    output device, and the sayingWord() signal is emitted when the output
+    reaches each word. Speech produced by the engine itself is not cached.
+
+    \sa audioCacheLimit(), setAudioCacheDirectory(), setAudioCacheCompression()
 */
+void QTextToSpeech::setAudioCacheLimit(qsizetype bytes)
+{
+    Q_D(QTextToSpeech);
+    d->m_audioCache.setMaxCost(qMax<qsizetype>(bytes, 0));
+}
 
 /*!
-    \qmlmethod enumeration TextToSpeech::errorReason()
-    \return the reason why the engine has reported an error.
+    \enum QTextToSpeech::AudioCompression
+    \since 6.10
 
-    \sa QTextToSpeech::ErrorReason
+    This enum describes how synthesized audio is stored in the audio cache.
+
+    \value None      The audio is stored as produced by the engine.
+    \value Lossless  16 bit audio is compressed without loss, typically to
+                     about half of its size.
+    \value Lossy     16 bit audio is compressed with IMA ADPCM to a quarter of
+                     its size, with a small loss in quality.
+
+    \sa setAudioCacheCompression()
 */
 
 /*!
-    \return the reason why the engine has reported an error.
+    \since 6.10
 
-    \sa state errorOccurred()
+    Returns how synthesized audio is compressed in the audio cache. The
+    default is \l{AudioCompression::}{None}.
+
+    \sa setAudioCacheCompression()
 */
-QTextToSpeech::ErrorReason QTextToSpeech::errorReason() const
+QTextToSpeech::AudioCompression QTextToSpeech::audioCacheCompression() const
 {
     Q_D(const QTextToSpeech);
-    if (d->m_engine)
-        return d->m_engine->errorReason();
-    return QTextToSpeech::ErrorReason::Initialization;
+    return d->m_audioCache.compression();
 }
 
 /*!
-    \qmlmethod string TextToSpeech::errorString()
-    \return the current engine error message.
+    \since 6.10
+
+    Sets the \a compression of the audio that is added to the audio cache.
+
+    Compressed audio takes less memory and disk space, so that more texts fit
+    into the audioCacheLimit(). The audio is decoded chunk by chunk when it is
+    delivered again. Only audio with 16 bit samples is compressed, audio in
+    other formats is stored as it is.
+
+    Entries that are already in the cache keep their compression.
+
+    \sa audioCacheCompression(), setAudioCacheLimit()
 */
+void QTextToSpeech::setAudioCacheCompression(AudioCompression compression)
+{
+    Q_D(QTextToSpeech);
+    d->m_audioCache.setCompression(compression);
+}
 
 /*!
-    \return the current engine error message.
+    \since 6.10
 
-    \sa errorOccurred()
+    Returns the directory in which synthesized audio is stored persistently, or
+    an empty string if audio is not stored on disk.
+
+    \sa setAudioCacheDirectory(), audioCacheLimit()
 */
-QString QTextToSpeech::errorString() const
+QString QTextToSpeech::audioCacheDirectory() const
 {
     Q_D(const QTextToSpeech);
-    if (d->m_engine)
-        return d->m_engine->errorString();
-    return tr("Text to speech engine not initialized");
+    return d->m_audioCache.directory();
 }
 
 /*!
-    \qmlmethod TextToSpeech::say(string text)
+    \since 6.10
 
-    Starts synthesizing the \a text.
+    Sets the \a directory in which synthesized audio is stored persistently.
 
-    This function starts sythesizing the speech asynchronously, and reads the text to the
-    default audio output device.
+    If \a directory is not empty, then each synthesized text is also written
+    to a file in \a directory, and texts that are not in the memory cache are
+    looked up there before the engine is used. The directory can be shared by
+    several QTextToSpeech instances and processes, and is never cleaned up by
+    QTextToSpeech.
 
-    \snippet quickspeech/Main.qml say0
-    \snippet quickspeech/Main.qml say1
+    \sa audioCacheDirectory(), setAudioCacheLimit()
+*/
+void QTextToSpeech::setAudioCacheDirectory(const QString &directory)
+{
+    Q_D(QTextToSpeech);
+    d->m_audioCache.setDirectory(directory);
+}
 
-    \note All in-progress readings are stopped before beginning to read the recently
-    synthesized text.
+/*!
+    \since 6.10
 
-    The current state is available using the \l state property, and is
-    set to \l {QTextToSpeech::Speaking} once the reading starts. When the reading is done,
-    \l state will be set to \l {QTextToSpeech::Ready}.
+    Returns the directory in which the voices of the engines are stored, or an
+    empty string if they are not stored.
 
-    \sa stop(), pause(), resume()
+    \sa setVoiceCacheDirectory()
 */
+QString QTextToSpeech::voiceCacheDirectory() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_voiceCacheDirectory;
+}
 
 /*!
-    Starts speaking the \a text.
+    \since 6.10
 
-    This function starts sythesizing the speech asynchronously, and reads the text to the
-    default audio output device.
+    Sets the \a directory in which the voices of the engines are stored.
 
-    \snippet hello_speak/mainwindow.cpp say
+    Enumerating the voices can take a while for some engines, for example
+    if many voices are installed. If \a directory is not empty, then the
+    voices that the engine reported are stored in a file in \a directory.
+    The next time that engine is used, with the same version and parameters,
+    availableVoices(), availableLocales(), and findVoices() return the
+    stored voices until the engine has enumerated its voices. This includes
+    the time in which an engine that is set with setEngineAsync() is created.
 
-    \note All in-progress readings are stopped before beginning to read the recently
-    synthesized text.
+    Once control returns to the event loop, the voices of the engine are
+    compared with the stored voices. If the voices on the system have changed,
+    then the file is updated, and the voicesChanged() signal is emitted.
 
-    The current state is available using the \l state property, and is
-    set to \l Speaking once the reading starts. When the reading is done,
-    \l state will be set to \l Ready.
+    Set the directory before setting the engine, for example by constructing
+    the QTextToSpeech object without an engine and calling setEngineAsync().
 
-    \sa enqueue(), stop(), pause(), resume(), synthesize()
+    \sa voiceCacheDirectory(), setAudioCacheDirectory()
 */
-void QTextToSpeech::say(const QString &text)
+void QTextToSpeech::setVoiceCacheDirectory(const QString &directory)
 {
     Q_D(QTextToSpeech);
-    d->m_pendingUtterances = {};
-    d->m_utteranceCounter = 1;
-    if (d->m_engine) {
-        emit aboutToSynthesize(0);
-        d->m_engine->say(text);
-    }
+    if (d->m_voiceCacheDirectory == directory)
+        return;
+    d->m_voiceCacheDirectory = directory;
+    d->loadVoiceCatalog();
+    d->m_voiceIndex.reset();
+    d->refreshVoiceCatalogLater();
 }
 
 /*!
-    \qmlmethod TextToSpeech::enqueue(string utterance)
-    \since 6.6
-
-    Adds \a utterance to the queue of text to be spoken, and starts speaking.
+    \since 6.10
 
-    If the engine's \l state is currently \c Ready, \a utterance will be spoken
-    immediately. Otherwise, the engine will start to speak \a utterance once it
-    has finished speaking the current text.
+    Returns the device from which the speech of say() and enqueue() is read,
+    or \nullptr if the engine was not set with the \c outputStream parameter.
 
-    Each time the engine proceeds to the next text entry in the queue, the
-    aboutToSynthesize() signal gets emitted. This allows applications to keep
-    track of the progress, and to make last-minute changes to voice attributes.
+    The device is sequential and read-only, and holds raw audio in the format
+    of the \c outputStreamFormat parameter. Read it in the thread of this
+    QTextToSpeech object, for example by starting a QAudioSink or a mixer
+    with it, as the speech continues only as fast as the audio is read: the
+    sayingWord() signal is emitted once the audio of the word has been read,
+    and the state changes to Ready once all audio of the texts has been read.
+    While the state is Paused, the device has no data to read. The device
+    belongs to the engine, and is deleted when the engine changes.
 
-    Calling stop() clears the queue.
+    \code
+    QTextToSpeech speech;
+    speech.setEngine("flite", {{"outputStream", true}});
+    QAudioFormat format;
+    format.setSampleRate(22050);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Int16);
+    QAudioSink sink(format);
+    sink.start(speech.outputStream());
+    speech.say("Hello World");
+    \endcode
 
-    \sa say(), stop(), aboutToSynthesize()
+    \sa setEngine(), sayingWord()
 */
+QIODevice *QTextToSpeech::outputStream() const
+{
+    Q_D(const QTextToSpeech);
+    if (auto *engine = qobject_cast<QTextToSpeechStreamEngine *>(d->m_engine.get()))
+        return engine->outputStream();
+    return nullptr;
+}
 
 /*!
-    \since 6.6
-
-    Adds \a utterance to the queue of texts to be spoken, and starts speaking.
-    Returns the index of the text in the queue, or -1 in case of an error.
+    \since 6.10
 
-    If the engine's \l state is currently \c Ready, \a utterance will be spoken
-    immediately. Otherwise, the engine will start to speak \a utterance once it
-    has finished speaking the current text.
+    Returns how fast the engine processed the texts since this object was
+    created, or since the last call to resetMetrics(), and how many texts
+    are waiting to be processed.
 
-    Each time the engine proceeds to the next text entry in the queue, the
-    aboutToSynthesize() signal gets emitted. This allows applications to keep
-    track of the progress, and to make last-minute changes to voice attributes.
+    \sa QTextToSpeechMetrics
+*/
+QTextToSpeechMetrics QTextToSpeech::metrics() const
+{
+    Q_D(const QTextToSpeech);
+    QTextToSpeechMetrics metrics = d->m_metrics;
+    // pauses are queued as empty texts
+    metrics.d->queueDepth = std::count_if(d->m_pendingUtterances.cbegin(),
+                                         d->m_pendingUtterances.cend(),
+                                         [](const auto &utterance) {
+        return !utterance.text.isEmpty();
+    });
+    return metrics;
+}
 
-    Calling stop() clears the queue. To pause the engine at the end of a text,
-    use the \l {QTextToSpeech::BoundaryHint::}{Utterance} boundary hint.
+/*!
+    \since 6.10
 
-    \sa say(), stop(), aboutToSynthesize(), synthesize()
+    Resets the values that metrics() returns.
 */
-qsizetype QTextToSpeech::enqueue(const QString &utterance)
+void QTextToSpeech::resetMetrics()
 {
     Q_D(QTextToSpeech);
-    if (!d->m_engine || utterance.isEmpty())
-        return -1;
-
-    switch (d->m_engine->state()) {
-    case QTextToSpeech::Error:
-        return -1;
-    case QTextToSpeech::Ready:
-        emit aboutToSynthesize(0);
-        d->m_engine->say(utterance);
-        break;
-    case QTextToSpeech::Speaking:
-    case QTextToSpeech::Synthesizing:
-    case QTextToSpeech::Paused:
-        d->m_pendingUtterances.enqueue(utterance);
-        break;
-    }
-
-    return d->m_utteranceCounter++;
+    d->m_metrics = {};
 }
 
 /*!
-    \fn template<typename Functor> void QTextToSpeech::synthesize(
-            const QString &text, Functor &&functor)
-    \fn template<typename Functor> void QTextToSpeech::synthesize(
-            const QString &text, const QObject *context, Functor &&functor)
-    \since 6.6
+    \since 6.10
 
-    Synthesizes the \a text into raw audio data.
+    Returns the format that synthesize() and synthesizeToDevice() deliver
+    audio in. By default, no format is set, and the audio is delivered in the
+    format that the engine produces.
 
-    This function synthesizes the speech asynchronously into raw audio data.
-    When data is available, the \a functor will be called as
-    \c {functor(QAudioFormat format, QByteArray bytes)}, with \c format
-    describing the \l {QAudioFormat}{format} of the data in \c bytes;
-    or as \c {functor(QAudioBuffer &buffer)}.
+    \sa setSynthesizeFormat()
+*/
+QAudioFormat QTextToSpeech::synthesizeFormat() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_converter.target();
+}
 
-    The \l state property is set to \l Synthesizing when the synthesis starts,
-    and to \l Ready once the synthesis is finished. While synthesizing, the
-    \a functor might be called multiple times, possibly with changing values
-    for \c format.
+/*!
+    \since 6.10
+
+    Sets the \a format that synthesize() and synthesizeToDevice() deliver
+    audio in.
+
+    Engines produce audio in different formats, and the format can depend on
+    the voice. With a format set, the audio is converted as it arrives, so
+    that it always has the requested sample rate, channel count, and sample
+    format. Properties that are not set in \a format are taken from the audio
+    of the engine, so setting only the sample format keeps the sample rate of
+    the voice. The sample rate is converted with linear interpolation; when
+    reducing the sample rate, the audio is low-pass filtered first, so that
+    frequencies the new rate cannot represent don't fold back as noise. The
+    filter is simple, and a speech-quality conversion rather than a
+    high-fidelity one.
+
+    Audio is stored in the audio cache as the engine produces it, so changing
+    the format does not invalidate the cache.
+
+    \sa synthesizeFormat(), synthesize()
+*/
+void QTextToSpeech::setSynthesizeFormat(const QAudioFormat &format)
+{
+    Q_D(QTextToSpeech);
+    d->m_converter.setTarget(format);
+}
 
-    The \a functor can be a callable, like a lambda or free function, with an
-    optional \a context object:
+/*!
+    \since 6.10
 
-    \code
-    tts.synthesize("Hello world", [](const QAudioFormat &format, const QByteArray &bytes){
-        // process data according to format
-    });
-    \endcode
+    Returns how many bytes of synthesized audio can be waiting to be delivered
+    before the engine pauses synthesizing. The default is 0, which means that
+    there is no limit.
 
-    or a member function of the \a context object:
+    \sa setSynthesizeBufferLimit()
+*/
+qsizetype QTextToSpeech::synthesizeBufferLimit() const
+{
+    Q_D(const QTextToSpeech);
+    return d->m_synthesizeBufferLimit;
+}
 
-    \code
-    struct PCMProcessor : QObject
-    {
-        void processData(const QAudioFormat &format, const QByteArray &bytes)
-        {
-            // process data according to format
-        }
-    } processor;
-    tts.synthesize("Hello world", &processor, &PCMProcessor::processData);
-    \endcode
+/*!
+    \since 6.10
 
-    If \a context is destroyed, then the \a functor will no longer get called.
+    Sets the number of \a bytes of synthesized audio that can be waiting to
+    be delivered to the synthesize() functor.
 
-    \note This API requires that the engine has the
-    \l {QTextToSpeech::Capability::}{Synthesize} capability.
+    Engines that synthesize in a background thread produce audio as fast as
+    they can, and the data waits in the event queue until it is delivered.
+    With a consumer that is slower than the engine, for instance one that
+    encodes or uploads the audio, that data can use a lot of memory for long
+    texts. With a limit set, the engine pauses synthesizing once that much
+    data is waiting, and continues when the data has been delivered. A single
+    chunk of audio is always delivered, even if it is larger than the limit.
 
-    \sa say(), stop()
-*/
+    The limit only applies to data that the engine delivers to this object's
+    thread. Functors that are called in a different thread receive the data
+    through the event queue of that thread, which is not limited.
 
-/*!
-    \internal
+    Only the \c flite engine supports this; other engines deliver the audio
+    in the thread of the QTextToSpeech object, or don't buffer it.
 
-    Handles the engine's synthesized() signal to call \a slotObj on the \a context
-    object. The slot object and the temporary connection are stored and released
-    in updateState() when the state of the engine transitions back to Ready.
+    With an \l{outputStream()}{output stream}, the limit is also how much
+    audio can wait in the stream before the engine continues with the next
+    sentence. Without a limit, that is about a second of audio.
+
+    \sa synthesizeBufferLimit()
 */
-void QTextToSpeech::synthesizeImpl(const QString &text,
-                                   QtPrivate::QSlotObjectBase *slotObj, const QObject *context,
-                                   SynthesizeOverload overload)
+void QTextToSpeech::setSynthesizeBufferLimit(qsizetype bytes)
 {
     Q_D(QTextToSpeech);
-    Q_ASSERT(slotObj);
-    if (d->m_slotObject)
-        d->m_slotObject->destroyIfLastRef();
-    d->m_slotObject = slotObj;
-    const auto receive = [d, context, overload](const QAudioFormat &format, const QByteArray &bytes){
-        Q_ASSERT(d->m_slotObject);
-        if (overload == SynthesizeOverload::AudioBuffer) {
-            const QAudioBuffer buffer(bytes, format);
-            void *args[] = {nullptr, const_cast<QAudioBuffer *>(&buffer)};
-            d->m_slotObject->call(const_cast<QObject *>(context), args);
-        } else {
-            void *args[] = {nullptr,
-                            const_cast<QAudioFormat *>(&format),
-                            const_cast<QByteArray *>(&bytes)};
-            d->m_slotObject->call(const_cast<QObject *>(context), args);
-        }
-    };
-    d->m_synthesizeConnection = connect(d->m_engine.get(), &QTextToSpeechEngine::synthesized,
-                                        context ? context : this, receive);
-
-    if (!d->m_engine)
+    bytes = qMax(bytes, 0);
+    if (d->m_synthesizeBufferLimit == bytes)
         return;
-
-    if (d->m_engine->state() == QTextToSpeech::Synthesizing)
-        d->m_pendingUtterances.enqueue(text);
-    else
-        d->m_engine->synthesize(text);
+    d->m_synthesizeBufferLimit = bytes;
+    if (d->m_engine)
+        d->m_engine->setSynthesizeBufferLimit(bytes);
+    if (d->m_prefetchEngine)
+        d->m_prefetchEngine->setSynthesizeBufferLimit(bytes);
 }
 
 /*!
@@ -958,8 +3430,17 @@ void QTextToSpeech::synthesizeImpl(const QString &text,
 void QTextToSpeech::stop(BoundaryHint boundaryHint)
 {
     Q_D(QTextToSpeech);
+    d->cancelSpoken();
+    d->resetStream();
+    d->m_utteranceTimer.invalidate();
     d->m_pendingUtterances = {};
     d->m_utteranceCounter = 0;
+    d->m_preemptHint.reset();
+    d->m_sentences.clear();
+    d->m_pausePending = false;
+    d->cancelCaching();
+    if (d->m_cachePlayer)
+        d->m_cachePlayer->stop();
     if (d->m_engine) {
         if (boundaryHint == QTextToSpeech::BoundaryHint::Immediate)
             d->disconnectSynthesizeFunctor();
@@ -992,13 +3473,19 @@ void QTextToSpeech::pause(BoundaryHint boundaryHint)
         return;
 
     if (boundaryHint == BoundaryHint::Utterance) {
-        if (d->m_pendingUtterances.isEmpty() || !d->m_pendingUtterances.first().isEmpty())
-            d->m_pendingUtterances.prepend(QString());
+        if (d->m_pendingUtterances.isEmpty() || !d->m_pendingUtterances.first().text.isEmpty())
+            d->m_pendingUtterances.prepend({});
     }
     // pause called in response to aboutToSynthesize
-    if (d->m_engine->state() == QTextToSpeech::Ready) {
+    if (d->speakingState() == QTextToSpeech::Ready) {
         d->updateState(QTextToSpeech::Paused);
+    } else if (d->playingCached()) {
+        // the pause marker takes care of the Utterance hint
+        if (boundaryHint != BoundaryHint::Utterance)
+            d->m_cachePlayer->pause();
     } else {
+        if (boundaryHint != BoundaryHint::Utterance)
+            d->m_pausePending = true;
         d->m_engine->pause(boundaryHint);
     }
 }
@@ -1028,8 +3515,13 @@ void QTextToSpeech::resume()
     if (d->m_engine) {
         // If we are pausing before proceeding with the next utterance,
         // then continue with the next pending text.
-        if (d->m_engine->state() == QTextToSpeech::Ready)
+        // Paused between two sentences of the current text
+        if (d->speakingState() == QTextToSpeech::Ready && d->sayNextSentence())
+            d->updateState(QTextToSpeech::Speaking);
+        else if (d->speakingState() == QTextToSpeech::Ready)
             d->updateState(QTextToSpeech::Ready);
+        else if (d->playingCached())
+            d->m_cachePlayer->resume();
         else
             d->m_engine->resume();
     }
@@ -1190,8 +3682,10 @@ void QTextToSpeech::setLocale(const QLocale &locale)
     const QVoice oldVoice = voice();
     if (d->m_engine->setLocale(locale)) {
         emit localeChanged(locale);
-        if (const QVoice newVoice = d->m_engine->voice(); oldVoice != newVoice)
+        if (const QVoice newVoice = d->m_engine->voice(); oldVoice != newVoice) {
+            d->m_reportedVoice = newVoice;
             emit voiceChanged(newVoice);
+        }
     }
 }
 
@@ -1217,9 +3711,16 @@ QLocale QTextToSpeech::locale() const
 QList<QLocale> QTextToSpeech::availableLocales() const
 {
     Q_D(const QTextToSpeech);
+    QList<QLocale> locales;
     if (d->m_engine)
-        return d->m_engine->availableLocales();
-    return QList<QLocale>();
+        locales = d->m_engine->availableLocales();
+    if (locales.isEmpty()) {
+        for (const QVoice &voice : d->m_cachedVoices) {
+            if (!locales.contains(voice.locale()))
+                locales << voice.locale();
+        }
+    }
+    return locales;
 }
 
 /*!
@@ -1259,6 +3760,7 @@ void QTextToSpeech::setVoice(const QVoice &voice)
 
     const QLocale oldLocale = locale();
     if (d->m_engine->setVoice(voice)) {
+        d->m_reportedVoice = voice;
         emit voiceChanged(voice);
         if (const QLocale newLocale = d->m_engine->locale(); newLocale != oldLocale)
             emit localeChanged(newLocale);
@@ -1289,11 +3791,38 @@ QVoice QTextToSpeech::voice() const
 QList<QVoice> QTextToSpeech::availableVoices() const
 {
     Q_D(const QTextToSpeech);
-    if (d->m_engine)
-        return d->m_engine->availableVoices();
-    return QList<QVoice>();
+    if (d->m_engine) {
+        QList<QVoice> voices = d->m_engine->availableVoices();
+        if (!voices.isEmpty() || d->m_cachedVoices.isEmpty())
+            return voices;
+    } else if (d->m_cachedVoices.isEmpty()) {
+        return QList<QVoice>();
+    }
+    return d->voiceIndex().voices(locale());
 }
 
+/*!
+    \qmlsignal TextToSpeech::voicesChanged()
+    \since 6.10
+
+    This signal is emitted when the voices of the engine have changed.
+
+    \sa availableVoices(), findVoices()
+*/
+
+/*!
+    \fn void QTextToSpeech::voicesChanged()
+    \since 6.10
+
+    This signal is emitted when the voices of the engine have changed.
+
+    Engines that take a while to enumerate their voices, like the speech-dispatcher
+    engine, become \l{QTextToSpeech::Ready}{ready} before they know all voices. They
+    then emit this signal once the voices have been loaded.
+
+    \sa availableVoices(), findVoices()
+*/
+
 /*!
     \fn template<typename ...Args> QList<QVoice> QTextToSpeech::findVoices(Args &&...args) const
     \since 6.6
@@ -1344,33 +3873,33 @@ QList<QVoice> QTextToSpeech::availableVoices() const
 /*!
     \internal
 
-    Returns the list of all voices. This requires iterating through all locales,
-    unless \a locale is set, in which case we can just go through the voices for
-    that locale.
+    Returns the list of all voices, or the voices for \a locale if it is set.
+    The voices of the engine are enumerated once, and looked up in an index
+    afterwards.
 */
 QList<QVoice> QTextToSpeech::allVoices(const QLocale *locale) const
 {
     Q_D(const QTextToSpeech);
-    if (!d->m_engine)
+    if (!d->m_engine && d->m_cachedVoices.isEmpty())
         return {};
 
-    const QVoice oldVoice = d->m_engine->voice();
+    const QTextToSpeechVoiceIndex &index = d->voiceIndex();
+    return locale ? index.voices(*locale) : index.voices();
+}
 
-    QList<QVoice> voices;
-    QSignalBlocker blockSignals(const_cast<QTextToSpeech *>(this));
-    const QList<QLocale> allLocales = locale ? QList<QLocale>{*locale} : availableLocales();
-    for (const auto &l : allLocales) {
-        if (d->m_engine->locale() != l)
-            d->m_engine->setLocale(l);
-        voices << d->m_engine->availableVoices();
-    }
+/*!
+    \internal
 
-    // reset back to old voice, which will have changed when we changed the
-    // engine's locale.
-    if (d->m_engine->voice() != oldVoice)
-        d->m_engine->setVoice(oldVoice);
+    Returns the voices that match all \a criteria, as used by the
+    QML TextToSpeech::findVoices() method and the VoiceSelector.
+*/
+QList<QVoice> QTextToSpeech::voicesMatching(const QVariantMap &criteria) const
+{
+    Q_D(const QTextToSpeech);
+    if (!d->m_engine && d->m_cachedVoices.isEmpty())
+        return {};
 
-    return voices;
+    return d->voiceIndex().find(criteria);
 }
 
 QT_END_NAMESPACE
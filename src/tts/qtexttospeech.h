@@ -8,7 +8,9 @@
 #define QTEXTTOSPEECH_H
 
 #include <QtTextToSpeech/qtexttospeech_global.h>
+#include <QtTextToSpeech/qtexttospeechmetrics.h>
 #include <QtTextToSpeech/qvoice.h>
+#include <QtCore/qfuture.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qshareddata.h>
 #include <QtCore/qlocale.h>
@@ -19,6 +21,7 @@ QT_BEGIN_NAMESPACE
 
 class QAudioFormat;
 class QAudioBuffer;
+class QIODevice;
 
 class QTextToSpeechPrivate;
 class Q_TEXTTOSPEECH_EXPORT QTextToSpeech : public QObject
@@ -72,6 +75,26 @@ public:
     Q_DECLARE_FLAGS(Capabilities, Capability)
     Q_FLAG(Capabilities)
 
+    enum class OutputFormat {
+        RawPcm,
+        Wav,
+    };
+    Q_ENUM(OutputFormat)
+
+    enum class Priority {
+        Low,
+        Normal,
+        High,
+    };
+    Q_ENUM(Priority)
+
+    enum class AudioCompression {
+        None,
+        Lossless,
+        Lossy,
+    };
+    Q_ENUM(AudioCompression)
+
     explicit QTextToSpeech(QObject *parent = nullptr);
     explicit QTextToSpeech(const QString &engine, QObject *parent = nullptr);
     explicit QTextToSpeech(const QString &engine, const QVariantMap &params,
@@ -79,6 +102,12 @@ public:
     ~QTextToSpeech() override;
 
     Q_INVOKABLE bool setEngine(const QString &engine, const QVariantMap &params = QVariantMap());
+    QFuture<bool> setEngineAsync(const QString &engine, const QVariantMap &params = QVariantMap());
+    bool prepareEngine(const QString &engine, const QVariantMap &params = QVariantMap());
+    QString preparedEngine() const;
+    bool switchToPreparedEngine();
+    void setFallbackEngines(const QStringList &engines);
+    QStringList fallbackEngines() const;
     QString engine() const;
     QTextToSpeech::Capabilities engineCapabilities() const;
 
@@ -129,6 +158,44 @@ public:
         synthesize(text, nullptr, std::forward<Functor>(func));
     }
 
+    bool synthesizeToDevice(const QString &text, QIODevice *device,
+                            QTextToSpeech::OutputFormat format = QTextToSpeech::OutputFormat::Wav);
+    QIODevice *outputStream() const;
+
+    QFuture<QAudioBuffer> synthesizeAsync(const QString &text);
+    QFuture<QAudioBuffer> synthesizeBatch(const QStringList &texts);
+    QFuture<void> sayAsync(const QString &text);
+
+    QList<qsizetype> enqueue(const QString &document,
+                             const QList<std::pair<qsizetype, qsizetype>> &ranges,
+                             QTextToSpeech::Priority priority = QTextToSpeech::Priority::Normal,
+                             QTextToSpeech::BoundaryHint boundaryHint = QTextToSpeech::BoundaryHint::Utterance);
+
+    bool prefetch(const QString &text);
+    int prefetchDepth() const;
+    void setPrefetchDepth(int depth);
+
+    QAudioFormat synthesizeFormat() const;
+    void setSynthesizeFormat(const QAudioFormat &format);
+
+    qsizetype synthesizeBufferLimit() const;
+    void setSynthesizeBufferLimit(qsizetype bytes);
+
+    bool sentenceChunking() const;
+    void setSentenceChunking(bool enable);
+
+    qsizetype audioCacheLimit() const;
+    void setAudioCacheLimit(qsizetype bytes);
+    AudioCompression audioCacheCompression() const;
+    void setAudioCacheCompression(AudioCompression compression);
+    QString audioCacheDirectory() const;
+    void setAudioCacheDirectory(const QString &directory);
+    QString voiceCacheDirectory() const;
+    void setVoiceCacheDirectory(const QString &directory);
+
+    QTextToSpeechMetrics metrics() const;
+    void resetMetrics();
+
     template <typename ...Args>
     QList<QVoice> findVoices(Args &&...args) const
     {
@@ -150,6 +217,10 @@ public:
 public Q_SLOTS:
     void say(const QString &text);
     qsizetype enqueue(const QString &text);
+    qsizetype enqueue(const QString &text, QTextToSpeech::Priority priority,
+                      QTextToSpeech::BoundaryHint boundaryHint = QTextToSpeech::BoundaryHint::Utterance);
+    qsizetype appendText(const QString &text);
+    void finishText();
     void stop(QTextToSpeech::BoundaryHint boundaryHint = QTextToSpeech::BoundaryHint::Default);
     void pause(QTextToSpeech::BoundaryHint boundaryHint = QTextToSpeech::BoundaryHint::Default);
     void resume();
@@ -170,12 +241,16 @@ Q_SIGNALS:
     void pitchChanged(double pitch);
     void volumeChanged(double volume);
     void voiceChanged(const QVoice &voice);
+    void voicesChanged();
 
     void sayingWord(const QString &word, qsizetype id, qsizetype start, qsizetype length);
+    void synthesizedWord(const QString &word, qsizetype id, qsizetype start, qsizetype length,
+                         qint64 position);
     void aboutToSynthesize(qsizetype id);
 
 protected:
     QList<QVoice> allVoices(const QLocale *locale) const;
+    QList<QVoice> voicesMatching(const QVariantMap &criteria) const;
 
 private:
     template <typename Functor>
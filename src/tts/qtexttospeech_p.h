@@ -19,16 +19,99 @@
 
 #include <qtexttospeech.h>
 #include <qtexttospeechplugin.h>
-#include <QMutex>
+#include "qtexttospeechaudioconverter_p.h"
+#include "qtexttospeechcache_p.h"
+#include <QReadWriteLock>
 #include <QCborMap>
+#include <QtCore/qatomic.h>
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qhash.h>
 #include <QtCore/qqueue.h>
 #include <QtCore/qnumeric.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qpromise.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qvariantmap.h>
+#include <QtMultimedia/qaudioformat.h>
 #include <QtCore/private/qobject_p.h>
 
+#include <functional>
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
+class QTextToSpeechDeviceWriter
+{
+public:
+    QTextToSpeechDeviceWriter(QIODevice *device, QTextToSpeech::OutputFormat format);
+
+    void write(const QAudioFormat &format, const QByteArray &bytes);
+    void finish();
+
+private:
+    void writeWavHeader(quint32 dataSize);
+
+    QPointer<QIODevice> m_device;
+    QTextToSpeech::OutputFormat m_outputFormat;
+    QAudioFormat m_format;
+    qint64 m_headerPos = -1;
+    qint64 m_dataSize = 0;
+};
+
+// Lookup tables for the voices of an engine, so that findVoices() doesn't have to
+// compare every voice against every criterion.
+class QTextToSpeechVoiceIndex
+{
+public:
+    explicit QTextToSpeechVoiceIndex(const QList<QVoice> &voices);
+
+    const QList<QVoice> &voices() const { return m_voices; }
+    QList<QVoice> voices(const QLocale &locale) const;
+    QList<QVoice> find(const QVariantMap &criteria) const;
+
+private:
+    QList<QVoice> m_voices;
+    // positions in m_voices, in the same order
+    QHash<QLocale, QList<qsizetype>> m_byLocale;
+    QHash<int, QList<qsizetype>> m_byLanguage;
+    QHash<int, QList<qsizetype>> m_byGender;
+    QHash<int, QList<qsizetype>> m_byAge;
+    QHash<QString, QList<qsizetype>> m_byName;
+};
+
+// Plugin metadata, read once per process and shared by all QTextToSpeech objects
+struct QTextToSpeechPluginRegistry
+{
+    QMultiHash<QString, QCborMap> plugins;
+    // metadata of the highest plugin version for each provider
+    QHash<QString, QCborMap> providers;
+    // provider with the highest priority
+    QString defaultProvider;
+    // plugin instances by index, so that QFactoryLoader's lock is only taken
+    // when a plugin is loaded for the first time
+    std::unique_ptr<QAtomicPointer<QTextToSpeechPlugin>[]> instances;
+};
+
+// Receives the audio of one or more synthesized utterances
+struct QTextToSpeechSynthesisReceiver
+{
+    ~QTextToSpeechSynthesisReceiver()
+    {
+        if (released)
+            released();
+    }
+
+    // the object in whose thread the audio is received, if any
+    QPointer<QObject> context;
+    bool hasContext = false;
+    std::function<void(const QAudioFormat &, const QByteArray &)> received;
+    // called after each utterance, and when all utterances are done
+    std::function<void()> finished;
+    std::function<void()> released;
+};
+
 class QTextToSpeech;
+class QTextToSpeechCachePlayer;
 class QTextToSpeechPrivate : public QObjectPrivate
 {
     Q_DECLARE_PUBLIC(QTextToSpeech)
@@ -38,26 +121,207 @@ public:
 
     void setEngineProvider(const QString &engine, const QVariantMap &params);
     static QMultiHash<QString, QCborMap> plugins(bool reload = false);
+    static std::shared_ptr<const QTextToSpeechPluginRegistry> registry(bool reload = false);
 
 private:
+    bool prepareEngineProvider(const QString &engine, const QVariantMap &params);
+    static std::unique_ptr<QTextToSpeechEngine> createEngine(QTextToSpeechPlugin *plugin,
+                                                             const QString &provider,
+                                                             const QVariantMap &params);
+    void attachEngine(std::unique_ptr<QTextToSpeechEngine> engine);
+    void setEngineProviderAsync(const QString &engine, const QVariantMap &params,
+                                const std::shared_ptr<QPromise<bool>> &promise);
+    using EngineCreated = std::function<void(std::unique_ptr<QTextToSpeechEngine>)>;
+    void createEngineAsync(QTextToSpeechPlugin *plugin, const QString &provider,
+                           const QCborMap &metaData, const QVariantMap &params,
+                           const EngineCreated &done);
+    void finishEngineLoad(std::unique_ptr<QTextToSpeechEngine> engine);
+    void storeEngineSettings();
+    void finishEngineChange();
+    void restoreEngineSettings();
+    struct StandbyEngine;
+    static StandbyEngine createStandby(const QString &engine, const QVariantMap &params);
+    static StandbyEngine loadStandby(const QString &engine, const QVariantMap &params);
+    void switchEngine(StandbyEngine &&standby);
+    void prepareFallback();
+    void prepareFallbackCandidate(qsizetype candidate);
+    QVariantMap fallbackParameters() const;
+    void prepareFallbackLater();
+    bool failOver();
     bool loadMeta();
     void loadPlugin();
+    static QTextToSpeechPlugin *loadPlugin(const QCborMap &metaData);
+    void engineStateChanged(QTextToSpeech::State newState);
     void updateState(QTextToSpeech::State newState);
     void disconnectSynthesizeFunctor();
+    void setReceiver(const std::shared_ptr<QTextToSpeechSynthesisReceiver> &receiver);
+    void cancelReceiver(const std::shared_ptr<QTextToSpeechSynthesisReceiver> &receiver);
+    void startSynthesis(const QString &text,
+                        std::shared_ptr<QTextToSpeechSynthesisReceiver> receiver);
+    void cancelReceiverLater(const std::weak_ptr<QTextToSpeechSynthesisReceiver> &receiver);
+    void finishSpoken(qsizetype id);
+    void cancelSpoken();
+    void startMeasuring();
+    void measureFirstAudio();
+    struct Utterance
+    {
+        QString text; // empty to pause
+        qsizetype id = -1;
+        QTextToSpeech::Priority priority = QTextToSpeech::Priority::High; // pauses stay first
+        // where text starts in the original text of an interrupted utterance
+        qsizetype offset = 0;
+        // for synthesized utterances, null to keep the current receiver
+        std::shared_ptr<QTextToSpeechSynthesisReceiver> receiver;
+        // if not negative, text is a document of which length characters
+        // at offset are spoken, so that the document is not copied
+        qsizetype length = -1;
+
+        QString spokenText() const { return length < 0 ? text : text.sliced(offset, length); }
+    };
+    qsizetype enqueueText(Utterance &&utterance, QTextToSpeech::BoundaryHint boundaryHint);
+    void enqueueUtterance(Utterance &&utterance, bool resumed = false);
+    void startUtterance(const Utterance &utterance);
+    QTextToSpeech::State speakingState() const;
+    void reportWord(const QString &word, qsizetype start, qsizetype length);
+    void preempt(QTextToSpeech::BoundaryHint boundaryHint);
+    void requeueInterrupted();
+    void say(const QString &text);
+    bool sayNextSentence();
+    void enqueueStreamed(bool finished);
+    void resetStream();
+    void synthesize(const QString &text);
+    void replay(const QTextToSpeechAudioCache::Entry &entry);
+    void deliverReplayed(const QAudioFormat &format, const QByteArray &bytes);
+    bool playCached(const QString &text);
+    bool playingCached() const;
+    void cancelCaching();
+    QByteArray cacheKey(const QString &text) const;
+    bool prefetch(const QString &text);
+    void createPrefetchEngine();
+    void resetPrefetching();
+    void prefetchPending();
+    void prefetchNext();
+    void prefetchStateChanged(QTextToSpeech::State state);
+    const QTextToSpeechVoiceIndex &voiceIndex() const;
+    QString voiceCatalogFile() const;
+    void loadVoiceCatalog();
+    void refreshVoiceCatalog();
+    void refreshVoiceCatalogLater();
     static void loadPluginMetadata(QMultiHash<QString, QCborMap> &list);
     QTextToSpeech *q_ptr;
     QTextToSpeechPlugin *m_plugin = nullptr;
     std::unique_ptr<QTextToSpeechEngine> m_engine = nullptr;
+    QVariantMap m_engineParameters;
     QString m_providerName;
     QCborMap m_metaData;
-    static QMutex m_mutex;
-    QQueue<QString> m_pendingUtterances;
+    static QReadWriteLock m_registryLock;
+    // incremented to drop an engine that is still being created asynchronously
+    quint64 m_engineLoadId = 0;
+    std::shared_ptr<QPromise<bool>> m_enginePromise;
+
+    // created by prepareEngine(), and used once switchToPreparedEngine() switches
+    struct StandbyEngine
+    {
+        std::unique_ptr<QTextToSpeechEngine> engine;
+        QString provider;
+        QVariantMap params;
+        QCborMap metaData;
+        QTextToSpeechPlugin *plugin = nullptr;
+    };
+    StandbyEngine m_standby;
+    // set until the current engine finishes its utterance
+    bool m_switchPending = false;
+    // engines to fail over to, by priority, and the one that is ready for that
+    QStringList m_fallbackEngines;
+    StandbyEngine m_fallback;
+    // set while the fallback engine is being prepared
+    bool m_fallbackPending = false;
+    // incremented to drop a fallback engine that is still being created
+    quint64 m_fallbackId = 0;
+    // ordered by priority, and by time of enqueueing
+    QQueue<Utterance> m_pendingUtterances;
     QTextToSpeech::State m_state = QTextToSpeech::Error;
     QMetaObject::Connection m_synthesizeConnection;
-    QtPrivate::QSlotObjectBase *m_slotObject = nullptr;
+    // receives the audio of the current and of following utterances without receiver
+    std::shared_ptr<QTextToSpeechSynthesisReceiver> m_receiver;
+    // futures returned by sayAsync(), by utterance id
+    QHash<qsizetype, std::shared_ptr<QPromise<void>>> m_spokenPromises;
+    qsizetype m_synthesizeBufferLimit = 0;
+    // converts the audio for the synthesize() functor to the requested format
+    QTextToSpeechAudioConverter m_converter;
+    // built on first use, reset when the engine changes
+    mutable std::optional<QTextToSpeechVoiceIndex> m_voiceIndex;
+    // voices stored by a previous process, used until the engine reports its voices
+    QString m_voiceCacheDirectory;
+    QList<QVoice> m_cachedVoices;
+    bool m_voiceCatalogRefreshPending = false;
+
+    // with sentence chunking, the utterance that is spoken one sentence at a time
+    bool m_sentenceChunking = false;
+    QString m_sentenceText;
+    QQueue<std::pair<qsizetype, qsizetype>> m_sentences; // offset and length
+    qsizetype m_sentenceOffset = 0;
+    // set while the engine is asked to pause, so that it doesn't get the next
+    // sentence if it finishes the current one instead
+    bool m_pausePending = false;
+
+    // text appended with appendText() that is not yet a complete sentence,
+    // and where it starts in all text appended to the stream
+    QString m_streamText;
+    qsizetype m_streamOffset = 0;
+    qsizetype m_streamId = -1;
+    // set until the engine reports that it started the sentence it was given
+    bool m_streamStarting = false;
+
+    QTextToSpeechAudioCache m_audioCache;
+    // key of the utterance that is recorded into m_recording, empty if none
+    QByteArray m_recordingKey;
+    QTextToSpeechAudioCache::Entry m_recording;
+    // incremented to cancel a pending replay
+    quint64 m_replayId = 0;
+    bool m_replaying = false;
+    // speaks cached audio in place of the engine
+    std::unique_ptr<QTextToSpeechCachePlayer> m_cachePlayer;
+
+    // Secondary engine instance that synthesizes prefetched texts into the cache
+    struct PrefetchItem
+    {
+        QByteArray key;
+        QString text;
+        QVoice voice;
+        double rate;
+        double pitch;
+        double volume;
+    };
+    std::unique_ptr<QTextToSpeechEngine> m_prefetchEngine;
+    // set while the prefetch engine is created, and incremented to drop it
+    bool m_prefetchEnginePending = false;
+    quint64 m_prefetchId = 0;
+    QQueue<PrefetchItem> m_prefetchQueue;
+    QByteArray m_prefetchKey;
+    QTextToSpeechAudioCache::Entry m_prefetchRecording;
+    // number of pending synthesized utterances that are prefetched automatically
+    int m_prefetchDepth = 1;
+
+    // measures the utterance that the engine is currently processing
+    QElapsedTimer m_utteranceTimer;
+    bool m_firstAudio = false;
+    qint64 m_utteranceDuration = 0; // of the synthesized audio, in microseconds
+    QTextToSpeechMetrics m_metrics;
 
     qsizetype m_utteranceCounter = 0;
     qsizetype m_currentUtterance = 0;
+    // the text of the current utterance, and where it starts in the enqueued text
+    QString m_currentText;
+    qsizetype m_currentOffset = 0;
+    QTextToSpeech::Priority m_currentPriority = QTextToSpeech::Priority::Normal;
+    // the last word reported by the engine, relative to m_currentText
+    qsizetype m_lastWordStart = 0;
+    qsizetype m_lastWordEnd = 0;
+    // set while the current utterance is stopped for one with higher priority
+    std::optional<QTextToSpeech::BoundaryHint> m_preemptHint;
+    // the voice that voiceChanged() reported last
+    QVoice m_reportedVoice;
     double m_storedPitch = qQNaN();
     double m_storedVolume = qQNaN();
     double m_storedRate = qQNaN();
@@ -0,0 +1,321 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechaudiocodec_p.h"
+
+#include <QtCore/qendian.h>
+#include <QtCore/qlist.h>
+
+#include <algorithm>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Encoded chunks start with the number of samples, as a little-endian quint32
+constexpr qsizetype HeaderSize = sizeof(quint32);
+
+// Frames that share a Rice parameter
+constexpr qsizetype BlockFrames = 256;
+constexpr int RiceParameterBits = 5;
+// Residuals with a larger quotient are stored with EscapeBits
+constexpr quint32 EscapeQuotient = 24;
+constexpr int EscapeBits = 20;
+
+constexpr qint16 AdpcmSteps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+constexpr qint8 AdpcmIndexSteps[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+class BitWriter
+{
+public:
+    explicit BitWriter(QByteArray &out) : m_out(out) {}
+
+    void write(quint32 value, int bits)
+    {
+        m_buffer = (m_buffer << bits) | (value & ((quint64(1) << bits) - 1));
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.append(char(m_buffer >> m_bits));
+        }
+    }
+
+    void writeOnes(quint32 count)
+    {
+        for (; count >= 16; count -= 16)
+            write(0xffff, 16);
+        if (count)
+            write((1u << count) - 1, int(count));
+    }
+
+    void flush()
+    {
+        if (m_bits > 0)
+            write(0, 8 - m_bits);
+    }
+
+private:
+    QByteArray &m_out;
+    quint64 m_buffer = 0;
+    int m_bits = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const char *data, qsizetype size)
+        : m_data(reinterpret_cast<const uchar *>(data)), m_end(m_data + size)
+    {}
+
+    bool atEnd() const { return m_failed; }
+
+    quint32 read(int bits)
+    {
+        while (m_bits < bits) {
+            if (m_data == m_end) {
+                m_failed = true;
+                return 0;
+            }
+            m_buffer = (m_buffer << 8) | *m_data++;
+            m_bits += 8;
+        }
+        m_bits -= bits;
+        return quint32(m_buffer >> m_bits) & ((quint64(1) << bits) - 1);
+    }
+
+    quint32 readOnes(quint32 limit)
+    {
+        quint32 count = 0;
+        while (count < limit && read(1) && !m_failed)
+            ++count;
+        return count;
+    }
+
+private:
+    const uchar *m_data;
+    const uchar *m_end;
+    quint64 m_buffer = 0;
+    int m_bits = 0;
+    bool m_failed = false;
+};
+
+quint32 zigzag(qint32 value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+qint32 unzigzag(quint32 value)
+{
+    return qint32(value >> 1) ^ -qint32(value & 1);
+}
+
+// Predicts a sample from the two before it, with fewer at the start of a chunk
+qint32 predict(const qint16 *samples, qsizetype frame, int channels)
+{
+    if (frame == 0)
+        return 0;
+    const qint32 previous = samples[-channels];
+    if (frame == 1)
+        return previous;
+    return 2 * previous - samples[-2 * channels];
+}
+
+void encodeLossless(const qint16 *samples, qsizetype frames, int channels, QByteArray &out)
+{
+    BitWriter writer(out);
+    QList<quint32> residuals(BlockFrames);
+    for (qsizetype block = 0; block < frames; block += BlockFrames) {
+        const qsizetype count = qMin(BlockFrames, frames - block);
+        for (int channel = 0; channel < channels; ++channel) {
+            quint64 sum = 0;
+            for (qsizetype i = 0; i < count; ++i) {
+                const qsizetype frame = block + i;
+                const qint16 *sample = samples + frame * channels + channel;
+                residuals[i] = zigzag(*sample - predict(sample, frame, channels));
+                sum += residuals[i];
+            }
+            // close to the optimal parameter for geometrically distributed residuals
+            const quint64 mean = sum / count;
+            int k = 0;
+            while (k < EscapeBits && (quint64(1) << (k + 1)) <= mean)
+                ++k;
+            writer.write(k, RiceParameterBits);
+            for (qsizetype i = 0; i < count; ++i) {
+                const quint32 quotient = residuals[i] >> k;
+                if (quotient >= EscapeQuotient) {
+                    writer.writeOnes(EscapeQuotient);
+                    writer.write(residuals[i], EscapeBits);
+                } else {
+                    writer.writeOnes(quotient);
+                    writer.write(0, 1);
+                    if (k)
+                        writer.write(residuals[i], k);
+                }
+            }
+        }
+    }
+    writer.flush();
+}
+
+bool decodeLossless(const char *data, qsizetype size, qint16 *samples, qsizetype frames,
+                    int channels)
+{
+    BitReader reader(data, size);
+    for (qsizetype block = 0; block < frames; block += BlockFrames) {
+        const qsizetype count = qMin(BlockFrames, frames - block);
+        for (int channel = 0; channel < channels; ++channel) {
+            const int k = int(reader.read(RiceParameterBits));
+            if (k > EscapeBits)
+                return false;
+            for (qsizetype i = 0; i < count; ++i) {
+                quint32 residual;
+                const quint32 quotient = reader.readOnes(EscapeQuotient);
+                if (quotient == EscapeQuotient)
+                    residual = reader.read(EscapeBits);
+                else
+                    residual = (quotient << k) | (k ? reader.read(k) : 0);
+                const qsizetype frame = block + i;
+                qint16 *sample = samples + frame * channels + channel;
+                *sample = qint16(predict(sample, frame, channels) + unzigzag(residual));
+            }
+            if (reader.atEnd())
+                return false;
+        }
+    }
+    return true;
+}
+
+struct AdpcmState
+{
+    qint32 predictor = 0;
+    int index = 0;
+
+    qint16 update(int code)
+    {
+        const int step = AdpcmSteps[index];
+        int difference = step >> 3;
+        if (code & 4)
+            difference += step;
+        if (code & 2)
+            difference += step >> 1;
+        if (code & 1)
+            difference += step >> 2;
+        predictor = std::clamp(predictor + ((code & 8) ? -difference : difference),
+                               qint32(-32768), qint32(32767));
+        index = std::clamp(index + AdpcmIndexSteps[code], 0, 88);
+        return qint16(predictor);
+    }
+
+    int encode(qint16 sample)
+    {
+        int difference = sample - predictor;
+        int code = 0;
+        if (difference < 0) {
+            code = 8;
+            difference = -difference;
+        }
+        int step = AdpcmSteps[index];
+        for (int bit = 4; bit; bit >>= 1, step >>= 1) {
+            if (difference >= step) {
+                code |= bit;
+                difference -= step;
+            }
+        }
+        // the decoder's state is what the encoder predicts from
+        update(code);
+        return code;
+    }
+};
+
+void encodeAdpcm(const qint16 *samples, qsizetype count, int channels, QByteArray &out)
+{
+    QList<AdpcmState> states(channels);
+    out.reserve(out.size() + (count + 1) / 2);
+    for (qsizetype i = 0; i < count; i += 2) {
+        const int low = states[i % channels].encode(samples[i]);
+        const int high = i + 1 < count ? states[(i + 1) % channels].encode(samples[i + 1]) : 0;
+        out.append(char(low | (high << 4)));
+    }
+}
+
+void decodeAdpcm(const char *data, qint16 *samples, qsizetype count, int channels)
+{
+    QList<AdpcmState> states(channels);
+    for (qsizetype i = 0; i < count; ++i) {
+        const uchar byte = uchar(data[i / 2]);
+        samples[i] = states[i % channels].update((i & 1) ? byte >> 4 : byte & 0xf);
+    }
+}
+
+} // namespace
+
+/*
+    Returns whether \a size bytes of audio in \a format can be compressed.
+    Only whole frames of 16 bit samples can.
+*/
+bool QTextToSpeechAudioCodec::canEncode(const QAudioFormat &format, qsizetype size)
+{
+    return format.sampleFormat() == QAudioFormat::Int16 && format.channelCount() > 0
+        && size > 0 && size % format.bytesPerFrame() == 0
+        && size / format.bytesPerSample() <= std::numeric_limits<quint32>::max();
+}
+
+QByteArray QTextToSpeechAudioCodec::encode(Compression compression, const QAudioFormat &format,
+                                           const QByteArray &pcm)
+{
+    if (compression == Compression::None || !canEncode(format, pcm.size()))
+        return pcm;
+
+    const qsizetype count = pcm.size() / format.bytesPerSample();
+    const int channels = format.channelCount();
+    const auto *samples = reinterpret_cast<const qint16 *>(pcm.constData());
+    QByteArray out(HeaderSize, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(count), out.data());
+    if (compression == Compression::Lossless)
+        encodeLossless(samples, count / channels, channels, out);
+    else
+        encodeAdpcm(samples, count, channels, out);
+    return out;
+}
+
+QByteArray QTextToSpeechAudioCodec::decode(Compression compression, const QAudioFormat &format,
+                                           const QByteArray &data)
+{
+    if (compression == Compression::None)
+        return data;
+    const int channels = format.channelCount();
+    if (format.sampleFormat() != QAudioFormat::Int16 || channels <= 0 || data.size() < HeaderSize)
+        return {};
+
+    const qsizetype count = qFromLittleEndian<quint32>(data.constData());
+    if (count % channels)
+        return {};
+    const char *payload = data.constData() + HeaderSize;
+    const qsizetype payloadSize = data.size() - HeaderSize;
+    // guards the allocation against corrupted files
+    if (compression == Compression::Lossy ? payloadSize != (count + 1) / 2
+                                          : payloadSize * 8 < count)
+        return {};
+
+    QByteArray pcm(count * qsizetype(sizeof(qint16)), Qt::Uninitialized);
+    auto *samples = reinterpret_cast<qint16 *>(pcm.data());
+    if (compression == Compression::Lossless) {
+        if (!decodeLossless(payload, payloadSize, samples, count / channels, channels))
+            return {};
+    } else {
+        decodeAdpcm(payload, samples, count, channels);
+    }
+    return pcm;
+}
+
+QT_END_NAMESPACE
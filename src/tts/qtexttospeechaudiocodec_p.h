@@ -0,0 +1,44 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHAUDIOCODEC_P_H
+#define QTEXTTOSPEECHAUDIOCODEC_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech.h>
+
+#include <QtCore/qbytearray.h>
+#include <QtMultimedia/qaudioformat.h>
+
+QT_BEGIN_NAMESPACE
+
+// Compresses 16 bit PCM for the audio cache. Each chunk is encoded on its own,
+// so that the chunks of an entry can be decoded one at a time as they are
+// replayed. Lossless uses a second order predictor with Rice coded residuals,
+// Lossy is IMA ADPCM with 4 bits per sample.
+class Q_TEXTTOSPEECH_EXPORT QTextToSpeechAudioCodec
+{
+public:
+    using Compression = QTextToSpeech::AudioCompression;
+
+    static bool canEncode(const QAudioFormat &format, qsizetype size);
+    static QByteArray encode(Compression compression, const QAudioFormat &format,
+                             const QByteArray &pcm);
+    // returns an empty array if the data is invalid
+    static QByteArray decode(Compression compression, const QAudioFormat &format,
+                             const QByteArray &data);
+};
+
+QT_END_NAMESPACE
+
+#endif
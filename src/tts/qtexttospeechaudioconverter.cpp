@@ -0,0 +1,302 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechaudioconverter_p.h"
+
+#include <QtCore/private/qsimd_p.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+void toFloat(const char *data, QAudioFormat::SampleFormat format, float *out, qsizetype count)
+{
+    qsizetype i = 0;
+    switch (format) {
+    case QAudioFormat::UInt8: {
+        const auto *in = reinterpret_cast<const quint8 *>(data);
+        for (; i < count; ++i)
+            out[i] = (int(in[i]) - 128) * (1.0f / 128.0f);
+        break;
+    }
+    case QAudioFormat::Int16: {
+        const auto *in = reinterpret_cast<const qint16 *>(data);
+        constexpr float scale = 1.0f / 32768.0f;
+#if defined(__SSE2__)
+        const __m128 factor = _mm_set1_ps(scale);
+        for (; i + 8 <= count; i += 8) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            // sign extend to 32 bit
+            const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(block, block), 16);
+            const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(block, block), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), factor));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), factor));
+        }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+        for (; i + 8 <= count; i += 8) {
+            const int16x8_t block = vld1q_s16(in + i);
+            const float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(block)));
+            const float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(block)));
+            vst1q_f32(out + i, vmulq_n_f32(low, scale));
+            vst1q_f32(out + i + 4, vmulq_n_f32(high, scale));
+        }
+#endif
+        for (; i < count; ++i)
+            out[i] = in[i] * scale;
+        break;
+    }
+    case QAudioFormat::Int32: {
+        const auto *in = reinterpret_cast<const qint32 *>(data);
+        for (; i < count; ++i)
+            out[i] = float(in[i] * (1.0 / 2147483648.0));
+        break;
+    }
+    case QAudioFormat::Float:
+        memcpy(out, data, count * sizeof(float));
+        break;
+    default:
+        std::fill(out, out + count, 0.0f);
+        break;
+    }
+}
+
+void fromFloat(const float *in, QAudioFormat::SampleFormat format, char *data, qsizetype count)
+{
+    qsizetype i = 0;
+    switch (format) {
+    case QAudioFormat::UInt8: {
+        auto *out = reinterpret_cast<quint8 *>(data);
+        for (; i < count; ++i)
+            out[i] = quint8(qBound(0, qRound(in[i] * 128.0f) + 128, 255));
+        break;
+    }
+    case QAudioFormat::Int16: {
+        auto *out = reinterpret_cast<qint16 *>(data);
+#if defined(__SSE2__)
+        const __m128 factor = _mm_set1_ps(32767.0f);
+        const __m128 lower = _mm_set1_ps(-1.0f);
+        const __m128 upper = _mm_set1_ps(1.0f);
+        for (; i + 8 <= count; i += 8) {
+            const __m128 low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lower), upper);
+            const __m128 high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lower), upper);
+            // converts with rounding to nearest, and packs with saturation
+            const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(low, factor)),
+                                                   _mm_cvtps_epi32(_mm_mul_ps(high, factor)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+        }
+#elif defined(__aarch64__)
+        for (; i + 8 <= count; i += 8) {
+            const int32x4_t low = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), 32767.0f));
+            const int32x4_t high = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32767.0f));
+            vst1q_s16(out + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+        }
+#endif
+        for (; i < count; ++i)
+            out[i] = qint16(qRound(qBound(-1.0f, in[i], 1.0f) * 32767.0f));
+        break;
+    }
+    case QAudioFormat::Int32: {
+        auto *out = reinterpret_cast<qint32 *>(data);
+        for (; i < count; ++i)
+            out[i] = qint32(std::llround(qBound(-1.0, double(in[i]), 1.0) * 2147483647.0));
+        break;
+    }
+    case QAudioFormat::Float:
+        memcpy(data, in, count * sizeof(float));
+        break;
+    default:
+        break;
+    }
+}
+
+// Mono is mixed down by averaging, and mono input is copied to all channels.
+// Otherwise, channels are dropped or silent channels are added.
+void mix(const float *in, qsizetype frames, int inChannels, float *out, int outChannels)
+{
+    if (outChannels == 1) {
+        const float scale = 1.0f / inChannels;
+        for (qsizetype frame = 0; frame < frames; ++frame, in += inChannels) {
+            float sum = 0;
+            for (int channel = 0; channel < inChannels; ++channel)
+                sum += in[channel];
+            out[frame] = sum * scale;
+        }
+    } else if (inChannels == 1) {
+        for (qsizetype frame = 0; frame < frames; ++frame, out += outChannels)
+            std::fill(out, out + outChannels, in[frame]);
+    } else {
+        const int common = std::min(inChannels, outChannels);
+        for (qsizetype frame = 0; frame < frames; ++frame, in += inChannels, out += outChannels) {
+            std::copy(in, in + common, out);
+            std::fill(out + common, out + outChannels, 0.0f);
+        }
+    }
+}
+
+} // namespace
+
+void QTextToSpeechAudioConverter::setTarget(const QAudioFormat &target)
+{
+    m_target = target;
+    reset();
+}
+
+/*
+    Returns whether the target format requests any conversion at all.
+*/
+bool QTextToSpeechAudioConverter::isActive() const
+{
+    return m_target.sampleRate() > 0 || m_target.channelCount() > 0
+        || m_target.sampleFormat() != QAudioFormat::Unknown;
+}
+
+/*
+    Returns the format that chunks in the \a input format are converted to.
+*/
+QAudioFormat QTextToSpeechAudioConverter::outputFormat(const QAudioFormat &input) const
+{
+    QAudioFormat output = input;
+    if (m_target.sampleRate() > 0)
+        output.setSampleRate(m_target.sampleRate());
+    if (m_target.channelCount() > 0 && m_target.channelCount() != input.channelCount()) {
+        if (m_target.channelConfig() != QAudioFormat::ChannelConfigUnknown)
+            output.setChannelConfig(m_target.channelConfig());
+        else
+            output.setChannelCount(m_target.channelCount());
+    }
+    if (m_target.sampleFormat() != QAudioFormat::Unknown)
+        output.setSampleFormat(m_target.sampleFormat());
+    return output;
+}
+
+/*
+    Forgets the state of the previous stream.
+*/
+void QTextToSpeechAudioConverter::reset()
+{
+    m_input = {};
+    m_pending.clear();
+    m_position = 0;
+    m_hasPrevious = false;
+    m_history.clear();
+}
+
+/*
+    Converts the \a bytes in \a format to outputFormat(). Audio that doesn't
+    need any conversion is returned as it is. A change of \a format starts a
+    new stream.
+*/
+QByteArray QTextToSpeechAudioConverter::convert(const QAudioFormat &format, const QByteArray &bytes)
+{
+    if (!isActive() || !format.isValid())
+        return bytes;
+    if (format != m_input) {
+        reset();
+        m_input = format;
+    }
+    const QAudioFormat output = outputFormat(format);
+    if (output == format)
+        return bytes;
+
+    const int inChannels = format.channelCount();
+    const int outChannels = output.channelCount();
+    const int frameSize = format.bytesPerFrame();
+    const QByteArray data = m_pending.isEmpty() ? bytes : m_pending + bytes;
+    const qsizetype frames = data.size() / frameSize;
+    m_pending = data.sliced(frames * frameSize);
+    if (!frames)
+        return {};
+
+    // the previous frame stays in front of the mixed audio
+    m_mixed.resize((frames + 1) * outChannels);
+    float *mixed = m_mixed.data() + outChannels;
+    if (inChannels == outChannels) {
+        toFloat(data.constData(), format.sampleFormat(), mixed, frames * inChannels);
+    } else {
+        m_samples.resize(frames * inChannels);
+        toFloat(data.constData(), format.sampleFormat(), m_samples.data(), m_samples.size());
+        mix(m_samples.constData(), frames, inChannels, mixed, outChannels);
+    }
+
+    const float *result = mixed;
+    qsizetype outFrames = frames;
+    if (output.sampleRate() != format.sampleRate()) {
+        const double step = double(format.sampleRate()) / output.sampleRate();
+        if (step > 1)
+            lowPass(mixed, frames, outChannels, int(std::ceil(step)));
+        resample(mixed, frames, outChannels, step);
+        result = m_resampled.constData();
+        outFrames = m_resampled.size() / outChannels;
+    }
+
+    QByteArray out(outFrames * output.bytesPerFrame(), Qt::Uninitialized);
+    fromFloat(result, output.sampleFormat(), out.data(), outFrames * outChannels);
+    return out;
+}
+
+/*
+    Replaces each of the \a frames at \a samples with the average of the
+    \a width input frames that end with it. Averaging over the frames of one
+    output step attenuates the frequencies above the output's Nyquist
+    frequency, which would otherwise alias when downsampling.
+*/
+void QTextToSpeechAudioConverter::lowPass(float *samples, qsizetype frames, int channels,
+                                          int width)
+{
+    // the stream starts with silence
+    const qsizetype history = qsizetype(width - 1) * channels;
+    if (m_history.size() != history)
+        m_history.fill(0.0f, history);
+
+    m_window.resize(history + frames * channels);
+    std::copy(m_history.cbegin(), m_history.cend(), m_window.begin());
+    std::copy(samples, samples + frames * channels, m_window.begin() + history);
+
+    const float scale = 1.0f / width;
+    for (qsizetype frame = 0; frame < frames; ++frame) {
+        const float *window = m_window.constData() + frame * channels;
+        for (int channel = 0; channel < channels; ++channel) {
+            float sum = 0;
+            for (int i = 0; i < width; ++i)
+                sum += window[i * channels + channel];
+            samples[frame * channels + channel] = sum * scale;
+        }
+    }
+    std::copy(m_window.cend() - history, m_window.cend(), m_history.begin());
+}
+
+/*
+    Interpolates between the \a frames at \a input, which is preceded by the
+    last frame of the previous chunk, in steps of \a step input frames.
+*/
+void QTextToSpeechAudioConverter::resample(const float *input, qsizetype frames, int channels,
+                                           double step)
+{
+    const float *base = m_hasPrevious ? input - channels : input;
+    const qsizetype last = frames - (m_hasPrevious ? 0 : 1);
+
+    m_resampled.resize(last > m_position
+                       ? (qsizetype((last - m_position) / step) + 1) * channels : 0);
+    float *out = m_resampled.data();
+    float *const end = out + m_resampled.size();
+    double position = m_position;
+    for (; position < last && out < end; position += step, out += channels) {
+        const qsizetype index = qsizetype(position);
+        const float fraction = float(position - index);
+        const float *a = base + index * channels;
+        const float *b = a + channels;
+        for (int channel = 0; channel < channels; ++channel)
+            out[channel] = a[channel] + (b[channel] - a[channel]) * fraction;
+    }
+    m_resampled.resize(out - m_resampled.data());
+
+    m_position = position - last;
+    std::copy(input + (frames - 1) * channels, input + frames * channels, m_mixed.data());
+    m_hasPrevious = true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,68 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHAUDIOCONVERTER_P_H
+#define QTEXTTOSPEECHAUDIOCONVERTER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech_global.h>
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtMultimedia/qaudioformat.h>
+
+QT_BEGIN_NAMESPACE
+
+// Converts a stream of synthesized audio chunks to a requested format. Properties
+// that are not set in the target format are taken from the input. The sample rate
+// is converted with linear interpolation, after a box filter when downsampling.
+// Both carry over from one chunk to the next, so reset() has to be called when a
+// new stream starts.
+class Q_TEXTTOSPEECH_EXPORT QTextToSpeechAudioConverter
+{
+public:
+    QTextToSpeechAudioConverter() = default;
+    explicit QTextToSpeechAudioConverter(const QAudioFormat &target) : m_target(target) {}
+
+    QAudioFormat target() const { return m_target; }
+    void setTarget(const QAudioFormat &target);
+    bool isActive() const;
+
+    QAudioFormat outputFormat(const QAudioFormat &input) const;
+    QByteArray convert(const QAudioFormat &format, const QByteArray &bytes);
+    void reset();
+
+private:
+    void lowPass(float *samples, qsizetype frames, int channels, int width);
+    void resample(const float *input, qsizetype frames, int channels, double step);
+
+    QAudioFormat m_target;
+    QAudioFormat m_input;
+    // bytes of an incomplete frame at the end of the last chunk
+    QByteArray m_pending;
+    // position of the next output frame, relative to the last input frame of the
+    // previous chunk, in input frames
+    double m_position = 0;
+    bool m_hasPrevious = false;
+    // the last input frames of the previous chunk that the low-pass filter needs
+    QList<float> m_history;
+    // reused between chunks; mixed audio has room for the previous frame in front
+    QList<float> m_samples;
+    QList<float> m_mixed;
+    QList<float> m_window;
+    QList<float> m_resampled;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,239 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechcache_p.h"
+#include "qtexttospeechaudiocodec_p.h"
+
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qdatastream.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+namespace {
+constexpr quint32 CacheFileMagic = 0x51545453; // "QTTS"
+// version 2 adds the word timings, version 3 the compression of each chunk
+constexpr quint32 CacheFileVersion = 3;
+constexpr quint32 CatalogFileMagic = 0x51545456; // "QTTV"
+constexpr quint32 CatalogFileVersion = 1;
+}
+
+QByteArray QTextToSpeechAudioCache::Chunk::pcm() const
+{
+    return QTextToSpeechAudioCodec::decode(compression, format, bytes);
+}
+
+qsizetype QTextToSpeechAudioCache::Entry::size() const
+{
+    qsizetype size = 0;
+    for (const auto &chunk : chunks)
+        size += chunk.bytes.size();
+    return size;
+}
+
+/*
+    Returns the key for synthesizing \a text with the given engine settings. The
+    text is normalized so that differences in whitespace don't produce new entries.
+*/
+QByteArray QTextToSpeechAudioCache::key(const QString &engine, const QVariantMap &params,
+                                        const QVoice &voice, double rate, double pitch,
+                                        double volume, const QString &text)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    // the voice includes its engine-specific data, as names need not be unique
+    stream << engine << params << voice << rate << pitch << volume << text.simplified();
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+/*
+    Returns the cached entry for \a key. Entries that are only available in the
+    cache directory are loaded into the memory cache. The audio data is
+    implicitly shared, so returning a copy is cheap.
+*/
+std::optional<QTextToSpeechAudioCache::Entry> QTextToSpeechAudioCache::find(const QByteArray &key)
+{
+    if (const Entry *entry = m_entries.object(key))
+        return *entry;
+    if (m_directory.isEmpty())
+        return std::nullopt;
+
+    Entry entry;
+    if (!readEntry(fileName(key), entry))
+        return std::nullopt;
+    if (m_entries.maxCost() > 0)
+        m_entries.insert(key, new Entry(entry), entry.size());
+    return entry;
+}
+
+/*
+    Stores \a entry for \a key. Chunks that are not compressed yet are
+    compressed with the compression() of the cache, if their format allows it.
+*/
+void QTextToSpeechAudioCache::insert(const QByteArray &key, Entry &&entry)
+{
+    if (entry.chunks.isEmpty())
+        return;
+    if (m_compression != QTextToSpeech::AudioCompression::None) {
+        for (Chunk &chunk : entry.chunks) {
+            if (chunk.compression != QTextToSpeech::AudioCompression::None
+                || !QTextToSpeechAudioCodec::canEncode(chunk.format, chunk.bytes.size())) {
+                continue;
+            }
+            chunk.bytes = QTextToSpeechAudioCodec::encode(m_compression, chunk.format,
+                                                          chunk.bytes);
+            chunk.compression = m_compression;
+        }
+    }
+    if (!m_directory.isEmpty())
+        writeEntry(fileName(key), entry);
+    if (m_entries.maxCost() > 0) {
+        const qsizetype cost = entry.size();
+        m_entries.insert(key, new Entry(std::move(entry)), cost);
+    }
+}
+
+QString QTextToSpeechAudioCache::fileName(const QByteArray &key) const
+{
+    return QDir(m_directory).filePath(QString::fromLatin1(key) + ".pcm"_L1);
+}
+
+bool QTextToSpeechAudioCache::readEntry(const QString &fileName, Entry &entry)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != CacheFileMagic || version < 1 || version > CacheFileVersion)
+        return false;
+
+    qint32 count = 0;
+    stream >> count;
+    entry.chunks.clear();
+    entry.chunks.reserve(count);
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 sampleRate = 0;
+        qint32 channelCount = 0;
+        qint32 sampleFormat = 0;
+        qint32 channelConfig = 0;
+        qint32 compression = 0;
+        QByteArray bytes;
+        stream >> sampleRate >> channelCount >> sampleFormat >> channelConfig;
+        if (version >= 3)
+            stream >> compression;
+        stream >> bytes;
+        // written by a later version
+        if (compression < 0 || compression > qint32(QTextToSpeech::AudioCompression::Lossy))
+            return false;
+
+        QAudioFormat format;
+        format.setSampleRate(sampleRate);
+        format.setChannelCount(channelCount);
+        format.setChannelConfig(QAudioFormat::ChannelConfig(channelConfig));
+        format.setSampleFormat(QAudioFormat::SampleFormat(sampleFormat));
+        entry.chunks.append({format, bytes, QTextToSpeech::AudioCompression(compression)});
+    }
+
+    entry.words.clear();
+    if (version >= 2) {
+        stream >> count;
+        for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            Word word;
+            qint64 start = 0;
+            qint64 length = 0;
+            stream >> word.text >> start >> length >> word.position;
+            word.start = start;
+            word.length = length;
+            entry.words.append(word);
+        }
+    }
+    return stream.status() == QDataStream::Ok && !entry.chunks.isEmpty();
+}
+
+bool QTextToSpeechAudioCache::writeEntry(const QString &fileName, const Entry &entry)
+{
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath()))
+        return false;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream << CacheFileMagic << CacheFileVersion << qint32(entry.chunks.size());
+    for (const Chunk &chunk : entry.chunks) {
+        const QAudioFormat &format = chunk.format;
+        stream << qint32(format.sampleRate()) << qint32(format.channelCount())
+               << qint32(format.sampleFormat()) << qint32(format.channelConfig())
+               << qint32(chunk.compression) << chunk.bytes;
+    }
+    stream << qint32(entry.words.size());
+    for (const Word &word : entry.words)
+        stream << word.text << qint64(word.start) << qint64(word.length) << word.position;
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+/*
+    Returns the file in \a directory for the voices of \a engine. Another
+    version of the plug-in, or other engine parameters, use another file.
+*/
+QString QTextToSpeechVoiceCatalog::fileName(const QString &directory, const QString &engine,
+                                            const QCborMap &metaData, const QVariantMap &params)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << metaData.value("Version"_L1).toInteger() << params;
+    const QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    return QDir(directory).filePath(
+            "voices-"_L1 + engine + u'-' + QString::fromLatin1(hash.left(16)) + ".bin"_L1);
+}
+
+// Returns the stored voices, or an empty list if the file is missing or invalid
+QList<QVoice> QTextToSpeechVoiceCatalog::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 streamVersion = 0;
+    stream >> magic >> version >> streamVersion;
+    if (magic != CatalogFileMagic || version != CatalogFileVersion
+        || streamVersion != stream.version()) {
+        return {};
+    }
+
+    QList<QVoice> voices;
+    stream >> voices;
+    if (stream.status() != QDataStream::Ok)
+        return {};
+    return voices;
+}
+
+bool QTextToSpeechVoiceCatalog::write(const QString &fileName, const QList<QVoice> &voices)
+{
+    if (!QDir().mkpath(QFileInfo(fileName).absolutePath()))
+        return false;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&file);
+    // the voices are stored in the format of the Qt version that wrote them
+    stream << CatalogFileMagic << CatalogFileVersion << qint32(stream.version()) << voices;
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,103 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHCACHE_P_H
+#define QTEXTTOSPEECHCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech.h>
+#include <QtTextToSpeech/qvoice.h>
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qcache.h>
+#include <QtCore/qcbormap.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qvariantmap.h>
+#include <QtMultimedia/qaudioformat.h>
+
+#include <optional>
+
+QT_BEGIN_NAMESPACE
+
+class QTextToSpeechAudioCache
+{
+public:
+    struct Word
+    {
+        QString text;
+        qsizetype start;
+        qsizetype length;
+        qint64 position; // in microseconds
+    };
+
+    struct Chunk
+    {
+        QAudioFormat format;
+        QByteArray bytes;
+        QTextToSpeech::AudioCompression compression = QTextToSpeech::AudioCompression::None;
+
+        // the PCM data of the chunk, empty if it cannot be decoded
+        QByteArray pcm() const;
+    };
+
+    struct Entry
+    {
+        QList<Chunk> chunks;
+        QList<Word> words;
+
+        qsizetype size() const;
+    };
+
+    static QByteArray key(const QString &engine, const QVariantMap &params, const QVoice &voice,
+                          double rate, double pitch, double volume, const QString &text);
+
+    qsizetype maxCost() const { return m_entries.maxCost(); }
+    void setMaxCost(qsizetype maxCost) { m_entries.setMaxCost(maxCost); }
+
+    QString directory() const { return m_directory; }
+    void setDirectory(const QString &directory) { m_directory = directory; }
+
+    QTextToSpeech::AudioCompression compression() const { return m_compression; }
+    void setCompression(QTextToSpeech::AudioCompression compression)
+    {
+        m_compression = compression;
+    }
+
+    std::optional<Entry> find(const QByteArray &key);
+    void insert(const QByteArray &key, Entry &&entry);
+
+private:
+    QString fileName(const QByteArray &key) const;
+    static bool readEntry(const QString &fileName, Entry &entry);
+    static bool writeEntry(const QString &fileName, const Entry &entry);
+
+    QCache<QByteArray, Entry> m_entries{0};
+    QString m_directory;
+    QTextToSpeech::AudioCompression m_compression = QTextToSpeech::AudioCompression::None;
+};
+
+// The voices of an engine, stored on disk so that they are known before the
+// engine has enumerated them.
+class QTextToSpeechVoiceCatalog
+{
+public:
+    static QString fileName(const QString &directory, const QString &engine,
+                            const QCborMap &metaData, const QVariantMap &params);
+    static QList<QVoice> read(const QString &fileName);
+    static bool write(const QString &fileName, const QList<QVoice> &voices);
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,171 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechcacheplayer_p.h"
+#include "qtexttospeechaudioconverter_p.h"
+
+#include <QtCore/qdebug.h>
+#include <QtMultimedia/qaudiosink.h>
+#include <QtMultimedia/qmediadevices.h>
+
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+// how often the position of the audio output is checked for the next word
+static constexpr int WordInterval = 10;
+
+QTextToSpeechCachePlayer::QTextToSpeechCachePlayer(QObject *parent)
+    : QObject(parent)
+{}
+
+QTextToSpeechCachePlayer::~QTextToSpeechCachePlayer()
+{
+    m_wordTimer.stop();
+    if (m_sink) {
+        m_sink->disconnect(this);
+        m_sink->stop();
+    }
+}
+
+/*
+    Starts playing the audio of \a entry with \a volume. Returns false if the
+    audio can't be decoded, or the audio output can't play it, in which case
+    the engine has to speak the text.
+*/
+bool QTextToSpeechCachePlayer::play(const QTextToSpeechAudioCache::Entry &entry, double volume)
+{
+    release();
+
+    // the output plays one format, so chunks in other formats are converted
+    QAudioFormat format;
+    QTextToSpeechAudioConverter converter;
+    QByteArray pcm;
+    for (const auto &chunk : entry.chunks) {
+        const QByteArray bytes = chunk.pcm();
+        if (bytes.isEmpty())
+            continue;
+        if (!format.isValid()) {
+            format = chunk.format;
+            converter.setTarget(format);
+        }
+        pcm += converter.convert(chunk.format, bytes);
+    }
+    if (pcm.isEmpty())
+        return false;
+
+    m_buffer.setData(pcm);
+    m_buffer.open(QIODevice::ReadOnly);
+    m_sink = std::make_unique<QAudioSink>(QMediaDevices::defaultAudioOutput(), format);
+    m_sink->setVolume(volume);
+    connect(m_sink.get(), &QAudioSink::stateChanged,
+            this, &QTextToSpeechCachePlayer::sinkStateChanged);
+    m_sink->start(&m_buffer);
+    if (m_sink->error() != QAudio::NoError) {
+        qWarning() << "Cannot play cached audio:" << m_sink->error();
+        release();
+        return false;
+    }
+
+    m_words = entry.words;
+    m_nextWord = 0;
+    setState(QTextToSpeech::Speaking);
+    reportWords(0);
+    if (m_state == QTextToSpeech::Speaking)
+        m_wordTimer.start(WordInterval, this);
+    return true;
+}
+
+void QTextToSpeechCachePlayer::stop()
+{
+    if (m_state == QTextToSpeech::Ready)
+        return;
+    release();
+    setState(QTextToSpeech::Ready);
+}
+
+void QTextToSpeechCachePlayer::pause()
+{
+    if (m_state != QTextToSpeech::Speaking)
+        return;
+    m_wordTimer.stop();
+    m_sink->suspend();
+    setState(QTextToSpeech::Paused);
+}
+
+void QTextToSpeechCachePlayer::resume()
+{
+    if (m_state != QTextToSpeech::Paused)
+        return;
+    m_sink->resume();
+    m_wordTimer.start(WordInterval, this);
+    setState(QTextToSpeech::Speaking);
+}
+
+void QTextToSpeechCachePlayer::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_wordTimer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+    if (m_sink)
+        reportWords(m_sink->processedUSecs());
+}
+
+// Reports the words that start before \a position, in microseconds
+void QTextToSpeechCachePlayer::reportWords(qint64 position)
+{
+    while (m_nextWord < m_words.size() && m_words.at(m_nextWord).position <= position) {
+        const QTextToSpeechAudioCache::Word word = m_words.at(m_nextWord++);
+        emit sayingWord(word.text, word.start, word.length);
+        // a connected slot might have stopped us
+        if (m_state != QTextToSpeech::Speaking)
+            return;
+    }
+}
+
+void QTextToSpeechCachePlayer::sinkStateChanged(QAudio::State state)
+{
+    switch (state) {
+    case QAudio::IdleState:
+        // all audio has been played
+        if (m_buffer.atEnd()) {
+            reportWords(std::numeric_limits<qint64>::max());
+            if (m_state == QTextToSpeech::Speaking)
+                stop();
+        }
+        break;
+    case QAudio::StoppedState:
+        if (m_sink && m_sink->error() != QAudio::NoError) {
+            qWarning() << "Playing cached audio failed:" << m_sink->error();
+            stop();
+        }
+        break;
+    case QAudio::ActiveState:
+    case QAudio::SuspendedState:
+        break;
+    }
+}
+
+void QTextToSpeechCachePlayer::release()
+{
+    m_wordTimer.stop();
+    if (m_sink) {
+        m_sink->disconnect(this);
+        m_sink->stop();
+        // we might be called from the sink's signal
+        m_sink.release()->deleteLater();
+    }
+    m_buffer.close();
+    m_words.clear();
+}
+
+void QTextToSpeechCachePlayer::setState(QTextToSpeech::State state)
+{
+    if (m_state == state)
+        return;
+    m_state = state;
+    emit stateChanged(state);
+}
+
+QT_END_NAMESPACE
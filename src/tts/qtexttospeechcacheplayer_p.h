@@ -0,0 +1,71 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHCACHEPLAYER_P_H
+#define QTEXTTOSPEECHCACHEPLAYER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech.h>
+#include "qtexttospeechcache_p.h"
+
+#include <QtCore/qbasictimer.h>
+#include <QtCore/qbuffer.h>
+#include <QtCore/qobject.h>
+#include <QtMultimedia/qaudio.h>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAudioSink;
+
+// Speaks audio from the audio cache with the default audio output, and
+// reports the words of it when the output reaches them, as engines do.
+class QTextToSpeechCachePlayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QTextToSpeechCachePlayer(QObject *parent = nullptr);
+    ~QTextToSpeechCachePlayer() override;
+
+    bool play(const QTextToSpeechAudioCache::Entry &entry, double volume);
+    void stop();
+    void pause();
+    void resume();
+
+    QTextToSpeech::State state() const { return m_state; }
+
+Q_SIGNALS:
+    void stateChanged(QTextToSpeech::State state);
+    void sayingWord(const QString &word, qsizetype start, qsizetype length);
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void reportWords(qint64 position);
+    void sinkStateChanged(QAudio::State state);
+    void release();
+    void setState(QTextToSpeech::State state);
+
+    std::unique_ptr<QAudioSink> m_sink;
+    QBuffer m_buffer;
+    QList<QTextToSpeechAudioCache::Word> m_words;
+    qsizetype m_nextWord = 0;
+    QBasicTimer m_wordTimer;
+    QTextToSpeech::State m_state = QTextToSpeech::Ready;
+};
+
+QT_END_NAMESPACE
+
+#endif
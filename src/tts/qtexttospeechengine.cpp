@@ -37,6 +37,54 @@ QT_BEGIN_NAMESPACE
     Implementation of \l QTextToSpeech::availableVoices().
 */
 
+/*!
+    Returns all voices for \a locale, or all voices of the engine if \a locale
+    is \nullptr. Used by \l QTextToSpeech::findVoices().
+
+    The default implementation sets each locale in turn to collect the
+    availableVoices(), and restores the current voice afterwards. Engines that
+    know all their voices anyway should reimplement this function to avoid
+    that.
+*/
+QList<QVoice> QTextToSpeechEngine::allVoices(const QLocale *locale) const
+{
+    QTextToSpeechEngine *that = const_cast<QTextToSpeechEngine *>(this);
+    const QVoice oldVoice = voice();
+
+    QList<QVoice> voices;
+    const QList<QLocale> allLocales = locale ? QList<QLocale>{*locale} : availableLocales();
+    for (const auto &l : allLocales) {
+        if (this->locale() != l)
+            that->setLocale(l);
+        voices << availableVoices();
+    }
+
+    // reset back to old voice, which will have changed when we changed the
+    // engine's locale.
+    if (voice() != oldVoice)
+        that->setVoice(oldVoice);
+
+    return voices;
+}
+
+/*!
+    \since 6.10
+
+    Implementation of \l QTextToSpeech::setSynthesizeBufferLimit().
+
+    Engines that synthesize in a different thread than the one the engine
+    lives in should not let more than \a bytes of audio data queue up
+    between that thread and synthesized(). Once data is emitted through
+    synthesized(), all receivers in the engine's thread are done with it.
+    If \a bytes is 0, there is no limit.
+
+    The default implementation does nothing.
+*/
+void QTextToSpeechEngine::setSynthesizeBufferLimit(qsizetype bytes)
+{
+    Q_UNUSED(bytes);
+}
+
 /*!
     \fn void QTextToSpeechEngine::say(const QString &text)
 
@@ -147,6 +195,37 @@ QT_BEGIN_NAMESPACE
     This signal is connected to QTextToSpeech::stateChanged() signal.
 */
 
+/*!
+    \fn void QTextToSpeechEngine::synthesizedWord(const QString &word, qsizetype start, qsizetype length, qint64 position)
+    \since 6.10
+
+    Emitted while synthesizing, for the \a word that is the slice of the text
+    given by \a start and \a length. The \a position is the time, in
+    microseconds, at which the word starts in the synthesized audio.
+
+    This signal is connected to QTextToSpeech::synthesizedWord() signal.
+*/
+
+/*!
+    \fn void QTextToSpeechEngine::audioUnderrun()
+    \since 6.10
+
+    Emitted when the audio output ran out of data while the engine was
+    speaking, before the end of the text.
+
+    QTextToSpeech counts these signals in QTextToSpeechMetrics::underruns().
+*/
+
+/*!
+    \fn void QTextToSpeechEngine::voicesChanged()
+    \since 6.10
+
+    Emitted when the voices that the engine supports have changed, for instance
+    because the engine has finished loading them after becoming ready.
+
+    This signal is connected to QTextToSpeech::voicesChanged() signal.
+*/
+
 /*!
     Constructs the text-to-speech engine base class with \a parent.
 */
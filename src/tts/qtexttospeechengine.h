@@ -60,6 +60,10 @@ public:
     virtual QTextToSpeech::ErrorReason errorReason() const = 0;
     virtual QString errorString() const = 0;
 
+    // new virtual functions go last, so that existing plugins keep working
+    virtual QList<QVoice> allVoices(const QLocale *locale) const;
+    virtual void setSynthesizeBufferLimit(qsizetype bytes);
+
 protected:
     static QVoice createVoice(const QString &name, const QLocale &locale, QVoice::Gender gender,
                               QVoice::Age age, const QVariant &data);
@@ -71,6 +75,9 @@ Q_SIGNALS:
 
     void sayingWord(const QString &word, qsizetype start, qsizetype length);
     void synthesized(const QAudioFormat &format, const QByteArray &data);
+    void synthesizedWord(const QString &word, qsizetype start, qsizetype length, qint64 position);
+    void audioUnderrun();
+    void voicesChanged();
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,165 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechmetrics.h"
+#include "qtexttospeechmetrics_p.h"
+
+QT_BEGIN_NAMESPACE
+
+QT_DEFINE_QSDP_SPECIALIZATION_DTOR(QTextToSpeechMetricsPrivate)
+
+/*!
+    \class QTextToSpeechMetrics
+    \brief The QTextToSpeechMetrics class describes how fast the engine
+    processed the texts of a QTextToSpeech object.
+    \inmodule QtTextToSpeech
+    \since 6.10
+
+    Use QTextToSpeech::metrics() to get the values for the utterances that the
+    engine has finished since the QTextToSpeech object was created, or since
+    QTextToSpeech::resetMetrics() was called. All times are in microseconds.
+
+    Utterances that are stopped, or that fail, are not measured. Neither is
+    audio that is delivered from the \l{QTextToSpeech::audioCacheLimit}{audio
+    cache}, as the engine doesn't process those texts.
+*/
+
+/*!
+    Constructs a QTextToSpeechMetrics object without any measurements.
+*/
+QTextToSpeechMetrics::QTextToSpeechMetrics()
+    : d(new QTextToSpeechMetricsPrivate)
+{}
+
+/*!
+    Copy-constructs a QTextToSpeechMetrics from \a other.
+*/
+QTextToSpeechMetrics::QTextToSpeechMetrics(const QTextToSpeechMetrics &other) noexcept
+    : d(other.d)
+{}
+
+/*!
+    Destroys the QTextToSpeechMetrics instance.
+*/
+QTextToSpeechMetrics::~QTextToSpeechMetrics()
+{}
+
+/*!
+    \fn QTextToSpeechMetrics::QTextToSpeechMetrics(QTextToSpeechMetrics &&other)
+
+    Constructs a QTextToSpeechMetrics object by moving from \a other.
+*/
+
+/*!
+    \fn QTextToSpeechMetrics &QTextToSpeechMetrics::operator=(QTextToSpeechMetrics &&other)
+    Moves \a other into this QTextToSpeechMetrics object.
+*/
+
+/*!
+    Assigns \a other to this QTextToSpeechMetrics object.
+*/
+QTextToSpeechMetrics &QTextToSpeechMetrics::operator=(const QTextToSpeechMetrics &other) noexcept
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    \fn void QTextToSpeechMetrics::swap(QTextToSpeechMetrics &other)
+
+    Swaps \a other with this object. This operation is very fast and never fails.
+*/
+
+/*!
+    Returns the number of texts that were waiting to be processed when the
+    metrics were requested.
+*/
+qsizetype QTextToSpeechMetrics::queueDepth() const noexcept
+{
+    return d->queueDepth;
+}
+
+/*!
+    Returns the number of utterances that the engine finished speaking or
+    synthesizing.
+*/
+qsizetype QTextToSpeechMetrics::utterances() const noexcept
+{
+    return d->utterances;
+}
+
+/*!
+    Returns how long the engine took for the last utterance, from starting
+    with the text until it had spoken or synthesized all of it.
+
+    \sa averageLatency()
+*/
+qint64 QTextToSpeechMetrics::lastLatency() const noexcept
+{
+    return d->lastLatency;
+}
+
+/*!
+    Returns how long the engine took for an utterance on average.
+
+    \sa lastLatency()
+*/
+qint64 QTextToSpeechMetrics::averageLatency() const noexcept
+{
+    return d->utterances ? d->totalLatency / d->utterances : 0;
+}
+
+/*!
+    Returns the time between the engine starting with the last utterance, and
+    the engine starting to speak it or delivering the first audio data of it.
+
+    \sa averageTimeToFirstAudio()
+*/
+qint64 QTextToSpeechMetrics::lastTimeToFirstAudio() const noexcept
+{
+    return d->lastTimeToFirstAudio;
+}
+
+/*!
+    Returns the average time until the engine started to speak an utterance,
+    or delivered the first audio data of it.
+
+    \sa lastTimeToFirstAudio()
+*/
+qint64 QTextToSpeechMetrics::averageTimeToFirstAudio() const noexcept
+{
+    return d->firstAudioCount ? d->totalTimeToFirstAudio / d->firstAudioCount : 0;
+}
+
+/*!
+    Returns the time the engine took to synthesize audio, divided by the
+    duration of that audio. With a value below 1, the engine synthesizes
+    faster than the audio plays. Only synthesized utterances are included,
+    as spoken utterances are played in real time.
+
+    Returns 0 if no utterance was synthesized.
+*/
+double QTextToSpeechMetrics::realTimeFactor() const noexcept
+{
+    return d->synthesizedDuration ? double(d->synthesisTime) / d->synthesizedDuration : 0.0;
+}
+
+/*!
+    Returns the number of bytes of audio data the engine synthesized.
+*/
+qint64 QTextToSpeechMetrics::bytesSynthesized() const noexcept
+{
+    return d->bytesSynthesized;
+}
+
+/*!
+    Returns how often the audio output ran out of data while the engine
+    was speaking, so that the speech was interrupted. Only the \c flite and
+    \c winrt engines report underruns.
+*/
+qsizetype QTextToSpeechMetrics::underruns() const noexcept
+{
+    return d->underruns;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,66 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHMETRICS_H
+#define QTEXTTOSPEECHMETRICS_H
+
+#include <QtTextToSpeech/qtexttospeech_global.h>
+#include <QtCore/qobjectdefs.h>
+#include <QtCore/qshareddata.h>
+
+QT_BEGIN_NAMESPACE
+
+class QTextToSpeechMetricsPrivate;
+
+QT_DECLARE_QSDP_SPECIALIZATION_DTOR_WITH_EXPORT(QTextToSpeechMetricsPrivate, Q_TEXTTOSPEECH_EXPORT)
+
+class Q_TEXTTOSPEECH_EXPORT QTextToSpeechMetrics
+{
+    Q_GADGET
+    Q_PROPERTY(qsizetype queueDepth READ queueDepth CONSTANT)
+    Q_PROPERTY(qsizetype utterances READ utterances CONSTANT)
+    Q_PROPERTY(qint64 lastLatency READ lastLatency CONSTANT)
+    Q_PROPERTY(qint64 averageLatency READ averageLatency CONSTANT)
+    Q_PROPERTY(qint64 lastTimeToFirstAudio READ lastTimeToFirstAudio CONSTANT)
+    Q_PROPERTY(qint64 averageTimeToFirstAudio READ averageTimeToFirstAudio CONSTANT)
+    Q_PROPERTY(double realTimeFactor READ realTimeFactor CONSTANT)
+    Q_PROPERTY(qint64 bytesSynthesized READ bytesSynthesized CONSTANT)
+    Q_PROPERTY(qsizetype underruns READ underruns CONSTANT)
+
+public:
+    QTextToSpeechMetrics();
+    ~QTextToSpeechMetrics();
+    QTextToSpeechMetrics(const QTextToSpeechMetrics &other) noexcept;
+    QTextToSpeechMetrics &operator=(const QTextToSpeechMetrics &other) noexcept;
+    QTextToSpeechMetrics(QTextToSpeechMetrics &&other) noexcept = default;
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_PURE_SWAP(QTextToSpeechMetrics)
+
+    void swap(QTextToSpeechMetrics &other) noexcept
+    { d.swap(other.d); }
+
+    qsizetype queueDepth() const noexcept;
+    qsizetype utterances() const noexcept;
+
+    qint64 lastLatency() const noexcept;
+    qint64 averageLatency() const noexcept;
+
+    qint64 lastTimeToFirstAudio() const noexcept;
+    qint64 averageTimeToFirstAudio() const noexcept;
+
+    double realTimeFactor() const noexcept;
+    qint64 bytesSynthesized() const noexcept;
+
+    qsizetype underruns() const noexcept;
+
+private:
+    friend class QTextToSpeech;
+    friend class QTextToSpeechPrivate;
+
+    QSharedDataPointer<QTextToSpeechMetricsPrivate> d;
+};
+
+Q_DECLARE_SHARED(QTextToSpeechMetrics)
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,44 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHMETRICS_P_H
+#define QTEXTTOSPEECHMETRICS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <qtexttospeechmetrics.h>
+
+#include <QtCore/qshareddata.h>
+#include <private/qglobal_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QTextToSpeechMetricsPrivate : public QSharedData
+{
+public:
+    qsizetype queueDepth = 0;
+    qsizetype utterances = 0;
+    // all times in microseconds
+    qint64 lastLatency = 0;
+    qint64 totalLatency = 0;
+    qint64 lastTimeToFirstAudio = 0;
+    qint64 totalTimeToFirstAudio = 0;
+    qsizetype firstAudioCount = 0;
+    qint64 synthesisTime = 0;
+    qint64 synthesizedDuration = 0;
+    qint64 bytesSynthesized = 0;
+    qsizetype underruns = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,132 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHREMOTE_P_H
+#define QTEXTTOSPEECHREMOTE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech_global.h>
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qdatastream.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qlocale.h>
+#include <QtCore/qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+// Protocol between the "remote" engine and the speech server. Each message is
+// a big-endian 32 bit size, followed by that many bytes of QDataStream data
+// that start with the Message type.
+namespace QTextToSpeechRemote {
+
+inline constexpr quint32 ProtocolVersion = 1;
+inline constexpr QDataStream::Version StreamVersion = QDataStream::Qt_6_8;
+
+inline QString defaultServerName()
+{
+    return QStringLiteral("qt-texttospeech");
+}
+
+enum class Message : quint8 {
+    // engine to server
+    Hello,          // version, engine, parameters
+    Say,            // request, text
+    Synthesize,     // request, text
+    Stop,           // boundary hint
+    Pause,          // boundary hint
+    Resume,
+    SetRate,        // rate
+    SetPitch,       // pitch
+    SetVolume,      // volume
+    SetVoice,       // index in the voice list
+
+    // server to engine
+    Init,           // capabilities, state, error reason, error string, voices,
+                    // voice index, rate, pitch, volume
+    Voices,         // voices, voice index
+    State,          // request, state
+    Error,          // request, error reason, error string
+    SayingWord,     // request, word, start, length
+    Synthesized,    // request, sample rate, channel count, sample format, data
+    SynthesizedWord // request, word, start, length, position
+};
+
+// A voice of the server's engine; the engine refers to it by its index
+struct Voice
+{
+    QString name;
+    QLocale locale;
+    qint32 gender = 0;
+    qint32 age = 0;
+};
+
+inline QDataStream &operator<<(QDataStream &out, const Voice &voice)
+{
+    return out << voice.name << voice.locale << voice.gender << voice.age;
+}
+
+inline QDataStream &operator>>(QDataStream &in, Voice &voice)
+{
+    return in >> voice.name >> voice.locale >> voice.gender >> voice.age;
+}
+
+template <typename ...Args>
+void send(QIODevice *device, Message message, const Args &...args)
+{
+    QByteArray frame(sizeof(quint32), Qt::Uninitialized);
+    {
+        QDataStream out(&frame, QIODevice::WriteOnly | QIODevice::Append);
+        out.setVersion(StreamVersion);
+        out << quint8(message);
+        (out << ... << args);
+    }
+    qToBigEndian<quint32>(quint32(frame.size() - sizeof(quint32)), frame.data());
+    device->write(frame);
+}
+
+// Collects the data of a device until it holds complete messages
+class Reader
+{
+public:
+    void read(QIODevice *device) { m_buffer += device->readAll(); }
+
+    // takes the next complete message, if there is one
+    bool next(Message *message, QByteArray *payload)
+    {
+        if (m_buffer.size() < qsizetype(sizeof(quint32)))
+            return false;
+        const qsizetype size = qFromBigEndian<quint32>(m_buffer.constData());
+        if (m_buffer.size() < qsizetype(sizeof(quint32)) + size)
+            return false;
+        if (size < 1) {
+            m_buffer.remove(0, sizeof(quint32));
+            return next(message, payload);
+        }
+        *message = Message(quint8(m_buffer.at(sizeof(quint32))));
+        *payload = m_buffer.sliced(sizeof(quint32) + 1, size - 1);
+        m_buffer.remove(0, sizeof(quint32) + size);
+        return true;
+    }
+
+private:
+    QByteArray m_buffer;
+};
+
+} // namespace QTextToSpeechRemote
+
+QT_END_NAMESPACE
+
+#endif
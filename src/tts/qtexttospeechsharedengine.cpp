@@ -0,0 +1,478 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechsharedengine_p.h"
+#include "qtexttospeechplugin.h"
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qthread.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+struct EngineHosts
+{
+    QMutex mutex;
+    QList<std::weak_ptr<QTextToSpeechEngineHost>> hosts;
+};
+}
+Q_GLOBAL_STATIC(EngineHosts, engineHosts)
+
+/*
+    Returns the host for the engine that \a plugin creates for \a provider with
+    \a params in the current thread, creating it if there is none yet.
+*/
+std::shared_ptr<QTextToSpeechEngineHost>
+QTextToSpeechEngineHost::instance(QTextToSpeechPlugin *plugin, const QString &provider,
+                                  const QVariantMap &params, QString *errorString)
+{
+    EngineHosts *registry = engineHosts();
+    QMutexLocker lock(&registry->mutex);
+    registry->hosts.removeIf([](const auto &host) { return host.expired(); });
+    for (const auto &weakHost : std::as_const(registry->hosts)) {
+        auto host = weakHost.lock();
+        if (host && host->thread() == QThread::currentThread()
+            && host->m_provider == provider && host->m_params == params) {
+            return host;
+        }
+    }
+
+    QTextToSpeechEngine *engine = plugin->createTextToSpeechEngine(params, nullptr, errorString);
+    if (!engine)
+        return nullptr;
+
+    std::shared_ptr<QTextToSpeechEngineHost> host(
+            new QTextToSpeechEngineHost(engine, provider, params));
+    registry->hosts.append(host);
+    return host;
+}
+
+QTextToSpeechEngineHost::QTextToSpeechEngineHost(QTextToSpeechEngine *engine,
+                                                 const QString &provider,
+                                                 const QVariantMap &params)
+    : m_engine(engine), m_provider(provider), m_params(params)
+    , m_initialized(engine->state() != QTextToSpeech::Error)
+{
+    connect(engine, &QTextToSpeechEngine::stateChanged,
+            this, &QTextToSpeechEngineHost::engineStateChanged);
+    connect(engine, &QTextToSpeechEngine::errorOccurred,
+            this, &QTextToSpeechEngineHost::engineErrorOccurred);
+    connect(engine, &QTextToSpeechEngine::sayingWord,
+            this, [this](const QString &word, qsizetype start, qsizetype length) {
+        if (m_active) {
+            m_active->m_wordEnd = start + length;
+            emit m_active->sayingWord(word, m_active->m_textOffset + start, length);
+        }
+    });
+    connect(engine, &QTextToSpeechEngine::synthesized,
+            this, [this](const QAudioFormat &format, const QByteArray &data) {
+        if (m_active)
+            emit m_active->synthesized(format, data);
+    });
+    connect(engine, &QTextToSpeechEngine::synthesizedWord,
+            this, [this](const QString &word, qsizetype start, qsizetype length,
+                         qint64 position) {
+        if (m_active)
+            emit m_active->synthesizedWord(word, start, length, position);
+    });
+    connect(engine, &QTextToSpeechEngine::audioUnderrun, this, [this] {
+        if (m_active)
+            emit m_active->audioUnderrun();
+    });
+    connect(engine, &QTextToSpeechEngine::voicesChanged,
+            this, &QTextToSpeechEngineHost::engineVoicesChanged);
+}
+
+QTextToSpeechEngineHost::~QTextToSpeechEngineHost()
+{
+    Q_ASSERT(m_clients.isEmpty());
+}
+
+bool QTextToSpeechEngineHost::isWaiting(const QTextToSpeechSharedEngine *client) const
+{
+    return m_waiting.contains(client);
+}
+
+void QTextToSpeechEngineHost::addClient(QTextToSpeechSharedEngine *client)
+{
+    m_clients.append(client);
+}
+
+void QTextToSpeechEngineHost::removeClient(QTextToSpeechSharedEngine *client)
+{
+    cancel(client);
+    m_clients.removeOne(client);
+}
+
+void QTextToSpeechEngineHost::request(QTextToSpeechSharedEngine *client)
+{
+    Q_ASSERT(client != m_active);
+    if (!m_waiting.contains(client)) {
+        // a client that gave up the engine while paused continues first
+        if (std::exchange(client->m_yielded, false))
+            m_waiting.prepend(client);
+        else
+            m_waiting.enqueue(client);
+    }
+    yieldPaused();
+    schedule();
+}
+
+void QTextToSpeechEngineHost::cancel(QTextToSpeechSharedEngine *client)
+{
+    m_waiting.removeOne(client);
+    if (m_active == client) {
+        m_active = nullptr;
+        m_engine->stop(QTextToSpeech::BoundaryHint::Immediate);
+        schedule();
+    }
+}
+
+void QTextToSpeechEngineHost::schedule()
+{
+    if (m_active || m_waiting.isEmpty())
+        return;
+
+    switch (m_engine->state()) {
+    case QTextToSpeech::Speaking:
+    case QTextToSpeech::Synthesizing:
+    case QTextToSpeech::Paused:
+        // still busy with a cancelled request; continue when it's done
+        return;
+    case QTextToSpeech::Ready:
+    case QTextToSpeech::Error:
+        break;
+    }
+
+    m_active = m_waiting.dequeue();
+    m_active->start();
+}
+
+/*
+    Lets the waiting clients use the engine while the active client is paused.
+    The engine can't continue a text it was stopped in, so the paused client
+    continues with the words it has not spoken yet once it resumes.
+*/
+void QTextToSpeechEngineHost::yieldPaused()
+{
+    if (!m_active || m_waiting.isEmpty() || m_engine->state() != QTextToSpeech::Paused
+        || m_active->m_request != QTextToSpeechSharedEngine::Request::Say) {
+        return;
+    }
+    QTextToSpeechSharedEngine *client = m_active;
+    // skip whitespace and punctuation after the last word
+    qsizetype resumeAt = client->m_wordEnd;
+    while (resumeAt < client->m_text.size() && !client->m_text.at(resumeAt).isLetterOrNumber())
+        ++resumeAt;
+    // nothing left to say, so resuming finishes right away
+    if (resumeAt == client->m_text.size())
+        return;
+
+    client->m_textOffset += resumeAt;
+    client->m_text = client->m_text.sliced(resumeAt);
+    client->m_wordEnd = 0;
+    client->m_yielded = true;
+    m_active = nullptr;
+    m_engine->stop(QTextToSpeech::BoundaryHint::Immediate);
+    schedule();
+}
+
+void QTextToSpeechEngineHost::engineStateChanged(QTextToSpeech::State state)
+{
+    if (!m_active) {
+        // asynchronously initialized engines become ready, or fail, for everyone
+        if (!m_initialized && (state == QTextToSpeech::Ready || state == QTextToSpeech::Error)) {
+            m_initialized = state == QTextToSpeech::Ready;
+            for (QTextToSpeechSharedEngine *client : std::as_const(m_clients)) {
+                if (client->m_request == QTextToSpeechSharedEngine::Request::None)
+                    client->setState(state);
+            }
+        }
+        schedule();
+        return;
+    }
+
+    switch (state) {
+    case QTextToSpeech::Speaking:
+    case QTextToSpeech::Synthesizing:
+        m_active->setState(state);
+        break;
+    case QTextToSpeech::Paused:
+        m_active->setState(state);
+        yieldPaused();
+        break;
+    case QTextToSpeech::Ready:
+    case QTextToSpeech::Error: {
+        // The client might request again when it learns that it's done; it
+        // then waits behind everyone who asked before.
+        m_initialized = true;
+        QTextToSpeechSharedEngine *client = std::exchange(m_active, nullptr);
+        client->m_request = QTextToSpeechSharedEngine::Request::None;
+        if (state == QTextToSpeech::Error)
+            client->setError(m_engine->errorReason(), m_engine->errorString());
+        else
+            client->setState(state);
+        schedule();
+        break;
+    }
+    }
+}
+
+void QTextToSpeechEngineHost::engineVoicesChanged()
+{
+    for (QTextToSpeechSharedEngine *client : std::as_const(m_clients)) {
+        // clients created before the engine knew its voices take the one it selected
+        if (client->m_voice == QVoice()) {
+            client->m_voice = m_engine->voice();
+            client->m_locale = m_engine->locale();
+        }
+        emit client->voicesChanged();
+    }
+}
+
+void QTextToSpeechEngineHost::engineErrorOccurred(QTextToSpeech::ErrorReason reason,
+                                                  const QString &errorString)
+{
+    if (m_active) {
+        m_active->m_errorReason = reason;
+        m_active->m_errorString = errorString;
+        emit m_active->errorOccurred(reason, errorString);
+        return;
+    }
+    for (QTextToSpeechSharedEngine *client : std::as_const(m_clients)) {
+        client->m_errorReason = reason;
+        client->m_errorString = errorString;
+        emit client->errorOccurred(reason, errorString);
+    }
+}
+
+QTextToSpeechSharedEngine::QTextToSpeechSharedEngine(std::shared_ptr<QTextToSpeechEngineHost> host,
+                                                     QObject *parent)
+    : QTextToSpeechEngine(parent)
+    , m_host(std::move(host))
+    , m_engine(m_host->engine())
+    , m_locale(m_engine->locale())
+    , m_voice(m_engine->voice())
+    , m_rate(m_engine->rate())
+    , m_pitch(m_engine->pitch())
+    , m_volume(m_engine->volume())
+    , m_state(m_engine->state() == QTextToSpeech::Error ? QTextToSpeech::Error
+                                                        : QTextToSpeech::Ready)
+    , m_errorReason(m_engine->errorReason())
+    , m_errorString(m_engine->errorString())
+{
+    m_host->addClient(this);
+}
+
+QTextToSpeechSharedEngine::~QTextToSpeechSharedEngine()
+{
+    m_host->removeClient(this);
+}
+
+QTextToSpeech::Capabilities QTextToSpeechSharedEngine::capabilities() const
+{
+    return m_engine->capabilities();
+}
+
+QList<QLocale> QTextToSpeechSharedEngine::availableLocales() const
+{
+    return m_engine->availableLocales();
+}
+
+QList<QVoice> QTextToSpeechSharedEngine::availableVoices() const
+{
+    return m_engine->allVoices(&m_locale);
+}
+
+QList<QVoice> QTextToSpeechSharedEngine::allVoices(const QLocale *locale) const
+{
+    return m_engine->allVoices(locale);
+}
+
+void QTextToSpeechSharedEngine::say(const QString &text)
+{
+    m_text = text;
+    m_textOffset = 0;
+    m_wordEnd = 0;
+    m_yielded = false;
+    m_request = Request::Say;
+    setState(QTextToSpeech::Speaking);
+    m_host->request(this);
+}
+
+void QTextToSpeechSharedEngine::synthesize(const QString &text)
+{
+    m_text = text;
+    m_textOffset = 0;
+    m_wordEnd = 0;
+    m_yielded = false;
+    m_request = Request::Synthesize;
+    setState(QTextToSpeech::Synthesizing);
+    m_host->request(this);
+}
+
+void QTextToSpeechSharedEngine::stop(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    if (m_host->activeClient() == this) {
+        m_engine->stop(boundaryHint);
+    } else if (m_request != Request::None) {
+        m_host->cancel(this);
+        m_request = Request::None;
+        m_yielded = false;
+        setState(QTextToSpeech::Ready);
+    }
+}
+
+void QTextToSpeechSharedEngine::pause(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    if (m_host->activeClient() == this) {
+        m_engine->pause(boundaryHint);
+    } else if (m_host->isWaiting(this)) {
+        // give up our place, resume() asks again
+        m_host->cancel(this);
+        setState(QTextToSpeech::Paused);
+    }
+}
+
+void QTextToSpeechSharedEngine::resume()
+{
+    if (m_host->activeClient() == this) {
+        m_engine->resume();
+    } else if (m_state == QTextToSpeech::Paused && m_request != Request::None) {
+        setState(m_request == Request::Say ? QTextToSpeech::Speaking
+                                           : QTextToSpeech::Synthesizing);
+        m_host->request(this);
+    }
+}
+
+double QTextToSpeechSharedEngine::rate() const
+{
+    return m_rate;
+}
+
+bool QTextToSpeechSharedEngine::setRate(double rate)
+{
+    m_rate = rate;
+    if (m_host->activeClient() == this)
+        m_engine->setRate(rate);
+    return true;
+}
+
+double QTextToSpeechSharedEngine::pitch() const
+{
+    return m_pitch;
+}
+
+bool QTextToSpeechSharedEngine::setPitch(double pitch)
+{
+    m_pitch = pitch;
+    if (m_host->activeClient() == this)
+        m_engine->setPitch(pitch);
+    return true;
+}
+
+QLocale QTextToSpeechSharedEngine::locale() const
+{
+    return m_locale;
+}
+
+bool QTextToSpeechSharedEngine::setLocale(const QLocale &locale)
+{
+    const QList<QVoice> voices = m_engine->allVoices(&locale);
+    if (voices.isEmpty())
+        return false;
+
+    m_locale = locale;
+    if (!voices.contains(m_voice))
+        m_voice = voices.first();
+    return true;
+}
+
+double QTextToSpeechSharedEngine::volume() const
+{
+    return m_volume;
+}
+
+bool QTextToSpeechSharedEngine::setVolume(double volume)
+{
+    m_volume = volume;
+    if (m_host->activeClient() == this)
+        m_engine->setVolume(volume);
+    return true;
+}
+
+QVoice QTextToSpeechSharedEngine::voice() const
+{
+    return m_voice;
+}
+
+bool QTextToSpeechSharedEngine::setVoice(const QVoice &voice)
+{
+    const QLocale locale = voice.locale();
+    if (!m_engine->allVoices(&locale).contains(voice))
+        return false;
+
+    m_voice = voice;
+    m_locale = locale;
+    return true;
+}
+
+QTextToSpeech::State QTextToSpeechSharedEngine::state() const
+{
+    return m_state;
+}
+
+QTextToSpeech::ErrorReason QTextToSpeechSharedEngine::errorReason() const
+{
+    return m_errorReason;
+}
+
+QString QTextToSpeechSharedEngine::errorString() const
+{
+    return m_errorString;
+}
+
+// The engine delivers to one client at a time, so the last limit set applies
+void QTextToSpeechSharedEngine::setSynthesizeBufferLimit(qsizetype bytes)
+{
+    m_engine->setSynthesizeBufferLimit(bytes);
+}
+
+// Called by the host when it's our turn to use the engine
+void QTextToSpeechSharedEngine::start()
+{
+    if (m_engine->voice() != m_voice)
+        m_engine->setVoice(m_voice);
+    if (m_engine->rate() != m_rate)
+        m_engine->setRate(m_rate);
+    if (m_engine->pitch() != m_pitch)
+        m_engine->setPitch(m_pitch);
+    if (m_engine->volume() != m_volume)
+        m_engine->setVolume(m_volume);
+
+    m_errorReason = QTextToSpeech::ErrorReason::NoError;
+    m_errorString.clear();
+    if (m_request == Request::Say)
+        m_engine->say(m_text);
+    else
+        m_engine->synthesize(m_text);
+}
+
+void QTextToSpeechSharedEngine::setState(QTextToSpeech::State state)
+{
+    if (m_state == state)
+        return;
+
+    m_state = state;
+    emit stateChanged(state);
+}
+
+void QTextToSpeechSharedEngine::setError(QTextToSpeech::ErrorReason reason,
+                                         const QString &errorString)
+{
+    m_errorReason = reason;
+    m_errorString = errorString;
+    setState(QTextToSpeech::Error);
+}
+
+QT_END_NAMESPACE
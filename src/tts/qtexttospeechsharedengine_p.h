@@ -0,0 +1,146 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHSHAREDENGINE_P_H
+#define QTEXTTOSPEECHSHAREDENGINE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeechengine.h>
+
+#include <QtCore/qlist.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qvariantmap.h>
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QTextToSpeechPlugin;
+class QTextToSpeechSharedEngine;
+
+// Owns the engine that several QTextToSpeechSharedEngine front-ends share,
+// and lets them use it one request at a time, in the order they asked. A
+// client that is paused while speaking gives up the engine to the others.
+// Paused synthesis keeps the engine, as the audio can't be continued.
+class QTextToSpeechEngineHost : public QObject
+{
+public:
+    static std::shared_ptr<QTextToSpeechEngineHost> instance(QTextToSpeechPlugin *plugin,
+                                                             const QString &provider,
+                                                             const QVariantMap &params,
+                                                             QString *errorString);
+    ~QTextToSpeechEngineHost() override;
+
+    QTextToSpeechEngine *engine() const { return m_engine.get(); }
+    QTextToSpeechSharedEngine *activeClient() const { return m_active; }
+    bool isWaiting(const QTextToSpeechSharedEngine *client) const;
+
+    void addClient(QTextToSpeechSharedEngine *client);
+    void removeClient(QTextToSpeechSharedEngine *client);
+    void request(QTextToSpeechSharedEngine *client);
+    void cancel(QTextToSpeechSharedEngine *client);
+
+private:
+    QTextToSpeechEngineHost(QTextToSpeechEngine *engine, const QString &provider,
+                            const QVariantMap &params);
+
+    void schedule();
+    void yieldPaused();
+    void engineStateChanged(QTextToSpeech::State state);
+    void engineErrorOccurred(QTextToSpeech::ErrorReason reason, const QString &errorString);
+    void engineVoicesChanged();
+
+    std::unique_ptr<QTextToSpeechEngine> m_engine;
+    const QString m_provider;
+    const QVariantMap m_params;
+    QList<QTextToSpeechSharedEngine *> m_clients;
+    QQueue<QTextToSpeechSharedEngine *> m_waiting;
+    QTextToSpeechSharedEngine *m_active = nullptr;
+    bool m_initialized;
+};
+
+// Engine front-end with its own settings and request, executed by the
+// engine of a QTextToSpeechEngineHost.
+class QTextToSpeechSharedEngine : public QTextToSpeechEngine
+{
+public:
+    explicit QTextToSpeechSharedEngine(std::shared_ptr<QTextToSpeechEngineHost> host,
+                                       QObject *parent = nullptr);
+    ~QTextToSpeechSharedEngine() override;
+
+    QTextToSpeech::Capabilities capabilities() const override;
+    QList<QLocale> availableLocales() const override;
+    QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
+
+    void say(const QString &text) override;
+    void synthesize(const QString &text) override;
+    void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void pause(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void resume() override;
+
+    double rate() const override;
+    bool setRate(double rate) override;
+    double pitch() const override;
+    bool setPitch(double pitch) override;
+    QLocale locale() const override;
+    bool setLocale(const QLocale &locale) override;
+    double volume() const override;
+    bool setVolume(double volume) override;
+    QVoice voice() const override;
+    bool setVoice(const QVoice &voice) override;
+    QTextToSpeech::State state() const override;
+    QTextToSpeech::ErrorReason errorReason() const override;
+    QString errorString() const override;
+    void setSynthesizeBufferLimit(qsizetype bytes) override;
+
+private:
+    friend class QTextToSpeechEngineHost;
+
+    enum class Request {
+        None,
+        Say,
+        Synthesize,
+    };
+
+    void start();
+    void setState(QTextToSpeech::State state);
+    void setError(QTextToSpeech::ErrorReason reason, const QString &errorString);
+
+    std::shared_ptr<QTextToSpeechEngineHost> m_host;
+    QTextToSpeechEngine *m_engine;
+
+    Request m_request = Request::None;
+    QString m_text;
+    // where m_text starts in the text of the request, as m_text is only the
+    // rest of it after we gave up the engine while paused
+    qsizetype m_textOffset = 0;
+    // the end of the last word spoken, in m_text
+    qsizetype m_wordEnd = 0;
+    // set while paused without the engine; resuming gets the next turn
+    bool m_yielded = false;
+
+    QLocale m_locale;
+    QVoice m_voice;
+    double m_rate;
+    double m_pitch;
+    double m_volume;
+
+    QTextToSpeech::State m_state;
+    QTextToSpeech::ErrorReason m_errorReason = QTextToSpeech::ErrorReason::NoError;
+    QString m_errorString;
+};
+
+QT_END_NAMESPACE
+
+#endif
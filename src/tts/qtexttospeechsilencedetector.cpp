@@ -0,0 +1,87 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechsilencedetector_p.h"
+
+#include <QtCore/private/qsimd_p.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Returns the first run of at least minimumLength() silent samples in the
+    \a count samples at \a samples, or an invalid run if there is none. A run
+    that reaches the end of the samples is reported if it is long enough,
+    even though it might continue in the next block of audio.
+
+    Blocks of eight samples that are all silent or all loud are classified
+    with one vector comparison; only mixed blocks are checked sample by sample.
+*/
+QTextToSpeechSilenceDetector::Run
+QTextToSpeechSilenceDetector::find(const qint16 *samples, qsizetype count) const
+{
+    const qint16 threshold = m_threshold;
+    const qsizetype minimumLength = qMax(m_minimumLength, qsizetype(1));
+    qsizetype runLength = 0;
+    qsizetype index = 0;
+
+    const auto endRun = [&](qsizetype end) -> Run {
+        if (runLength >= minimumLength)
+            return Run{end - runLength, runLength};
+        runLength = 0;
+        return Run{};
+    };
+    const auto scalar = [&](qsizetype end) -> Run {
+        for (; index < end; ++index) {
+            const qint16 sample = samples[index];
+            if (sample < threshold && sample > -threshold) {
+                ++runLength;
+            } else if (const Run run = endRun(index); run.isValid()) {
+                return run;
+            }
+        }
+        return Run{};
+    };
+
+#if defined(__SSE2__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+    constexpr qsizetype BlockSize = 8;
+# if defined(__SSE2__)
+    const __m128i upper = _mm_set1_epi16(threshold);
+    const __m128i lower = _mm_set1_epi16(-threshold);
+# else
+    const int16x8_t upper = vdupq_n_s16(threshold);
+    const int16x8_t lower = vdupq_n_s16(-threshold);
+# endif
+    for (; index + BlockSize <= count; ) {
+# if defined(__SSE2__)
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + index));
+        const __m128i silent = _mm_and_si128(_mm_cmplt_epi16(block, upper),
+                                             _mm_cmpgt_epi16(block, lower));
+        const int mask = _mm_movemask_epi8(silent);
+        const bool allSilent = mask == 0xffff;
+        const bool allLoud = mask == 0;
+# else
+        const int16x8_t block = vld1q_s16(samples + index);
+        const uint16x8_t silent = vandq_u16(vcltq_s16(block, upper), vcgtq_s16(block, lower));
+        const quint64 mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(silent)), 0);
+        const bool allSilent = mask == ~quint64(0);
+        const bool allLoud = mask == 0;
+# endif
+        if (allSilent) {
+            runLength += BlockSize;
+            index += BlockSize;
+        } else if (allLoud) {
+            if (const Run run = endRun(index); run.isValid())
+                return run;
+            index += BlockSize;
+        } else if (const Run run = scalar(index + BlockSize); run.isValid()) {
+            return run;
+        }
+    }
+#endif
+
+    if (const Run run = scalar(count); run.isValid())
+        return run;
+    return endRun(count);
+}
+
+QT_END_NAMESPACE
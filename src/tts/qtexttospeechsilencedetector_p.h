@@ -0,0 +1,59 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHSILENCEDETECTOR_P_H
+#define QTEXTTOSPEECHSILENCEDETECTOR_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeech_global.h>
+
+#include <QtCore/qtypes.h>
+
+QT_BEGIN_NAMESPACE
+
+// Finds pauses in synthesized Int16 audio, so that engines can pause between
+// words without knowing where the words are. Synthesized speech has no noise,
+// so a run of samples with low absolute values is enough.
+class Q_TEXTTOSPEECH_EXPORT QTextToSpeechSilenceDetector
+{
+public:
+    struct Run
+    {
+        qsizetype start = -1;
+        qsizetype length = 0;
+
+        bool isValid() const { return start >= 0; }
+    };
+
+    QTextToSpeechSilenceDetector() = default;
+    QTextToSpeechSilenceDetector(qint16 threshold, qsizetype minimumLength)
+        : m_threshold(threshold), m_minimumLength(minimumLength)
+    {}
+
+    qint16 threshold() const { return m_threshold; }
+    void setThreshold(qint16 threshold) { m_threshold = threshold; }
+    qsizetype minimumLength() const { return m_minimumLength; }
+    void setMinimumLength(qsizetype length) { m_minimumLength = length; }
+
+    Run find(const qint16 *samples, qsizetype count) const;
+
+private:
+    // samples with an absolute value below the threshold are silent
+    qint16 m_threshold = 10;
+    // number of silent samples in a row that make a pause
+    qsizetype m_minimumLength = 320;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,488 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qtexttospeechstreamengine_p.h"
+
+#include <QtCore/qtextboundaryfinder.h>
+
+#include <cstring>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+QTextToSpeechOutputStream::QTextToSpeechOutputStream(QObject *parent)
+    : QIODevice(parent)
+{
+    // without QIODevice's buffer, what was read is what the reader consumed
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+qint64 QTextToSpeechOutputStream::bytesAvailable() const
+{
+    const qint64 available = m_paused ? 0 : m_buffer.size() - m_readPos;
+    return available + QIODevice::bytesAvailable();
+}
+
+void QTextToSpeechOutputStream::append(const QByteArray &bytes)
+{
+    if (bytes.isEmpty())
+        return;
+    m_buffer.append(bytes);
+    m_written += bytes.size();
+    if (!m_paused)
+        emit readyRead();
+}
+
+/*
+    Drops the audio after \a position in the stream, unless it has been read.
+*/
+void QTextToSpeechOutputStream::truncate(qint64 position)
+{
+    position = qMax(position, m_consumed);
+    if (position >= m_written)
+        return;
+    m_buffer.truncate(m_readPos + (position - m_consumed));
+    m_written = position;
+}
+
+void QTextToSpeechOutputStream::setPaused(bool paused)
+{
+    if (m_paused == paused)
+        return;
+    m_paused = paused;
+    if (!m_paused && m_readPos < m_buffer.size())
+        emit readyRead();
+}
+
+qint64 QTextToSpeechOutputStream::readData(char *data, qint64 maxSize)
+{
+    if (m_paused)
+        return 0;
+    const qint64 size = qMin(maxSize, qint64(m_buffer.size() - m_readPos));
+    if (size <= 0)
+        return 0;
+    std::memcpy(data, m_buffer.constData() + m_readPos, size);
+    m_readPos += size;
+    m_consumed += size;
+    // drop what was read once that is more than what is left
+    if (m_readPos == m_buffer.size()) {
+        m_buffer.clear();
+        m_readPos = 0;
+    } else if (m_readPos > m_buffer.size() / 2) {
+        m_buffer.remove(0, m_readPos);
+        m_readPos = 0;
+    }
+    if (onConsumed)
+        onConsumed(m_consumed);
+    return size;
+}
+
+qint64 QTextToSpeechOutputStream::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+QTextToSpeechStreamEngine::QTextToSpeechStreamEngine(std::unique_ptr<QTextToSpeechEngine> engine,
+                                                     const QAudioFormat &format, QObject *parent)
+    : QTextToSpeechEngine(parent)
+    , m_engine(std::move(engine))
+    , m_stream(new QTextToSpeechOutputStream(this))
+    , m_converter(format)
+    , m_state(m_engine->state())
+{
+    // so that the engine moves with us if we are created in another thread
+    m_engine->setParent(this);
+
+    connect(m_engine.get(), &QTextToSpeechEngine::stateChanged,
+            this, &QTextToSpeechStreamEngine::engineStateChanged);
+    connect(m_engine.get(), &QTextToSpeechEngine::errorOccurred,
+            this, &QTextToSpeechEngine::errorOccurred);
+    connect(m_engine.get(), &QTextToSpeechEngine::synthesized,
+            this, &QTextToSpeechStreamEngine::engineSynthesized);
+    connect(m_engine.get(), &QTextToSpeechEngine::synthesizedWord,
+            this, &QTextToSpeechStreamEngine::engineSynthesizedWord);
+    connect(m_engine.get(), &QTextToSpeechEngine::voicesChanged,
+            this, &QTextToSpeechEngine::voicesChanged);
+    m_stream->onConsumed = [this](qint64 position) { consumed(position); };
+}
+
+QTextToSpeechStreamEngine::~QTextToSpeechStreamEngine()
+{
+    m_stream->onConsumed = nullptr;
+    m_engine->disconnect(this);
+}
+
+QTextToSpeech::Capabilities QTextToSpeechStreamEngine::capabilities() const
+{
+    // words are reported from the timing of the synthesized audio
+    return (m_engine->capabilities() & QTextToSpeech::Capability::WordByWordProgress)
+         | QTextToSpeech::Capability::Speak
+         | QTextToSpeech::Capability::PauseResume
+         | QTextToSpeech::Capability::Synthesize;
+}
+
+QList<QLocale> QTextToSpeechStreamEngine::availableLocales() const
+{
+    return m_engine->availableLocales();
+}
+
+QList<QVoice> QTextToSpeechStreamEngine::availableVoices() const
+{
+    return m_engine->availableVoices();
+}
+
+QList<QVoice> QTextToSpeechStreamEngine::allVoices(const QLocale *locale) const
+{
+    return m_engine->allVoices(locale);
+}
+
+/*
+    The engine gets one sentence at a time, and the next one only once the
+    reader has consumed most of the audio in the stream, so that a long text
+    doesn't end up in memory all at once.
+*/
+void QTextToSpeechStreamEngine::say(const QString &text)
+{
+    m_request = Request::Say;
+    m_words.clear();
+    m_sentences.clear();
+    m_pendingSynthesis.clear();
+    stopEngine();
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Sentence, text);
+    qsizetype start = 0;
+    while (finder.toNextBoundary() != -1) {
+        m_sentences.enqueue({start, finder.position() - start});
+        start = finder.position();
+    }
+    m_text = text;
+    m_synthesizing = false;
+    m_synthesized = false;
+    m_converter.reset();
+    m_stream->setPaused(false);
+    setState(QTextToSpeech::Speaking);
+    synthesizeMore();
+    consumed(m_stream->consumed());
+}
+
+void QTextToSpeechStreamEngine::synthesize(const QString &text)
+{
+    if (m_request == Request::Say) {
+        m_words.clear();
+        m_sentences.clear();
+        m_synthesized = true;
+        stopEngine();
+    }
+    m_request = Request::Synthesize;
+    if (m_engineStopping) {
+        // started once the engine is done with the sentence
+        m_pendingSynthesis = text;
+        setState(QTextToSpeech::Synthesizing);
+        return;
+    }
+    m_engine->synthesize(text);
+}
+
+void QTextToSpeechStreamEngine::stop(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    if (!m_pendingSynthesis.isEmpty()) {
+        // the engine never got the text
+        m_pendingSynthesis.clear();
+        m_request = Request::None;
+        setState(QTextToSpeech::Ready);
+        return;
+    }
+    if (m_request != Request::Say) {
+        m_engine->stop(boundaryHint);
+        return;
+    }
+
+    switch (boundaryHint) {
+    case QTextToSpeech::BoundaryHint::Utterance:
+        // the rest of the utterance is played
+        return;
+    case QTextToSpeech::BoundaryHint::Word:
+    case QTextToSpeech::BoundaryHint::Sentence:
+        // play up to the next word that the engine reported
+        m_stream->truncate(m_words.isEmpty() ? m_stream->written() : m_words.head().position);
+        m_words.clear();
+        m_sentences.clear();
+        m_synthesized = true;
+        stopEngine();
+        consumed(m_stream->consumed());
+        return;
+    case QTextToSpeech::BoundaryHint::Default:
+    case QTextToSpeech::BoundaryHint::Immediate:
+        break;
+    }
+
+    m_request = Request::None;
+    m_words.clear();
+    m_sentences.clear();
+    m_stream->truncate(m_stream->consumed());
+    m_stream->setPaused(false);
+    stopEngine();
+    setState(QTextToSpeech::Ready);
+}
+
+void QTextToSpeechStreamEngine::pause(QTextToSpeech::BoundaryHint boundaryHint)
+{
+    if (m_request != Request::Say) {
+        m_engine->pause(boundaryHint);
+        return;
+    }
+    // the engine continues to synthesize, only the reader gets nothing
+    m_stream->setPaused(true);
+    setState(QTextToSpeech::Paused);
+}
+
+void QTextToSpeechStreamEngine::resume()
+{
+    if (m_request != Request::Say) {
+        m_engine->resume();
+        return;
+    }
+    if (m_state != QTextToSpeech::Paused)
+        return;
+    setState(QTextToSpeech::Speaking);
+    m_stream->setPaused(false);
+    // the engine might have finished while we were paused
+    consumed(m_stream->consumed());
+}
+
+double QTextToSpeechStreamEngine::rate() const
+{
+    return m_engine->rate();
+}
+
+bool QTextToSpeechStreamEngine::setRate(double rate)
+{
+    return m_engine->setRate(rate);
+}
+
+double QTextToSpeechStreamEngine::pitch() const
+{
+    return m_engine->pitch();
+}
+
+bool QTextToSpeechStreamEngine::setPitch(double pitch)
+{
+    return m_engine->setPitch(pitch);
+}
+
+QLocale QTextToSpeechStreamEngine::locale() const
+{
+    return m_engine->locale();
+}
+
+bool QTextToSpeechStreamEngine::setLocale(const QLocale &locale)
+{
+    return m_engine->setLocale(locale);
+}
+
+double QTextToSpeechStreamEngine::volume() const
+{
+    return m_engine->volume();
+}
+
+bool QTextToSpeechStreamEngine::setVolume(double volume)
+{
+    return m_engine->setVolume(volume);
+}
+
+QVoice QTextToSpeechStreamEngine::voice() const
+{
+    return m_engine->voice();
+}
+
+bool QTextToSpeechStreamEngine::setVoice(const QVoice &voice)
+{
+    return m_engine->setVoice(voice);
+}
+
+QTextToSpeech::State QTextToSpeechStreamEngine::state() const
+{
+    return m_state;
+}
+
+QTextToSpeech::ErrorReason QTextToSpeechStreamEngine::errorReason() const
+{
+    return m_engine->errorReason();
+}
+
+QString QTextToSpeechStreamEngine::errorString() const
+{
+    return m_engine->errorString();
+}
+
+void QTextToSpeechStreamEngine::setSynthesizeBufferLimit(qsizetype bytes)
+{
+    // also how much audio can wait in the stream before the engine gets the
+    // next sentence
+    m_bufferLimit = bytes;
+    m_engine->setSynthesizeBufferLimit(bytes);
+}
+
+void QTextToSpeechStreamEngine::engineStateChanged(QTextToSpeech::State state)
+{
+    if (m_engineStopping) {
+        if (state != QTextToSpeech::Ready && state != QTextToSpeech::Error)
+            return;
+        // the engine is done with the sentence that we stopped
+        m_engineStopping = false;
+        m_synthesizing = false;
+        if (!m_pendingSynthesis.isEmpty())
+            m_engine->synthesize(std::exchange(m_pendingSynthesis, {}));
+        else if (m_request == Request::Say)
+            synthesizeMore();
+        return;
+    }
+
+    switch (m_request) {
+    case Request::Say:
+        if (state == QTextToSpeech::Ready) {
+            m_synthesizing = false;
+            consumed(m_stream->consumed());
+        } else if (state == QTextToSpeech::Error) {
+            m_request = Request::None;
+            m_words.clear();
+            m_sentences.clear();
+            m_stream->truncate(m_stream->consumed());
+            m_stream->setPaused(false);
+            setState(state);
+        }
+        break;
+    case Request::Synthesize:
+        if (state == QTextToSpeech::Ready || state == QTextToSpeech::Error)
+            m_request = Request::None;
+        setState(state);
+        break;
+    case Request::None:
+        // asynchronously initialized engines, and engines that we stopped
+        if (state == QTextToSpeech::Ready || state == QTextToSpeech::Error)
+            setState(state);
+        break;
+    }
+}
+
+void QTextToSpeechStreamEngine::engineSynthesized(const QAudioFormat &format,
+                                                  const QByteArray &bytes)
+{
+    if (m_engineStopping)
+        return;
+    switch (m_request) {
+    case Request::Say:
+        if (!m_synthesized)
+            m_stream->append(m_converter.convert(format, bytes));
+        break;
+    case Request::Synthesize:
+        emit synthesized(format, bytes);
+        break;
+    case Request::None:
+        break;
+    }
+}
+
+void QTextToSpeechStreamEngine::engineSynthesizedWord(const QString &word, qsizetype start,
+                                                      qsizetype length, qint64 position)
+{
+    if (m_engineStopping)
+        return;
+    switch (m_request) {
+    case Request::Say:
+        if (!m_synthesized) {
+            const qint64 bytes = m_converter.target().bytesForDuration(position);
+            m_words.enqueue({word, m_sentenceOffset + start, length, m_sentenceStart + bytes});
+        }
+        break;
+    case Request::Synthesize:
+        emit synthesizedWord(word, start, length, position);
+        break;
+    case Request::None:
+        break;
+    }
+}
+
+/*
+    Reports the words whose audio the reader has reached with \a position,
+    lets the engine continue with the next sentence once most of the audio
+    has been read, and finishes the utterance once all of it has been read.
+*/
+void QTextToSpeechStreamEngine::consumed(qint64 position)
+{
+    if (m_request != Request::Say)
+        return;
+    while (!m_words.isEmpty() && m_words.head().position <= position) {
+        const Word word = m_words.dequeue();
+        emit sayingWord(word.text, word.start, word.length);
+        // a connected slot might have stopped us
+        if (m_request != Request::Say)
+            return;
+    }
+    synthesizeMore();
+    if (m_synthesized && m_state != QTextToSpeech::Paused && position >= m_stream->written())
+        finishSaying();
+}
+
+/*
+    Gives the engine the next sentence of the current utterance if it is idle,
+    and if the audio that waits in the stream is below the buffer limit, or
+    below a second of audio without a limit.
+*/
+void QTextToSpeechStreamEngine::synthesizeMore()
+{
+    if (m_synthesizing || m_synthesized || m_engineStopping)
+        return;
+    const qint64 limit = m_bufferLimit > 0 ? m_bufferLimit
+                                           : m_converter.target().bytesForDuration(1000000);
+    if (m_stream->written() - m_stream->consumed() >= limit)
+        return;
+
+    while (!m_sentences.isEmpty()) {
+        const auto [offset, length] = m_sentences.dequeue();
+        const QString sentence = m_text.sliced(offset, length);
+        if (sentence.trimmed().isEmpty())
+            continue;
+        m_sentenceOffset = offset;
+        m_sentenceStart = m_stream->written();
+        m_synthesizing = true;
+        m_engine->synthesize(sentence);
+        return;
+    }
+    m_text.clear();
+    m_synthesized = true;
+}
+
+/*
+    Stops the engine if it is synthesizing a sentence for us. Engines might
+    still deliver audio, and report that they are ready, after stop() returned;
+    all of that is ignored, and the engine gets the next text only afterwards.
+*/
+void QTextToSpeechStreamEngine::stopEngine()
+{
+    if (!m_synthesizing || m_engine->state() != QTextToSpeech::Synthesizing)
+        return;
+    m_engineStopping = true;
+    m_engine->stop(QTextToSpeech::BoundaryHint::Immediate);
+    // engines that stopped right away might not report it
+    if (m_engine->state() != QTextToSpeech::Synthesizing) {
+        m_engineStopping = false;
+        m_synthesizing = false;
+    }
+}
+
+void QTextToSpeechStreamEngine::finishSaying()
+{
+    m_request = Request::None;
+    m_words.clear();
+    setState(QTextToSpeech::Ready);
+}
+
+void QTextToSpeechStreamEngine::setState(QTextToSpeech::State state)
+{
+    if (m_state == state)
+        return;
+    m_state = state;
+    emit stateChanged(state);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,152 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QTEXTTOSPEECHSTREAMENGINE_P_H
+#define QTEXTTOSPEECHSTREAMENGINE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of other Qt classes.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtTextToSpeech/qtexttospeechengine.h>
+#include "qtexttospeechaudioconverter_p.h"
+
+#include <QtCore/qiodevice.h>
+#include <QtCore/qqueue.h>
+
+#include <functional>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Read-only device from which the application pulls the spoken audio
+class QTextToSpeechOutputStream : public QIODevice
+{
+public:
+    explicit QTextToSpeechOutputStream(QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+    // total number of bytes appended, and read
+    qint64 written() const { return m_written; }
+    qint64 consumed() const { return m_consumed; }
+
+    void append(const QByteArray &bytes);
+    void truncate(qint64 position);
+    void setPaused(bool paused);
+
+    // called after each read, with the number of bytes read so far
+    std::function<void(qint64)> onConsumed;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QByteArray m_buffer;
+    qsizetype m_readPos = 0;
+    qint64 m_written = 0;
+    qint64 m_consumed = 0;
+    bool m_paused = false;
+};
+
+// Engine front-end that speaks by synthesizing with another engine into a
+// QTextToSpeechOutputStream, and reports words once the audio for them is read.
+class QTextToSpeechStreamEngine : public QTextToSpeechEngine
+{
+    Q_OBJECT
+public:
+    QTextToSpeechStreamEngine(std::unique_ptr<QTextToSpeechEngine> engine,
+                              const QAudioFormat &format, QObject *parent = nullptr);
+    ~QTextToSpeechStreamEngine() override;
+
+    QIODevice *outputStream() const { return m_stream; }
+    QAudioFormat outputFormat() const { return m_converter.target(); }
+
+    QTextToSpeech::Capabilities capabilities() const override;
+    QList<QLocale> availableLocales() const override;
+    QList<QVoice> availableVoices() const override;
+    QList<QVoice> allVoices(const QLocale *locale) const override;
+
+    void say(const QString &text) override;
+    void synthesize(const QString &text) override;
+    void stop(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void pause(QTextToSpeech::BoundaryHint boundaryHint) override;
+    void resume() override;
+
+    double rate() const override;
+    bool setRate(double rate) override;
+    double pitch() const override;
+    bool setPitch(double pitch) override;
+    QLocale locale() const override;
+    bool setLocale(const QLocale &locale) override;
+    double volume() const override;
+    bool setVolume(double volume) override;
+    QVoice voice() const override;
+    bool setVoice(const QVoice &voice) override;
+    QTextToSpeech::State state() const override;
+    QTextToSpeech::ErrorReason errorReason() const override;
+    QString errorString() const override;
+    void setSynthesizeBufferLimit(qsizetype bytes) override;
+
+private:
+    enum class Request {
+        None,
+        Say,
+        Synthesize,
+    };
+
+    struct Word
+    {
+        QString text;
+        qsizetype start;
+        qsizetype length;
+        qint64 position; // in bytes of the stream
+    };
+
+    void engineStateChanged(QTextToSpeech::State state);
+    void engineSynthesized(const QAudioFormat &format, const QByteArray &bytes);
+    void engineSynthesizedWord(const QString &word, qsizetype start, qsizetype length,
+                               qint64 position);
+    void consumed(qint64 position);
+    void synthesizeMore();
+    void stopEngine();
+    void finishSaying();
+    void setState(QTextToSpeech::State state);
+
+    std::unique_ptr<QTextToSpeechEngine> m_engine;
+    QTextToSpeechOutputStream *m_stream;
+    QTextToSpeechAudioConverter m_converter;
+
+    Request m_request = Request::None;
+    // the sentences of the current utterance that the engine didn't get yet,
+    // and where the one it synthesizes starts in the text and in the stream
+    QString m_text;
+    QQueue<std::pair<qsizetype, qsizetype>> m_sentences; // offset and length
+    qsizetype m_sentenceOffset = 0;
+    qint64 m_sentenceStart = 0;
+    // set while the engine synthesizes a sentence
+    bool m_synthesizing = false;
+    // set once the engine has synthesized all audio of the current utterance
+    bool m_synthesized = false;
+    // set until the engine reports the end of a sentence that we stopped, so
+    // that its remaining audio doesn't end up in the next utterance
+    bool m_engineStopping = false;
+    // text that synthesize() got while the engine was stopping
+    QString m_pendingSynthesis;
+    qsizetype m_bufferLimit = 0;
+    QQueue<Word> m_words;
+    QTextToSpeech::State m_state;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -7,10 +7,63 @@
 #include "qvoice_p.h"
 #include "qtexttospeech.h"
 
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+
 QT_BEGIN_NAMESPACE
 
 QT_DEFINE_QESDP_SPECIALIZATION_DTOR(QVoicePrivate)
 
+namespace {
+struct QVoiceRegistry
+{
+    QMutex mutex;
+    // all instances, by name
+    QMultiHash<QString, QVoicePrivate *> voices;
+};
+Q_GLOBAL_STATIC(QVoiceRegistry, voiceRegistry)
+}
+
+QVoicePrivate *QVoicePrivate::intern(const QString &n, const QLocale &l, QVoice::Gender g,
+                                     QVoice::Age a, const QVariant &d)
+{
+    QVoiceRegistry *registry = voiceRegistry();
+    if (!registry) {
+        // during shutdown
+        QVoicePrivate *voice = new QVoicePrivate(n, l, g, a, d);
+        voice->ref.storeRelaxed(1);
+        return voice;
+    }
+
+    QMutexLocker locker(&registry->mutex);
+    for (auto it = registry->voices.constFind(n); it != registry->voices.cend() && it.key() == n;
+         ++it) {
+        QVoicePrivate *voice = *it;
+        if (voice->locale != l || voice->gender != g || voice->age != a || voice->data != d)
+            continue;
+        // the last reference might just have been dropped in another thread
+        int count = voice->ref.loadRelaxed();
+        while (count > 0) {
+            if (voice->ref.testAndSetOrdered(count, count + 1, count))
+                return voice;
+        }
+    }
+
+    QVoicePrivate *voice = new QVoicePrivate(n, l, g, a, d);
+    voice->ref.storeRelaxed(1);
+    registry->voices.insert(voice->name, voice);
+    return voice;
+}
+
+QVoicePrivate::~QVoicePrivate()
+{
+    if (voiceRegistry.isDestroyed())
+        return;
+    QVoiceRegistry *registry = voiceRegistry();
+    QMutexLocker locker(&registry->mutex);
+    registry->voices.remove(name, this);
+}
+
 /*!
     \class QVoice
     \brief The QVoice class represents a particular voice.
@@ -101,7 +154,7 @@ QVoice &QVoice::operator=(const QVoice &other) noexcept
 */
 QVoice::QVoice(const QString &name, const QLocale &locale, Gender gender,
                Age age, const QVariant &data)
-    :d(new QVoicePrivate(name, locale, gender, age, data))
+    : d(QVoicePrivate::intern(name, locale, gender, age, data), QAdoptSharedDataTag{})
 {
 }
 
@@ -110,6 +163,9 @@ QVoice::QVoice(const QString &name, const QLocale &locale, Gender gender,
     \internal
     Compares all attributes of this voice with \a other.
     Returns \c true if all of them match.
+
+    Voices with the same attributes share their data, so this usually only
+    compares the pointers.
 */
 bool QVoice::isEqual(const QVoice &other) const noexcept
 {
@@ -311,13 +367,12 @@ QDataStream &QVoice::writeTo(QDataStream &stream) const
 
 QDataStream &QVoice::readFrom(QDataStream &stream)
 {
-    if (!d)
-        d.reset(new QVoicePrivate);
-
+    QString name;
+    QLocale locale;
     int g, a;
-    stream >> d->name >> d->locale >> g >> a >> d->data;
-    d->gender = Gender(g);
-    d->age = Age(a);
+    QVariant data;
+    stream >> name >> locale >> g >> a >> data;
+    *this = QVoice(name, locale, Gender(g), Age(a), data);
     return stream;
 }
 #endif
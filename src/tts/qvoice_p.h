@@ -26,14 +26,16 @@
 
 QT_BEGIN_NAMESPACE
 
+// Voices with the same attributes share one instance, so the voices that
+// engines enumerate repeatedly, or that several engines of the same kind
+// report, don't take more memory, and usually compare by pointer.
 class QVoicePrivate : public QSharedData
 {
 public:
-    QVoicePrivate() = default;
-    QVoicePrivate(const QVoicePrivate &other);
-    QVoicePrivate(const QString &n, const QLocale &l, QVoice::Gender g,
-                  QVoice::Age a, const QVariant &d);
-    ~QVoicePrivate() = default;
+    // returns an instance with a reference that the caller adopts
+    static QVoicePrivate *intern(const QString &n, const QLocale &l, QVoice::Gender g,
+                                 QVoice::Age a, const QVariant &d);
+    ~QVoicePrivate();
 
     QString name;
     QLocale locale;
@@ -43,19 +45,14 @@ public:
     // On OS X the VoiceIdentifier is stored.
     // On unix the synthesizer (output module) is stored.
     QVariant data;
-};
-
-QVoicePrivate::QVoicePrivate(const QVoicePrivate &other)
-    : QSharedData(other), name(other.name), locale(other.locale)
-    , gender(other.gender), age(other.age), data(other.data)
-{
-}
 
-QVoicePrivate::QVoicePrivate(const QString &n, const QLocale &l, QVoice::Gender g,
-                             QVoice::Age a, const QVariant &d)
-    :name(n), locale(l), gender(g), age(a), data(d)
-{
-}
+private:
+    QVoicePrivate(const QString &n, const QLocale &l, QVoice::Gender g,
+                  QVoice::Age a, const QVariant &d)
+        : name(n), locale(l), gender(g), age(a), data(d)
+    {}
+    Q_DISABLE_COPY_MOVE(QVoicePrivate)
+};
 
 QT_END_NAMESPACE
 
@@ -11,7 +11,17 @@
 #include <QAudioBuffer>
 #include <QOperatingSystemVersion>
 #include <QRegularExpression>
+#include <QBuffer>
+#include <QtEndian>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QtMath>
+#include <QThread>
 #include <qttexttospeech-config.h>
+#include <QtTextToSpeech/private/qtexttospeechaudiocodec_p.h>
+#include <QtTextToSpeech/private/qtexttospeechaudioconverter_p.h>
+#include <QtTextToSpeech/private/qtexttospeechcache_p.h>
+#include <QtTextToSpeech/private/qtexttospeechsilencedetector_p.h>
 
 #if QT_CONFIG(speechd)
     #include <libspeechd.h>
@@ -41,6 +51,8 @@ private slots:
 
     void locale();
     void voice();
+    void voicesChanged();
+    void voicesLoadedAsync();
 
     void rate();
     void pitch();
@@ -63,12 +75,48 @@ private slots:
     void sayingWordWithPause_data();
     void sayingWordWithPause();
 
+    void sentenceChunking();
+    void enqueueWithPriority();
+    void appendText();
+
     void synthesize_data();
     void synthesize();
 
     void synthesizeCallback_data();
     void synthesizeCallback();
 
+    void synthesizeToDevice_data();
+    void synthesizeToDevice();
+    void synthesizedWord();
+    void metrics();
+
+    void audioCache();
+    void sayCached();
+    void prefetch();
+    void sharedEngine();
+
+    void synthesizeWithWorkers();
+    void headless();
+    void silenceDetector();
+    void audioConverter();
+    void synthesizeFormat();
+    void synthesizeBatch();
+    void synthesizeBufferLimit();
+    void asyncApi();
+    void mockLoadGeneration();
+    void sharedFliteVoice();
+    void setEngineAsync();
+    void switchToPreparedEngine();
+    void fallbackEngines();
+    void voiceCache();
+    void enqueueRanges();
+    void additionalAudioDevices();
+    void gaplessFlite();
+    void outputStream();
+    void fliteLexicon();
+    void audioCacheCompression();
+    void workerThreads();
+
 public:
     using Selector = QList<QVoice>(*)(const QTextToSpeech *);
     using VoiceData = typename std::tuple<QString, QLocale, QVoice::Gender, QVoice::Age>;
@@ -172,6 +220,10 @@ void tst_QTextToSpeech::init()
             QSKIP("speechd engine reported an error, "
                   "make sure the speech-dispatcher service is running!");
         }
+    } else if (engine == "remote") {
+        QTextToSpeech tts(engine);
+        if (tts.state() == QTextToSpeech::Error)
+            QSKIP("remote engine reported an error, make sure qttexttospeechserver is running!");
     } else if (engine == "darwin"
         && QOperatingSystemVersion::current() <= QOperatingSystemVersion::MacOSMojave) {
         QTextToSpeech tts(engine);
@@ -465,6 +517,61 @@ void tst_QTextToSpeech::voice()
     }
 }
 
+/*
+    Engines that only know their voices once they are initialized report
+    that their voices changed. The current voice is only reported if the
+    engine selected a different one.
+*/
+void tst_QTextToSpeech::voicesChanged()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    for (const QString &name : {u"Bob"_s, u"Anne"_s}) {
+        QTextToSpeech tts(engine, {{u"delayedInitialization"_s, true},
+                                   {u"initializedVoice"_s, name}});
+        QSignalSpy voicesSpy(&tts, &QTextToSpeech::voicesChanged);
+        QSignalSpy voiceSpy(&tts, &QTextToSpeech::voiceChanged);
+        const QVoice initialVoice = tts.voice();
+        QCOMPARE(initialVoice.name(), u"Bob"_s);
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QTRY_COMPARE(voicesSpy.size(), 1);
+        QCOMPARE(tts.voice().name(), name);
+        if (name == initialVoice.name()) {
+            QCOMPARE(voiceSpy.size(), 0);
+        } else {
+            QCOMPARE(voiceSpy.size(), 1);
+            QCOMPARE(voiceSpy.first().first().value<QVoice>(), tts.voice());
+        }
+    }
+}
+
+/*!
+    speech-dispatcher lists its voices in the background. The default voice is
+    selected before the voices are reported, so that voiceChanged() follows.
+*/
+void tst_QTextToSpeech::voicesLoadedAsync()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "speechd")
+        QSKIP("Only testing with speech-dispatcher");
+
+    QTextToSpeech tts(engine);
+    if (!tts.availableVoices().isEmpty())
+        QSKIP("The voices of speech-dispatcher are already loaded");
+
+    QSignalSpy voiceSpy(&tts, &QTextToSpeech::voiceChanged);
+    QVoice voiceWhenLoaded;
+    connect(&tts, &QTextToSpeech::voicesChanged, this, [&tts, &voiceWhenLoaded]{
+        voiceWhenLoaded = tts.voice();
+    });
+    QTRY_VERIFY(!tts.availableVoices().isEmpty());
+    QCOMPARE_NE(voiceWhenLoaded, QVoice());
+    QVERIFY(!voiceSpy.isEmpty());
+    QCOMPARE(voiceSpy.last().first().value<QVoice>(), voiceWhenLoaded);
+}
+
 void tst_QTextToSpeech::rate()
 {
     QFETCH_GLOBAL(QString, engine);
@@ -889,6 +996,174 @@ void tst_QTextToSpeech::sayingWordWithPause()
     debugHelper.dismiss();
 }
 
+void tst_QTextToSpeech::sentenceChunking()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    const QString text = u"First sentence here. Second sentence! And the third?"_s;
+    const QStringList expectedWords = text.split(QRegularExpression("\\W"), Qt::SkipEmptyParts);
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(!tts.sentenceChunking());
+    tts.setSentenceChunking(true);
+
+    QStringList words;
+    QList<qsizetype> ids;
+    connect(&tts, &QTextToSpeech::sayingWord, this,
+            [&](const QString &word, qsizetype id, qsizetype start, qsizetype length) {
+        QCOMPARE(text.sliced(start, length), word);
+        words << word;
+        ids << id;
+    });
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    QSignalSpy aboutToSynthesizeSpy(&tts, &QTextToSpeech::aboutToSynthesize);
+
+    tts.say(text);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, expectedWords);
+    QCOMPARE(ids, QList<qsizetype>(expectedWords.size(), 0));
+    QCOMPARE(stateSpy.size(), 2);
+    QCOMPARE(aboutToSynthesizeSpy.size(), 1);
+
+    // pausing at the utterance boundary pauses only after the last sentence
+    words.clear();
+    tts.enqueue(text);
+    tts.enqueue(text);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    tts.pause(QTextToSpeech::BoundaryHint::Utterance);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Paused);
+    QCOMPARE(words, expectedWords);
+    tts.resume();
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, expectedWords + expectedWords);
+
+    // the engine finishes the sentence when pausing at its last word, and
+    // the following sentences are spoken once resumed
+    words.clear();
+    const auto pauseConnection = connect(&tts, &QTextToSpeech::sayingWord, this,
+                                         [&tts](const QString &word) {
+        if (word == u"here"_s)
+            tts.pause(QTextToSpeech::BoundaryHint::Word);
+    });
+    tts.say(text);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Paused);
+    QCOMPARE(words, expectedWords.first(3));
+    disconnect(pauseConnection);
+    tts.resume();
+    QCOMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, expectedWords);
+}
+
+void tst_QTextToSpeech::enqueueWithPriority()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QMap<qsizetype, QString> texts;
+    QStringList words;
+    connect(&tts, &QTextToSpeech::sayingWord, this,
+            [&](const QString &word, qsizetype id, qsizetype start, qsizetype length) {
+        QCOMPARE(texts.value(id).sliced(start, length), word);
+        words << word;
+    });
+    const auto enqueue = [&](const QString &text, auto &&...args) {
+        const qsizetype id = tts.enqueue(text, args...);
+        texts.insert(id, text);
+        return id;
+    };
+
+    // without a boundary hint, the current text is completed
+    const QString article = u"one two three four"_s;
+    QCOMPARE(enqueue(article), 0);
+    QCOMPARE(enqueue(u"low"_s, QTextToSpeech::Priority::Low), 1);
+    QCOMPARE(enqueue(u"normal"_s), 2);
+    QCOMPARE(enqueue(u"high"_s, QTextToSpeech::Priority::High), 3);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, (QStringList{u"one"_s, u"two"_s, u"three"_s, u"four"_s,
+                                 u"high"_s, u"normal"_s, u"low"_s}));
+
+    // interrupting at a word boundary continues after the interrupted word
+    words.clear();
+    texts.clear();
+    const QStringList articleWords = article.split(u' ');
+    enqueue(article);
+    QTRY_VERIFY(!words.isEmpty());
+    enqueue(u"alert"_s, QTextToSpeech::Priority::High, QTextToSpeech::BoundaryHint::Word);
+    QCOMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    const qsizetype interruptedAt = words.indexOf(u"alert"_s);
+    QCOMPARE_GT(interruptedAt, 0);
+    QCOMPARE(words, articleWords.first(interruptedAt) + QStringList{u"alert"_s}
+                    + articleWords.sliced(interruptedAt));
+
+    // synthesized texts don't use up the ids of enqueued texts
+    tts.stop();
+    tts.synthesize(article, [](const QAudioFormat &, const QByteArray &) {});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    tts.synthesize(article, [](const QAudioFormat &, const QByteArray &) {});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(enqueue(u"next"_s), 0);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+}
+
+void tst_QTextToSpeech::appendText()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    const QString text = u"First sentence here. Second sentence! And the third?"_s;
+    const QStringList expectedWords = text.split(QRegularExpression("\\W"), Qt::SkipEmptyParts);
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QStringList words;
+    QList<qsizetype> ids;
+    connect(&tts, &QTextToSpeech::sayingWord, this,
+            [&](const QString &word, qsizetype id, qsizetype start, qsizetype length) {
+        QCOMPARE(text.sliced(start, length), word);
+        words << word;
+        ids << id;
+    });
+    QSignalSpy aboutToSynthesizeSpy(&tts, &QTextToSpeech::aboutToSynthesize);
+
+    // nothing is spoken until the first sentence is complete
+    QCOMPARE(tts.appendText(text.first(10)), 0);
+    QCOMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(aboutToSynthesizeSpy.isEmpty());
+    QCOMPARE(tts.appendText(text.sliced(10, 14)), 0);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QCOMPARE(aboutToSynthesizeSpy.size(), 1);
+
+    // the last sentence is only complete once the text is finished
+    QCOMPARE(tts.appendText(text.sliced(24)), 0);
+    QCOMPARE(aboutToSynthesizeSpy.size(), 1);
+    tts.finishText();
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, expectedWords);
+    QCOMPARE(ids, QList<qsizetype>(expectedWords.size(), 0));
+    QCOMPARE(aboutToSynthesizeSpy.size(), 3);
+
+    // the next text starts a new utterance
+    disconnect(&tts, &QTextToSpeech::sayingWord, this, nullptr);
+    QCOMPARE(tts.appendText(u"Next one."_s), 1);
+    tts.stop();
+    QCOMPARE(tts.appendText(u"Next one."_s), 0);
+    tts.finishText();
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+}
+
 void tst_QTextToSpeech::synthesize_data()
 {
     QTest::addColumn<QString>("text");
@@ -1075,5 +1350,1389 @@ void tst_QTextToSpeech::synthesizeCallback()
     processor.reset();
 }
 
+void tst_QTextToSpeech::synthesizeToDevice_data()
+{
+    QTest::addColumn<QTextToSpeech::OutputFormat>("format");
+
+    QTest::addRow("raw") << QTextToSpeech::OutputFormat::RawPcm;
+    QTest::addRow("wav") << QTextToSpeech::OutputFormat::Wav;
+}
+
+void tst_QTextToSpeech::synthesizeToDevice()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+    QFETCH(QTextToSpeech::OutputFormat, format);
+
+    const QString text = u"this will produce more than one chunk."_s;
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QAudioFormat expectedFormat;
+    QByteArray expectedBytes;
+    tts.synthesize(text, [&expectedFormat, &expectedBytes]
+                         (const QAudioFormat &format, const QByteArray &bytes) {
+        expectedFormat = format;
+        expectedBytes += bytes;
+    });
+    QTRY_VERIFY(expectedFormat.isValid());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QBuffer closedBuffer;
+    QVERIFY(!tts.synthesizeToDevice(text, &closedBuffer, format));
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(tts.synthesizeToDevice(text, &buffer, format));
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    const QByteArray data = buffer.data();
+    if (format == QTextToSpeech::OutputFormat::RawPcm) {
+        QCOMPARE(data, expectedBytes);
+        return;
+    }
+
+    QCOMPARE(data.size(), expectedBytes.size() + 44);
+    QCOMPARE(data.first(4), "RIFF");
+    QCOMPARE(qFromLittleEndian<quint32>(data.constData() + 4), quint32(data.size() - 8));
+    QCOMPARE(data.sliced(8, 8), "WAVEfmt ");
+    QCOMPARE(int(qFromLittleEndian<quint16>(data.constData() + 22)), expectedFormat.channelCount());
+    QCOMPARE(int(qFromLittleEndian<quint32>(data.constData() + 24)), expectedFormat.sampleRate());
+    QCOMPARE(int(qFromLittleEndian<quint16>(data.constData() + 34)), expectedFormat.bytesPerSample() * 8);
+    QCOMPARE(data.sliced(36, 4), "data");
+    QCOMPARE(qFromLittleEndian<quint32>(data.constData() + 40), quint32(expectedBytes.size()));
+    QCOMPARE(data.sliced(44), expectedBytes);
+}
+
+void tst_QTextToSpeech::synthesizedWord()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    const QString text = u"one two three"_s;
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    tts.setAudioCacheLimit(1024 * 1024);
+
+    // the second time, the audio and words come from the cache
+    for (int run = 0; run < 2; ++run) {
+        QSignalSpy wordSpy(&tts, &QTextToSpeech::synthesizedWord);
+        QList<qint64> chunkStarts;
+        qint64 duration = 0;
+        tts.synthesize(text, [&](const QAudioFormat &format, const QByteArray &bytes) {
+            chunkStarts << duration;
+            duration += format.durationForBytes(bytes.size());
+        });
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+        QCOMPARE(wordSpy.size(), 3);
+        QStringList words;
+        for (qsizetype i = 0; i < wordSpy.size(); ++i) {
+            const auto &arguments = wordSpy.at(i);
+            const QString word = arguments.at(0).toString();
+            const qsizetype start = arguments.at(2).value<qsizetype>();
+            const qsizetype length = arguments.at(3).value<qsizetype>();
+            QCOMPARE(text.sliced(start, length), word);
+            // the mock engine produces one chunk per word
+            QCOMPARE(arguments.at(4).value<qint64>(), chunkStarts.value(i, -1));
+            words << word;
+        }
+        QCOMPARE(words, (QStringList{u"one"_s, u"two"_s, u"three"_s}));
+    }
+}
+
+void tst_QTextToSpeech::metrics()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.metrics().utterances(), 0);
+
+    tts.enqueue(u"one two"_s);
+    tts.enqueue(u"three"_s);
+    tts.enqueue(u"four"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QCOMPARE(tts.metrics().queueDepth(), 2);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QTextToSpeechMetrics metrics = tts.metrics();
+    QCOMPARE(metrics.queueDepth(), 0);
+    QCOMPARE(metrics.utterances(), 3);
+    QCOMPARE_GT(metrics.lastLatency(), 0);
+    QCOMPARE_GE(metrics.averageLatency(), metrics.averageTimeToFirstAudio());
+    // spoken texts are played in real time
+    QCOMPARE(metrics.realTimeFactor(), 0.0);
+    QCOMPARE(metrics.bytesSynthesized(), 0);
+
+    tts.resetMetrics();
+    qint64 bytes = 0;
+    tts.synthesize(u"one two three"_s, [&](const QAudioFormat &, const QByteArray &data) {
+        bytes += data.size();
+    });
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    metrics = tts.metrics();
+    QCOMPARE(metrics.utterances(), 1);
+    QCOMPARE(metrics.bytesSynthesized(), bytes);
+    QCOMPARE_GT(metrics.realTimeFactor(), 0.0);
+    QCOMPARE_LE(metrics.lastTimeToFirstAudio(), metrics.lastLatency());
+
+    // stopped texts are not measured
+    tts.say(u"one two three four five"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    tts.stop(QTextToSpeech::BoundaryHint::Immediate);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.metrics().utterances(), 1);
+}
+
+void tst_QTextToSpeech::audioCache()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    const QDir dir(cacheDir.path());
+    const QString text = u"this will produce more than one chunk."_s;
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.audioCacheLimit(), 0);
+    tts.setAudioCacheLimit(1024 * 1024);
+    tts.setAudioCacheDirectory(cacheDir.path());
+    QCOMPARE(tts.audioCacheDirectory(), cacheDir.path());
+
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    QByteArray expected;
+    tts.synthesize(text, [&expected](const QAudioFormat &, const QByteArray &bytes) {
+        expected += bytes;
+    });
+    QTRY_COMPARE(stateSpy.size(), 2);
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(dir.entryList(QDir::Files).size(), 1);
+
+    // served from memory, with the same state transitions
+    stateSpy.clear();
+    QByteArray cached;
+    tts.synthesize(text, [&cached](const QAudioFormat &, const QByteArray &bytes) {
+        cached += bytes;
+    });
+    QCOMPARE(cached, QByteArray()); // delivered asynchronously
+    QTRY_COMPARE(stateSpy.size(), 2);
+    QCOMPARE(stateSpy.at(0).first().value<QTextToSpeech::State>(), QTextToSpeech::Synthesizing);
+    QCOMPARE(stateSpy.at(1).first().value<QTextToSpeech::State>(), QTextToSpeech::Ready);
+    QCOMPARE(cached, expected);
+    QCOMPARE(dir.entryList(QDir::Files).size(), 1);
+
+    // different settings produce a new entry
+    stateSpy.clear();
+    tts.setRate(0.5);
+    tts.synthesize(u"   this will produce   more than one chunk. "_s,
+                   [](const QAudioFormat &, const QByteArray &) {});
+    QTRY_COMPARE(stateSpy.size(), 2);
+    QCOMPARE(dir.entryList(QDir::Files).size(), 2);
+
+    // served from disk by a different instance
+    QTextToSpeech other(engine);
+    QTRY_COMPARE(other.state(), QTextToSpeech::Ready);
+    other.setAudioCacheDirectory(cacheDir.path());
+    QSignalSpy otherSpy(&other, &QTextToSpeech::stateChanged);
+    cached.clear();
+    other.synthesize(text, [&cached](const QAudioFormat &, const QByteArray &bytes) {
+        cached += bytes;
+    });
+    QTRY_COMPARE(otherSpy.size(), 2);
+    QCOMPARE(cached, expected);
+    QCOMPARE(dir.entryList(QDir::Files).size(), 2);
+}
+
+/*!
+    Texts that are cached are spoken from the cache, with the same words and
+    signals as if the engine spoke them.
+*/
+void tst_QTextToSpeech::sayCached()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+    if (!hasDefaultAudioOutput())
+        QSKIP("Cached audio is played with the default audio output");
+
+    const QString text = u"one two three"_s;
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    tts.setAudioCacheLimit(1024 * 1024);
+
+    QSignalSpy synthesizedWordSpy(&tts, &QTextToSpeech::synthesizedWord);
+    tts.synthesize(text, [](const QAudioFormat &, const QByteArray &) {});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(synthesizedWordSpy.size(), 3);
+    QCOMPARE(tts.metrics().utterances(), 1);
+
+    // replayed words are reported by QTextToSpeech, and the audio goes to
+    // the functor of the new utterance
+    synthesizedWordSpy.clear();
+    qsizetype replayed = 0;
+    tts.synthesize(text, [&replayed](const QAudioFormat &, const QByteArray &bytes) {
+        replayed += bytes.size();
+    });
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE_GT(replayed, 0);
+    QCOMPARE(synthesizedWordSpy.size(), 3);
+    QCOMPARE(synthesizedWordSpy.at(1).at(0).toString(), u"two"_s);
+    QCOMPARE(synthesizedWordSpy.at(1).at(2).toLongLong(), 4);
+    QCOMPARE(tts.metrics().utterances(), 1);
+
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    QSignalSpy sayingWordSpy(&tts, &QTextToSpeech::sayingWord);
+    tts.say(text);
+    QTRY_COMPARE(stateSpy.size(), 2);
+    QCOMPARE(stateSpy.at(0).first().value<QTextToSpeech::State>(), QTextToSpeech::Speaking);
+    QCOMPARE(stateSpy.at(1).first().value<QTextToSpeech::State>(), QTextToSpeech::Ready);
+    QStringList words;
+    for (const auto &signal : std::as_const(sayingWordSpy))
+        words << signal.at(0).toString();
+    QCOMPARE(words, (QStringList{u"one"_s, u"two"_s, u"three"_s}));
+    QCOMPARE(sayingWordSpy.at(2).at(2).toLongLong(), 8);
+    // the engine was not involved
+    QCOMPARE(tts.metrics().utterances(), 1);
+
+    // a text that is not cached is spoken by the engine
+    tts.say(u"four five"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.metrics().utterances(), 2);
+
+    // queued texts are prefetched while the engine speaks, and are spoken
+    // from the cache once they are next
+    sayingWordSpy.clear();
+    tts.enqueue(u"This text has enough words for the next one to be prefetched."_s);
+    tts.enqueue(u"six seven"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(sayingWordSpy.last().at(0).toString(), u"seven"_s);
+    QCOMPARE(tts.metrics().utterances(), 3);
+}
+
+void tst_QTextToSpeech::prefetch()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    const QDir dir(cacheDir.path());
+    const QStringList texts{u"The first text to prefetch."_s, u"And the second one."_s};
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    // no cache
+    QVERIFY(!tts.prefetch(texts.first()));
+
+    tts.setAudioCacheLimit(1024 * 1024);
+    tts.setAudioCacheDirectory(cacheDir.path());
+
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    for (const QString &text : texts)
+        QVERIFY(tts.prefetch(text));
+    QTRY_COMPARE(dir.entryList(QDir::Files).size(), texts.size());
+    // the prefetching happens without affecting the public state
+    QCOMPARE(stateSpy.size(), 0);
+
+    // compare with uncached data from a different instance
+    QTextToSpeech reference(engine);
+    QTRY_COMPARE(reference.state(), QTextToSpeech::Ready);
+    for (const QString &text : texts) {
+        QByteArray expected;
+        QSignalSpy referenceSpy(&reference, &QTextToSpeech::stateChanged);
+        reference.synthesize(text, [&expected](const QAudioFormat &, const QByteArray &bytes) {
+            expected += bytes;
+        });
+        QTRY_COMPARE(referenceSpy.size(), 2);
+
+        QByteArray prefetched;
+        stateSpy.clear();
+        tts.synthesize(text, [&prefetched](const QAudioFormat &, const QByteArray &bytes) {
+            prefetched += bytes;
+        });
+        QTRY_COMPARE(stateSpy.size(), 2);
+        QCOMPARE(prefetched, expected);
+    }
+    QCOMPARE(dir.entryList(QDir::Files).size(), texts.size());
+
+    // texts waiting to be synthesized are prefetched while the engine is busy
+    QCOMPARE(tts.prefetchDepth(), 1);
+    const QString longText = u"This text has so many words that the engine needs a few "
+                             "seconds to synthesize all of them, one after the other."_s;
+    const QString queuedText = u"Queued text."_s;
+    const auto ignore = [](const QAudioFormat &, const QByteArray &) {};
+    tts.synthesize(longText, ignore);
+    QCOMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    tts.synthesize(queuedText, ignore);
+    QTRY_COMPARE(dir.entryList(QDir::Files).size(), texts.size() + 1);
+    QCOMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    tts.stop(QTextToSpeech::BoundaryHint::Immediate);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // prefetching continues with the next text after an engine error
+    QTemporaryDir failDir;
+    QVERIFY(failDir.isValid());
+    QTextToSpeech failing(engine, {{u"failAfterWords"_s, 2}});
+    QTRY_COMPARE(failing.state(), QTextToSpeech::Ready);
+    failing.setAudioCacheDirectory(failDir.path());
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(u"Prefetching failed"_s));
+    QVERIFY(failing.prefetch(u"This one fails after two words."_s));
+    QVERIFY(failing.prefetch(u"This one works."_s));
+    QTRY_COMPARE(QDir(failDir.path()).entryList(QDir::Files).size(), 1);
+}
+
+/*!
+    With the sharedEngine parameter, QTextToSpeech objects use one engine
+    instance, but have their own settings, and take turns.
+*/
+void tst_QTextToSpeech::sharedEngine()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    const QVariantMap params{{u"sharedEngine"_s, true}};
+    QTextToSpeech first(engine, params);
+    QTextToSpeech second(engine, params);
+    QTRY_COMPARE(first.state(), QTextToSpeech::Ready);
+    QTRY_COMPARE(second.state(), QTextToSpeech::Ready);
+
+    const QLocale finnish(QLocale::Finnish, QLocale::Finland);
+    second.setLocale(finnish);
+    second.setRate(0.5);
+    QCOMPARE(second.locale(), finnish);
+    QCOMPARE_NE(first.locale(), finnish);
+    QCOMPARE_NE(first.rate(), 0.5);
+
+    QStringList words;
+    connect(&first, &QTextToSpeech::sayingWord, &first, [&words](const QString &word) {
+        words << u"first:"_s + word;
+    });
+    connect(&second, &QTextToSpeech::sayingWord, &second, [&words](const QString &word) {
+        words << u"second:"_s + word;
+    });
+
+    // the second object waits, but it's speaking as far as its users know
+    first.say(u"one"_s);
+    first.enqueue(u"two"_s);
+    second.say(u"three"_s);
+    QCOMPARE(first.state(), QTextToSpeech::Speaking);
+    QCOMPARE(second.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(first.state(), QTextToSpeech::Ready);
+    QTRY_COMPARE(second.state(), QTextToSpeech::Ready);
+    // the enqueued text of the first object comes after the second's
+    QCOMPARE(words, (QStringList{u"first:one"_s, u"second:three"_s, u"first:two"_s}));
+
+    // stopping the waiting object doesn't affect the speaking one
+    words.clear();
+    first.say(u"four five"_s);
+    second.say(u"six"_s);
+    second.stop();
+    QCOMPARE(second.state(), QTextToSpeech::Ready);
+    QCOMPARE(first.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(first.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, (QStringList{u"first:four"_s, u"first:five"_s}));
+    QCOMPARE(second.locale(), finnish);
+
+    // a paused object lets the others speak, and continues where it paused
+    words.clear();
+    QList<qsizetype> starts;
+    connect(&first, &QTextToSpeech::sayingWord, &first,
+            [&starts](const QString &, qsizetype, qsizetype start) {
+        starts << start;
+    });
+    first.say(u"seven eight nine"_s);
+    second.say(u"ten"_s);
+    first.pause(QTextToSpeech::BoundaryHint::Word);
+    QTRY_COMPARE(first.state(), QTextToSpeech::Paused);
+    QTRY_COMPARE(second.state(), QTextToSpeech::Ready);
+    QCOMPARE(first.state(), QTextToSpeech::Paused);
+    QCOMPARE(words, (QStringList{u"first:seven"_s, u"second:ten"_s}));
+    first.resume();
+    QCOMPARE(first.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(first.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, (QStringList{u"first:seven"_s, u"second:ten"_s,
+                                 u"first:eight"_s, u"first:nine"_s}));
+    // at their position in the text that was said
+    QCOMPARE(starts, (QList<qsizetype>{0, 6, 12}));
+}
+
+/*!
+    The flite engine can synthesize the sentences of a text in parallel. The
+    result has to be the same as synthesizing each sentence by itself, and in
+    order.
+*/
+void tst_QTextToSpeech::synthesizeWithWorkers()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine supports worker threads");
+
+    const QStringList sentences{"This is the first sentence.",
+                                "Here comes the second one.",
+                                "And a third sentence.",
+                                "The last sentence"};
+
+    QByteArray expected;
+    QTextToSpeech reference(engine);
+    QTRY_COMPARE(reference.state(), QTextToSpeech::Ready);
+    for (const QString &sentence : sentences) {
+        QSignalSpy spy(&reference, &QTextToSpeech::stateChanged);
+        reference.synthesize(sentence, [&expected](const QAudioFormat &, const QByteArray &bytes) {
+            expected += bytes;
+        });
+        QTRY_VERIFY(spy.size() >= 2);
+        QTRY_COMPARE(reference.state(), QTextToSpeech::Ready);
+    }
+    QVERIFY(!expected.isEmpty());
+
+    QByteArray pcmData;
+    QTextToSpeech tts(engine, {{"workerThreads", 4}});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QSignalSpy spy(&tts, &QTextToSpeech::stateChanged);
+    tts.synthesize(sentences.join(u' '), [&pcmData](const QAudioFormat &, const QByteArray &bytes) {
+        pcmData += bytes;
+    });
+    QTRY_VERIFY(spy.size() >= 2);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(pcmData.size(), expected.size());
+    QCOMPARE(pcmData, expected);
+}
+
+/*!
+    In headless mode, engines only synthesize, and don't need an audio device.
+*/
+void tst_QTextToSpeech::headless()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite" && engine != "winrt")
+        QSKIP("Engine doesn't support headless mode");
+
+    QTextToSpeech tts(engine, {{"headless", true}});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.engineCapabilities(), QTextToSpeech::Capability::Synthesize);
+
+    QByteArray pcmData;
+    tts.synthesize("Hello World", [&pcmData](const QAudioFormat &, const QByteArray &bytes) {
+        pcmData += bytes;
+    });
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(!pcmData.isEmpty());
+
+    tts.say("Hello World");
+    QTRY_COMPARE(tts.errorReason(), QTextToSpeech::ErrorReason::Playback);
+}
+
+void tst_QTextToSpeech::silenceDetector()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Engine independent, only testing once");
+
+    // loud samples, with runs of silence of different lengths in between, at
+    // offsets that are not aligned to the blocks that get checked at once
+    QList<qint16> samples(100, 1000);
+    for (qsizetype i = 13; i < 18; ++i)
+        samples[i] = 3;
+    for (qsizetype i = 37; i < 61; ++i)
+        samples[i] = (i % 2) ? -9 : 9;
+    samples[70] = -32768;
+
+    QTextToSpeechSilenceDetector detector(10, 20);
+    auto run = detector.find(samples.constData(), samples.size());
+    QCOMPARE(run.start, 37);
+    QCOMPARE(run.length, 24);
+
+    // nothing is silent with a threshold of -10 < sample < 10
+    detector.setThreshold(9);
+    QVERIFY(!detector.find(samples.constData(), samples.size()).isValid());
+
+    detector.setThreshold(10);
+    detector.setMinimumLength(5);
+    run = detector.find(samples.constData(), samples.size());
+    QCOMPARE(run.start, 13);
+    QCOMPARE(run.length, 5);
+
+    // a run at the end is reported if it is long enough
+    for (qsizetype i = 90; i < samples.size(); ++i)
+        samples[i] = 0;
+    detector.setMinimumLength(25);
+    run = detector.find(samples.constData(), samples.size());
+    QVERIFY(!run.isValid());
+    detector.setMinimumLength(10);
+    run = detector.find(samples.constData() + 62, samples.size() - 62);
+    QCOMPARE(run.start, 90 - 62);
+    QCOMPARE(run.length, 10);
+}
+
+void tst_QTextToSpeech::audioConverter()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Engine independent, only testing once");
+
+    QAudioFormat input;
+    input.setSampleRate(8000);
+    input.setChannelConfig(QAudioFormat::ChannelConfigMono);
+    input.setSampleFormat(QAudioFormat::Int16);
+
+    // more samples than fit into a vector register
+    QList<qint16> samples;
+    for (int i = 0; i < 37; ++i)
+        samples << qint16((i % 3 - 1) * 16384);
+    const QByteArray bytes(reinterpret_cast<const char *>(samples.constData()),
+                           samples.size() * sizeof(qint16));
+
+    // nothing to do
+    QTextToSpeechAudioConverter converter;
+    QVERIFY(!converter.isActive());
+    QCOMPARE(converter.convert(input, bytes).constData(), bytes.constData());
+    converter.setTarget(input);
+    QCOMPARE(converter.convert(input, bytes).constData(), bytes.constData());
+
+    // sample format and channels
+    QAudioFormat target;
+    target.setChannelConfig(QAudioFormat::ChannelConfigStereo);
+    target.setSampleFormat(QAudioFormat::Float);
+    converter.setTarget(target);
+    const QAudioFormat output = converter.outputFormat(input);
+    QCOMPARE(output.sampleRate(), 8000);
+    QCOMPARE(output.channelCount(), 2);
+    QCOMPARE(output.sampleFormat(), QAudioFormat::Float);
+    QByteArray converted = converter.convert(input, bytes);
+    QCOMPARE(converted.size(), output.bytesForFrames(samples.size()));
+    const float *floats = reinterpret_cast<const float *>(converted.constData());
+    for (qsizetype i = 0; i < samples.size(); ++i) {
+        QCOMPARE(floats[2 * i], samples.at(i) / 32768.0f);
+        QCOMPARE(floats[2 * i + 1], samples.at(i) / 32768.0f);
+    }
+
+    // and back, also when the chunks don't contain whole frames
+    QTextToSpeechAudioConverter back(input);
+    QByteArray roundTrip = back.convert(output, converted.first(21));
+    roundTrip += back.convert(output, converted.sliced(21));
+    QCOMPARE(roundTrip.size(), bytes.size());
+    const qint16 *ints = reinterpret_cast<const qint16 *>(roundTrip.constData());
+    for (qsizetype i = 0; i < samples.size(); ++i)
+        QCOMPARE_LE(qAbs(ints[i] - samples.at(i)), 1);
+
+    // resampling gives the same result for a stream as for the complete audio
+    target = {};
+    target.setSampleRate(22050);
+    converter.setTarget(target);
+    const QByteArray whole = converter.convert(input, bytes);
+    // give or take two samples
+    QCOMPARE_GE(whole.size(), bytes.size() * 22050 / 8000 - 4);
+    QCOMPARE_LE(whole.size(), bytes.size() * 22050 / 8000 + 4);
+    converter.reset();
+    QByteArray streamed;
+    for (qsizetype offset = 0; offset < bytes.size(); offset += 10)
+        streamed += converter.convert(input, bytes.sliced(offset, qMin<qsizetype>(10, bytes.size() - offset)));
+    QCOMPARE(streamed, whole);
+
+    // downsampling filters out the frequencies that the lower rate can't represent
+    QList<qint16> nyquist;
+    for (int i = 0; i < 40; ++i)
+        nyquist << qint16(i % 2 ? 16384 : -16384);
+    const QByteArray nyquistBytes(reinterpret_cast<const char *>(nyquist.constData()),
+                                  nyquist.size() * sizeof(qint16));
+    target.setSampleRate(4000);
+    converter.setTarget(target);
+    const QByteArray filtered = converter.convert(input, nyquistBytes);
+    QCOMPARE(filtered.size(), nyquistBytes.size() / 2);
+    const qint16 *filteredInts = reinterpret_cast<const qint16 *>(filtered.constData());
+    // the first frame is averaged with the silence before the stream
+    for (qsizetype i = 1; i < filtered.size() / qsizetype(sizeof(qint16)); ++i)
+        QCOMPARE(filteredInts[i], 0);
+    converter.reset();
+    streamed.clear();
+    for (qsizetype offset = 0; offset < nyquistBytes.size(); offset += 6)
+        streamed += converter.convert(input, nyquistBytes.sliced(offset, qMin<qsizetype>(6, nyquistBytes.size() - offset)));
+    QCOMPARE(streamed, filtered);
+}
+
+void tst_QTextToSpeech::synthesizeFormat()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(!tts.synthesizeFormat().isValid());
+
+    QAudioFormat requested;
+    requested.setSampleRate(48000);
+    requested.setChannelConfig(QAudioFormat::ChannelConfigStereo);
+    requested.setSampleFormat(QAudioFormat::Float);
+    tts.setSynthesizeFormat(requested);
+    QCOMPARE(tts.synthesizeFormat(), requested);
+
+    QAudioFormat received;
+    QByteArray data;
+    tts.synthesize("Hello world", this, [&](const QAudioFormat &format, const QByteArray &bytes){
+        received = format;
+        data += bytes;
+    });
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(received, requested);
+    QVERIFY(!data.isEmpty());
+    QCOMPARE(data.size() % requested.bytesPerFrame(), 0);
+}
+
+void tst_QTextToSpeech::synthesizeBatch()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // the mock engine produces the same amount of audio for each word
+    QByteArray first;
+    QByteArray last;
+    tts.synthesize("one two", this, [&first](const QAudioFormat &, const QByteArray &bytes){
+        first += bytes;
+    });
+    QFuture<QAudioBuffer> batch = tts.synthesizeBatch({"three", "", "four five six"});
+    tts.synthesize("seven", this, [&last](const QAudioFormat &, const QByteArray &bytes){
+        last += bytes;
+    });
+    QCOMPARE(batch.progressMaximum(), 3);
+    QTRY_VERIFY(batch.isFinished());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QVERIFY(!batch.isCanceled());
+    QCOMPARE(batch.progressValue(), 3);
+    QCOMPARE(batch.resultCount(), 3);
+    const qsizetype wordSize = batch.resultAt(0).byteCount();
+    QCOMPARE_GT(wordSize, 0);
+    QCOMPARE(batch.resultAt(1).byteCount(), 0);
+    QCOMPARE(batch.resultAt(2).byteCount(), 3 * wordSize);
+    QCOMPARE(first.size(), 2 * wordSize);
+    QCOMPARE(last.size(), wordSize);
+
+    // canceling drops the rest of the batch, but not what comes after
+    last.clear();
+    batch = tts.synthesizeBatch({"one", "two three", "four"});
+    tts.synthesize("five", this, [&last](const QAudioFormat &, const QByteArray &bytes){
+        last += bytes;
+    });
+    QTRY_COMPARE(batch.resultCount(), 1);
+    batch.cancel();
+    QTRY_VERIFY(batch.isFinished());
+    QTRY_COMPARE(last.size(), wordSize);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE_LT(batch.resultCount(), 3);
+}
+
+void tst_QTextToSpeech::synthesizeBufferLimit()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine supports flow control");
+
+    const QString text = u"This is a longer text. It is synthesized in several chunks, "
+                         "so that the engine has to wait for some of them to be delivered."_s;
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.synthesizeBufferLimit(), 0);
+
+    const auto synthesize = [&]{
+        QByteArray data;
+        tts.synthesize(text, [&](const QAudioFormat &, const QByteArray &bytes) {
+            data += bytes;
+        });
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+        QTRY_COMPARE_WITH_TIMEOUT(tts.state(), QTextToSpeech::Ready, 10000);
+        return data;
+    };
+    const QByteArray unlimited = synthesize();
+    QVERIFY(!unlimited.isEmpty());
+
+    // smaller than a chunk, so the engine waits for each chunk to be delivered
+    tts.setSynthesizeBufferLimit(1);
+    QCOMPARE(tts.synthesizeBufferLimit(), 1);
+    QCOMPARE(synthesize(), unlimited);
+
+    // stopping doesn't leave the engine waiting
+    tts.synthesize(text, [](const QAudioFormat &, const QByteArray &) {});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Synthesizing);
+    tts.stop(QTextToSpeech::BoundaryHint::Immediate);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(synthesize(), unlimited);
+}
+
+void tst_QTextToSpeech::asyncApi()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // one chunk per word
+    QFuture<QAudioBuffer> synthesis = tts.synthesizeAsync("one two three");
+    bool continued = false;
+    synthesis.then(this, [&continued, &synthesis]{
+        continued = true;
+        QCOMPARE(synthesis.resultCount(), 3);
+    });
+    QTRY_VERIFY(continued);
+    QVERIFY(!synthesis.isCanceled());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QFuture<void> speech = tts.sayAsync("one two");
+    QVERIFY(!speech.isFinished());
+    QTRY_VERIFY(speech.isFinished());
+    QVERIFY(!speech.isCanceled());
+    QCOMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // stopped or replaced speech is canceled
+    speech = tts.sayAsync("one two three");
+    QFuture<void> next = tts.sayAsync("four");
+    QVERIFY(speech.isCanceled());
+    tts.stop(QTextToSpeech::BoundaryHint::Immediate);
+    QVERIFY(next.isCanceled());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+}
+
+void tst_QTextToSpeech::mockLoadGeneration()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QStringList words;
+    for (int i = 0; i < 50; ++i)
+        words << u"word%1"_s.arg(i);
+    const QString text = words.join(u' ');
+
+    // without the timer, synthesizing doesn't take as long as the audio plays
+    {
+        QTextToSpeech tts(engine, {{u"maxSpeed"_s, true}, {u"chunkSize"_s, 1001}});
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QSignalSpy wordSpy(&tts, &QTextToSpeech::synthesizedWord);
+        QList<qsizetype> chunkSizes;
+        qint64 duration = 0;
+        QElapsedTimer timer;
+        timer.start();
+        tts.synthesize(text, [&](const QAudioFormat &format, const QByteArray &bytes) {
+            chunkSizes << bytes.size();
+            duration += format.durationForBytes(bytes.size());
+        });
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QCOMPARE_LT(timer.elapsed() * 1000, duration / 2);
+        QCOMPARE(wordSpy.size(), words.size());
+        // whole frames of 16 bit mono audio
+        for (qsizetype size : std::as_const(chunkSizes)) {
+            QCOMPARE_LE(size, 1000);
+            QCOMPARE(size % 2, 0);
+        }
+    }
+
+    // no audio before the latency has passed
+    {
+        QTextToSpeech tts(engine, {{u"latency"_s, 300}, {u"latencyJitter"_s, 50},
+                                   {u"realTimeFactor"_s, 0.1}});
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QElapsedTimer timer;
+        qint64 firstAudio = -1;
+        timer.start();
+        tts.synthesize(u"one two three"_s, [&](const QAudioFormat &, const QByteArray &) {
+            if (firstAudio < 0)
+                firstAudio = timer.elapsed();
+        });
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QCOMPARE_GE(firstAudio, 250);
+    }
+}
+
+void tst_QTextToSpeech::sharedFliteVoice()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine shares voices between engines");
+
+    const QString text = u"Both engines synthesize this text at the same time."_s;
+    auto first = std::make_unique<QTextToSpeech>(engine);
+    QTextToSpeech second(engine);
+    QTRY_COMPARE(first->state(), QTextToSpeech::Ready);
+    QTRY_COMPARE(second.state(), QTextToSpeech::Ready);
+
+    QByteArray firstData;
+    QByteArray secondData;
+    first->synthesize(text, [&](const QAudioFormat &, const QByteArray &bytes) {
+        firstData += bytes;
+    });
+    second.synthesize(text, [&](const QAudioFormat &, const QByteArray &bytes) {
+        secondData += bytes;
+    });
+    QTRY_COMPARE_WITH_TIMEOUT(first->state(), QTextToSpeech::Ready, 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(second.state(), QTextToSpeech::Ready, 10000);
+    QVERIFY(!firstData.isEmpty());
+    QCOMPARE(secondData, firstData);
+
+    // the voice stays registered for the remaining engine
+    first.reset();
+    secondData.clear();
+    second.synthesize(text, [&](const QAudioFormat &, const QByteArray &bytes) {
+        secondData += bytes;
+    });
+    QTRY_COMPARE_WITH_TIMEOUT(second.state(), QTextToSpeech::Ready, 10000);
+    QCOMPARE(secondData, firstData);
+}
+
+void tst_QTextToSpeech::setEngineAsync()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    tts.setRate(0.5);
+    QSignalSpy engineSpy(&tts, &QTextToSpeech::engineChanged);
+
+    QFuture<bool> future = tts.setEngineAsync(engine, {{u"delayedInitialization"_s, true}});
+    // the engine is created in a worker thread, and attached in the event loop
+    QCOMPARE(tts.state(), QTextToSpeech::Error);
+    QVERIFY(engineSpy.isEmpty());
+    QTRY_VERIFY(future.isFinished());
+    QVERIFY(future.result());
+    QCOMPARE(engineSpy.size(), 1);
+    QCOMPARE(tts.engine(), engine);
+    QCOMPARE(tts.rate(), 0.5);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    tts.say(u"Hello World"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // changing the engine again drops the engine that is still being created
+    QFuture<bool> first = tts.setEngineAsync(engine, {{u"delayedInitialization"_s, true}});
+    QFuture<bool> second = tts.setEngineAsync(engine, {{u"latency"_s, 10}});
+    QVERIFY(first.isCanceled());
+    QTRY_VERIFY(second.isFinished());
+    QVERIFY(second.result());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // unknown engines fail right away
+    QTest::ignoreMessage(QtCriticalMsg, "Text-to-speech plug-in \"nonexistent\" is not supported.");
+    QFuture<bool> failed = tts.setEngineAsync(u"nonexistent"_s);
+    QVERIFY(failed.isFinished());
+    QVERIFY(!failed.result());
+    QCOMPARE(tts.state(), QTextToSpeech::Error);
+}
+
+void tst_QTextToSpeech::switchToPreparedEngine()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(!tts.switchToPreparedEngine());
+    QVERIFY(tts.preparedEngine().isEmpty());
+
+    // the events in the order in which they happen
+    QStringList events;
+    connect(&tts, &QTextToSpeech::engineChanged, this, [&events]{
+        events << u"engineChanged"_s;
+    });
+    connect(&tts, &QTextToSpeech::aboutToSynthesize, this, [&events](qsizetype id){
+        events << u"aboutToSynthesize %1"_s.arg(id);
+    });
+
+    QVERIFY(tts.prepareEngine(engine, {{u"latency"_s, 10}}));
+    QCOMPARE(tts.preparedEngine(), engine);
+    tts.setRate(0.5);
+    const qsizetype first = tts.enqueue(u"one two three"_s);
+    const qsizetype second = tts.enqueue(u"four five"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    // the current text is completed, and the queue is kept
+    QVERIFY(tts.switchToPreparedEngine());
+    QCOMPARE(events, QStringList{u"aboutToSynthesize %1"_s.arg(first)});
+    QTRY_COMPARE(events.size(), 3);
+    QCOMPARE(events.at(1), u"engineChanged"_s);
+    QCOMPARE(events.at(2), u"aboutToSynthesize %1"_s.arg(second));
+    QVERIFY(tts.preparedEngine().isEmpty());
+    QCOMPARE(tts.rate(), 0.5);
+    QCOMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // an idle engine changes right away
+    events.clear();
+    QVERIFY(tts.prepareEngine(engine));
+    QVERIFY(tts.switchToPreparedEngine());
+    QCOMPARE(events, QStringList{u"engineChanged"_s});
+    QCOMPARE(tts.state(), QTextToSpeech::Ready);
+
+    // an engine that isn't ready yet is used once it is, even if the
+    // current engine finished all texts before that
+    events.clear();
+    tts.say(u"six"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QVERIFY(tts.prepareEngine(engine, {{u"delayedInitialization"_s, true}}));
+    QVERIFY(tts.switchToPreparedEngine());
+    QTRY_VERIFY(events.contains(u"engineChanged"_s));
+    QVERIFY(tts.preparedEngine().isEmpty());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+}
+
+void tst_QTextToSpeech::fallbackEngines()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine, {{u"failAfterWords"_s, 2}});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QVERIFY(tts.fallbackEngines().isEmpty());
+    tts.setFallbackEngines({engine, u"nonexistent"_s, engine});
+    QCOMPARE(tts.fallbackEngines(), QStringList{engine});
+
+    QStringList words;
+    connect(&tts, &QTextToSpeech::sayingWord, this, [&words](const QString &word) {
+        words << word;
+    });
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    QSignalSpy errorSpy(&tts, &QTextToSpeech::errorOccurred);
+    QSignalSpy engineSpy(&tts, &QTextToSpeech::engineChanged);
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(u"failed.*continuing"_s));
+    tts.enqueue(u"one two three"_s);
+    tts.enqueue(u"four five"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(engineSpy.size(), 1);
+    // the new engine continues with the word that failed
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(words, (QStringList{u"one"_s, u"two"_s, u"two"_s, u"three"_s,
+                                 u"four"_s, u"five"_s}));
+    QVERIFY(errorSpy.isEmpty());
+    for (const auto &state : std::as_const(stateSpy))
+        QCOMPARE_NE(state.first().value<QTextToSpeech::State>(), QTextToSpeech::Error);
+
+    tts.setFallbackEngines({});
+    QVERIFY(tts.fallbackEngines().isEmpty());
+}
+
+void tst_QTextToSpeech::voiceCache()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    const QDir dir(cacheDir.path());
+
+    QList<QVoice> voices;
+    {
+        QTextToSpeech tts(engine);
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QVERIFY(tts.voiceCacheDirectory().isEmpty());
+        voices = tts.findVoices();
+        QVERIFY(voices.size() > 1);
+        tts.setVoiceCacheDirectory(cacheDir.path());
+        QCOMPARE(tts.voiceCacheDirectory(), cacheDir.path());
+        QTRY_COMPARE(dir.entryList(QDir::Files).size(), 1);
+    }
+    const QString fileName = dir.filePath(dir.entryList(QDir::Files).first());
+    QCOMPARE(QTextToSpeechVoiceCatalog::read(fileName), voices);
+
+    // the stored voices are known while the engine is created
+    QTextToSpeech tts;
+    tts.setVoiceCacheDirectory(cacheDir.path());
+    QFuture<bool> future = tts.setEngineAsync(engine);
+    QVERIFY(!future.isFinished());
+    QCOMPARE(tts.findVoices(), voices);
+    QCOMPARE(tts.findVoices(voices.first().locale()).first(), voices.first());
+    QVERIFY(tts.availableLocales().contains(voices.first().locale()));
+    QTRY_VERIFY(future.isFinished());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(tts.findVoices(), voices);
+    tts.setVoice(voices.last());
+    QCOMPARE(tts.voice(), voices.last());
+
+    // outdated voices are replaced once the engine has enumerated its voices
+    QVERIFY(QTextToSpeechVoiceCatalog::write(fileName, {voices.first()}));
+    QFuture<bool> second = tts.setEngineAsync(engine);
+    QSignalSpy voicesSpy(&tts, &QTextToSpeech::voicesChanged);
+    QCOMPARE(tts.findVoices(), QList<QVoice>{voices.first()});
+    QTRY_VERIFY(second.isFinished());
+    QTRY_COMPARE(voicesSpy.size(), 1);
+    QCOMPARE(tts.findVoices(), voices);
+    QCOMPARE(QTextToSpeechVoiceCatalog::read(fileName), voices);
+}
+
+void tst_QTextToSpeech::enqueueRanges()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with the mock engine");
+
+    QTextToSpeech tts(engine);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    const QString document = u"One two. Three four five. Six"_s;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(u"Cannot enqueue range"_s));
+    QVERIFY(tts.enqueue(document, {{0, 8}, {20, 20}}).isEmpty());
+    QCOMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QList<std::pair<QString, qsizetype>> words;
+    connect(&tts, &QTextToSpeech::sayingWord, this,
+            [&words](const QString &word, qsizetype, qsizetype start) {
+        words.append({word, start});
+    });
+    QSignalSpy aboutToSynthesizeSpy(&tts, &QTextToSpeech::aboutToSynthesize);
+
+    const QList<qsizetype> ids = tts.enqueue(document, {{9, 16}, {0, 7}});
+    QCOMPARE(ids.size(), 2);
+    QCOMPARE_NE(ids.first(), ids.last());
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(aboutToSynthesizeSpy.size(), 2);
+    QCOMPARE(aboutToSynthesizeSpy.first().first().value<qsizetype>(), ids.first());
+
+    // the words are reported at their position in the document
+    const QList<std::pair<QString, qsizetype>> expected = {
+        {u"Three"_s, 9}, {u"four"_s, 15}, {u"five"_s, 20}, {u"One"_s, 0}, {u"two"_s, 4},
+    };
+    QCOMPARE(words, expected);
+}
+
+void tst_QTextToSpeech::additionalAudioDevices()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine plays to several devices");
+    const QList<QAudioDevice> devices = QMediaDevices::audioOutputs();
+    if (devices.size() < 2)
+        QSKIP("This test requires two audio output devices");
+
+    QTextToSpeech tts(engine, {
+        {u"audioDevice"_s, QVariant::fromValue(devices.at(0))},
+        {u"additionalAudioDevices"_s, QVariantList{
+            QVariantMap{{u"device"_s, QVariant::fromValue(devices.at(1))},
+                        {u"volume"_s, 0.5}, {u"delay"_s, 20}}
+        }},
+    });
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QSignalSpy wordSpy(&tts, &QTextToSpeech::sayingWord);
+
+    tts.say(u"Attention please, this is an announcement."_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE_WITH_TIMEOUT(tts.state(), QTextToSpeech::Ready, 10000);
+    QCOMPARE(wordSpy.size(), 6);
+}
+
+void tst_QTextToSpeech::gaplessFlite()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine has a gapless mode");
+    if (!hasDefaultAudioOutput())
+        QSKIP("No audio device present");
+
+    QTextToSpeech tts(engine, {{u"gapless"_s, true}, {u"utteranceGap"_s, 100}});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+
+    QStringList words;
+    connect(&tts, &QTextToSpeech::sayingWord, this, [&words](const QString &word) {
+        words << word;
+    });
+    QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+    QSignalSpy aboutToSynthesizeSpy(&tts, &QTextToSpeech::aboutToSynthesize);
+
+    tts.enqueue(u"This is the first text"_s);
+    tts.enqueue(u"and this is the second text"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE_WITH_TIMEOUT(tts.state(), QTextToSpeech::Ready, 10000);
+    QCOMPARE(aboutToSynthesizeSpy.size(), 2);
+    QCOMPARE(words.size(), 11);
+    // no Ready state between the texts
+    QCOMPARE(stateSpy.size(), 2);
+
+    // another text continues the stream of the previous one
+    words.clear();
+    tts.say(u"Once more"_s);
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Speaking);
+    QTRY_COMPARE_WITH_TIMEOUT(tts.state(), QTextToSpeech::Ready, 10000);
+    QCOMPARE(words, (QStringList{u"Once"_s, u"more"_s}));
+}
+
+void tst_QTextToSpeech::outputStream()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    QTextToSpeech tts(engine, {{u"outputStream"_s, true}});
+    QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+    QIODevice *stream = tts.outputStream();
+    QVERIFY(stream);
+    QVERIFY(stream->isSequential());
+    QVERIFY(tts.engineCapabilities() & QTextToSpeech::Capability::Speak);
+
+    QSignalSpy wordSpy(&tts, &QTextToSpeech::sayingWord);
+    tts.say(u"one two three"_s);
+    QCOMPARE(tts.state(), QTextToSpeech::Speaking);
+
+    // nothing is spoken until the audio is read
+    QTRY_VERIFY(stream->bytesAvailable() > 0);
+    QCOMPARE(wordSpy.size(), 0);
+    QByteArray audio = stream->read(1);
+    QCOMPARE(audio.size(), 1);
+    QTRY_COMPARE(wordSpy.size(), 1);
+    QCOMPARE(wordSpy.first().at(0).toString(), u"one"_s);
+
+    tts.pause(QTextToSpeech::BoundaryHint::Immediate);
+    QCOMPARE(tts.state(), QTextToSpeech::Paused);
+    QCOMPARE(stream->bytesAvailable(), 0);
+    QVERIFY(stream->readAll().isEmpty());
+    tts.resume();
+    QCOMPARE(tts.state(), QTextToSpeech::Speaking);
+
+    QTRY_VERIFY_WITH_TIMEOUT((audio += stream->readAll(), tts.state() == QTextToSpeech::Ready),
+                             5000);
+    QCOMPARE(wordSpy.size(), 3);
+    QVERIFY(audio.size() > 1);
+    QCOMPARE(stream->bytesAvailable(), 0);
+
+    // stopping drops the audio that was not read
+    tts.say(u"one two three"_s);
+    QTRY_VERIFY(stream->bytesAvailable() > 0);
+    tts.stop(QTextToSpeech::BoundaryHint::Immediate);
+    QCOMPARE(tts.state(), QTextToSpeech::Ready);
+    QCOMPARE(stream->bytesAvailable(), 0);
+
+    // the engine gets the next sentence only once the audio has been read
+    tts.setSynthesizeBufferLimit(1);
+    wordSpy.clear();
+    tts.say(u"One. Two. Three."_s);
+    QTRY_VERIFY(stream->bytesAvailable() > 0);
+    const qint64 sentenceBytes = stream->bytesAvailable();
+    QTest::qWait(300);
+    QCOMPARE(stream->bytesAvailable(), sentenceBytes);
+    QTRY_VERIFY_WITH_TIMEOUT((stream->readAll(), tts.state() == QTextToSpeech::Ready), 5000);
+    QCOMPARE(wordSpy.size(), 3);
+    QCOMPARE(wordSpy.at(1).at(0).toString(), u"Two"_s);
+    QCOMPARE(wordSpy.at(1).at(2).toLongLong(), 5);
+    QCOMPARE(wordSpy.at(2).at(2).toLongLong(), 10);
+
+    // without the parameter, the engine plays the speech itself
+    QVERIFY(tts.setEngine(engine, {{u"outputStream"_s, false}}));
+    QCOMPARE(tts.outputStream(), nullptr);
+}
+
+void tst_QTextToSpeech::fliteLexicon()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "flite")
+        QSKIP("Only the flite engine supports a lexicon");
+
+    const auto synthesize = [&engine](const QVariantMap &params, qint64 *duration) {
+        QTextToSpeech tts(engine, params);
+        *duration = 0;
+        tts.synthesize(u"hello world"_s, [duration](const QAudioFormat &format,
+                                                  const QByteArray &bytes) {
+            *duration += format.durationForBytes(bytes.size());
+        });
+        QTRY_COMPARE_WITH_TIMEOUT(tts.state(), QTextToSpeech::Ready, 10000);
+    };
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile lexicon(dir.filePath(u"lexicon.txt"_s));
+    QVERIFY(lexicon.open(QIODevice::WriteOnly));
+    // a much longer pronunciation than the one of the voice
+    lexicon.write("hello hh ah0 l ow1 hh ah0 l ow1 hh ah0 l ow1 hh ah0 l ow1\n"
+                  "world w er1 l d\n");
+    lexicon.close();
+
+    qint64 defaultDuration = 0;
+    synthesize({}, &defaultDuration);
+    QCOMPARE_GT(defaultDuration, 0);
+    // the second time, the pronunciations come from the cache
+    qint64 duration = 0;
+    synthesize({}, &duration);
+    QCOMPARE(duration, defaultDuration);
+    synthesize({{u"lexicon"_s, lexicon.fileName()}}, &duration);
+    QCOMPARE_GT(duration, defaultDuration);
+
+    // unsorted lexicons are ignored
+    QVERIFY(lexicon.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    lexicon.write("world w er1 l d\n"
+                  "hello hh ah0 l ow1 hh ah0 l ow1 hh ah0 l ow1 hh ah0 l ow1\n");
+    lexicon.close();
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(u"is not sorted"_s));
+    synthesize({{u"lexicon"_s, lexicon.fileName()}}, &duration);
+    QCOMPARE(duration, defaultDuration);
+}
+
+void tst_QTextToSpeech::audioCacheCompression()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    using Compression = QTextToSpeech::AudioCompression;
+
+    // a tone with a bit of noise, in stereo
+    QAudioFormat format;
+    format.setSampleRate(22050);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::Int16);
+    QByteArray pcm(format.bytesForDuration(100000), Qt::Uninitialized);
+    auto *samples = reinterpret_cast<qint16 *>(pcm.data());
+    const qsizetype count = pcm.size() / format.bytesPerSample();
+    for (qsizetype i = 0; i < count; ++i)
+        samples[i] = qint16(8000 * qSin(i * 0.05) + (i * 7919) % 64);
+
+    QCOMPARE(QTextToSpeechAudioCodec::encode(Compression::None, format, pcm), pcm);
+    const QByteArray lossless = QTextToSpeechAudioCodec::encode(Compression::Lossless, format, pcm);
+    QCOMPARE_LT(lossless.size(), pcm.size());
+    QCOMPARE(QTextToSpeechAudioCodec::decode(Compression::Lossless, format, lossless), pcm);
+    QCOMPARE(QTextToSpeechAudioCodec::decode(Compression::Lossless, format, lossless.chopped(8)),
+             QByteArray());
+
+    const QByteArray lossy = QTextToSpeechAudioCodec::encode(Compression::Lossy, format, pcm);
+    QCOMPARE_LE(lossy.size(), pcm.size() / 4 + 8);
+    const QByteArray decoded = QTextToSpeechAudioCodec::decode(Compression::Lossy, format, lossy);
+    QCOMPARE(decoded.size(), pcm.size());
+    const auto *decodedSamples = reinterpret_cast<const qint16 *>(decoded.constData());
+    double signal = 0;
+    double noise = 0;
+    for (qsizetype i = 0; i < count; ++i) {
+        signal += double(samples[i]) * samples[i];
+        noise += double(samples[i] - decodedSamples[i]) * (samples[i] - decodedSamples[i]);
+    }
+    QCOMPARE_GT(signal, 100 * noise);
+
+    // only 16 bit audio is compressed
+    QAudioFormat floatFormat = format;
+    floatFormat.setSampleFormat(QAudioFormat::Float);
+    QVERIFY(!QTextToSpeechAudioCodec::canEncode(floatFormat, pcm.size()));
+    QCOMPARE(QTextToSpeechAudioCodec::encode(Compression::Lossless, floatFormat, pcm), pcm);
+
+    // cached audio is delivered as it was synthesized, and takes less space
+    const QString text = u"this will produce more than one chunk."_s;
+    for (const Compression compression : {Compression::Lossless, Compression::Lossy}) {
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        QTextToSpeech tts(engine);
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QCOMPARE(tts.audioCacheCompression(), Compression::None);
+        tts.setAudioCacheLimit(1024 * 1024);
+        tts.setAudioCacheDirectory(cacheDir.path());
+        tts.setAudioCacheCompression(compression);
+        QCOMPARE(tts.audioCacheCompression(), compression);
+
+        QByteArray expected;
+        tts.synthesize(text, [&expected](const QAudioFormat &, const QByteArray &bytes) {
+            expected += bytes;
+        });
+        QTRY_COMPARE(tts.state(), QTextToSpeech::Ready);
+        QVERIFY(!expected.isEmpty());
+        const QFileInfoList files = QDir(cacheDir.path()).entryInfoList(QDir::Files);
+        QCOMPARE(files.size(), 1);
+        QCOMPARE_LT(files.first().size(), expected.size() / 2);
+
+        QSignalSpy stateSpy(&tts, &QTextToSpeech::stateChanged);
+        QByteArray cached;
+        tts.synthesize(text, [&cached](const QAudioFormat &, const QByteArray &bytes) {
+            cached += bytes;
+        });
+        QTRY_COMPARE(stateSpy.size(), 2);
+        // the mock engine synthesizes silence, which both compressions preserve
+        QCOMPARE(cached, expected);
+
+        // and from disk
+        QTextToSpeech other(engine);
+        QTRY_COMPARE(other.state(), QTextToSpeech::Ready);
+        other.setAudioCacheDirectory(cacheDir.path());
+        cached.clear();
+        other.synthesize(text, [&cached](const QAudioFormat &, const QByteArray &bytes) {
+            cached += bytes;
+        });
+        QTRY_COMPARE(other.state(), QTextToSpeech::Ready);
+        QCOMPARE(cached, expected);
+    }
+}
+
+void tst_QTextToSpeech::workerThreads()
+{
+    QFETCH_GLOBAL(QString, engine);
+    if (engine != "mock")
+        QSKIP("Only testing with mock engine");
+
+    struct Result
+    {
+        bool ready = false;
+        bool finished = false;
+        QByteArray audio;
+        QStringList words;
+    };
+    const QString text = u"this will produce more than one chunk."_s;
+    // QTest's macros can only be used in the main thread
+    const auto synthesize = [&engine, &text](Result *result) {
+        QTextToSpeech tts(engine);
+        result->ready = QTest::qWaitFor([&tts]{
+            return tts.state() == QTextToSpeech::Ready;
+        }, 10000);
+        if (!result->ready)
+            return;
+        QObject::connect(&tts, &QTextToSpeech::synthesizedWord, &tts,
+                         [result](const QString &word) {
+            result->words.append(word);
+        });
+        tts.synthesize(text, [result](const QAudioFormat &, const QByteArray &bytes) {
+            result->audio += bytes;
+        });
+        result->finished = QTest::qWaitFor([&tts]{
+            return tts.state() == QTextToSpeech::Ready;
+        }, 10000);
+    };
+
+    Result expected;
+    synthesize(&expected);
+    QVERIFY(expected.finished);
+    QVERIFY(!expected.audio.isEmpty());
+
+    // several objects, each in a thread of its own, at the same time
+    constexpr int threadCount = 4;
+    Result results[threadCount];
+    std::unique_ptr<QThread> threads[threadCount];
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].reset(QThread::create(synthesize, &results[i]));
+        threads[i]->start();
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        QVERIFY(threads[i]->wait(QDeadlineTimer(30000)));
+        QVERIFY(results[i].ready);
+        QVERIFY(results[i].finished);
+        QCOMPARE(results[i].audio, expected.audio);
+        QCOMPARE(results[i].words, expected.words);
+    }
+}
+
 QTEST_MAIN(tst_QTextToSpeech)
 #include "tst_qtexttospeech.moc"
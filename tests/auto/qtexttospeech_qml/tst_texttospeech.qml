@@ -43,6 +43,22 @@ TestCase {
         compare(def.pitch, 0.1)
     }
 
+    Component {
+        id: asynchronousEngine
+        TextToSpeech {
+            asynchronous: true
+            engine: "mock"
+            rate: 0.5
+        }
+    }
+
+    function test_asynchronous() {
+        let speech = createTemporaryObject(asynchronousEngine, testCase)
+        tryCompare(speech, "state", TextToSpeech.Ready)
+        compare(speech.engine, "mock")
+        compare(speech.rate, 0.5)
+    }
+
     function test_availableLocales() {
         compare(tts.availableLocales().length, 5)
     }
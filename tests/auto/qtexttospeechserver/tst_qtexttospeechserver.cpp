@@ -0,0 +1,249 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+
+#include <QTest>
+#include <QTextToSpeech>
+#include <QBuffer>
+#include <QLocalSocket>
+#include <QtTextToSpeech/private/qtexttospeechremote_p.h>
+
+#include "qtexttospeechserver.h"
+
+#include <algorithm>
+
+using namespace Qt::StringLiterals;
+using Message = QTextToSpeechRemote::Message;
+
+// Speaks the protocol of the "remote" engine, without blocking the event
+// loop that the server in the same thread needs
+class RemoteClient
+{
+public:
+    struct Received
+    {
+        Message message;
+        QByteArray payload;
+
+        // the request that a message from the server is about
+        quint32 request() const
+        {
+            QDataStream in(payload);
+            in.setVersion(QTextToSpeechRemote::StreamVersion);
+            quint32 request;
+            in >> request;
+            return request;
+        }
+
+        QTextToSpeech::State state() const
+        {
+            QDataStream in(payload);
+            in.setVersion(QTextToSpeechRemote::StreamVersion);
+            quint32 request;
+            qint32 state;
+            in >> request >> state;
+            return QTextToSpeech::State(state);
+        }
+    };
+
+    bool connectTo(const QString &serverName)
+    {
+        QObject::connect(&socket, &QLocalSocket::readyRead, &socket, [this]{
+            reader.read(&socket);
+            Received received;
+            while (reader.next(&received.message, &received.payload))
+                messages.append(received);
+        });
+        socket.connectToServer(serverName);
+        return socket.waitForConnected(1000);
+    }
+
+    template <typename ...Args>
+    void send(Message message, const Args &...args)
+    {
+        QTextToSpeechRemote::send(&socket, message, args...);
+    }
+
+    bool hasState(quint32 request, QTextToSpeech::State state) const
+    {
+        return std::any_of(messages.cbegin(), messages.cend(), [=](const Received &received) {
+            return received.message == Message::State && received.request() == request
+                && received.state() == state;
+        });
+    }
+
+    QList<QTextToSpeech::State> states(quint32 request) const
+    {
+        QList<QTextToSpeech::State> states;
+        for (const Received &received : messages) {
+            if (received.message == Message::State && received.request() == request)
+                states << received.state();
+        }
+        return states;
+    }
+
+    QLocalSocket socket;
+    QTextToSpeechRemote::Reader reader;
+    QList<Received> messages;
+};
+
+class tst_QTextToSpeechServer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void reader();
+    void say();
+    void synthesize();
+    void nextRequest();
+
+private:
+    bool startClient(RemoteClient &client);
+
+    QString m_serverName;
+    std::unique_ptr<QTextToSpeechServer> m_server;
+};
+
+void tst_QTextToSpeechServer::initTestCase()
+{
+    if (!QTextToSpeech::availableEngines().contains(u"mock"_s))
+        QSKIP("The server is tested with the mock engine");
+    m_serverName = u"tst_qtexttospeechserver-%1"_s.arg(QCoreApplication::applicationPid());
+}
+
+void tst_QTextToSpeechServer::init()
+{
+    m_server = std::make_unique<QTextToSpeechServer>();
+    QVERIFY2(m_server->listen(m_serverName), qPrintable(m_server->errorString()));
+}
+
+bool tst_QTextToSpeechServer::startClient(RemoteClient &client)
+{
+    if (!client.connectTo(m_serverName))
+        return false;
+    client.send(Message::Hello, QTextToSpeechRemote::ProtocolVersion, u"mock"_s,
+                QVariantMap());
+    return QTest::qWaitFor([&client]{
+        return !client.messages.isEmpty() && client.messages.first().message == Message::Init;
+    });
+}
+
+void tst_QTextToSpeechServer::reader()
+{
+    QBuffer frames;
+    frames.open(QIODevice::WriteOnly);
+    QTextToSpeechRemote::send(&frames, Message::Say, quint32(7), u"hello"_s);
+    const qsizetype firstSize = frames.size();
+    // frames without a message type are skipped
+    frames.write(QByteArray(sizeof(quint32), '\0'));
+    QTextToSpeechRemote::send(&frames, Message::Resume);
+    const QByteArray data = frames.data();
+
+    // messages are only complete once all of their data arrived
+    QTextToSpeechRemote::Reader reader;
+    QList<std::pair<Message, QByteArray>> messages;
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        QBuffer chunk;
+        chunk.setData(data.sliced(i, 1));
+        chunk.open(QIODevice::ReadOnly);
+        reader.read(&chunk);
+        Message message;
+        QByteArray payload;
+        while (reader.next(&message, &payload))
+            messages.append({message, payload});
+        QCOMPARE(messages.size(), i < firstSize - 1 ? 0 : i < data.size() - 1 ? 1 : 2);
+    }
+
+    QCOMPARE(messages.at(0).first, Message::Say);
+    QDataStream in(messages.at(0).second);
+    in.setVersion(QTextToSpeechRemote::StreamVersion);
+    quint32 request;
+    QString text;
+    in >> request >> text;
+    QCOMPARE(request, 7u);
+    QCOMPARE(text, u"hello"_s);
+    QVERIFY(in.atEnd());
+
+    QCOMPARE(messages.at(1).first, Message::Resume);
+    QVERIFY(messages.at(1).second.isEmpty());
+}
+
+void tst_QTextToSpeechServer::say()
+{
+    RemoteClient client;
+    QVERIFY(startClient(client));
+
+    client.send(Message::Say, quint32(1), u"one two three"_s);
+    QTRY_VERIFY(client.hasState(1, QTextToSpeech::Ready));
+    QCOMPARE(client.states(1), (QList{QTextToSpeech::Speaking, QTextToSpeech::Ready}));
+
+    QStringList words;
+    for (const auto &received : std::as_const(client.messages)) {
+        if (received.message != Message::SayingWord)
+            continue;
+        QDataStream in(received.payload);
+        in.setVersion(QTextToSpeechRemote::StreamVersion);
+        quint32 request;
+        QString word;
+        in >> request >> word;
+        QCOMPARE(request, 1u);
+        words << word;
+    }
+    QCOMPARE(words, (QStringList{u"one"_s, u"two"_s, u"three"_s}));
+}
+
+void tst_QTextToSpeechServer::synthesize()
+{
+    RemoteClient client;
+    QVERIFY(startClient(client));
+
+    client.send(Message::Synthesize, quint32(1), u"one two"_s);
+    QTRY_VERIFY(client.hasState(1, QTextToSpeech::Ready));
+
+    qsizetype bytes = 0;
+    for (const auto &received : std::as_const(client.messages)) {
+        if (received.message != Message::Synthesized)
+            continue;
+        QDataStream in(received.payload);
+        in.setVersion(QTextToSpeechRemote::StreamVersion);
+        quint32 request;
+        qint32 sampleRate, channelCount, sampleFormat;
+        QByteArray data;
+        in >> request >> sampleRate >> channelCount >> sampleFormat >> data;
+        QCOMPARE(request, 1u);
+        QCOMPARE_GT(sampleRate, 0);
+        bytes += data.size();
+    }
+    QCOMPARE_GT(bytes, 0);
+}
+
+void tst_QTextToSpeechServer::nextRequest()
+{
+    RemoteClient client;
+    QVERIFY(startClient(client));
+
+    client.send(Message::Say, quint32(1), u"one two three four five"_s);
+    QTRY_VERIFY(client.hasState(1, QTextToSpeech::Speaking));
+    client.send(Message::Say, quint32(2), u"six seven"_s);
+    QTRY_VERIFY(client.hasState(2, QTextToSpeech::Ready));
+
+    // stopping the first request is reported for it, and all messages about
+    // the second request follow
+    QCOMPARE(client.states(1).last(), QTextToSpeech::Ready);
+    QCOMPARE(client.states(2), (QList{QTextToSpeech::Speaking, QTextToSpeech::Ready}));
+    bool second = false;
+    for (const auto &received : std::as_const(client.messages)) {
+        if (received.message == Message::Init || received.message == Message::Voices)
+            continue;
+        if (received.request() == 2)
+            second = true;
+        else
+            QVERIFY(!second);
+    }
+}
+
+QTEST_MAIN(tst_QTextToSpeechServer)
+#include "tst_qtexttospeechserver.moc"
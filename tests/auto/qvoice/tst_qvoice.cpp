@@ -41,6 +41,10 @@ void tst_QVoice::init()
             QSKIP("speechd engine reported an error, "
                   "make sure the speech-dispatcher service is running!");
         }
+    } else if (engine == "remote") {
+        QTextToSpeech tts(engine);
+        if (tts.state() == QTextToSpeech::Error)
+            QSKIP("remote engine reported an error, make sure qttexttospeechserver is running!");
     } else if (engine == "darwin"
         && QOperatingSystemVersion::current() <= QOperatingSystemVersion::MacOSMojave) {
         QTextToSpeech tts(engine);
@@ -93,6 +97,11 @@ void tst_QVoice::sameEngine()
 
     for (const auto &voice : voices)
         QVERIFY(tts2.availableVoices().indexOf(voice) != -1);
+
+    // both engines share the data of each voice
+    const QList<QVoice> voices2 = tts2.availableVoices();
+    for (qsizetype i = 0; i < voices.size(); ++i)
+        QCOMPARE(voices.at(i).name().constData(), voices2.at(i).name().constData());
 }
 
 void tst_QVoice::datastream()
@@ -118,6 +127,7 @@ void tst_QVoice::datastream()
     readStream >> loadedVoice;
 
     QCOMPARE(loadedVoice, savedVoice);
+    QCOMPARE(loadedVoice.name().constData(), savedVoice.name().constData());
 }
 
 QTEST_MAIN(tst_QVoice)
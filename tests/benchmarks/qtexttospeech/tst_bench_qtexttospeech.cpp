@@ -0,0 +1,157 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QTest>
+#include <QTextToSpeech>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+#include <QAudioFormat>
+
+using namespace Qt::StringLiterals;
+
+enum : int { SynthesisTimeout = 60000 };
+
+class tst_QTextToSpeechBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase_data();
+    void init();
+
+    void construction();
+    void availableVoices();
+    void findVoices();
+
+    void timeToFirstChunk();
+    void synthesizeThroughput();
+
+private:
+    static bool waitForState(QTextToSpeech &tts, QTextToSpeech::State state)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (tts.state() != state && timer.elapsed() < SynthesisTimeout)
+            QTest::qWait(1);
+        return tts.state() == state;
+    }
+
+    static const QString &paragraph()
+    {
+        static const QString text = u"The quick brown fox jumps over the lazy dog. "
+                                    "Speech synthesis turns written text into audio, "
+                                    "one sentence after the other. This paragraph is long "
+                                    "enough to produce several chunks of data in every engine, "
+                                    "and short enough to keep the benchmark fast."_s;
+        return text;
+    }
+};
+
+void tst_QTextToSpeechBenchmark::initTestCase_data()
+{
+    QTest::addColumn<QString>("engine");
+    const auto engines = QTextToSpeech::availableEngines();
+    if (engines.isEmpty())
+        QSKIP("No speech engines available, skipping benchmark");
+    for (const auto &engine : engines)
+        QTest::addRow("%s", engine.toUtf8().constData()) << engine;
+}
+
+void tst_QTextToSpeechBenchmark::init()
+{
+    QFETCH_GLOBAL(QString, engine);
+    QTextToSpeech tts(engine);
+    if (!waitForState(tts, QTextToSpeech::Ready))
+        QSKIP("Engine is not functional on this system");
+}
+
+void tst_QTextToSpeechBenchmark::construction()
+{
+    QFETCH_GLOBAL(QString, engine);
+
+    QBENCHMARK {
+        QTextToSpeech tts(engine);
+        QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+    }
+}
+
+void tst_QTextToSpeechBenchmark::availableVoices()
+{
+    QFETCH_GLOBAL(QString, engine);
+    QTextToSpeech tts(engine);
+    QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+
+    QBENCHMARK {
+        const QList<QVoice> voices = tts.availableVoices();
+        Q_UNUSED(voices);
+    }
+}
+
+void tst_QTextToSpeechBenchmark::findVoices()
+{
+    QFETCH_GLOBAL(QString, engine);
+    QTextToSpeech tts(engine);
+    QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+
+    QBENCHMARK {
+        const QList<QVoice> voices = tts.findVoices(QVoice::Female);
+        Q_UNUSED(voices);
+    }
+}
+
+void tst_QTextToSpeechBenchmark::timeToFirstChunk()
+{
+    QFETCH_GLOBAL(QString, engine);
+    QTextToSpeech tts(engine);
+    QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+    if (!(tts.engineCapabilities() & QTextToSpeech::Capability::Synthesize))
+        QSKIP("This engine doesn't support synthesize()");
+
+    QBENCHMARK {
+        bool received = false;
+        tts.synthesize(paragraph(), [&received](const QAudioFormat &, const QByteArray &) {
+            received = true;
+        });
+        QTRY_VERIFY_WITH_TIMEOUT(received, SynthesisTimeout);
+        // don't include the rest of the synthesis in the measurement
+        QBENCHMARK_PAUSE_MEASUREMENT {
+            QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+        }
+    }
+}
+
+/*
+    Reports the synthesized bytes per second, and logs the real-time factor,
+    i.e. how many seconds of audio are produced per second of processing.
+*/
+void tst_QTextToSpeechBenchmark::synthesizeThroughput()
+{
+    QFETCH_GLOBAL(QString, engine);
+    QTextToSpeech tts(engine);
+    QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+    if (!(tts.engineCapabilities() & QTextToSpeech::Capability::Synthesize))
+        QSKIP("This engine doesn't support synthesize()");
+
+    QAudioFormat format;
+    qint64 bytes = 0;
+    QSignalSpy spy(&tts, &QTextToSpeech::stateChanged);
+    QElapsedTimer timer;
+    timer.start();
+    tts.synthesize(paragraph(), [&format, &bytes](const QAudioFormat &f, const QByteArray &data) {
+        format = f;
+        bytes += data.size();
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(spy.size() >= 2, SynthesisTimeout);
+    QVERIFY(waitForState(tts, QTextToSpeech::Ready));
+    const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+
+    QVERIFY(format.isValid());
+    QVERIFY(bytes > 0);
+    const qreal audioSeconds = format.durationForBytes(bytes) / 1000000.0;
+    qInfo("Real-time factor: %.2f (%.2fs of audio in %lldms)",
+          audioSeconds * 1000 / elapsed, audioSeconds, elapsed);
+    QTest::setBenchmarkResult(bytes * 1000.0 / elapsed, QTest::BytesPerSecond);
+}
+
+QTEST_MAIN(tst_QTextToSpeechBenchmark)
+#include "tst_bench_qtexttospeech.moc"